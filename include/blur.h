@@ -0,0 +1,45 @@
+#ifndef BLUR_H
+#define BLUR_H
+
+#include "image_processing.h"
+#include "filters.h"
+
+/**
+ * Gaussian blur implementations selectable with --blur-mode
+ */
+typedef enum {
+    BLUR_MODE_KERNEL,       // Sampled size x size kernel (cost grows with sigma)
+    BLUR_MODE_RECURSIVE,    // Young-van Vliet IIR Gaussian (constant cost per pixel)
+    BLUR_MODE_BOX           // Three stacked running-sum box filters (constant cost per pixel)
+} blur_mode_t;
+
+/**
+ * Parse a blur mode name ("kernel", "iir", "box")
+ * Returns false for unknown names
+ */
+bool parse_blur_mode(const char* mode_str, blur_mode_t* mode);
+
+/**
+ * Kernel dimension used by BLUR_MODE_KERNEL for a given sigma (5 for sigma 1)
+ */
+size_t gaussian_kernel_size(float sigma);
+
+/**
+ * True when a blur with this sigma and mode runs as a sampled-kernel
+ * convolution (the recursive mode falls back to it for small sigma)
+ */
+bool blur_uses_kernel(float sigma, blur_mode_t mode);
+
+/**
+ * Blur a grayscale image with a Gaussian of standard deviation sigma
+ * Returns a new image with the filter applied
+ */
+grayscale_image_t apply_gaussian_blur(const grayscale_image_t* image, float sigma, blur_mode_t mode);
+
+/**
+ * Blur each channel of an RGB image with a Gaussian of standard deviation sigma
+ * Returns a new image with the filter applied
+ */
+rgb_image_t apply_gaussian_blur_rgb(const rgb_image_t* image, float sigma, blur_mode_t mode);
+
+#endif // BLUR_H
@@ -0,0 +1,24 @@
+#ifndef FFT_CONVOLUTION_H
+#define FFT_CONVOLUTION_H
+
+#include "filters.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Cost model: true when tiled FFT convolution of a width x height channel is
+ * expected to beat the spatial path for this kernel (two 1D passes when
+ * `separable`, a direct K x K sweep otherwise)
+ */
+bool fft_convolution_preferred(const kernel_t* kernel, size_t width, size_t height, bool separable);
+
+/**
+ * Convolve one 8-bit channel, with rows `input_stride` bytes apart, into a
+ * packed output by multiplying spectra tile by tile, with the same clamped
+ * borders, divisor and offset as the spatial path.
+ * Returns false if memory or an FFTW plan could not be allocated
+ */
+bool fft_convolve_channel(const unsigned char* input, size_t input_stride, unsigned char* output,
+                          size_t width, size_t height, const kernel_t* kernel);
+
+#endif // FFT_CONVOLUTION_H
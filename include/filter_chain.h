@@ -0,0 +1,74 @@
+#ifndef FILTER_CHAIN_H
+#define FILTER_CHAIN_H
+
+#include "image_processing.h"
+#include "filters.h"
+#include "blur.h"
+
+#define MAX_CHAIN_FILTERS 8
+
+/**
+ * Filters applied one after another, as given to -f (e.g. "blur,sharpen,sobel")
+ */
+typedef struct {
+    filter_type_t filters[MAX_CHAIN_FILTERS];
+    size_t count;
+} filter_chain_t;
+
+/**
+ * Settings shared by the filters of a chain
+ */
+typedef struct {
+    blur_mode_t blur_mode;
+    float blur_sigma;
+    float noise_density;
+    double cutoff;
+    int median_radius;
+    int element_width;      // Morphology structuring element
+    int element_height;
+    float spatial_sigma;    // Bilateral filter
+    float range_sigma;
+    int guided_radius;      // Guided filter
+    float guided_epsilon;
+    int guided_subsample;
+    int nlm_search_radius;  // Non-local means
+    int nlm_patch_radius;
+    float nlm_strength;
+} filter_chain_params_t;
+
+/**
+ * Parse a comma-separated list of filter names; "none" entries are dropped
+ * Returns false for unknown names, empty entries or more than
+ * MAX_CHAIN_FILTERS filters
+ */
+bool parse_filter_chain(const char* chain_str, filter_chain_t* chain);
+
+/**
+ * True when every filter of the chain has an RGB form in the single-filter
+ * path (blur, sharpen, median, bilateral, guided, non-local means and
+ * morphology)
+ */
+bool filter_chain_preserves_color(const filter_chain_t* chain);
+
+/**
+ * Apply a chain of filters to a grayscale image. Runs of neighbourhood
+ * filters (kernel blur, sharpen, Laplacian, Sobel, Prewitt, Roberts) are
+ * fused: each band of output rows streams through per-filter line buffers
+ * instead of materialising an image per filter. Other filters, including
+ * the median, the edge-aware smoothers and morphology, run on the whole
+ * image between runs. The result equals applying the filters one by one.
+ * Returns a new image with the chain applied
+ */
+grayscale_image_t apply_filter_chain(const grayscale_image_t* image, const filter_chain_t* chain,
+                                     const filter_chain_params_t* params);
+
+/**
+ * Apply a chain to an RGB image: filters run on each channel separately,
+ * except bilateral, guided and non-local means stages, which take their
+ * edges from the whole image as the single-filter path does
+ * Only meaningful when filter_chain_preserves_color holds
+ */
+rgb_image_t apply_filter_chain_rgb(const rgb_image_t* image, const filter_chain_t* chain,
+                                   const filter_chain_params_t* params);
+
+#endif // FILTER_CHAIN_H
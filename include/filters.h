@@ -3,6 +3,12 @@
 
 #include "image_processing.h"
 #include <stddef.h>
+#include <stdint.h>
+
+#define DEFAULT_BILATERAL_SPATIAL_SIGMA 8.0f
+#define DEFAULT_BILATERAL_RANGE_SIGMA 25.0f
+#define DEFAULT_GUIDED_RADIUS 8
+#define DEFAULT_GUIDED_EPSILON 0.01f      // 0.1^2 on [0, 1] intensities
 
 /**
  * Represents a convolution kernel
@@ -27,12 +33,63 @@ typedef enum {
     FILTER_EDGE_LAPLACIAN,
     FILTER_EDGE_CANNY,
     FILTER_SALT_PEPPER,
+    FILTER_MEDIAN,
+    FILTER_BILATERAL,
+    FILTER_GUIDED,
+    FILTER_NL_MEANS,
+    FILTER_ERODE,
+    FILTER_DILATE,
+    FILTER_OPEN,
+    FILTER_CLOSE,
+    FILTER_TOPHAT,
     FILTER_IDEAL_LOWPASS,
     FILTER_IDEAL_HIGHPASS,
     FILTER_GAUSSIAN_LOWPASS,
     FILTER_GAUSSIAN_HIGHPASS
 } filter_type_t;
 
+/**
+ * Derivative operators supported by the fused gradient kernel
+ */
+typedef enum {
+    GRADIENT_SOBEL,
+    GRADIENT_PREWITT,
+    GRADIENT_ROBERTS
+} gradient_operator_t;
+
+/**
+ * Magnitude computed alongside the gradient (NONE skips the magnitude plane)
+ */
+typedef enum {
+    GRADIENT_NORM_NONE,
+    GRADIENT_NORM_L1,
+    GRADIENT_NORM_L2
+} gradient_norm_t;
+
+/**
+ * Quantized gradient orientation: atan2(gy, gx) folded into [0, 180) degrees
+ */
+typedef enum {
+    GRADIENT_DIR_0,     // [0, 22.5) and [157.5, 180)
+    GRADIENT_DIR_45,    // [22.5, 67.5)
+    GRADIENT_DIR_90,    // [67.5, 112.5)
+    GRADIENT_DIR_135    // [112.5, 157.5)
+} gradient_direction_t;
+
+/**
+ * Signed image gradient with optional magnitude and orientation planes.
+ * All planes are width * height, row-major. They come from the buffer
+ * pool (image_alloc.h), so release them with free_gradient_field only.
+ */
+typedef struct {
+    size_t width;
+    size_t height;
+    int16_t* gx;                // Horizontal derivative
+    int16_t* gy;                // Vertical derivative
+    uint16_t* magnitude;        // NULL when norm is GRADIENT_NORM_NONE
+    unsigned char* direction;   // gradient_direction_t per pixel, NULL unless requested
+} gradient_field_t;
+
 /**
  * Apply a convolution kernel to a grayscale image
  * Returns a new image with the filter applied
@@ -45,6 +102,66 @@ grayscale_image_t apply_convolution_grayscale(const grayscale_image_t* image, co
  */
 rgb_image_t apply_convolution_rgb(const rgb_image_t* image, const kernel_t* kernel);
 
+/**
+ * Edge-preserving smoothing with a bilateral grid: a Gaussian of
+ * spatial_sigma pixels that only averages pixels within about range_sigma
+ * grey levels of each other. Cost scales with the grid, which shrinks as
+ * the sigmas grow, not with the spatial footprint. Sigmas so small that
+ * the grid would outgrow its 64 MiB bound are scaled up together until it
+ * fits.
+ * Non-positive sigmas select the defaults
+ * Returns a new image with the filter applied
+ */
+grayscale_image_t apply_bilateral_filter(const grayscale_image_t* image, float spatial_sigma, float range_sigma);
+
+/**
+ * Bilateral grid over an RGB image; edges are taken from the luma so the
+ * channels stay aligned
+ * Returns a new image with the filter applied
+ */
+rgb_image_t apply_bilateral_filter_rgb(const rgb_image_t* image, float spatial_sigma, float range_sigma);
+
+/**
+ * Guided filter: each (2 * radius + 1)^2 window of the output is a linear
+ * function of the guide fitted to the image, so edges of the guide survive
+ * and the rest is smoothed. epsilon is the regularisation on [0, 1]
+ * intensities (larger smooths more). Built from box means, so the cost does
+ * not grow with the radius; subsample > 1 fits the coefficients on a grid
+ * that much coarser (the fast guided filter). A NULL guide uses the image
+ * itself; non-positive parameters select the defaults.
+ * Returns a new image with the filter applied
+ */
+grayscale_image_t apply_guided_filter(const grayscale_image_t* image, const grayscale_image_t* guide,
+                                      int radius, float epsilon, int subsample);
+
+/**
+ * Guided filter of a grayscale image (e.g. an alpha matte) by an RGB guide
+ * Returns a new image with the filter applied
+ */
+grayscale_image_t apply_guided_filter_color_guide(const grayscale_image_t* image, const rgb_image_t* guide,
+                                                  int radius, float epsilon, int subsample);
+
+/**
+ * Guided filter of each channel of an RGB image by an RGB guide (NULL for
+ * the image itself); the channels share the guide statistics
+ * Returns a new image with the filter applied
+ */
+rgb_image_t apply_guided_filter_rgb(const rgb_image_t* image, const rgb_image_t* guide,
+                                    int radius, float epsilon, int subsample);
+
+/**
+ * Compute signed Gx/Gy in a single pass over the image, with edge clamping.
+ * The magnitude and quantized orientation are produced in the same pass.
+ * Returns a zeroed field on failure.
+ */
+gradient_field_t compute_gradient(const grayscale_image_t* image, gradient_operator_t op,
+                                  gradient_norm_t norm, bool with_direction);
+
+/**
+ * Free gradient field memory
+ */
+void free_gradient_field(gradient_field_t* field);
+
 /**
  * Apply Sobel edge detection to a grayscale image
  * Returns a new image with the filter applied
@@ -63,6 +180,49 @@ grayscale_image_t apply_prewitt_edge_detection(const grayscale_image_t* image);
  */
 grayscale_image_t apply_roberts_edge_detection(const grayscale_image_t* image);
 
+/**
+ * Supplies input rows to a row filter: returns row y of the input image
+ */
+typedef const unsigned char* (*row_source_fn)(void* source, size_t y);
+
+/**
+ * Streaming form of a convolution or gradient edge filter, used by filter
+ * chains. Output rows are produced in increasing order, each from the input
+ * rows within `radius` of it (clamped to the image), which are pulled from
+ * a row_source_fn in increasing order. The output is byte-identical to the
+ * whole-image filter.
+ */
+typedef struct row_filter row_filter_t;
+
+/**
+ * Row filter computing what apply_convolution_grayscale computes on a
+ * width x height image. Returns NULL when that would use FFT convolution,
+ * which cannot stream, or on allocation failure.
+ */
+row_filter_t* create_convolution_row_filter(const kernel_t* kernel, size_t width, size_t height);
+
+/**
+ * Row filter for the saturated L2 gradient magnitude of the Sobel, Prewitt
+ * and Roberts edge detectors
+ */
+row_filter_t* create_gradient_row_filter(gradient_operator_t op, size_t width, size_t height);
+
+/**
+ * Number of input rows a row filter reads on each side of an output row
+ */
+size_t row_filter_radius(const row_filter_t* filter);
+
+/**
+ * Produce output row y into `out` (width bytes)
+ * Rows must be requested in increasing order
+ */
+void row_filter_run(row_filter_t* filter, size_t y, row_source_fn source, void* context, unsigned char* out);
+
+/**
+ * Free a row filter and its line buffers
+ */
+void free_row_filter(row_filter_t* filter);
+
 /**
  * Apply Canny edge detection to a grayscale image
  * Returns a new image with the filter applied
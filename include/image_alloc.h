@@ -0,0 +1,96 @@
+#ifndef IMAGE_ALLOC_H
+#define IMAGE_ALLOC_H
+
+#include "image_processing.h"
+
+#define IMAGE_ALIGNMENT 64                      // Cache line; also covers any SSE/AVX load
+#define IMAGE_HUGE_PAGE_SIZE (2u << 20)
+#define IMAGE_HUGE_PAGE_THRESHOLD (4u << 20)    // Blocks from this size on are advised onto huge pages
+
+/**
+ * Allocate pixel memory aligned to IMAGE_ALIGNMENT. Blocks of at least
+ * IMAGE_HUGE_PAGE_THRESHOLD bytes are aligned and padded to whole huge
+ * pages and advised as such (Linux transparent huge pages), which cuts TLB
+ * misses when a large frame is walked column-wise.
+ * The memory comes from posix_memalign, so image_free and free() are
+ * interchangeable on it; stb_image allocates through here as well, so
+ * every owned grayscale buffer can be released with image_free.
+ * Returns NULL on failure or for a zero size
+ */
+void* image_alloc(size_t size);
+
+void image_free(void* data);
+
+/**
+ * Resize a block from image_alloc, keeping the alignment realloc() would
+ * drop: the first min(old_size, size) bytes move to a fresh aligned block.
+ * On failure the old block is left untouched.
+ * Returns NULL on failure or for a zero size
+ */
+void* image_realloc(void* data, size_t old_size, size_t size);
+
+/**
+ * Packed width x height image in one aligned block
+ * Returns an empty image on failure
+ */
+grayscale_image_t allocate_grayscale_image(size_t width, size_t height);
+
+/**
+ * Packed width x height RGB image whose three planes share one aligned
+ * block, each plane starting on an IMAGE_ALIGNMENT boundary: one allocation
+ * and one free instead of three. free_rgb_image releases the block.
+ * Returns an empty image on failure
+ */
+rgb_image_t allocate_rgb_image(size_t width, size_t height);
+
+/**
+ * Buffer pool for transient full-size planes (blurred copies, gradients,
+ * coefficient arrays) that a routine allocates and frees before it
+ * returns. Buffers are grouped in power-of-two size classes from 4 KiB to
+ * 256 MiB; a released buffer is kept for the next request of its class, so
+ * per-frame processing stops paying for malloc, free and fresh page faults.
+ * Sizes outside the classes, full classes and a disabled pool fall back to
+ * image_alloc. Buffers are IMAGE_ALIGNMENT aligned, uninitialised, and must
+ * be returned with image_buffer_release, never free(). Thread safe.
+ * Returns NULL on failure or for a zero size
+ */
+void* image_buffer_acquire(size_t size);
+
+void image_buffer_release(void* buffer);
+
+/**
+ * Turn pooling on (the default) or off; off, every acquire is a fresh
+ * allocation and every release a free. Turning it off trims the pool
+ */
+void image_buffer_pool_set_enabled(bool enabled);
+
+/**
+ * Free the idle pooled buffers
+ */
+void image_buffer_pool_trim(void);
+
+/**
+ * Position in the calling thread's scratch arena
+ */
+typedef struct {
+    void* chunk;
+    size_t used;
+} scratch_mark_t;
+
+/**
+ * Per-thread scratch arena for small working buffers (row rings, row
+ * pointer tables, 1D transform lines): allocation bumps a pointer in the
+ * calling thread's chunk, and scratch_release frees everything allocated
+ * since a mark in one step. Chunks come from the buffer pool and go back
+ * to it when the thread exits; the parallel_for workers live as long as
+ * the process, so their chunks are reused from call to call. Memory is IMAGE_ALIGNMENT aligned and uninitialised.
+ * Usage: mark, allocate, release the mark before returning.
+ * Returns NULL on failure
+ */
+void* scratch_alloc(size_t size);
+
+scratch_mark_t scratch_mark(void);
+
+void scratch_release(scratch_mark_t mark);
+
+#endif // IMAGE_ALLOC_H
@@ -3,25 +3,84 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+/**
+ * Images are row-major. Row y starts stride bytes after row y - 1; a zero
+ * stride means the rows are packed (stride == width), which is what every
+ * zero-initialised image gets. A borrowed image is a view of pixels owned
+ * by something else (another image, a decoder frame): freeing it only
+ * clears the struct. The filters read their input through the stride,
+ * so a view can be filtered in place, and return packed images; routines
+ * that do not take the stride into account (the video and compression
+ * paths that index frames directly) require packed images, and
+ * copy_grayscale_image packs a view.
+ */
 typedef struct {
     size_t width;
     size_t height;
     unsigned char* data;
+    size_t stride;      // Bytes from one row to the next, 0 when packed
+    size_t alignment;   // Alignment of data and of every row, 0 when unknown
+    bool borrowed;      // data is not owned by this image
 } grayscale_image_t;
 
+/**
+ * Three planes sharing one stride, alignment and ownership. A contiguous
+ * image (see allocate_rgb_image) holds all three planes in the one block
+ * r_data points to; otherwise each plane is a separate allocation.
+ * free_rgb_image handles both
+ */
 typedef struct {
     size_t width;
     size_t height;
     unsigned char* r_data;
     unsigned char* g_data;
     unsigned char* b_data;
+    size_t stride;
+    size_t alignment;
+    bool borrowed;
+    bool contiguous;    // g_data and b_data live inside the r_data block
 } rgb_image_t;
 
 typedef enum {
     INTERPOLATION_NEAREST,
-    INTERPOLATION_AVERAGE
+    INTERPOLATION_AVERAGE,
+    INTERPOLATION_BILINEAR,
+    INTERPOLATION_BICUBIC,
+    INTERPOLATION_LANCZOS3
 } interpolation_method_t;
 
+static inline size_t grayscale_stride(const grayscale_image_t* image) {
+    return image->stride != 0 ? image->stride : image->width;
+}
+
+static inline size_t rgb_stride(const rgb_image_t* image) {
+    return image->stride != 0 ? image->stride : image->width;
+}
+
+static inline unsigned char* grayscale_row(const grayscale_image_t* image, size_t y) {
+    return image->data + y * grayscale_stride(image);
+}
+
+/**
+ * Borrowed view of the width x height rectangle at (x, y); no pixels are
+ * copied, so the view is only valid while `image` is
+ * Returns an empty image when the rectangle does not fit
+ */
+grayscale_image_t image_view_roi(const grayscale_image_t* image, size_t x, size_t y, size_t width, size_t height);
+
+rgb_image_t image_view_roi_rgb(const rgb_image_t* image, size_t x, size_t y, size_t width, size_t height);
+
+/**
+ * Borrowed view of pixels held elsewhere, e.g. an FFmpeg frame plane with
+ * its linesize as the stride
+ */
+grayscale_image_t image_view_buffer(unsigned char* data, size_t width, size_t height, size_t stride);
+
+/**
+ * Packed, owned copy of an image or view
+ */
+grayscale_image_t copy_grayscale_image(const grayscale_image_t* image);
+
 grayscale_image_t load_image_as_grayscale(const char* file_path);
 
 grayscale_image_t make_resized_grayscale(grayscale_image_t* original, size_t max_width, size_t max_height, interpolation_method_t method);
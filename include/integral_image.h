@@ -0,0 +1,73 @@
+#ifndef INTEGRAL_IMAGE_H
+#define INTEGRAL_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Summed-area table of an 8-bit plane. Entry (x, y) of the
+ * (width + 1) x (height + 1) table holds the sum of the pixels in
+ * [0, x) x [0, y); the first row and column are zero. Sums wrap modulo 2^32,
+ * which still gives exact rectangle sums for any rectangle of fewer than
+ * 2^32 / 255 (about 16.8 million) pixels. Tables are transient, so their
+ * sums come from the buffer pool; release them with free_integral_image.
+ */
+typedef struct {
+    size_t width;       // Dimensions of the source plane
+    size_t height;
+    size_t stride;      // width + 1
+    uint32_t* sums;
+} integral_image_t;
+
+/**
+ * Summed-area table of a signed 32-bit plane, for sums that do not fit in
+ * 32 bits (squares and products of gradients). Same layout as integral_image_t
+ */
+typedef struct {
+    size_t width;
+    size_t height;
+    size_t stride;
+    int64_t* sums;
+} integral_image64_t;
+
+/**
+ * Build the summed-area table of a width x height plane whose rows are
+ * `stride` bytes apart. Rows are prefix summed in parallel (four sums per
+ * SSE2 step), then column batches are accumulated down the table in
+ * parallel.
+ * Returns false on invalid input or allocation failure
+ */
+bool build_integral_image(const unsigned char* data, size_t width, size_t height, size_t stride,
+                          integral_image_t* table);
+
+/**
+ * Build the 64-bit summed-area table of a width x height plane, rows
+ * `stride` elements apart
+ * Returns false on invalid input or allocation failure
+ */
+bool build_integral_image64(const int32_t* data, size_t width, size_t height, size_t stride,
+                            integral_image64_t* table);
+
+void free_integral_image(integral_image_t* table);
+
+void free_integral_image64(integral_image64_t* table);
+
+/**
+ * Sum of the pixels in [x0, x1) x [y0, y1), in four lookups
+ */
+static inline uint32_t integral_rect_sum(const integral_image_t* table,
+                                         size_t x0, size_t y0, size_t x1, size_t y1) {
+    const uint32_t* top = table->sums + y0 * table->stride;
+    const uint32_t* bottom = table->sums + y1 * table->stride;
+    return bottom[x1] - bottom[x0] - top[x1] + top[x0];
+}
+
+static inline int64_t integral_rect_sum64(const integral_image64_t* table,
+                                          size_t x0, size_t y0, size_t x1, size_t y1) {
+    const int64_t* top = table->sums + y0 * table->stride;
+    const int64_t* bottom = table->sums + y1 * table->stride;
+    return bottom[x1] - bottom[x0] - top[x1] + top[x0];
+}
+
+#endif // INTEGRAL_IMAGE_H
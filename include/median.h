@@ -0,0 +1,24 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include "image_processing.h"
+
+#define DEFAULT_MEDIAN_RADIUS 1
+#define MAX_MEDIAN_RADIUS 127     // Window counts must fit the 16-bit histograms
+
+/**
+ * Median of the (2 * radius + 1)^2 window around each pixel, with clamped
+ * borders. Radii 1 and 2 use vectorized selection networks; larger radii
+ * use Perreault-Hebert sliding histograms, whose cost per pixel does not
+ * grow with the radius.
+ * Returns a new image with the filter applied
+ */
+grayscale_image_t apply_median_filter(const grayscale_image_t* image, int radius);
+
+/**
+ * Median filter each channel of an RGB image
+ * Returns a new image with the filter applied
+ */
+rgb_image_t apply_median_filter_rgb(const rgb_image_t* image, int radius);
+
+#endif // MEDIAN_H
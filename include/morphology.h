@@ -0,0 +1,52 @@
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include "image_processing.h"
+#include "filters.h"
+
+#define DEFAULT_ELEMENT_SIZE 3
+#define MAX_ELEMENT_SIZE 1001
+
+/**
+ * Morphological operators with a rectangular structuring element
+ */
+typedef enum {
+    MORPHOLOGY_ERODE,       // Minimum over the element
+    MORPHOLOGY_DILATE,      // Maximum over the element
+    MORPHOLOGY_OPEN,        // Erosion, then dilation
+    MORPHOLOGY_CLOSE,       // Dilation, then erosion
+    MORPHOLOGY_TOPHAT       // Image minus its opening
+} morphology_op_t;
+
+/**
+ * Morphology operator behind a -f filter type (erode, dilate, open, close, tophat)
+ * Returns false for other filters
+ */
+bool morphology_op_for_filter(filter_type_t filter_type, morphology_op_t* op);
+
+/**
+ * Apply a morphological operator with an element_width x element_height
+ * rectangle anchored at its centre; the element is clipped to the image at
+ * the borders. Uses the van Herk/Gil-Werman algorithm, three comparisons
+ * per pixel and direction whatever the element size. Images holding only
+ * 0 and 255 take the bit-packed binary path.
+ * Returns a new image with the operator applied
+ */
+grayscale_image_t apply_morphology(const grayscale_image_t* image, morphology_op_t op,
+                                   size_t element_width, size_t element_height);
+
+/**
+ * Apply a morphological operator to a binary mask (non-zero is foreground)
+ * packed 64 pixels to a word. Returns a 0/255 mask
+ */
+grayscale_image_t apply_binary_morphology(const grayscale_image_t* mask, morphology_op_t op,
+                                          size_t element_width, size_t element_height);
+
+/**
+ * Apply a morphological operator to each channel of an RGB image
+ * Returns a new image with the operator applied
+ */
+rgb_image_t apply_morphology_rgb(const rgb_image_t* image, morphology_op_t op,
+                                 size_t element_width, size_t element_height);
+
+#endif // MORPHOLOGY_H
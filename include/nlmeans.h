@@ -0,0 +1,35 @@
+#ifndef NLMEANS_H
+#define NLMEANS_H
+
+#include "image_processing.h"
+
+#define DEFAULT_NLM_SEARCH_RADIUS 7
+#define DEFAULT_NLM_PATCH_RADIUS 2
+#define DEFAULT_NLM_STRENGTH 10.0f
+#define MAX_NLM_SEARCH_RADIUS 20    // Keeps the fixed-point weight sums within 32 bits
+#define MAX_NLM_PATCH_RADIUS 10
+
+/**
+ * Non-local means: each pixel becomes the average of the pixels in its
+ * (2 * search_radius + 1)^2 neighbourhood, weighted by
+ * exp(-d / strength^2), where d is the mean squared difference between the
+ * (2 * patch_radius + 1)^2 patches around the two pixels. Patch distances
+ * for one search offset come from an integral image of squared
+ * differences, so the cost per pixel does not depend on the patch size.
+ * Search offsets are shared out between the worker threads; weights are
+ * accumulated in fixed point, so the result does not depend on the split.
+ * Borders are clamped.
+ * Returns a new image with the filter applied
+ */
+grayscale_image_t apply_nl_means(const grayscale_image_t* image, int search_radius, int patch_radius,
+                                 float strength);
+
+/**
+ * Non-local means on an RGB image: patch distances are summed over the
+ * three channels and every channel is averaged with the same weights
+ * Returns a new image with the filter applied
+ */
+rgb_image_t apply_nl_means_rgb(const rgb_image_t* image, int search_radius, int patch_radius,
+                               float strength);
+
+#endif // NLMEANS_H
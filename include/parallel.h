@@ -0,0 +1,66 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Work below this many cost units (roughly pixel-taps) stays on the calling
+ * thread; handing bands to workers costs more than it saves on small images
+ */
+#define PARALLEL_MIN_BAND_COST ((size_t)1 << 16)
+
+/**
+ * Contiguous band of rows handed to one worker. The band owns output rows
+ * [begin, end); [halo_begin, halo_end) widens it by the halo passed to
+ * parallel_for, clamped to the image, and is the range of input rows a
+ * neighbourhood operation may read.
+ */
+typedef struct {
+    size_t begin;
+    size_t end;
+    size_t halo_begin;
+    size_t halo_end;
+    size_t index;       // Band number, 0 .. band count - 1
+} row_band_t;
+
+/**
+ * Band worker. Bands never share output rows, so a worker only has to keep
+ * its writes inside [begin, end). Returns false on failure (e.g. a scratch
+ * allocation), which makes parallel_for fail.
+ */
+typedef bool (*row_band_fn)(void* context, const row_band_t* band);
+
+/**
+ * Set the number of worker threads used by parallel_for (--threads)
+ * Zero or a negative count means one thread per online CPU. The worker
+ * pool grows to the new count on the next parallel_for; it never shrinks,
+ * but no call uses more threads than the count
+ */
+void set_thread_count(int threads);
+
+/**
+ * Number of worker threads parallel_for will use
+ */
+int get_thread_count(void);
+
+/**
+ * Number of bands parallel_for splits `rows` rows of `row_cost` units each
+ * into, for callers that size per-band scratch up front
+ */
+size_t parallel_band_count(size_t rows, size_t row_cost);
+
+/**
+ * Split rows [0, rows) into equal bands and run `fn` on each, one band per
+ * thread. Bands go to a pool of worker threads started on first use and
+ * kept for the life of the process (so are their scratch arenas); the
+ * calling thread runs bands too and waits for the rest. Bands may call
+ * parallel_for themselves. `row_cost` estimates the work in
+ * one row and keeps bands above PARALLEL_MIN_BAND_COST; `halo` is the number
+ * of extra input rows a band reads on each side. Rows may stand for any
+ * independent items, such as column batches.
+ * Returns false if any band failed
+ */
+bool parallel_for(size_t rows, size_t row_cost, size_t halo, row_band_fn fn, void* context);
+
+#endif // PARALLEL_H
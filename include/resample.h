@@ -0,0 +1,33 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include "image_processing.h"
+
+/**
+ * Resize an image or view to a packed width x height image with a
+ * separable filter: each source row is filtered horizontally, then the
+ * filtered rows are combined vertically. Weights are precomputed per
+ * destination column and row in 14-bit fixed point, cached per (source
+ * size, destination size, method), and the inner loops use SSE2 16-bit
+ * multiply-adds. Output rows are shared out between the worker threads.
+ *
+ * INTERPOLATION_AVERAGE gives every destination pixel the mean of the
+ * source area it covers, with partly covered pixels weighted by their
+ * coverage; INTERPOLATION_NEAREST picks the source pixel under its corner.
+ * INTERPOLATION_BILINEAR, INTERPOLATION_BICUBIC (Keys, a = -0.5) and
+ * INTERPOLATION_LANCZOS3 sample their kernel at each pixel centre; when
+ * shrinking, the kernel is widened by the scale factor to avoid aliasing.
+ * Returns a new image, or an empty one on failure
+ */
+grayscale_image_t resample_grayscale(const grayscale_image_t* image, size_t width, size_t height,
+                                     interpolation_method_t method);
+
+/**
+ * Resize the three channels of an RGB image in one pass over the rows,
+ * sharing the weights
+ * Returns a new image, or an empty one on failure
+ */
+rgb_image_t resample_rgb(const rgb_image_t* image, size_t width, size_t height,
+                         interpolation_method_t method);
+
+#endif // RESAMPLE_H
@@ -0,0 +1,35 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/**
+ * Compile-time SIMD capability detection for the pixel kernels.
+ * Every vectorized routine keeps a scalar fallback, so these macros only
+ * select the fastest variant the compiler is able to target.
+ */
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TERMIVIEW_SSE2 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TERMIVIEW_NEON 1
+#endif
+
+/**
+ * AVX2 variants are compiled per function with a target attribute, so the
+ * binary still runs on CPUs without AVX2; callers pick them at runtime with
+ * termiview_cpu_has_avx2().
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TERMIVIEW_AVX2 1
+#define TERMIVIEW_AVX2_TARGET __attribute__((target("avx2")))
+
+static inline int termiview_cpu_has_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#endif // SIMD_H
@@ -0,0 +1,71 @@
+#ifndef VIDEO_CODEC_H
+#define VIDEO_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "image_processing.h"
+
+// Motion-compensated predictive codec for grayscale video.
+// Each GOP starts with an intra (I) frame; the following predicted (P) frames
+// code quarter-pel motion vectors against the previous reconstructed frame
+// plus the 8x8 DCT-quantized prediction residual. Every frame packet is
+// Huffman coded.
+
+#define VIDEO_FRAME_INTRA 'I'
+#define VIDEO_FRAME_PREDICTED 'P'
+
+// Stream parameters stored in the container header
+typedef struct {
+    int width;
+    int height;
+    int gop_size;      // Distance between intra frames
+    int quality;       // 1-100, scales the quantization tables
+} VideoStreamHeader;
+
+// Encoder state: the reconstructed reference is what the decoder will see
+typedef struct {
+    VideoStreamHeader header;
+    int search_window;
+    int frame_index;
+    grayscale_image_t reference;
+    unsigned short intra_quant[64];
+    unsigned short inter_quant[64];
+} VideoEncoder;
+
+// Decoder state
+typedef struct {
+    VideoStreamHeader header;
+    int frame_index;
+    grayscale_image_t reference;
+    unsigned short intra_quant[64];
+    unsigned short inter_quant[64];
+} VideoDecoder;
+
+// Function to create an encoder for frames of the given size
+VideoEncoder* video_encoder_create(int width, int height, int gop_size, int quality, int search_window);
+
+// Function to encode one frame; returns a packet (first byte is the frame type)
+unsigned char* video_encode_frame(VideoEncoder* encoder, const grayscale_image_t* frame, size_t* encoded_len_bytes);
+
+// Function to free VideoEncoder
+void video_encoder_free(VideoEncoder* encoder);
+
+// Function to create a decoder for a stream header
+VideoDecoder* video_decoder_create(const VideoStreamHeader* header);
+
+// Function to decode one packet into out_frame (allocated by the decoder, free with free_grayscale_image)
+bool video_decode_frame(VideoDecoder* decoder, const unsigned char* packet, size_t packet_len, grayscale_image_t* out_frame);
+
+// Function to free VideoDecoder
+void video_decoder_free(VideoDecoder* decoder);
+
+// Container I/O: a "TVC1" header followed by length-prefixed frame packets
+bool write_video_stream_header(FILE* out, const VideoStreamHeader* header);
+bool read_video_stream_header(FILE* in, VideoStreamHeader* header);
+bool write_video_packet(FILE* out, const unsigned char* packet, size_t packet_len);
+
+// Function to read the next packet; returns NULL at end of stream
+unsigned char* read_video_packet(FILE* in, size_t* packet_len);
+
+#endif // VIDEO_CODEC_H
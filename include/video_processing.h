@@ -22,6 +22,7 @@ typedef struct {
     struct SwsContext *sws_ctx; // For pixel format conversion
     struct AVFrame *frame;      // Reusable frame for decoding
     struct AVPacket *packet;    // Reusable packet for reading
+    bool keyframes_only;        // Skip non-key packets before they reach the decoder
 } VideoContext;
 
 // Function to initialize video context and open video file
@@ -31,6 +32,9 @@ VideoContext* open_video(const char* filename);
 // Returns true on success, false on EOF or error
 bool read_video_frame(VideoContext* vid_ctx, rgb_image_t* out_rgb_frame);
 
+// Function to restrict decoding to keyframes; inter frames are dropped unparsed
+void set_video_keyframes_only(VideoContext* vid_ctx, bool keyframes_only);
+
 // Function to close video context and free resources
 void close_video(VideoContext* vid_ctx);
 
@@ -38,11 +42,15 @@ void close_video(VideoContext* vid_ctx);
 grayscale_image_t temporal_average(grayscale_image_t** frames, int num_frames);
 
 // Structure to represent a single motion vector
+// The displacement is (dx + frac_dx / 4, dy + frac_dy / 4); integer-pel
+// searches leave frac_dx and frac_dy at 0.
 typedef struct {
     int block_x;
     int block_y;
     int dx;
     int dy;
+    int frac_dx; // Quarter-pel fraction, 0-3
+    int frac_dy; // Quarter-pel fraction, 0-3
 } MotionVector;
 
 // Structure to represent a field of motion vectors for a frame
@@ -60,6 +68,32 @@ grayscale_image_t* compensate_motion(const grayscale_image_t* reference_frame, c
 // Function to free MotionVectorField
 void free_motion_vector_field(MotionVectorField* mv_field);
 
+// Structure holding the sixteen quarter-pel phases of a reference frame.
+// planes[fy * 4 + fx] stores the sample at (x + fx / 4, y + fy / 4); half-pel
+// phases use the H.264 6-tap filter and quarter-pel phases average their two
+// nearest half-pel neighbours.
+typedef struct {
+    int width;
+    int height;
+    unsigned char* planes[16];
+    unsigned char* buffer; // Single allocation backing all planes
+} SubpelReference;
+
+// Function to interpolate every sub-pixel phase of a reference frame once
+SubpelReference* build_subpel_reference(const grayscale_image_t* reference_frame);
+
+// Function to free SubpelReference
+void free_subpel_reference(SubpelReference* subpel_ref);
+
+// Function to estimate motion with sub-pixel refinement.
+// precision is 1 (integer), 2 (half-pel) or 4 (quarter-pel); the integer
+// block matching search runs first and is refined against the cached planes.
+MotionVectorField* estimate_motion_subpel(const grayscale_image_t* current_frame, const SubpelReference* reference,
+                                          int block_size, int search_window, int precision);
+
+// Function to compensate motion using fractional motion vectors
+grayscale_image_t* compensate_motion_subpel(const SubpelReference* reference, const MotionVectorField* mv_field, int block_size);
+
 // Structure to represent optical flow for each pixel (vx, vy)
 typedef struct {
     double vx;
@@ -79,4 +113,72 @@ OpticalFlowField* compute_optical_flow(const grayscale_image_t* frame1, const gr
 // Function to free OpticalFlowField
 void free_optical_flow_field(OpticalFlowField* flow_field);
 
+// Per-tile change detector over a 4x downsampled luma signature
+typedef struct {
+    int width;
+    int height;
+    int tile_size;            // Tile edge in source pixels (multiple of 4)
+    int tiles_x;
+    int tiles_y;
+    int thumb_width;          // Size of the downsampled signature
+    int thumb_height;
+    unsigned char* reference; // Signature each tile had when it last changed
+    unsigned char* current;
+    unsigned char* dirty;     // Per-tile flags set by the last detect_frame_changes call
+    bool has_reference;
+} FrameChangeDetector;
+
+// Function to create a change detector for frames of the given size
+FrameChangeDetector* create_frame_change_detector(int width, int height, int tile_size);
+
+// Function to flag tiles whose mean absolute luma difference exceeds threshold.
+// Returns the number of dirty tiles (all tiles on the first frame), or -1 on error.
+// Clean tiles keep their old reference so slow drift still accumulates.
+int detect_frame_changes(FrameChangeDetector* detector, const grayscale_image_t* frame, double threshold);
+
+// Function to free FrameChangeDetector
+void free_frame_change_detector(FrameChangeDetector* detector);
+
+// Per-pixel running Gaussian background model (structure of arrays, fixed point)
+typedef struct {
+    int width;
+    int height;
+    unsigned short* mean;          // Background mean per pixel, 8.8 fixed point
+    unsigned short* variance;      // Background variance per pixel, in squared luma levels
+    int learning_shift;            // Learning rate alpha = 1 / 2^learning_shift
+    unsigned short threshold_q8;   // Squared foreground threshold in standard deviations, 8.8 fixed point
+    unsigned short min_variance;   // Variance floor so flat regions do not become over-sensitive
+    bool initialized;
+    grayscale_image_t mask;        // Foreground mask from the last update (255 = foreground)
+} BackgroundModel;
+
+// Function to create a background model; pixels further than threshold_sigma
+// standard deviations from the mean are classified as foreground
+BackgroundModel* create_background_model(int width, int height, int learning_shift, double threshold_sigma);
+
+// Function to classify a frame against the model and then blend it in.
+// Returns the model's foreground mask, valid until the next call.
+grayscale_image_t* subtract_background(BackgroundModel* model, const grayscale_image_t* frame);
+
+// Function to free BackgroundModel
+void free_background_model(BackgroundModel* model);
+
+#define SCENE_HISTOGRAM_BINS 64
+
+// Function to compute a SCENE_HISTOGRAM_BINS-bin luma histogram of a frame
+void compute_luma_histogram(const grayscale_image_t* frame, unsigned int* histogram);
+
+// Function to compare two luma histograms with the chi-square distance,
+// normalized to 0 (identical) .. 1 (disjoint)
+double histogram_chi_square_distance(const unsigned int* hist_a, const unsigned int* hist_b);
+
+// Function to compare two luma histograms by intersection; returns 1 - overlap (0 .. 1)
+double histogram_intersection_distance(const unsigned int* hist_a, const unsigned int* hist_b);
+
+// Function to box-downscale a frame to thumb_width columns, keeping its aspect ratio
+grayscale_image_t make_thumbnail(const grayscale_image_t* frame, int thumb_width);
+
+// Function to tile equally sized thumbnails into a contact sheet with a one-pixel black grid
+grayscale_image_t make_contact_sheet(const grayscale_image_t* thumbnails, int num_thumbnails, int columns);
+
 #endif // VIDEO_PROCESSING_H
@@ -0,0 +1,473 @@
+#include "../include/blur.h"
+#include "../include/image_alloc.h"
+#include "../include/parallel.h"
+#include "../include/simd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#define BOX_PASSES 3
+#define COLUMN_BATCH 256      // Columns filtered together in the vertical pass
+#define STRIP_ROWS 16         // Rows transposed together for the horizontal pass
+
+/**
+ * Young-van Vliet recursive Gaussian coefficients, normalised by b0
+ */
+typedef struct {
+    float gain;     // B = 1 - (b1 + b2 + b3) / b0
+    float a1;       // b1 / b0
+    float a2;       // b2 / b0
+    float a3;       // b3 / b0
+    float tail[3][3];   // Maps the last three causal outputs to the first three anti-causal ones
+} recursive_gaussian_t;
+
+static unsigned char clamp_byte(float value) {
+    if (value < 0.0f) return 0;
+    if (value > 255.0f) return 255;
+    return (unsigned char)(value + 0.5f);
+}
+
+bool parse_blur_mode(const char* mode_str, blur_mode_t* mode) {
+    if (mode_str == NULL) {
+        return false;
+    }
+    if (strcmp(mode_str, "kernel") == 0) {
+        *mode = BLUR_MODE_KERNEL;
+    } else if (strcmp(mode_str, "iir") == 0) {
+        *mode = BLUR_MODE_RECURSIVE;
+    } else if (strcmp(mode_str, "box") == 0) {
+        *mode = BLUR_MODE_BOX;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+size_t gaussian_kernel_size(float sigma) {
+    int radius = (int)ceilf(2.0f * sigma);
+    if (radius < 1) radius = 1;
+    return (size_t)(2 * radius + 1);
+}
+
+/**
+ * Coefficients from Young & van Vliet, "Recursive implementation of the
+ * Gaussian filter" (1995). Valid for sigma >= 0.5.
+ */
+static recursive_gaussian_t make_recursive_gaussian(float sigma) {
+    double q = sigma >= 2.5f ? 0.98711 * sigma - 0.96330
+                             : 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+    double q2 = q * q;
+    double q3 = q2 * q;
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+    double b2 = -(1.4281 * q2 + 1.26661 * q3);
+    double b3 = 0.422205 * q3;
+
+    double gain = 1.0 - (b1 + b2 + b3) / b0;
+    double a[3] = { b1 / b0, b2 / b0, b3 / b0 };
+
+    recursive_gaussian_t coeffs;
+    coeffs.gain = (float)gain;
+    coeffs.a1 = (float)a[0];
+    coeffs.a2 = (float)a[1];
+    coeffs.a3 = (float)a[2];
+
+    // Replicated borders (Triggs & Sdika): past the last sample the input
+    // stays at its edge value u, so relative to u the causal filter just
+    // rings down from its last three outputs and the anti-causal pass
+    // starts from the decayed response. The response is linear in those
+    // three outputs; measure it once per sigma by running both recursions
+    // over a tail long enough for the filter to die out.
+    int length = (int)(20.0f * sigma) + 64;
+    double* causal = (double*)malloc((size_t)(length + 3) * sizeof(double));
+    double* anticausal = (double*)malloc((size_t)(length + 6) * sizeof(double));
+    memset(coeffs.tail, 0, sizeof(coeffs.tail));
+    if (causal != NULL && anticausal != NULL) {
+        for (int state = 0; state < 3; state++) {
+            // causal[0..2] = outputs at N-3, N-2, N-1; tail samples follow
+            causal[0] = state == 2;
+            causal[1] = state == 1;
+            causal[2] = state == 0;
+            for (int n = 3; n < length + 3; n++) {
+                causal[n] = a[0] * causal[n - 1] + a[1] * causal[n - 2] + a[2] * causal[n - 3];
+            }
+            for (int n = length + 3; n < length + 6; n++) {
+                anticausal[n] = 0.0;
+            }
+            for (int n = length + 2; n >= 3; n--) {
+                anticausal[n] = gain * causal[n] + a[0] * anticausal[n + 1] + a[1] * anticausal[n + 2] +
+                                a[2] * anticausal[n + 3];
+            }
+            for (int k = 0; k < 3; k++) {
+                coeffs.tail[k][state] = (float)anticausal[3 + k];
+            }
+        }
+    }
+    free(causal);
+    free(anticausal);
+    return coeffs;
+}
+
+/**
+ * Widths of BOX_PASSES odd box filters whose cascade has variance sigma^2
+ * (Kovesi, "Fast almost-Gaussian filtering", 2010)
+ */
+static void box_widths_for_gaussian(float sigma, int* widths) {
+    double ideal = sqrt(12.0 * sigma * sigma / BOX_PASSES + 1.0);
+    int lower = (int)floor(ideal);
+    if (lower % 2 == 0) lower--;
+    int upper = lower + 2;
+    double m_ideal = (12.0 * sigma * sigma - BOX_PASSES * lower * lower - 4.0 * BOX_PASSES * lower - 3.0 * BOX_PASSES) /
+                     (-4.0 * lower - 4.0);
+    int m = (int)lround(m_ideal);
+    for (int i = 0; i < BOX_PASSES; i++) {
+        widths[i] = i < m ? lower : upper;
+    }
+}
+
+/**
+ * One recursive update across a batch of columns:
+ * row = gain * row + a1 * p1 + a2 * p2 + a3 * p3
+ */
+static void recursive_row_update(float* row, const float* p1, const float* p2, const float* p3,
+                                 int x0, int x1, const recursive_gaussian_t* c) {
+    int x = x0;
+#ifdef TERMIVIEW_SSE2
+    const __m128 gain = _mm_set1_ps(c->gain);
+    const __m128 a1 = _mm_set1_ps(c->a1);
+    const __m128 a2 = _mm_set1_ps(c->a2);
+    const __m128 a3 = _mm_set1_ps(c->a3);
+    for (; x + 4 <= x1; x += 4) {
+        __m128 value = _mm_mul_ps(gain, _mm_loadu_ps(row + x));
+        value = _mm_add_ps(value, _mm_mul_ps(a1, _mm_loadu_ps(p1 + x)));
+        value = _mm_add_ps(value, _mm_mul_ps(a2, _mm_loadu_ps(p2 + x)));
+        value = _mm_add_ps(value, _mm_mul_ps(a3, _mm_loadu_ps(p3 + x)));
+        _mm_storeu_ps(row + x, value);
+    }
+#endif
+    for (; x < x1; x++) {
+        float value = c->gain * row[x];
+        value += c->a1 * p1[x];
+        value += c->a2 * p2[x];
+        value += c->a3 * p3[x];
+        row[x] = value;
+    }
+}
+
+/**
+ * Causal then anti-causal recursive Gaussian down columns [x0, x1), in place,
+ * with replicated borders. A constant signal is a fixed point of the filter,
+ * so the causal pass starts exactly from the first row. `tail` holds four
+ * rows: the saved last input row and the three anti-causal outputs past the
+ * end.
+ */
+static void recursive_gaussian_columns(float* plane, float* tail, int width, int height, int x0, int x1,
+                                       const recursive_gaussian_t* c) {
+    float* edge = tail;
+    float* beyond[3] = { tail + width, tail + 2 * (size_t)width, tail + 3 * (size_t)width };
+    memcpy(edge + x0, plane + (size_t)(height - 1) * width + x0, (size_t)(x1 - x0) * sizeof(float));
+
+    for (int y = 1; y < height; y++) {
+        float* row = plane + (size_t)y * width;
+        const float* p1 = plane + (size_t)(y - 1) * width;
+        const float* p2 = plane + (size_t)(y >= 2 ? y - 2 : 0) * width;
+        const float* p3 = plane + (size_t)(y >= 3 ? y - 3 : 0) * width;
+        recursive_row_update(row, p1, p2, p3, x0, x1, c);
+    }
+
+    const float* last[3] = {
+        plane + (size_t)(height - 1) * width,
+        plane + (size_t)(height >= 2 ? height - 2 : 0) * width,
+        plane + (size_t)(height >= 3 ? height - 3 : 0) * width
+    };
+    for (int x = x0; x < x1; x++) {
+        float u = edge[x];
+        float d0 = last[0][x] - u, d1 = last[1][x] - u, d2 = last[2][x] - u;
+        for (int k = 0; k < 3; k++) {
+            beyond[k][x] = u + c->tail[k][0] * d0 + c->tail[k][1] * d1 + c->tail[k][2] * d2;
+        }
+    }
+
+    for (int y = height - 1; y >= 0; y--) {
+        float* row = plane + (size_t)y * width;
+        const float* p1 = y + 1 < height ? plane + (size_t)(y + 1) * width : beyond[y + 1 - height];
+        const float* p2 = y + 2 < height ? plane + (size_t)(y + 2) * width : beyond[y + 2 - height];
+        const float* p3 = y + 3 < height ? plane + (size_t)(y + 3) * width : beyond[y + 3 - height];
+        recursive_row_update(row, p1, p2, p3, x0, x1, c);
+    }
+}
+
+/**
+ * Edge-clamped running-sum box filter of the given odd width down columns
+ * [x0, x1). `sums` holds one accumulator per column.
+ */
+static void box_columns(const float* src, float* dst, float* sums, int width, int height, int x0, int x1,
+                        int box_width) {
+    int radius = box_width / 2;
+    float scale = 1.0f / (float)box_width;
+
+    for (int x = x0; x < x1; x++) {
+        sums[x] = 0.0f;
+    }
+    for (int k = -radius; k <= radius; k++) {
+        const float* row = src + (size_t)(k < 0 ? 0 : (k >= height ? height - 1 : k)) * width;
+        for (int x = x0; x < x1; x++) {
+            sums[x] += row[x];
+        }
+    }
+
+    for (int y = 0; y < height; y++) {
+        float* out = dst + (size_t)y * width;
+        int enter = y + radius + 1 < height ? y + radius + 1 : height - 1;
+        int leave = y - radius > 0 ? y - radius : 0;
+        const float* entering = src + (size_t)enter * width;
+        const float* leaving = src + (size_t)leave * width;
+        int x = x0;
+#ifdef TERMIVIEW_SSE2
+        const __m128 scale_v = _mm_set1_ps(scale);
+        for (; x + 4 <= x1; x += 4) {
+            __m128 sum = _mm_loadu_ps(sums + x);
+            _mm_storeu_ps(out + x, _mm_mul_ps(sum, scale_v));
+            sum = _mm_add_ps(sum, _mm_sub_ps(_mm_loadu_ps(entering + x), _mm_loadu_ps(leaving + x)));
+            _mm_storeu_ps(sums + x, sum);
+        }
+#endif
+        for (; x < x1; x++) {
+            out[x] = sums[x] * scale;
+            sums[x] += entering[x] - leaving[x];
+        }
+    }
+}
+
+/**
+ * Per-call blur setup shared by every column batch and row strip
+ */
+typedef struct {
+    blur_mode_t mode;
+    recursive_gaussian_t recursive;
+    int box_widths[BOX_PASSES];
+} blur_plan_t;
+
+/**
+ * Blur columns [x0, x1) of a plane vertically, leaving the result in `plane`.
+ * `scratch` is a second plane of the same shape (box mode only) and `rows`
+ * holds four plane rows of work space.
+ */
+static void blur_column_range(float* plane, float* scratch, float* rows, int width, int height,
+                              int x0, int x1, const blur_plan_t* plan) {
+    if (plan->mode == BLUR_MODE_RECURSIVE) {
+        recursive_gaussian_columns(plane, rows, width, height, x0, x1, &plan->recursive);
+        return;
+    }
+
+    float* src = plane;
+    float* dst = scratch;
+    for (int pass = 0; pass < BOX_PASSES; pass++) {
+        box_columns(src, dst, rows, width, height, x0, x1, plan->box_widths[pass]);
+        float* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != plane) {
+        for (int y = 0; y < height; y++) {
+            memcpy(plane + (size_t)y * width + x0, src + (size_t)y * width + x0, (size_t)(x1 - x0) * sizeof(float));
+        }
+    }
+}
+
+/**
+ * One channel blur shared by the column-batch and row-strip workers. The
+ * column batches write disjoint columns of `plane`, `plane_scratch` and
+ * `rows`, so they share them; every strip band has its own strip buffers.
+ */
+typedef struct {
+    const unsigned char* input;
+    size_t input_stride;
+    unsigned char* output;      // Packed
+    float* plane;
+    float* plane_scratch;
+    float* rows;
+    int width;
+    int height;
+    const blur_plan_t* plan;
+} blur_job_t;
+
+// Items are COLUMN_BATCH-wide column batches
+static bool blur_column_batches(void* context, const row_band_t* band) {
+    const blur_job_t* job = (const blur_job_t*)context;
+    int width = job->width;
+    for (size_t batch = band->begin; batch < band->end; batch++) {
+        int x0 = (int)batch * COLUMN_BATCH;
+        int x1 = x0 + COLUMN_BATCH < width ? x0 + COLUMN_BATCH : width;
+        for (int y = 0; y < job->height; y++) {
+            const unsigned char* in = job->input + (size_t)y * job->input_stride;
+            float* row = job->plane + (size_t)y * width;
+            for (int x = x0; x < x1; x++) {
+                row[x] = (float)in[x];
+            }
+        }
+        blur_column_range(job->plane, job->plane_scratch, job->rows, width, job->height, x0, x1, job->plan);
+    }
+    return true;
+}
+
+// Items are STRIP_ROWS-tall strips of the vertically blurred plane
+static bool blur_row_strips(void* context, const row_band_t* band) {
+    const blur_job_t* job = (const blur_job_t*)context;
+    int width = job->width;
+    int height = job->height;
+    size_t strip = (size_t)width * STRIP_ROWS;
+    bool box = job->plan->mode == BLUR_MODE_BOX;
+    scratch_mark_t mark = scratch_mark();
+    float* strip_plane = (float*)scratch_alloc(strip * sizeof(float));
+    float* strip_scratch = box ? (float*)scratch_alloc(strip * sizeof(float)) : NULL;
+    float* rows = (float*)scratch_alloc(4 * STRIP_ROWS * sizeof(float));
+    if (strip_plane == NULL || rows == NULL || (box && strip_scratch == NULL)) {
+        scratch_release(mark);
+        return false;
+    }
+
+    for (size_t s = band->begin; s < band->end; s++) {
+        int y0 = (int)s * STRIP_ROWS;
+        int lanes = y0 + STRIP_ROWS < height ? STRIP_ROWS : height - y0;
+        // Strip as a width x lanes plane: row x holds column x of the strip's rows
+        for (int x = 0; x < width; x++) {
+            for (int lane = 0; lane < lanes; lane++) {
+                strip_plane[(size_t)x * lanes + lane] = job->plane[(size_t)(y0 + lane) * width + x];
+            }
+        }
+        blur_column_range(strip_plane, strip_scratch, rows, lanes, width, 0, lanes, job->plan);
+        for (int lane = 0; lane < lanes; lane++) {
+            unsigned char* out = job->output + (size_t)(y0 + lane) * width;
+            for (int x = 0; x < width; x++) {
+                out[x] = clamp_byte(strip_plane[(size_t)x * lanes + lane]);
+            }
+        }
+    }
+
+    scratch_release(mark);
+    return true;
+}
+
+/**
+ * Separable constant-cost blur of one 8-bit channel. The vertical pass runs
+ * down cache-sized batches of columns; the horizontal pass transposes strips
+ * of STRIP_ROWS rows so the same column kernel runs along the rows with the
+ * strip's rows as vector lanes, then writes the strip back as bytes. Both
+ * passes spread their batches and strips over the worker threads. Input
+ * rows are `input_stride` bytes apart; the output is packed.
+ */
+static bool blur_channel(const unsigned char* input, size_t input_stride, unsigned char* output,
+                         int width, int height, const blur_plan_t* plan) {
+    size_t pixels = (size_t)width * height;
+    bool box = plan->mode == BLUR_MODE_BOX;
+    float* plane = (float*)image_buffer_acquire(pixels * sizeof(float));
+    float* plane_scratch = box ? (float*)image_buffer_acquire(pixels * sizeof(float)) : NULL;
+    float* rows = (float*)image_buffer_acquire(4 * (size_t)width * sizeof(float));
+    bool ok = plane != NULL && rows != NULL && (!box || plane_scratch != NULL);
+
+    if (ok) {
+        blur_job_t job = { input, input_stride, output, plane, plane_scratch, rows, width, height, plan };
+        size_t batches = ((size_t)width + COLUMN_BATCH - 1) / COLUMN_BATCH;
+        size_t strips = ((size_t)height + STRIP_ROWS - 1) / STRIP_ROWS;
+        ok = parallel_for(batches, (size_t)height * COLUMN_BATCH, 0, blur_column_batches, &job) &&
+             parallel_for(strips, (size_t)width * STRIP_ROWS, 0, blur_row_strips, &job);
+    }
+
+    image_buffer_release(plane);
+    image_buffer_release(plane_scratch);
+    image_buffer_release(rows);
+    return ok;
+}
+
+static blur_plan_t make_blur_plan(float sigma, blur_mode_t mode) {
+    blur_plan_t plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.mode = mode;
+    if (mode == BLUR_MODE_RECURSIVE) {
+        plan.recursive = make_recursive_gaussian(sigma);
+    } else {
+        box_widths_for_gaussian(sigma, plan.box_widths);
+    }
+    return plan;
+}
+
+/**
+ * The recursive coefficients are only valid from sigma 0.5; narrower blurs
+ * are cheap with the sampled kernel anyway
+ */
+static blur_mode_t effective_blur_mode(float sigma, blur_mode_t mode) {
+    if (mode == BLUR_MODE_RECURSIVE && sigma < 0.5f) {
+        return BLUR_MODE_KERNEL;
+    }
+    return mode;
+}
+
+bool blur_uses_kernel(float sigma, blur_mode_t mode) {
+    return effective_blur_mode(sigma, mode) == BLUR_MODE_KERNEL;
+}
+
+grayscale_image_t apply_gaussian_blur(const grayscale_image_t* image, float sigma, blur_mode_t mode) {
+    grayscale_image_t result = {0};
+    if (image == NULL || image->data == NULL || sigma <= 0.0f) {
+        fprintf(stderr, "Error: Invalid input to apply_gaussian_blur\n");
+        return result;
+    }
+
+    mode = effective_blur_mode(sigma, mode);
+    if (mode == BLUR_MODE_KERNEL) {
+        kernel_t kernel = create_gaussian_blur_kernel(gaussian_kernel_size(sigma), sigma);
+        if (kernel.data == NULL) {
+            return result;
+        }
+        result = apply_convolution_grayscale(image, &kernel);
+        free_kernel(&kernel);
+        return result;
+    }
+
+    blur_plan_t plan = make_blur_plan(sigma, mode);
+    result = allocate_grayscale_image(image->width, image->height);
+    if (result.data == NULL ||
+        !blur_channel(image->data, grayscale_stride(image), result.data, (int)image->width, (int)image->height,
+                      &plan)) {
+        fprintf(stderr, "Error: Failed to allocate memory for blur\n");
+        free_grayscale_image(&result);
+        return (grayscale_image_t){0};
+    }
+    return result;
+}
+
+rgb_image_t apply_gaussian_blur_rgb(const rgb_image_t* image, float sigma, blur_mode_t mode) {
+    rgb_image_t result = {0};
+    if (image == NULL || image->r_data == NULL || image->g_data == NULL || image->b_data == NULL || sigma <= 0.0f) {
+        fprintf(stderr, "Error: Invalid input to apply_gaussian_blur_rgb\n");
+        return result;
+    }
+
+    mode = effective_blur_mode(sigma, mode);
+    if (mode == BLUR_MODE_KERNEL) {
+        kernel_t kernel = create_gaussian_blur_kernel(gaussian_kernel_size(sigma), sigma);
+        if (kernel.data == NULL) {
+            return result;
+        }
+        result = apply_convolution_rgb(image, &kernel);
+        free_kernel(&kernel);
+        return result;
+    }
+
+    result = allocate_rgb_image(image->width, image->height);
+    int width = (int)image->width;
+    int height = (int)image->height;
+    size_t stride = rgb_stride(image);
+    blur_plan_t plan = make_blur_plan(sigma, mode);
+    if (result.r_data == NULL ||
+        !blur_channel(image->r_data, stride, result.r_data, width, height, &plan) ||
+        !blur_channel(image->g_data, stride, result.g_data, width, height, &plan) ||
+        !blur_channel(image->b_data, stride, result.b_data, width, height, &plan)) {
+        fprintf(stderr, "Error: Failed to allocate memory for blur\n");
+        free_rgb_image(&result);
+        return (rgb_image_t){0};
+    }
+    return result;
+}
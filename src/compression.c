@@ -6,6 +6,7 @@
 #include <stdbool.h> // For bool type
 #include <fftw3.h>
 #include "../include/image_processing.h"
+#include "../include/image_alloc.h"
 #include <math.h> // For round()
 
 
@@ -26,7 +27,8 @@ void calculate_frequencies(const unsigned char* data, size_t data_len, unsigned
 static void dwt_1d(double* data, int n) {
     if (n <= 1) return;
 
-    double* temp = (double*)malloc(sizeof(double) * n);
+    scratch_mark_t mark = scratch_mark();
+    double* temp = (double*)scratch_alloc(sizeof(double) * n);
     if (temp == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for DWT temporary array\n");
         exit(EXIT_FAILURE);
@@ -39,14 +41,15 @@ static void dwt_1d(double* data, int n) {
     }
 
     memcpy(data, temp, sizeof(double) * n);
-    free(temp);
+    scratch_release(mark);
 }
 
 // 1D Inverse Haar DWT
 static void idwt_1d(double* data, int n) {
     if (n <= 1) return;
 
-    double* temp = (double*)malloc(sizeof(double) * n);
+    scratch_mark_t mark = scratch_mark();
+    double* temp = (double*)scratch_alloc(sizeof(double) * n);
     if (temp == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for IDWT temporary array\n");
         exit(EXIT_FAILURE);
@@ -59,7 +62,7 @@ static void idwt_1d(double* data, int n) {
     }
 
     memcpy(data, temp, sizeof(double) * n);
-    free(temp);
+    scratch_release(mark);
 }
 
 // Function to create a new Huffman node
@@ -841,15 +844,16 @@ void compute_dct_2d(const grayscale_image_t* image, double* out_coeffs) {
     int width = image->width;
     int height = image->height;
 
-    double* in = (double*)fftw_malloc(sizeof(double) * width * height);
+    double* in = (double*)image_buffer_acquire(sizeof(double) * width * height);
     if (in == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for FFTW input\n");
         return;
     }
 
     for (int i = 0; i < height; i++) {
+        const unsigned char* row = grayscale_row(image, (size_t)i);
         for (int j = 0; j < width; j++) {
-            in[i * width + j] = (double)image->data[i * width + j] - 128.0;
+            in[i * width + j] = (double)row[j] - 128.0;
         }
     }
 
@@ -857,7 +861,7 @@ void compute_dct_2d(const grayscale_image_t* image, double* out_coeffs) {
     fftw_execute(plan);
 
     fftw_destroy_plan(plan);
-    fftw_free(in);
+    image_buffer_release(in);
 
 }
 
@@ -871,7 +875,7 @@ void compute_idct_2d(double* in_coeffs, grayscale_image_t* out_image) {
     int width = out_image->width;
     int height = out_image->height;
 
-    double* out = (double*)fftw_malloc(sizeof(double) * width * height);
+    double* out = (double*)image_buffer_acquire(sizeof(double) * width * height);
     if (out == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for FFTW output\n");
         return;
@@ -885,16 +889,17 @@ void compute_idct_2d(double* in_coeffs, grayscale_image_t* out_image) {
     // Normalize by 4*width*height as IDCT is unnormalized in FFTW
     double normalization_factor = 4.0 * width * height;
     for (int i = 0; i < height; i++) {
+        unsigned char* row = grayscale_row(out_image, (size_t)i);
         for (int j = 0; j < width; j++) {
             double val = out[i * width + j] / normalization_factor + 128.0;
             if (val < 0.0) val = 0.0;
             if (val > 255.0) val = 255.0;
-            out_image->data[i * width + j] = (unsigned char)round(val);
+            row[j] = (unsigned char)round(val);
         }
     }
 
     fftw_destroy_plan(plan);
-    fftw_free(out);
+    image_buffer_release(out);
 }
 
 // Function to encode data using DCT-based compression
@@ -907,7 +912,7 @@ unsigned char* dct_based_encode(const grayscale_image_t* image, size_t* encoded_
     int height = image->height;
     size_t num_coeffs = width * height;
 
-    double* dct_coeffs = (double*)fftw_malloc(sizeof(double) * num_coeffs);
+    double* dct_coeffs = (double*)image_buffer_acquire(sizeof(double) * num_coeffs);
     if (dct_coeffs == NULL) {
         return NULL;
     }
@@ -922,7 +927,7 @@ unsigned char* dct_based_encode(const grayscale_image_t* image, size_t* encoded_
     *encoded_len_bytes = sizeof(int) * 2 + num_coeffs * sizeof(char); 
     unsigned char* encoded_data = (unsigned char*)malloc(*encoded_len_bytes);
     if (encoded_data == NULL) {
-        fftw_free(dct_coeffs);
+        image_buffer_release(dct_coeffs);
         return NULL;
     }
 
@@ -936,7 +941,7 @@ unsigned char* dct_based_encode(const grayscale_image_t* image, size_t* encoded_
         quantized_coeffs[i] = (char)round(dct_coeffs[i] / quantization_step);
     }
 
-    fftw_free(dct_coeffs);
+    image_buffer_release(dct_coeffs);
     return encoded_data;
 }
 
@@ -958,7 +963,7 @@ grayscale_image_t* dct_based_decode(const unsigned char* encoded_data, size_t en
     size_t num_coeffs = width * height;
     const char* quantized_coeffs = (const char*)(encoded_data + sizeof(int) * 2);
 
-    double* dct_coeffs = (double*)fftw_malloc(sizeof(double) * num_coeffs);
+    double* dct_coeffs = (double*)image_buffer_acquire(sizeof(double) * num_coeffs);
     if (dct_coeffs == NULL) {
         return NULL;
     }
@@ -969,9 +974,9 @@ grayscale_image_t* dct_based_decode(const unsigned char* encoded_data, size_t en
         dct_coeffs[i] = (double)quantized_coeffs[i] * quantization_step;
     }
 
-    grayscale_image_t* decoded_image = (grayscale_image_t*)malloc(sizeof(grayscale_image_t));
+    grayscale_image_t* decoded_image = (grayscale_image_t*)calloc(1, sizeof(grayscale_image_t));
     if (decoded_image == NULL) {
-        fftw_free(dct_coeffs);
+        image_buffer_release(dct_coeffs);
         return NULL;
     }
     decoded_image->width = width;
@@ -979,18 +984,18 @@ grayscale_image_t* dct_based_decode(const unsigned char* encoded_data, size_t en
     decoded_image->data = (unsigned char*)malloc(num_coeffs);
     if (decoded_image->data == NULL) {
         free(decoded_image);
-        fftw_free(dct_coeffs);
+        image_buffer_release(dct_coeffs);
         return NULL;
     }
 
     compute_idct_2d(dct_coeffs, decoded_image);
 
-    fftw_free(dct_coeffs);
+    image_buffer_release(dct_coeffs);
     return decoded_image;
 }
 
 // Default JPEG Luminance Quantization Table (scaled for quality)
-static const unsigned char default_luminance_quant_table[64] = {
+const unsigned char default_luminance_quant_table[64] = {
     16, 11, 10, 16, 24, 40, 51, 61,
     12, 12, 14, 19, 26, 58, 60, 55,
     14, 13, 16, 24, 40, 57, 69, 56,
@@ -1002,7 +1007,7 @@ static const unsigned char default_luminance_quant_table[64] = {
 };
 
 // Zig-zag scan order for an 8x8 block
-static const unsigned char zigzag_order[64] = {
+const unsigned char zigzag_order[64] = {
      0,  1,  5,  6, 14, 15, 27, 28,
      2,  4,  7, 13, 16, 26, 29, 42,
      3,  8, 12, 17, 25, 30, 41, 43,
@@ -1016,7 +1021,7 @@ static const unsigned char zigzag_order[64] = {
 
 // Function to encode grayscale image using JPEG (simplified)
 unsigned char* jpeg_encode(const grayscale_image_t* image, int quality, size_t* encoded_len_bytes) {
-    if (image == NULL || encoded_len_bytes == NULL) {
+    if (image == NULL || image->data == NULL || encoded_len_bytes == NULL) {
         return NULL;
     }
 
@@ -1024,24 +1029,9 @@ unsigned char* jpeg_encode(const grayscale_image_t* image, int quality, size_t*
     int original_width = image->width;
     int original_height = image->height;
 
-    // Pad image to be a multiple of block_size
-    int padded_width = ((original_width + block_size - 1) / block_size) * block_size;
-    int padded_height = ((original_height + block_size - 1) / block_size) * block_size;
-
-    grayscale_image_t padded_image = { .width = padded_width, .height = padded_height };
-    padded_image.data = (unsigned char*)calloc(padded_width * padded_height, sizeof(unsigned char));
-    if (padded_image.data == NULL) {
-        return NULL;
-    }
-
-    // Copy original image data to padded image, fill with 0 or replicate edge pixels
-    for (int y = 0; y < original_height; y++) {
-        memcpy(padded_image.data + y * padded_width, image->data + y * original_width, original_width);
-    }
-    // For simplicity, remaining padded areas are 0 (or could replicate edge)
-
-    int num_blocks_x = padded_width / block_size;
-    int num_blocks_y = padded_height / block_size;
+    // The image is coded as if padded with zeros to a multiple of block_size
+    int num_blocks_x = (original_width + block_size - 1) / block_size;
+    int num_blocks_y = (original_height + block_size - 1) / block_size;
     int total_blocks = num_blocks_x * num_blocks_y;
 
     // Quantization table scaling
@@ -1057,8 +1047,20 @@ unsigned char* jpeg_encode(const grayscale_image_t* image, int quality, size_t*
     // For simplicity, we'll store all 64 coefficients per block as chars
     size_t buffer_capacity = sizeof(int) * 2 + total_blocks * 64 * sizeof(char); // + original width/height
     unsigned char* encoded_data = (unsigned char*)malloc(buffer_capacity);
-    if (encoded_data == NULL) {
-        free_grayscale_image(&padded_image);
+
+    // One DCT plan and sample buffer serve every block
+    scratch_mark_t mark = scratch_mark();
+    double* block_samples = (double*)scratch_alloc(sizeof(double) * 64);
+    double* block_coeffs = (double*)scratch_alloc(sizeof(double) * 64);
+    fftw_plan plan = NULL;
+    if (block_samples != NULL && block_coeffs != NULL) {
+        plan = fftw_plan_r2r_2d(block_size, block_size, block_samples, block_coeffs,
+                                FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE);
+    }
+    if (encoded_data == NULL || plan == NULL) {
+        if (plan != NULL) fftw_destroy_plan(plan);
+        scratch_release(mark);
+        free(encoded_data);
         return NULL;
     }
     size_t current_encoded_idx = 0;
@@ -1069,29 +1071,27 @@ unsigned char* jpeg_encode(const grayscale_image_t* image, int quality, size_t*
     memcpy(encoded_data + current_encoded_idx, &original_height, sizeof(int));
     current_encoded_idx += sizeof(int);
 
-
-    double block_coeffs[64];
     char quantized_block[64];
 
     for (int by = 0; by < num_blocks_y; by++) {
         for (int bx = 0; bx < num_blocks_x; bx++) {
-            // Extract 8x8 block
-            grayscale_image_t current_block = { .width = block_size, .height = block_size };
-            current_block.data = (unsigned char*)malloc(block_size * block_size);
-            if (current_block.data == NULL) {
-                free_grayscale_image(&padded_image);
-                free(encoded_data);
-                return NULL;
-            }
+            // Read the block in place; samples past the image edge are zero
+            int x0 = bx * block_size;
+            int y0 = by * block_size;
+            int block_w = original_width - x0 < block_size ? original_width - x0 : block_size;
+            int block_h = original_height - y0 < block_size ? original_height - y0 : block_size;
+            grayscale_image_t block = image_view_roi(image, (size_t)x0, (size_t)y0, (size_t)block_w, (size_t)block_h);
 
             for (int y = 0; y < block_size; y++) {
+                const unsigned char* row = y < block_h ? grayscale_row(&block, (size_t)y) : NULL;
                 for (int x = 0; x < block_size; x++) {
-                    current_block.data[y * block_size + x] = padded_image.data[(by * block_size + y) * padded_width + (bx * block_size + x)];
+                    double pixel = row != NULL && x < block_w ? (double)row[x] : 0.0;
+                    block_samples[y * block_size + x] = pixel - 128.0;
                 }
             }
 
             // Compute DCT for the block
-            compute_dct_2d(&current_block, block_coeffs);
+            fftw_execute(plan);
 
             // Quantize
             for (int i = 0; i < 64; i++) {
@@ -1102,10 +1102,12 @@ unsigned char* jpeg_encode(const grayscale_image_t* image, int quality, size_t*
             for (int i = 0; i < 64; i++) {
                 encoded_data[current_encoded_idx++] = quantized_block[zigzag_order[i]];
             }
-            free(current_block.data);
         }
     }
 
+    fftw_destroy_plan(plan);
+    scratch_release(mark);
+    *encoded_len_bytes = current_encoded_idx;
     return encoded_data;
 }
 
@@ -1125,9 +1127,14 @@ void compute_dwt_2d(const grayscale_image_t* image, double* out_coeffs, int leve
     int padded_height = 1;
     while (padded_height < original_height) padded_height <<= 1;
 
-    double* temp_data = (double*)malloc(sizeof(double) * padded_width * padded_height);
-    if (temp_data == NULL) {
+    // One line buffer serves every row and column
+    scratch_mark_t mark = scratch_mark();
+    double* temp_data = (double*)image_buffer_acquire(sizeof(double) * padded_width * padded_height);
+    double* line = (double*)scratch_alloc(sizeof(double) * (padded_width > padded_height ? padded_width : padded_height));
+    if (temp_data == NULL || line == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for DWT temp_data\n");
+        image_buffer_release(temp_data);
+        scratch_release(mark);
         return;
     }
 
@@ -1155,32 +1162,27 @@ void compute_dwt_2d(const grayscale_image_t* image, double* out_coeffs, int leve
 
         // DWT on rows
         for (int y = 0; y < current_height; y++) {
-            double* row_data = (double*)malloc(sizeof(double) * current_width);
-            if (row_data == NULL) { /* handle error */ return; }
-            memcpy(row_data, temp_data + y * padded_width, sizeof(double) * current_width);
-            dwt_1d(row_data, current_width);
-            memcpy(temp_data + y * padded_width, row_data, sizeof(double) * current_width);
-            free(row_data);
+            memcpy(line, temp_data + y * padded_width, sizeof(double) * current_width);
+            dwt_1d(line, current_width);
+            memcpy(temp_data + y * padded_width, line, sizeof(double) * current_width);
         }
 
         // DWT on columns
         for (int x = 0; x < current_width; x++) {
-            double* col_data = (double*)malloc(sizeof(double) * current_height);
-            if (col_data == NULL) { /* handle error */ return; }
             for (int y = 0; y < current_height; y++) {
-                col_data[y] = temp_data[y * padded_width + x];
+                line[y] = temp_data[y * padded_width + x];
             }
-            dwt_1d(col_data, current_height);
+            dwt_1d(line, current_height);
             for (int y = 0; y < current_height; y++) {
-                temp_data[y * padded_width + x] = col_data[y];
+                temp_data[y * padded_width + x] = line[y];
             }
-            free(col_data);
         }
         current_width /= 2;
         current_height /= 2;
     }
     memcpy(out_coeffs, temp_data, sizeof(double) * padded_width * padded_height);
-    free(temp_data);
+    image_buffer_release(temp_data);
+    scratch_release(mark);
 }
 
 // Compute 2D IDWT using 1D Haar wavelets
@@ -1198,9 +1200,13 @@ void compute_idwt_2d(double* in_coeffs, grayscale_image_t* out_image, int levels
     int padded_height = 1;
     while (padded_height < original_height) padded_height <<= 1;
 
-    double* temp_data = (double*)malloc(sizeof(double) * padded_width * padded_height);
-    if (temp_data == NULL) {
+    scratch_mark_t mark = scratch_mark();
+    double* temp_data = (double*)image_buffer_acquire(sizeof(double) * padded_width * padded_height);
+    double* line = (double*)scratch_alloc(sizeof(double) * (padded_width > padded_height ? padded_width : padded_height));
+    if (temp_data == NULL || line == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for DWT temp_data\n");
+        image_buffer_release(temp_data);
+        scratch_release(mark);
         return;
     }
     memcpy(temp_data, in_coeffs, sizeof(double) * padded_width * padded_height);
@@ -1213,26 +1219,20 @@ void compute_idwt_2d(double* in_coeffs, grayscale_image_t* out_image, int levels
     for (int l = 0; l < levels; l++) {
         // IDWT on columns
         for (int x = 0; x < current_width; x++) {
-            double* col_data = (double*)malloc(sizeof(double) * current_height);
-            if (col_data == NULL) { /* handle error */ return; }
             for (int y = 0; y < current_height; y++) {
-                col_data[y] = temp_data[y * padded_width + x];
+                line[y] = temp_data[y * padded_width + x];
             }
-            idwt_1d(col_data, current_height);
+            idwt_1d(line, current_height);
             for (int y = 0; y < current_height; y++) {
-                temp_data[y * padded_width + x] = col_data[y];
+                temp_data[y * padded_width + x] = line[y];
             }
-            free(col_data);
         }
 
         // IDWT on rows
         for (int y = 0; y < current_height; y++) {
-            double* row_data = (double*)malloc(sizeof(double) * current_width);
-            if (row_data == NULL) { /* handle error */ return; }
-            memcpy(row_data, temp_data + y * padded_width, sizeof(double) * current_width);
-            idwt_1d(row_data, current_width);
-            memcpy(temp_data + y * padded_width, row_data, sizeof(double) * current_width);
-            free(row_data);
+            memcpy(line, temp_data + y * padded_width, sizeof(double) * current_width);
+            idwt_1d(line, current_width);
+            memcpy(temp_data + y * padded_width, line, sizeof(double) * current_width);
         }
         current_width *= 2;
         current_height *= 2;
@@ -1247,7 +1247,8 @@ void compute_idwt_2d(double* in_coeffs, grayscale_image_t* out_image, int levels
             out_image->data[y * original_width + x] = (unsigned char)round(val);
         }
     }
-    free(temp_data);
+    image_buffer_release(temp_data);
+    scratch_release(mark);
 }
 
 // Function to encode data using Wavelet-based compression
@@ -1266,7 +1267,7 @@ unsigned char* wavelet_encode(const grayscale_image_t* image, int levels, size_t
     while (padded_height < original_height) padded_height <<= 1;
 
     size_t num_coeffs = padded_width * padded_height;
-    double* dwt_coeffs = (double*)malloc(sizeof(double) * num_coeffs);
+    double* dwt_coeffs = (double*)image_buffer_acquire(sizeof(double) * num_coeffs);
     if (dwt_coeffs == NULL) {
         return NULL;
     }
@@ -1280,7 +1281,7 @@ unsigned char* wavelet_encode(const grayscale_image_t* image, int levels, size_t
     *encoded_len_bytes = sizeof(int) * 3 + num_coeffs * sizeof(char); 
     unsigned char* encoded_data = (unsigned char*)malloc(*encoded_len_bytes);
     if (encoded_data == NULL) {
-        free(dwt_coeffs);
+        image_buffer_release(dwt_coeffs);
         return NULL;
     }
 
@@ -1298,7 +1299,7 @@ unsigned char* wavelet_encode(const grayscale_image_t* image, int levels, size_t
         quantized_coeffs[i] = (char)round(dwt_coeffs[i] / quantization_step);
     }
 
-    free(dwt_coeffs);
+    image_buffer_release(dwt_coeffs);
     return encoded_data;
 }
 
@@ -1330,7 +1331,7 @@ grayscale_image_t* wavelet_decode(const unsigned char* encoded_data, size_t enco
     size_t num_coeffs = padded_width * padded_height;
     const char* quantized_coeffs = (const char*)(encoded_data + current_decoded_idx);
 
-    double* dwt_coeffs = (double*)malloc(sizeof(double) * num_coeffs);
+    double* dwt_coeffs = (double*)image_buffer_acquire(sizeof(double) * num_coeffs);
     if (dwt_coeffs == NULL) {
         return NULL;
     }
@@ -1341,23 +1342,21 @@ grayscale_image_t* wavelet_decode(const unsigned char* encoded_data, size_t enco
         dwt_coeffs[i] = (double)quantized_coeffs[i] * quantization_step;
     }
 
-    grayscale_image_t* decoded_image = (grayscale_image_t*)malloc(sizeof(grayscale_image_t));
+    grayscale_image_t* decoded_image = (grayscale_image_t*)calloc(1, sizeof(grayscale_image_t));
     if (decoded_image == NULL) {
-        free(dwt_coeffs);
+        image_buffer_release(dwt_coeffs);
         return NULL;
     }
-    decoded_image->width = original_width;
-    decoded_image->height = original_height;
-    decoded_image->data = (unsigned char*)malloc(original_width * original_height);
+    *decoded_image = allocate_grayscale_image((size_t)original_width, (size_t)original_height);
     if (decoded_image->data == NULL) {
         free(decoded_image);
-        free(dwt_coeffs);
+        image_buffer_release(dwt_coeffs);
         return NULL;
     }
 
     compute_idwt_2d(dwt_coeffs, decoded_image, levels);
 
-    free(dwt_coeffs);
+    image_buffer_release(dwt_coeffs);
     return decoded_image;
 }
 
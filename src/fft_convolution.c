@@ -0,0 +1,242 @@
+#include "../include/fft_convolution.h"
+#include "../include/image_alloc.h"
+#include "../include/parallel.h"
+#include <fftw3.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Cost model constants in nanoseconds, calibrated on an AVX2 x86-64 core
+ * against the spatial paths in filters.c and FFTW_ESTIMATE plans. Only
+ * their ratios matter.
+ */
+#define DIRECT_NS_PER_TAP 0.12          // Vectorized K x K sweep, per output pixel and tap
+#define SEPARABLE_NS_PER_TAP 0.10       // Two 1D passes, per output pixel and tap
+#define FFT_NS_PER_POINT_LOG 0.28       // One real 2D transform, per point and log2(points)
+#define TILE_NS_PER_POINT 1.0           // Gather, spectrum product and write-back, per tile point
+
+/**
+ * Candidate FFT sizes. Only powers of two: with estimated plans, sizes such
+ * as 96 or 192 measured two to three times slower per point.
+ */
+static const int tile_sizes[] = { 32, 64, 128, 256, 512, 1024 };
+#define TILE_SIZE_COUNT (sizeof(tile_sizes) / sizeof(tile_sizes[0]))
+
+/**
+ * Forward and inverse plans for one n x n tile. Plans are created once per
+ * size on first use and kept for the life of the process; executing them
+ * on other arrays (fftw_execute_dft_*) is thread-safe. The cache and the
+ * FFTW planner, which is not, are only touched under plan_lock.
+ */
+typedef struct {
+    int size;
+    fftw_plan forward;
+    fftw_plan inverse;
+} tile_plan_t;
+
+static tile_plan_t plan_cache[TILE_SIZE_COUNT];
+static pthread_mutex_t plan_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned char clamp_byte(double value) {
+    if (value < 0.0) return 0;
+    if (value > 255.0) return 255;
+    return (unsigned char)(value + 0.5);
+}
+
+static double tile_cost(int n) {
+    double points = (double)n * n;
+    return points * (2.0 * FFT_NS_PER_POINT_LOG * log2(points) + TILE_NS_PER_POINT);
+}
+
+/**
+ * Tile size with the lowest estimated cost for the whole channel, or 0 when
+ * no candidate tile holds the kernel. `cost` receives that estimate.
+ */
+static int choose_tile_size(size_t kernel_size, size_t width, size_t height, double* cost) {
+    int best = 0;
+    double best_cost = HUGE_VAL;
+    for (size_t i = 0; i < TILE_SIZE_COUNT; i++) {
+        int n = tile_sizes[i];
+        if ((size_t)n <= kernel_size) {
+            continue;
+        }
+        size_t block = (size_t)n - kernel_size + 1;
+        double tiles = (double)((width + block - 1) / block) * (double)((height + block - 1) / block);
+        double total = tiles * tile_cost(n);
+        if (total < best_cost) {
+            best_cost = total;
+            best = n;
+        }
+    }
+    *cost = best_cost;
+    return best;
+}
+
+bool fft_convolution_preferred(const kernel_t* kernel, size_t width, size_t height, bool separable) {
+    if (kernel == NULL || kernel->divisor == 0.0f || width == 0 || height == 0) {
+        return false;
+    }
+    double k = (double)kernel->size;
+    double spatial = (double)width * height * (separable ? 2.0 * k * SEPARABLE_NS_PER_TAP : k * k * DIRECT_NS_PER_TAP);
+    double fft;
+    return choose_tile_size(kernel->size, width, height, &fft) != 0 && fft < spatial;
+}
+
+static const tile_plan_t* tile_plan(int n) {
+    size_t slot = 0;
+    while (slot < TILE_SIZE_COUNT && tile_sizes[slot] != n) {
+        slot++;
+    }
+    if (slot == TILE_SIZE_COUNT) {
+        return NULL;
+    }
+    tile_plan_t* plan = &plan_cache[slot];
+    pthread_mutex_lock(&plan_lock);
+    if (plan->size == n) {
+        pthread_mutex_unlock(&plan_lock);
+        return plan;
+    }
+
+    double* samples = (double*)fftw_malloc(sizeof(double) * n * n);
+    fftw_complex* spectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * n * (n / 2 + 1));
+    if (samples != NULL && spectrum != NULL) {
+        plan->forward = fftw_plan_dft_r2c_2d(n, n, samples, spectrum, FFTW_ESTIMATE);
+        plan->inverse = fftw_plan_dft_c2r_2d(n, n, spectrum, samples, FFTW_ESTIMATE);
+    }
+    fftw_free(samples);
+    fftw_free(spectrum);
+    if (plan->forward == NULL || plan->inverse == NULL) {
+        if (plan->forward != NULL) fftw_destroy_plan(plan->forward);
+        if (plan->inverse != NULL) fftw_destroy_plan(plan->inverse);
+        plan->forward = plan->inverse = NULL;
+        pthread_mutex_unlock(&plan_lock);
+        return NULL;
+    }
+    plan->size = n;
+    pthread_mutex_unlock(&plan_lock);
+    return plan;
+}
+
+typedef struct {
+    const unsigned char* input;
+    size_t input_stride;
+    unsigned char* output;
+    size_t width;
+    size_t height;
+    const kernel_t* kernel;
+    const tile_plan_t* plan;
+    const fftw_complex* kernel_spectrum;
+    size_t block;       // Output pixels per tile side
+    size_t tiles_x;
+} fft_job_t;
+
+/**
+ * Overlap-save over the tiles of rows [begin, end) of the tile grid: each
+ * n x n input patch (clamped at the image borders) is multiplied by the
+ * kernel spectrum, and the block x block part without wrap-around is the
+ * output.
+ */
+static bool fft_tile_rows(void* context, const row_band_t* band) {
+    const fft_job_t* job = (const fft_job_t*)context;
+    int n = job->plan->size;
+    size_t bins = (size_t)n * (n / 2 + 1);
+    int half = (int)job->kernel->size / 2;
+    int width = (int)job->width;
+    int height = (int)job->height;
+    // Scratch memory is IMAGE_ALIGNMENT aligned, which covers the SIMD
+    // alignment the plans were made with
+    scratch_mark_t mark = scratch_mark();
+    double* patch = (double*)scratch_alloc(sizeof(double) * n * n);
+    fftw_complex* spectrum = (fftw_complex*)scratch_alloc(sizeof(fftw_complex) * bins);
+    int* columns = (int*)scratch_alloc(sizeof(int) * n);
+    if (patch == NULL || spectrum == NULL || columns == NULL) {
+        scratch_release(mark);
+        return false;
+    }
+
+    for (size_t ty = band->begin; ty < band->end; ty++) {
+        for (size_t tx = 0; tx < job->tiles_x; tx++) {
+            int y0 = (int)(ty * job->block);
+            int x0 = (int)(tx * job->block);
+            for (int px = 0; px < n; px++) {
+                int sx = x0 - half + px;
+                columns[px] = sx < 0 ? 0 : (sx >= width ? width - 1 : sx);
+            }
+            for (int py = 0; py < n; py++) {
+                int sy = y0 - half + py;
+                const unsigned char* row =
+                    job->input + (size_t)(sy < 0 ? 0 : (sy >= height ? height - 1 : sy)) * job->input_stride;
+                double* dst = patch + (size_t)py * n;
+                for (int px = 0; px < n; px++) {
+                    dst[px] = row[columns[px]];
+                }
+            }
+
+            fftw_execute_dft_r2c(job->plan->forward, patch, spectrum);
+            for (size_t i = 0; i < bins; i++) {
+                double re = spectrum[i][0] * job->kernel_spectrum[i][0] - spectrum[i][1] * job->kernel_spectrum[i][1];
+                double im = spectrum[i][0] * job->kernel_spectrum[i][1] + spectrum[i][1] * job->kernel_spectrum[i][0];
+                spectrum[i][0] = re;
+                spectrum[i][1] = im;
+            }
+            fftw_execute_dft_c2r(job->plan->inverse, spectrum, patch);
+
+            int rows = y0 + (int)job->block < height ? (int)job->block : height - y0;
+            int cols = x0 + (int)job->block < width ? (int)job->block : width - x0;
+            for (int y = 0; y < rows; y++) {
+                unsigned char* out = job->output + (size_t)(y0 + y) * width + x0;
+                const double* src = patch + (size_t)y * n;
+                for (int x = 0; x < cols; x++) {
+                    out[x] = clamp_byte(src[x] + job->kernel->offset);
+                }
+            }
+        }
+    }
+
+    scratch_release(mark);
+    return true;
+}
+
+bool fft_convolve_channel(const unsigned char* input, size_t input_stride, unsigned char* output,
+                          size_t width, size_t height, const kernel_t* kernel) {
+    double cost;
+    int n = choose_tile_size(kernel->size, width, height, &cost);
+    const tile_plan_t* plan = n > 0 ? tile_plan(n) : NULL;
+    if (plan == NULL) {
+        return false;
+    }
+
+    size_t bins = (size_t)n * (n / 2 + 1);
+    double* taps = (double*)fftw_malloc(sizeof(double) * n * n);
+    fftw_complex* kernel_spectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * bins);
+    if (taps == NULL || kernel_spectrum == NULL) {
+        fftw_free(taps);
+        fftw_free(kernel_spectrum);
+        return false;
+    }
+
+    // Kernel mirrored about the origin, so the circular convolution is the
+    // correlation the spatial path computes; divisor and the 1 / n^2 of the
+    // unnormalised inverse transform are folded into the taps
+    int k = (int)kernel->size;
+    double scale = 1.0 / ((double)kernel->divisor * n * n);
+    memset(taps, 0, sizeof(double) * n * n);
+    for (int ky = 0; ky < k; ky++) {
+        for (int kx = 0; kx < k; kx++) {
+            taps[(size_t)((n - ky) % n) * n + (n - kx) % n] = kernel->data[ky * k + kx] * scale;
+        }
+    }
+    fftw_execute_dft_r2c(plan->forward, taps, kernel_spectrum);
+    fftw_free(taps);
+
+    size_t block = (size_t)n - kernel->size + 1;
+    size_t tiles_y = (height + block - 1) / block;
+    fft_job_t job = { input, input_stride, output, width, height, kernel, plan, (const fftw_complex*)kernel_spectrum,
+                      block, (width + block - 1) / block };
+    bool ok = parallel_for(tiles_y, job.tiles_x * (size_t)tile_cost(n), 0, fft_tile_rows, &job);
+    fftw_free(kernel_spectrum);
+    return ok;
+}
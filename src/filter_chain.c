@@ -0,0 +1,407 @@
+#include "../include/filter_chain.h"
+#include "../include/frequency.h"
+#include "../include/image_alloc.h"
+#include "../include/median.h"
+#include "../include/nlmeans.h"
+#include "../include/morphology.h"
+#include "../include/parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * One filter of a fused run. Stage 0 of a band stands for the run's input;
+ * every later stage keeps the last `ring_rows` rows it produced, as many as
+ * the next stage reads around one output row.
+ */
+typedef struct stream_stage {
+    row_filter_t* filter;           // NULL for the input stage
+    const unsigned char* input;     // Input stage only, rows `input_stride` bytes apart
+    size_t input_stride;
+    unsigned char* ring;
+    size_t ring_rows;
+    size_t next_row;                // Next row this stage will produce
+    size_t width;
+    struct stream_stage* upstream;
+} stream_stage_t;
+
+typedef struct {
+    const unsigned char* input;
+    size_t input_stride;
+    unsigned char* output;
+    size_t width;
+    size_t height;
+    const filter_type_t* filters;
+    size_t count;
+    const filter_chain_params_t* params;
+} stream_job_t;
+
+bool parse_filter_chain(const char* chain_str, filter_chain_t* chain) {
+    chain->count = 0;
+    if (chain_str == NULL) {
+        return false;
+    }
+
+    const char* start = chain_str;
+    for (;;) {
+        const char* end = strchr(start, ',');
+        size_t length = end != NULL ? (size_t)(end - start) : strlen(start);
+        char name[32];
+        if (length == 0 || length >= sizeof(name)) {
+            return false;
+        }
+        memcpy(name, start, length);
+        name[length] = '\0';
+
+        // "none" entries are dropped; any other name must be a known filter
+        filter_type_t type = parse_filter_type(name);
+        if (type == FILTER_NONE && strcmp(name, "none") != 0) {
+            return false;
+        }
+        if (type != FILTER_NONE) {
+            if (chain->count == MAX_CHAIN_FILTERS) {
+                return false;
+            }
+            chain->filters[chain->count++] = type;
+        }
+        if (end == NULL) {
+            return true;
+        }
+        start = end + 1;
+    }
+}
+
+bool filter_chain_preserves_color(const filter_chain_t* chain) {
+    for (size_t i = 0; i < chain->count; i++) {
+        filter_type_t type = chain->filters[i];
+        morphology_op_t op;
+        if (type != FILTER_BLUR && type != FILTER_SHARPEN && type != FILTER_MEDIAN &&
+            type != FILTER_BILATERAL && type != FILTER_GUIDED && type != FILTER_NL_MEANS &&
+            !morphology_op_for_filter(type, &op)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Row filter for a filter that can stream, or NULL when it has to see the
+ * whole image (recursive and box blurs, FFT-sized kernels, noise, frequency
+ * filters)
+ */
+static row_filter_t* create_stage_filter(filter_type_t type, const filter_chain_params_t* params,
+                                         size_t width, size_t height) {
+    kernel_t kernel = {0};
+    switch (type) {
+        case FILTER_BLUR:
+            if (!blur_uses_kernel(params->blur_sigma, params->blur_mode)) {
+                return NULL;
+            }
+            kernel = create_gaussian_blur_kernel(gaussian_kernel_size(params->blur_sigma), params->blur_sigma);
+            break;
+        case FILTER_SHARPEN:
+            kernel = create_sharpen_kernel();
+            break;
+        case FILTER_EDGE_LAPLACIAN:
+            kernel = create_laplacian_kernel();
+            break;
+        case FILTER_EDGE_SOBEL:
+            return create_gradient_row_filter(GRADIENT_SOBEL, width, height);
+        case FILTER_EDGE_PREWITT:
+            return create_gradient_row_filter(GRADIENT_PREWITT, width, height);
+        case FILTER_EDGE_ROBERTS:
+            return create_gradient_row_filter(GRADIENT_ROBERTS, width, height);
+        default:
+            return NULL;
+    }
+    if (kernel.data == NULL) {
+        return NULL;
+    }
+    row_filter_t* filter = create_convolution_row_filter(&kernel, width, height);
+    free_kernel(&kernel);
+    return filter;
+}
+
+/**
+ * Row source for the next stage: produces this stage's rows up to y on
+ * demand, pulling from upstream in turn
+ */
+static const unsigned char* stage_row(void* source, size_t y) {
+    stream_stage_t* stage = (stream_stage_t*)source;
+    if (stage->filter == NULL) {
+        return stage->input + y * stage->input_stride;
+    }
+    while (stage->next_row <= y) {
+        unsigned char* out = stage->ring + (stage->next_row % stage->ring_rows) * stage->width;
+        row_filter_run(stage->filter, stage->next_row, stage_row, stage->upstream, out);
+        stage->next_row++;
+    }
+    return stage->ring + (y % stage->ring_rows) * stage->width;
+}
+
+static bool stream_band(void* context, const row_band_t* band) {
+    const stream_job_t* job = (const stream_job_t*)context;
+    stream_stage_t stages[MAX_CHAIN_FILTERS + 1];
+    size_t count = job->count;
+    scratch_mark_t mark = scratch_mark();
+    bool ok = true;
+
+    memset(stages, 0, sizeof(stages));
+    stages[0].input = job->input;
+    stages[0].input_stride = job->input_stride;
+    stages[0].width = job->width;
+    for (size_t j = 1; j <= count && ok; j++) {
+        stages[j].filter = create_stage_filter(job->filters[j - 1], job->params, job->width, job->height);
+        stages[j].width = job->width;
+        stages[j].upstream = &stages[j - 1];
+        ok = stages[j].filter != NULL;
+    }
+
+    // A stage produces the rows of the band widened by the radii of the stages after it
+    size_t downstream = 0;
+    for (size_t j = count; j >= 1 && ok; j--) {
+        if (j < count) {
+            stages[j].ring_rows = 2 * row_filter_radius(stages[j + 1].filter) + 1;
+            stages[j].ring = (unsigned char*)scratch_alloc(stages[j].ring_rows * job->width);
+            ok = stages[j].ring != NULL;
+            downstream += row_filter_radius(stages[j + 1].filter);
+        }
+        stages[j].next_row = band->begin > downstream ? band->begin - downstream : 0;
+    }
+
+    if (ok) {
+        stream_stage_t* last = &stages[count];
+        for (size_t y = band->begin; y < band->end; y++) {
+            row_filter_run(last->filter, y, stage_row, last->upstream, job->output + y * job->width);
+        }
+    }
+
+    for (size_t j = 1; j <= count; j++) {
+        free_row_filter(stages[j].filter);
+    }
+    scratch_release(mark);
+    return ok;
+}
+
+/**
+ * Run filters[0 .. count) as one fused pass over the image. `stage_filters`
+ * are the run's row filters, built once by the caller for their radii;
+ * every band builds its own, since a row filter keeps the rows of its band
+ */
+static grayscale_image_t stream_filters(const grayscale_image_t* image, const filter_type_t* filters,
+                                        row_filter_t* const* stage_filters, size_t count,
+                                        const filter_chain_params_t* params) {
+    grayscale_image_t result = allocate_grayscale_image(image->width, image->height);
+    if (result.data == NULL) {
+        return result;
+    }
+
+    size_t halo = 0;
+    size_t row_cost = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t radius = row_filter_radius(stage_filters[i]);
+        halo += radius;
+        row_cost += image->width * (2 * radius + 1) * (2 * radius + 1);
+    }
+
+    stream_job_t job = { image->data, grayscale_stride(image), result.data, image->width, image->height, filters, count, params };
+    if (!parallel_for(image->height, row_cost, halo, stream_band, &job)) {
+        fprintf(stderr, "Error: Failed to allocate memory for filter chain\n");
+        free_grayscale_image(&result);
+    }
+    return result;
+}
+
+/**
+ * Apply one filter to the whole image, as the single-filter path does;
+ * filters without an image path there (Canny) leave it unchanged
+ */
+static grayscale_image_t apply_whole_image_filter(const grayscale_image_t* image, filter_type_t type,
+                                                  const filter_chain_params_t* params) {
+    kernel_t kernel = {0};
+    morphology_op_t op;
+    if (morphology_op_for_filter(type, &op)) {
+        return apply_morphology(image, op, (size_t)params->element_width, (size_t)params->element_height);
+    }
+    switch (type) {
+        case FILTER_BLUR:
+            return apply_gaussian_blur(image, params->blur_sigma, params->blur_mode);
+        case FILTER_SHARPEN:
+            kernel = create_sharpen_kernel();
+            break;
+        case FILTER_EDGE_LAPLACIAN:
+            kernel = create_laplacian_kernel();
+            break;
+        case FILTER_EDGE_SOBEL:
+            return apply_sobel_edge_detection(image);
+        case FILTER_EDGE_PREWITT:
+            return apply_prewitt_edge_detection(image);
+        case FILTER_EDGE_ROBERTS:
+            return apply_roberts_edge_detection(image);
+        case FILTER_SALT_PEPPER:
+            return apply_salt_pepper_noise(image, params->noise_density);
+        case FILTER_MEDIAN:
+            return apply_median_filter(image, params->median_radius);
+        case FILTER_BILATERAL:
+            return apply_bilateral_filter(image, params->spatial_sigma, params->range_sigma);
+        case FILTER_GUIDED:
+            return apply_guided_filter(image, NULL, params->guided_radius, params->guided_epsilon,
+                                       params->guided_subsample);
+        case FILTER_NL_MEANS:
+            return apply_nl_means(image, params->nlm_search_radius, params->nlm_patch_radius,
+                                  params->nlm_strength);
+        case FILTER_IDEAL_LOWPASS:
+        case FILTER_IDEAL_HIGHPASS:
+        case FILTER_GAUSSIAN_LOWPASS:
+        case FILTER_GAUSSIAN_HIGHPASS:
+            return apply_frequency_filter(image, type, params->cutoff);
+        default:
+            break;
+    }
+    if (kernel.data != NULL) {
+        grayscale_image_t result = apply_convolution_grayscale(image, &kernel);
+        free_kernel(&kernel);
+        return result;
+    }
+
+    return copy_grayscale_image(image);
+}
+
+grayscale_image_t apply_filter_chain(const grayscale_image_t* image, const filter_chain_t* chain,
+                                     const filter_chain_params_t* params) {
+    if (image == NULL || image->data == NULL || chain == NULL || params == NULL) {
+        fprintf(stderr, "Error: Invalid input to apply_filter_chain\n");
+        return (grayscale_image_t){0};
+    }
+
+    grayscale_image_t current = *image;
+    bool owned = false;
+    size_t i = 0;
+    do {
+        grayscale_image_t next;
+        row_filter_t* run_filters[MAX_CHAIN_FILTERS];
+        size_t run = 0;
+        while (i + run < chain->count) {
+            run_filters[run] = create_stage_filter(chain->filters[i + run], params, image->width, image->height);
+            if (run_filters[run] == NULL) {
+                break;
+            }
+            run++;
+        }
+
+        if (run > 0) {
+            next = stream_filters(&current, chain->filters + i, run_filters, run, params);
+            for (size_t j = 0; j < run; j++) {
+                free_row_filter(run_filters[j]);
+            }
+            i += run;
+        } else {
+            next = apply_whole_image_filter(&current, i < chain->count ? chain->filters[i] : FILTER_NONE, params);
+            i++;
+        }
+        if (owned) {
+            free_grayscale_image(&current);
+        }
+        if (next.data == NULL) {
+            return (grayscale_image_t){0};
+        }
+        current = next;
+        owned = true;
+    } while (i < chain->count);
+    return current;
+}
+
+/**
+ * True for filters whose RGB form takes its edges from all three channels
+ * together, so that filtering each channel with its own edges would not
+ * match it
+ */
+static bool is_color_stage(filter_type_t type) {
+    return type == FILTER_BILATERAL || type == FILTER_GUIDED || type == FILTER_NL_MEANS;
+}
+
+// Apply a colour-aware filter to the whole RGB image, as the single-filter path does
+static rgb_image_t apply_color_stage(const rgb_image_t* image, filter_type_t type,
+                                     const filter_chain_params_t* params) {
+    switch (type) {
+        case FILTER_BILATERAL:
+            return apply_bilateral_filter_rgb(image, params->spatial_sigma, params->range_sigma);
+        case FILTER_GUIDED:
+            return apply_guided_filter_rgb(image, NULL, params->guided_radius, params->guided_epsilon,
+                                           params->guided_subsample);
+        case FILTER_NL_MEANS:
+            return apply_nl_means_rgb(image, params->nlm_search_radius, params->nlm_patch_radius,
+                                      params->nlm_strength);
+        default:
+            return (rgb_image_t){0};
+    }
+}
+
+// Apply filters[0 .. count) to each channel separately
+static rgb_image_t apply_channel_filters(const rgb_image_t* image, const filter_type_t* filters, size_t count,
+                                         const filter_chain_params_t* params) {
+    rgb_image_t result = {0};
+    filter_chain_t run = { .count = count };
+    memcpy(run.filters, filters, count * sizeof(filter_type_t));
+
+    unsigned char* channels[3] = { image->r_data, image->g_data, image->b_data };
+    unsigned char** outputs[3] = { &result.r_data, &result.g_data, &result.b_data };
+    for (int c = 0; c < 3; c++) {
+        grayscale_image_t channel = {
+            .width = image->width,
+            .height = image->height,
+            .data = channels[c],
+            .stride = image->stride,
+            .borrowed = true
+        };
+        grayscale_image_t filtered = apply_filter_chain(&channel, &run, params);
+        if (filtered.data == NULL) {
+            free_rgb_image(&result);
+            return (rgb_image_t){0};
+        }
+        *outputs[c] = filtered.data;
+        result.alignment = filtered.alignment;
+    }
+    result.width = image->width;
+    result.height = image->height;
+    return result;
+}
+
+rgb_image_t apply_filter_chain_rgb(const rgb_image_t* image, const filter_chain_t* chain,
+                                   const filter_chain_params_t* params) {
+    if (image == NULL || image->r_data == NULL || image->g_data == NULL || image->b_data == NULL ||
+        chain == NULL || params == NULL) {
+        fprintf(stderr, "Error: Invalid input to apply_filter_chain_rgb\n");
+        return (rgb_image_t){0};
+    }
+
+    // Runs of per-channel filters go through the grayscale chain; colour-aware
+    // filters between them see the whole image
+    rgb_image_t current = *image;
+    bool owned = false;
+    size_t i = 0;
+    do {
+        rgb_image_t next;
+        size_t run = 0;
+        while (i + run < chain->count && !is_color_stage(chain->filters[i + run])) {
+            run++;
+        }
+
+        if (i < chain->count && run == 0) {
+            next = apply_color_stage(&current, chain->filters[i], params);
+            i++;
+        } else {
+            next = apply_channel_filters(&current, chain->filters + i, run, params);
+            i += run > 0 ? run : 1;
+        }
+        if (owned) {
+            free_rgb_image(&current);
+        }
+        if (next.r_data == NULL) {
+            return (rgb_image_t){0};
+        }
+        current = next;
+        owned = true;
+    } while (i < chain->count);
+    return current;
+}
@@ -1,8 +1,14 @@
 #include "../include/filters.h"
+#include "../include/fft_convolution.h"
+#include "../include/image_alloc.h"
+#include "../include/parallel.h"
+#include "../include/simd.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdint.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -18,105 +24,1670 @@ static unsigned char clamp_byte(float value) {
 }
 
 /**
- * Apply convolution to a single channel
+ * Factor a kernel as the outer product col * row^T when it has rank 1.
+ * The largest-magnitude entry is used as pivot; every entry must then be
+ * reproduced within a small tolerance relative to that pivot.
  */
-static unsigned char* convolve_channel(const unsigned char* input, size_t width, size_t height,
-                                       const kernel_t* kernel) {
-    unsigned char* output = (unsigned char*)malloc(width * height);
-    if (output == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for convolution output\n");
+static bool factor_separable_kernel(const kernel_t* kernel, float* col_taps, float* row_taps) {
+    size_t size = kernel->size;
+    size_t pivot = 0;
+    float max_abs = 0.0f;
+    for (size_t i = 0; i < size * size; i++) {
+        if (fabsf(kernel->data[i]) > max_abs) {
+            max_abs = fabsf(kernel->data[i]);
+            pivot = i;
+        }
+    }
+    if (max_abs == 0.0f) {
+        return false;
+    }
+
+    size_t pivot_row = pivot / size;
+    size_t pivot_col = pivot % size;
+    float pivot_value = kernel->data[pivot];
+    for (size_t i = 0; i < size; i++) {
+        col_taps[i] = kernel->data[i * size + pivot_col];
+        row_taps[i] = kernel->data[pivot_row * size + i] / pivot_value;
+    }
+
+    float tolerance = 1e-5f * max_abs;
+    for (size_t y = 0; y < size; y++) {
+        for (size_t x = 0; x < size; x++) {
+            if (fabsf(kernel->data[y * size + x] - col_taps[y] * row_taps[x]) > tolerance) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Row kernels shared by the separable and direct convolution paths. Each
+ * variant produces bit-identical results: taps are accumulated in the same
+ * order with separate multiplies and adds, and the final divide, offset,
+ * clamp and round match clamp_byte.
+ *
+ *   taps_row:   dst[i] = sum_k src[i + k] * taps[k]
+ *   taps_col:   out[i] = clamp(sum_k rows[k][i] * taps[k] / divisor + offset)
+ *   taps_2d:    out[i] = clamp(sum_ky sum_kx rows[ky][i + kx] * kernel[ky][kx] / divisor + offset)
+ */
+typedef struct {
+    void (*taps_row)(const unsigned char* src, float* dst, int count, const float* taps, int size);
+    void (*taps_col)(const float* const* rows, unsigned char* out, int count, const float* taps, int size,
+                     float divisor, float offset);
+    void (*taps_2d)(const unsigned char* const* rows, unsigned char* out, int count, const float* kernel, int size,
+                    float divisor, float offset);
+} convolution_kernels_t;
+
+static void taps_row_scalar(const unsigned char* src, float* dst, int count, const float* taps, int size) {
+    for (int i = 0; i < count; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < size; k++) {
+            sum += (float)src[i + k] * taps[k];
+        }
+        dst[i] = sum;
+    }
+}
+
+static void taps_col_scalar(const float* const* rows, unsigned char* out, int count, const float* taps, int size,
+                            float divisor, float offset) {
+    for (int i = 0; i < count; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < size; k++) {
+            sum += rows[k][i] * taps[k];
+        }
+        out[i] = clamp_byte(sum / divisor + offset);
+    }
+}
+
+// Scalar 2D taps for lanes [begin, count); also finishes the vector kernels' tails
+static void taps_2d_from(const unsigned char* const* rows, unsigned char* out, int begin, int count,
+                         const float* kernel, int size, float divisor, float offset) {
+    for (int i = begin; i < count; i++) {
+        float sum = 0.0f;
+        for (int ky = 0; ky < size; ky++) {
+            for (int kx = 0; kx < size; kx++) {
+                sum += (float)rows[ky][i + kx] * kernel[ky * size + kx];
+            }
+        }
+        out[i] = clamp_byte(sum / divisor + offset);
+    }
+}
+
+static void taps_2d_scalar(const unsigned char* const* rows, unsigned char* out, int count, const float* kernel, int size,
+                           float divisor, float offset) {
+    taps_2d_from(rows, out, 0, count, kernel, size, divisor, offset);
+}
+
+#ifdef TERMIVIEW_SSE2
+static inline __m128 load4_u8_ps(const unsigned char* p) {
+    int bytes;
+    memcpy(&bytes, p, 4);
+    __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+}
+
+// Divide, offset, clamp to [0, 255], round half up and narrow 8 lanes to bytes
+static inline void store8_ps_u8(unsigned char* out, __m128 lo, __m128 hi, __m128 divisor, __m128 offset) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_value = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    lo = _mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_div_ps(lo, divisor), offset), zero), max_value), half);
+    hi = _mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_div_ps(hi, divisor), offset), zero), max_value), half);
+    __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi));
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(words, words));
+}
+
+static void taps_row_sse2(const unsigned char* src, float* dst, int count, const float* taps, int size) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 lo = _mm_setzero_ps();
+        __m128 hi = _mm_setzero_ps();
+        for (int k = 0; k < size; k++) {
+            __m128 tap = _mm_set1_ps(taps[k]);
+            lo = _mm_add_ps(lo, _mm_mul_ps(load4_u8_ps(src + i + k), tap));
+            hi = _mm_add_ps(hi, _mm_mul_ps(load4_u8_ps(src + i + k + 4), tap));
+        }
+        _mm_storeu_ps(dst + i, lo);
+        _mm_storeu_ps(dst + i + 4, hi);
+    }
+    taps_row_scalar(src + i, dst + i, count - i, taps, size);
+}
+
+static void taps_col_sse2(const float* const* rows, unsigned char* out, int count, const float* taps, int size,
+                          float divisor, float offset) {
+    const __m128 divisor_v = _mm_set1_ps(divisor);
+    const __m128 offset_v = _mm_set1_ps(offset);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 lo = _mm_setzero_ps();
+        __m128 hi = _mm_setzero_ps();
+        for (int k = 0; k < size; k++) {
+            __m128 tap = _mm_set1_ps(taps[k]);
+            lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), tap));
+            hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(rows[k] + i + 4), tap));
+        }
+        store8_ps_u8(out + i, lo, hi, divisor_v, offset_v);
+    }
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < size; k++) {
+            sum += rows[k][i] * taps[k];
+        }
+        out[i] = clamp_byte(sum / divisor + offset);
+    }
+}
+
+static void taps_2d_sse2(const unsigned char* const* rows, unsigned char* out, int count, const float* kernel, int size,
+                         float divisor, float offset) {
+    const __m128 divisor_v = _mm_set1_ps(divisor);
+    const __m128 offset_v = _mm_set1_ps(offset);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 lo = _mm_setzero_ps();
+        __m128 hi = _mm_setzero_ps();
+        for (int ky = 0; ky < size; ky++) {
+            const unsigned char* row = rows[ky] + i;
+            for (int kx = 0; kx < size; kx++) {
+                __m128 tap = _mm_set1_ps(kernel[ky * size + kx]);
+                lo = _mm_add_ps(lo, _mm_mul_ps(load4_u8_ps(row + kx), tap));
+                hi = _mm_add_ps(hi, _mm_mul_ps(load4_u8_ps(row + kx + 4), tap));
+            }
+        }
+        store8_ps_u8(out + i, lo, hi, divisor_v, offset_v);
+    }
+    taps_2d_from(rows, out, i, count, kernel, size, divisor, offset);
+}
+#endif
+
+#ifdef TERMIVIEW_AVX2
+TERMIVIEW_AVX2_TARGET
+static inline __m256 load8_u8_ps_avx2(const unsigned char* p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+TERMIVIEW_AVX2_TARGET
+static inline void store16_ps_u8_avx2(unsigned char* out, __m256 lo, __m256 hi, __m256 divisor, __m256 offset) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max_value = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    lo = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_div_ps(lo, divisor), offset), zero), max_value), half);
+    hi = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_div_ps(hi, divisor), offset), zero), max_value), half);
+    __m256i lo_i = _mm256_cvttps_epi32(lo);
+    __m256i hi_i = _mm256_cvttps_epi32(hi);
+    __m128i lo_words = _mm_packs_epi32(_mm256_castsi256_si128(lo_i), _mm256_extracti128_si256(lo_i, 1));
+    __m128i hi_words = _mm_packs_epi32(_mm256_castsi256_si128(hi_i), _mm256_extracti128_si256(hi_i, 1));
+    _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(lo_words, hi_words));
+}
+
+TERMIVIEW_AVX2_TARGET
+static void taps_row_avx2(const unsigned char* src, float* dst, int count, const float* taps, int size) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 lo = _mm256_setzero_ps();
+        __m256 hi = _mm256_setzero_ps();
+        for (int k = 0; k < size; k++) {
+            __m256 tap = _mm256_set1_ps(taps[k]);
+            lo = _mm256_add_ps(lo, _mm256_mul_ps(load8_u8_ps_avx2(src + i + k), tap));
+            hi = _mm256_add_ps(hi, _mm256_mul_ps(load8_u8_ps_avx2(src + i + k + 8), tap));
+        }
+        _mm256_storeu_ps(dst + i, lo);
+        _mm256_storeu_ps(dst + i + 8, hi);
+    }
+    taps_row_scalar(src + i, dst + i, count - i, taps, size);
+}
+
+TERMIVIEW_AVX2_TARGET
+static void taps_col_avx2(const float* const* rows, unsigned char* out, int count, const float* taps, int size,
+                          float divisor, float offset) {
+    const __m256 divisor_v = _mm256_set1_ps(divisor);
+    const __m256 offset_v = _mm256_set1_ps(offset);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 lo = _mm256_setzero_ps();
+        __m256 hi = _mm256_setzero_ps();
+        for (int k = 0; k < size; k++) {
+            __m256 tap = _mm256_set1_ps(taps[k]);
+            lo = _mm256_add_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), tap));
+            hi = _mm256_add_ps(hi, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i + 8), tap));
+        }
+        store16_ps_u8_avx2(out + i, lo, hi, divisor_v, offset_v);
+    }
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < size; k++) {
+            sum += rows[k][i] * taps[k];
+        }
+        out[i] = clamp_byte(sum / divisor + offset);
+    }
+}
+
+TERMIVIEW_AVX2_TARGET
+static void taps_2d_avx2(const unsigned char* const* rows, unsigned char* out, int count, const float* kernel, int size,
+                         float divisor, float offset) {
+    const __m256 divisor_v = _mm256_set1_ps(divisor);
+    const __m256 offset_v = _mm256_set1_ps(offset);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 lo = _mm256_setzero_ps();
+        __m256 hi = _mm256_setzero_ps();
+        for (int ky = 0; ky < size; ky++) {
+            const unsigned char* row = rows[ky] + i;
+            for (int kx = 0; kx < size; kx++) {
+                __m256 tap = _mm256_set1_ps(kernel[ky * size + kx]);
+                lo = _mm256_add_ps(lo, _mm256_mul_ps(load8_u8_ps_avx2(row + kx), tap));
+                hi = _mm256_add_ps(hi, _mm256_mul_ps(load8_u8_ps_avx2(row + kx + 8), tap));
+            }
+        }
+        store16_ps_u8_avx2(out + i, lo, hi, divisor_v, offset_v);
+    }
+    taps_2d_from(rows, out, i, count, kernel, size, divisor, offset);
+}
+#endif
+
+#ifdef TERMIVIEW_NEON
+static inline float32x4_t load4_u8_f32_neon(const unsigned char* p) {
+    uint32_t bytes;
+    memcpy(&bytes, p, 4);
+    uint16x8_t words = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(bytes)));
+    return vcvtq_f32_u32(vmovl_u16(vget_low_u16(words)));
+}
+
+static inline void store8_f32_u8_neon(unsigned char* out, float32x4_t lo, float32x4_t hi, float divisor, float offset) {
+    float lanes[8];
+    vst1q_f32(lanes, lo);
+    vst1q_f32(lanes + 4, hi);
+    for (int j = 0; j < 8; j++) {
+        out[j] = clamp_byte(lanes[j] / divisor + offset);
+    }
+}
+
+static void taps_row_neon(const unsigned char* src, float* dst, int count, const float* taps, int size) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t lo = vdupq_n_f32(0.0f);
+        float32x4_t hi = vdupq_n_f32(0.0f);
+        for (int k = 0; k < size; k++) {
+            float32x4_t tap = vdupq_n_f32(taps[k]);
+            lo = vaddq_f32(lo, vmulq_f32(load4_u8_f32_neon(src + i + k), tap));
+            hi = vaddq_f32(hi, vmulq_f32(load4_u8_f32_neon(src + i + k + 4), tap));
+        }
+        vst1q_f32(dst + i, lo);
+        vst1q_f32(dst + i + 4, hi);
+    }
+    taps_row_scalar(src + i, dst + i, count - i, taps, size);
+}
+
+static void taps_col_neon(const float* const* rows, unsigned char* out, int count, const float* taps, int size,
+                          float divisor, float offset) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t lo = vdupq_n_f32(0.0f);
+        float32x4_t hi = vdupq_n_f32(0.0f);
+        for (int k = 0; k < size; k++) {
+            float32x4_t tap = vdupq_n_f32(taps[k]);
+            lo = vaddq_f32(lo, vmulq_f32(vld1q_f32(rows[k] + i), tap));
+            hi = vaddq_f32(hi, vmulq_f32(vld1q_f32(rows[k] + i + 4), tap));
+        }
+        store8_f32_u8_neon(out + i, lo, hi, divisor, offset);
+    }
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < size; k++) {
+            sum += rows[k][i] * taps[k];
+        }
+        out[i] = clamp_byte(sum / divisor + offset);
+    }
+}
+
+static void taps_2d_neon(const unsigned char* const* rows, unsigned char* out, int count, const float* kernel, int size,
+                         float divisor, float offset) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t lo = vdupq_n_f32(0.0f);
+        float32x4_t hi = vdupq_n_f32(0.0f);
+        for (int ky = 0; ky < size; ky++) {
+            const unsigned char* row = rows[ky] + i;
+            for (int kx = 0; kx < size; kx++) {
+                float32x4_t tap = vdupq_n_f32(kernel[ky * size + kx]);
+                lo = vaddq_f32(lo, vmulq_f32(load4_u8_f32_neon(row + kx), tap));
+                hi = vaddq_f32(hi, vmulq_f32(load4_u8_f32_neon(row + kx + 4), tap));
+            }
+        }
+        store8_f32_u8_neon(out + i, lo, hi, divisor, offset);
+    }
+    taps_2d_from(rows, out, i, count, kernel, size, divisor, offset);
+}
+#endif
+
+static convolution_kernels_t resolved_kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void resolve_convolution_kernels(void) {
+    convolution_kernels_t selected = { taps_row_scalar, taps_col_scalar, taps_2d_scalar };
+#if defined(TERMIVIEW_SSE2)
+    selected = (convolution_kernels_t){ taps_row_sse2, taps_col_sse2, taps_2d_sse2 };
+#elif defined(TERMIVIEW_NEON)
+    selected = (convolution_kernels_t){ taps_row_neon, taps_col_neon, taps_2d_neon };
+#endif
+#ifdef TERMIVIEW_AVX2
+    if (termiview_cpu_has_avx2()) {
+        selected = (convolution_kernels_t){ taps_row_avx2, taps_col_avx2, taps_2d_avx2 };
+    }
+#endif
+    resolved_kernels = selected;
+}
+
+/**
+ * Pick the widest row kernels the running CPU supports (resolved once;
+ * band workers call this concurrently)
+ */
+static const convolution_kernels_t* convolution_kernels(void) {
+    pthread_once(&kernels_once, resolve_convolution_kernels);
+    return &resolved_kernels;
+}
+
+/**
+ * Point `rows` at the 2 * half + 1 input rows around row y, clamped to the
+ * image; input rows are `stride` bytes apart
+ */
+static void clamped_rows(const unsigned char* input, size_t stride, int height, int y, int half,
+                         const unsigned char** rows) {
+    for (int k = 0; k <= 2 * half; k++) {
+        int py = y + k - half;
+        rows[k] = input + (size_t)(py < 0 ? 0 : (py >= height ? height - 1 : py)) * stride;
+    }
+}
+
+/**
+ * Scalar convolution of a single pixel with column clamping (border region);
+ * `rows` are the kernel's input rows, already clamped
+ */
+static unsigned char convolve_pixel_clamped(const unsigned char* const* rows, int width, const kernel_t* kernel,
+                                            int x) {
+    int k_half = (int)(kernel->size / 2);
+    float sum = 0.0f;
+    for (int ky = -k_half; ky <= k_half; ky++) {
+        const unsigned char* row = rows[ky + k_half];
+        for (int kx = -k_half; kx <= k_half; kx++) {
+            int px = x + kx;
+            if (px < 0) px = 0;
+            if (px >= width) px = width - 1;
+            sum += (float)row[px] * kernel->data[(size_t)(ky + k_half) * kernel->size + (kx + k_half)];
+        }
+    }
+    return clamp_byte(sum / kernel->divisor + kernel->offset);
+}
+
+/**
+ * Horizontal 1D pass over one row: clamped taps at both ends, vector kernel in between
+ */
+static void convolve_row(const unsigned char* src, float* dst, size_t width, const float* taps, int half) {
+    int w = (int)width;
+    int interior_begin = half < w ? half : w;
+    int interior_end = w - half > interior_begin ? w - half : interior_begin;
+
+    for (int x = 0; x < w; x++) {
+        if (x == interior_begin && interior_end > interior_begin) {
+            convolution_kernels()->taps_row(src + x - half, dst + x, interior_end - interior_begin, taps, 2 * half + 1);
+            x = interior_end - 1;
+            continue;
+        }
+        float sum = 0.0f;
+        for (int k = -half; k <= half; k++) {
+            int px = x + k;
+            if (px < 0) px = 0;
+            if (px >= w) px = w - 1;
+            sum += (float)src[px] * taps[k + half];
+        }
+        dst[x] = sum;
+    }
+}
+
+/**
+ * Separable convolution of output rows [y0, y1): each source row is filtered
+ * horizontally once into a ring of kernel-height float rows, and every output
+ * row is the vertical combination of the ring rows it covers. K^2 multiplies
+ * per pixel become 2K.
+ */
+static bool convolve_separable(const unsigned char* input, size_t stride, unsigned char* output, size_t width,
+                               size_t height, int y0, int y1, const float* col_taps, const float* row_taps, const kernel_t* kernel) {
+    int size = (int)kernel->size;
+    int half = size / 2;
+    int h = (int)height;
+    scratch_mark_t mark = scratch_mark();
+    float* ring = (float*)scratch_alloc((size_t)size * width * sizeof(float));
+    const float** rows = (const float**)scratch_alloc((size_t)size * sizeof(float*));
+    if (ring == NULL || rows == NULL) {
+        scratch_release(mark);
+        return false;
+    }
+
+    const convolution_kernels_t* kernels = convolution_kernels();
+    int next_source_row = y0 > half ? y0 - half : 0;
+    for (int y = y0; y < y1; y++) {
+        // Rows y-half .. y+half span at most `size` distinct source rows, so ring slots never collide
+        int last_needed = y + half < h ? y + half : h - 1;
+        while (next_source_row <= last_needed) {
+            convolve_row(input + (size_t)next_source_row * stride, ring + (size_t)(next_source_row % size) * width,
+                         width, row_taps, half);
+            next_source_row++;
+        }
+        for (int k = 0; k < size; k++) {
+            int py = y + k - half;
+            if (py < 0) py = 0;
+            if (py >= h) py = h - 1;
+            rows[k] = ring + (size_t)(py % size) * width;
+        }
+
+        // Row pointers are already clamped, so the vertical pass has no border case
+        kernels->taps_col(rows, output + (size_t)y * width, (int)width, col_taps, size,
+                          kernel->divisor, kernel->offset);
+    }
+
+    scratch_release(mark);
+    return true;
+}
+
+/**
+ * Direct K x K convolution of one output row from its clamped input rows.
+ * Only the `half`-wide columns at each end need clamping; the interior runs
+ * the branch-free vector kernel.
+ */
+static void convolve_direct_row(const unsigned char* const* rows, unsigned char* out, int width,
+                                const kernel_t* kernel) {
+    int half = (int)kernel->size / 2;
+    if (width <= 2 * half) {
+        for (int x = 0; x < width; x++) {
+            out[x] = convolve_pixel_clamped(rows, width, kernel, x);
+        }
+        return;
+    }
+
+    for (int x = 0; x < half; x++) {
+        out[x] = convolve_pixel_clamped(rows, width, kernel, x);
+    }
+    convolution_kernels()->taps_2d(rows, out + half, width - 2 * half, kernel->data, (int)kernel->size,
+                                   kernel->divisor, kernel->offset);
+    for (int x = width - half; x < width; x++) {
+        out[x] = convolve_pixel_clamped(rows, width, kernel, x);
+    }
+}
+
+/**
+ * Direct K x K convolution of output rows [y0, y1)
+ */
+static bool convolve_direct(const unsigned char* input, size_t stride, unsigned char* output, size_t width,
+                            size_t height, int y0, int y1, const kernel_t* kernel) {
+    scratch_mark_t mark = scratch_mark();
+    const unsigned char** rows = (const unsigned char**)scratch_alloc(kernel->size * sizeof(unsigned char*));
+    if (rows == NULL) {
+        scratch_release(mark);
+        return false;
+    }
+    for (int y = y0; y < y1; y++) {
+        clamped_rows(input, stride, (int)height, y, (int)kernel->size / 2, rows);
+        convolve_direct_row(rows, output + (size_t)y * width, (int)width, kernel);
+    }
+    scratch_release(mark);
+    return true;
+}
+
+/**
+ * Small kernels (3x3, 5x5, 7x7) run in integer fixed point. Taps are the
+ * kernel divided by its divisor and scaled by 2^shift; bias folds in the
+ * offset and the rounding half, so an output is (sum + bias) >> shift
+ * clamped to [0, 255]. Integer kernels use shift 0 and are exact.
+ */
+#define FIXED_MAX_SIZE 7
+#define FIXED_MAX_SHIFT 14
+#define FIXED_MIN_SHIFT 8
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FIXED_INLINE static inline __attribute__((always_inline))
+#else
+#define FIXED_INLINE static inline
+#endif
+
+typedef struct {
+    int size;
+    int shift;
+    int32_t bias;
+    bool narrow;        // Every sum fits int16 (small integer kernels)
+    int16_t taps[FIXED_MAX_SIZE * FIXED_MAX_SIZE];
+} fixed_kernel_t;
+
+// Arithmetic right shift: floor division, so rounding matches clamp_byte
+FIXED_INLINE unsigned char fixed_to_byte(int32_t sum, int32_t bias, int shift) {
+    int32_t value = (sum + bias) >> shift;
+    return value < 0 ? 0 : (value > 255 ? 255 : (unsigned char)value);
+}
+
+#ifdef TERMIVIEW_SSE2
+static inline __m128i load8_u8_epi16(const unsigned char* p) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+}
+
+// acc += tap * pixels in 16-bit lanes; unit taps need no multiply
+FIXED_INLINE __m128i accumulate_tap_epi16(__m128i acc, __m128i pixels, int16_t tap) {
+    if (tap == 1) return _mm_add_epi16(acc, pixels);
+    if (tap == -1) return _mm_sub_epi16(acc, pixels);
+    return _mm_add_epi16(acc, _mm_mullo_epi16(pixels, _mm_set1_epi16(tap)));
+}
+
+/**
+ * Sixteen outputs of a narrow integer kernel (shift 0): 16-bit sums, then a
+ * saturating pack does the clamp
+ */
+FIXED_INLINE void convolve_narrow_block_sse2(const unsigned char* const* rows, unsigned char* out, int x,
+                                             const fixed_kernel_t* kernel, const int size) {
+    const int half = size / 2;
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    for (int ky = 0; ky < size; ky++) {
+        for (int kx = 0; kx < size; kx++) {
+            int16_t tap = kernel->taps[ky * size + kx];
+            if (tap == 0) continue;
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(rows[ky] + x + kx - half));
+            lo = accumulate_tap_epi16(lo, _mm_unpacklo_epi8(bytes, _mm_setzero_si128()), tap);
+            hi = accumulate_tap_epi16(hi, _mm_unpackhi_epi8(bytes, _mm_setzero_si128()), tap);
+        }
+    }
+    __m128i bias = _mm_set1_epi16((int16_t)kernel->bias);
+    _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(_mm_add_epi16(lo, bias), _mm_add_epi16(hi, bias)));
+}
+#endif
+
+/**
+ * Fixed-point convolution of one output row from `size` clamped input rows.
+ * Inlined into one function per kernel size, and per constant kernel, so
+ * the tap loops unroll and zero taps of the constant kernels disappear.
+ */
+FIXED_INLINE void convolve_fixed_row_body(const unsigned char* const* rows, unsigned char* out, int width,
+                                          const fixed_kernel_t* kernel, const int size) {
+    const int half = size / 2;
+    int x = 0;
+    while (x < width) {
+#ifdef TERMIVIEW_SSE2
+        if (kernel->narrow && x >= half && x + 16 + half <= width) {
+            convolve_narrow_block_sse2(rows, out, x, kernel, size);
+            x += 16;
+            continue;
+        }
+        if (x >= half && x + 8 + half <= width) {
+            __m128i lo = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+            for (int ky = 0; ky < size; ky++) {
+                for (int kx = 0; kx < size; kx++) {
+                    int16_t tap = kernel->taps[ky * size + kx];
+                    if (tap == 0) continue;
+                    __m128i pixels = load8_u8_epi16(rows[ky] + x + kx - half);
+                    __m128i coeff = _mm_set1_epi16(tap);
+                    __m128i product_lo = _mm_mullo_epi16(pixels, coeff);
+                    __m128i product_hi = _mm_mulhi_epi16(pixels, coeff);
+                    lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(product_lo, product_hi));
+                    hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(product_lo, product_hi));
+                }
+            }
+            __m128i bias = _mm_set1_epi32(kernel->bias);
+            __m128i shift = _mm_cvtsi32_si128(kernel->shift);
+            lo = _mm_sra_epi32(_mm_add_epi32(lo, bias), shift);
+            hi = _mm_sra_epi32(_mm_add_epi32(hi, bias), shift);
+            __m128i words = _mm_packs_epi32(lo, hi);
+            _mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(words, words));
+            x += 8;
+            continue;
+        }
+#endif
+        int32_t sum = 0;
+        for (int ky = 0; ky < size; ky++) {
+            for (int kx = 0; kx < size; kx++) {
+                int16_t tap = kernel->taps[ky * size + kx];
+                if (tap == 0) continue;
+                int px = x + kx - half;
+                px = px < 0 ? 0 : (px >= width ? width - 1 : px);
+                sum += tap * rows[ky][px];
+            }
+        }
+        out[x] = fixed_to_byte(sum, kernel->bias, kernel->shift);
+        x++;
+    }
+}
+
+typedef void (*fixed_convolution_fn)(const unsigned char* const* rows, unsigned char* out, int width,
+                                     const fixed_kernel_t* kernel);
+
+// One specialisation per supported size, for kernels quantized at run time
+#define DEFINE_FIXED_CONVOLUTION(K)                                                                     \
+    static void convolve_fixed_##K(const unsigned char* const* rows, unsigned char* out, int width,   \
+                                   const fixed_kernel_t* kernel) {                                     \
+        convolve_fixed_row_body(rows, out, width, kernel, K);                                          \
+    }
+
+DEFINE_FIXED_CONVOLUTION(3)
+DEFINE_FIXED_CONVOLUTION(5)
+DEFINE_FIXED_CONVOLUTION(7)
+
+// One specialisation per built-in integer kernel, with its taps as constants
+#define DEFINE_CONSTANT_KERNEL_3X3(name, ...)                                                           \
+    static const fixed_kernel_t name##_fixed = { 3, 0, 0, true, { __VA_ARGS__ } };                     \
+    static void convolve_##name(const unsigned char* const* rows, unsigned char* out, int width,      \
+                                const fixed_kernel_t* kernel) {                                        \
+        (void)kernel;                                                                                  \
+        convolve_fixed_row_body(rows, out, width, &name##_fixed, 3);                                   \
+    }
+
+DEFINE_CONSTANT_KERNEL_3X3(sharpen,    0, -1,  0, -1,  5, -1,  0, -1,  0)
+DEFINE_CONSTANT_KERNEL_3X3(laplacian,  0,  1,  0,  1, -4,  1,  0,  1,  0)
+DEFINE_CONSTANT_KERNEL_3X3(sobel_x,   -1,  0,  1, -2,  0,  2, -1,  0,  1)
+DEFINE_CONSTANT_KERNEL_3X3(sobel_y,   -1, -2, -1,  0,  0,  0,  1,  2,  1)
+DEFINE_CONSTANT_KERNEL_3X3(prewitt_x, -1,  0,  1, -1,  0,  1, -1,  0,  1)
+DEFINE_CONSTANT_KERNEL_3X3(prewitt_y, -1, -1, -1,  0,  0,  0,  1,  1,  1)
+DEFINE_CONSTANT_KERNEL_3X3(roberts_x,  1,  0,  0,  0, -1,  0,  0,  0,  0)
+DEFINE_CONSTANT_KERNEL_3X3(roberts_y,  0,  1,  0, -1,  0,  0,  0,  0,  0)
+
+static const struct {
+    const fixed_kernel_t* kernel;
+    fixed_convolution_fn convolve;
+} constant_kernels[] = {
+    { &sharpen_fixed, convolve_sharpen },
+    { &laplacian_fixed, convolve_laplacian },
+    { &sobel_x_fixed, convolve_sobel_x },
+    { &sobel_y_fixed, convolve_sobel_y },
+    { &prewitt_x_fixed, convolve_prewitt_x },
+    { &prewitt_y_fixed, convolve_prewitt_y },
+    { &roberts_x_fixed, convolve_roberts_x },
+    { &roberts_y_fixed, convolve_roberts_y },
+};
+
+/**
+ * Pick the fixed-point routine for a kernel: a constant specialisation when
+ * it is one of the built-in integer kernels, otherwise the size
+ * specialisation with taps quantized into `fixed`. Returns NULL when the
+ * kernel is too large, its taps cannot be represented precisely enough, or
+ * it is separable (two 1D passes beat K^2 integer taps).
+ */
+static fixed_convolution_fn select_fixed_convolution(const kernel_t* kernel, fixed_kernel_t* fixed) {
+    size_t size = kernel->size;
+    if ((size != 3 && size != 5 && size != 7) || kernel->divisor == 0.0f) {
+        return NULL;
+    }
+
+    if (size == 3 && kernel->divisor == 1.0f && kernel->offset == 0.0f) {
+        for (size_t k = 0; k < sizeof(constant_kernels) / sizeof(constant_kernels[0]); k++) {
+            bool match = true;
+            for (size_t i = 0; i < 9 && match; i++) {
+                match = kernel->data[i] == (float)constant_kernels[k].kernel->taps[i];
+            }
+            if (match) {
+                *fixed = *constant_kernels[k].kernel;
+                return constant_kernels[k].convolve;
+            }
+        }
+    }
+
+    float col_taps[FIXED_MAX_SIZE], row_taps[FIXED_MAX_SIZE];
+    if (factor_separable_kernel(kernel, col_taps, row_taps)) {
         return NULL;
     }
 
-    int k_half = (int)(kernel->size / 2);
+    // Largest shift whose taps fit int16 and whose sums cannot overflow int32
+    double max_abs = 0.0;
+    double sum_abs = 0.0;
+    for (size_t i = 0; i < size * size; i++) {
+        double tap = fabs((double)kernel->data[i] / kernel->divisor);
+        if (tap > max_abs) max_abs = tap;
+        sum_abs += tap;
+    }
+    double reach = sum_abs * 255.0 + fabs((double)kernel->offset) + 1.0;
+    int shift = FIXED_MAX_SHIFT;
+    while (shift >= 0 && (max_abs * (1 << shift) > 32767.0 || reach * (1 << shift) > 1073741824.0)) {
+        shift--;
+    }
+
+    // Integer kernels are exact at any shift; others need enough fractional bits
+    bool integral = kernel->offset == floorf(kernel->offset);
+    for (size_t i = 0; i < size * size && integral; i++) {
+        float tap = kernel->data[i] / kernel->divisor;
+        integral = tap == floorf(tap);
+    }
+    if (shift < 0 || (!integral && shift < FIXED_MIN_SHIFT)) {
+        return NULL;
+    }
+    if (integral && reach <= 32767.0) {
+        shift = 0;
+    }
+
+    fixed->size = (int)size;
+    fixed->shift = shift;
+    fixed->narrow = integral && reach <= 32767.0;
+    fixed->bias = (int32_t)lround(kernel->offset * (double)(1 << shift)) + (shift > 0 ? 1 << (shift - 1) : 0);
+    for (size_t i = 0; i < size * size; i++) {
+        fixed->taps[i] = (int16_t)lround((double)kernel->data[i] / kernel->divisor * (double)(1 << shift));
+    }
+    return size == 3 ? convolve_fixed_3 : (size == 5 ? convolve_fixed_5 : convolve_fixed_7);
+}
+
+/**
+ * One channel convolution shared by all row bands. Exactly one of
+ * fixed_convolve, separable_taps (column then row taps) or neither (direct)
+ * is in use.
+ */
+typedef struct {
+    const unsigned char* input;
+    size_t input_stride;
+    unsigned char* output;
+    size_t width;
+    size_t height;
+    const kernel_t* kernel;
+    fixed_convolution_fn fixed_convolve;
+    const fixed_kernel_t* fixed;
+    const float* separable_taps;
+} convolution_job_t;
+
+static bool convolve_band(void* context, const row_band_t* band) {
+    const convolution_job_t* job = (const convolution_job_t*)context;
+    int y0 = (int)band->begin;
+    int y1 = (int)band->end;
+    if (job->fixed_convolve != NULL) {
+        const unsigned char* rows[FIXED_MAX_SIZE];
+        for (int y = y0; y < y1; y++) {
+            clamped_rows(job->input, job->input_stride, (int)job->height, y, job->fixed->size / 2, rows);
+            job->fixed_convolve(rows, job->output + (size_t)y * job->width, (int)job->width, job->fixed);
+        }
+        return true;
+    }
+    if (job->separable_taps != NULL) {
+        return convolve_separable(job->input, job->input_stride, job->output, job->width, job->height, y0, y1,
+                                  job->separable_taps, job->separable_taps + job->kernel->size, job->kernel);
+    }
+    return convolve_direct(job->input, job->input_stride, job->output, job->width, job->height, y0, y1,
+                           job->kernel);
+}
+
+/**
+ * Apply convolution to a single channel whose rows are `input_stride`
+ * bytes apart, in parallel row bands, into a caller-provided packed
+ * width x height plane.
+ * Kernels up to 7x7 run in fixed point without any scratch allocation;
+ * larger rank-1 kernels (e.g. wide Gaussians) run as two 1D passes, and
+ * large kernels move to tiled FFT convolution when the cost model says the
+ * spectra are cheaper.
+ */
+static bool convolve_channel_into(const unsigned char* input, size_t input_stride, unsigned char* output,
+                                  size_t width, size_t height, const kernel_t* kernel) {
+    fixed_kernel_t fixed;
+    scratch_mark_t mark = scratch_mark();
+    float* taps = NULL;
+    convolution_job_t job = { input, input_stride, output, width, height, kernel, NULL, &fixed, NULL };
+    size_t row_cost = width * kernel->size * kernel->size;
+    job.fixed_convolve = select_fixed_convolution(kernel, &fixed);
+    if (job.fixed_convolve == NULL && kernel->size > 1) {
+        taps = (float*)scratch_alloc(2 * kernel->size * sizeof(float));
+        if (taps != NULL && factor_separable_kernel(kernel, taps, taps + kernel->size)) {
+            job.separable_taps = taps;
+            row_cost = width * 2 * kernel->size;
+        }
+    }
+
+    bool done;
+    if (job.fixed_convolve == NULL && fft_convolution_preferred(kernel, width, height, job.separable_taps != NULL)) {
+        done = fft_convolve_channel(input, input_stride, output, width, height, kernel);
+    } else {
+        done = parallel_for(height, row_cost, kernel->size / 2, convolve_band, &job);
+    }
+    scratch_release(mark);
+    if (!done) {
+        fprintf(stderr, "Error: Failed to allocate memory for convolution rows\n");
+    }
+    return done;
+}
+
+grayscale_image_t apply_convolution_grayscale(const grayscale_image_t* image, const kernel_t* kernel) {
+    grayscale_image_t result = {0};
+
+    if (image == NULL || image->data == NULL || kernel == NULL || kernel->data == NULL) {
+        fprintf(stderr, "Error: Invalid input to apply_convolution_grayscale\n");
+        return result;
+    }
+
+    if (kernel->size % 2 == 0) {
+        fprintf(stderr, "Error: Kernel size must be odd\n");
+        return result;
+    }
+
+    result = allocate_grayscale_image(image->width, image->height);
+    if (result.data != NULL &&
+        !convolve_channel_into(image->data, grayscale_stride(image), result.data, image->width, image->height,
+                               kernel)) {
+        free_grayscale_image(&result);
+    }
+
+    return result;
+}
+
+rgb_image_t apply_convolution_rgb(const rgb_image_t* image, const kernel_t* kernel) {
+    rgb_image_t result = {0};
+
+    if (image == NULL || image->r_data == NULL || kernel == NULL || kernel->data == NULL) {
+        fprintf(stderr, "Error: Invalid input to apply_convolution_rgb\n");
+        return result;
+    }
+
+    if (kernel->size % 2 == 0) {
+        fprintf(stderr, "Error: Kernel size must be odd\n");
+        return result;
+    }
+
+    result = allocate_rgb_image(image->width, image->height);
+    if (result.r_data == NULL) {
+        return result;
+    }
+
+    // Apply convolution to each channel
+    size_t stride = rgb_stride(image);
+    if (!convolve_channel_into(image->r_data, stride, result.r_data, image->width, image->height, kernel) ||
+        !convolve_channel_into(image->g_data, stride, result.g_data, image->width, image->height, kernel) ||
+        !convolve_channel_into(image->b_data, stride, result.b_data, image->width, image->height, kernel)) {
+        free_rgb_image(&result);
+    }
+
+    return result;
+}
+
+// Empty cells around the occupied grid keep the [1 4 6 4 1] grid blur and the
+// trilinear slice in bounds
+#define BILATERAL_GRID_PAD 2
+#define BILATERAL_MAX_GRID_FLOATS ((size_t)1 << 24)   // 64 MiB per grid buffer
+
+typedef struct {
+    const unsigned char* guide;         // Range coordinate of each pixel
+    size_t guide_stride;
+    const unsigned char* const* planes; // `channels` planes to smooth
+    size_t plane_stride;
+    unsigned char* const* out;          // Packed
+    int channels;
+    size_t width;
+    size_t height;
+    float spatial_sigma;
+    float range_sigma;
+    size_t grid_width;
+    size_t grid_height;
+    size_t grid_depth;
+    size_t cell;                        // Floats per cell: channel sums, then weight
+    float* grid;
+    size_t* column_cell;                // Splat cell of each column
+    size_t* column_index;               // Lower slice cell and its weight, per column
+    float* column_weight;
+    size_t range_cell[256];             // The same per guide value
+    size_t range_index[256];
+    float range_weight[256];
+    const float* src;                   // Blur pass input and output
+    float* dst;
+    int axis;                           // 0: x, 1: y, 2: range
+} bilateral_job_t;
+
+static size_t bilateral_cell(float position, float sigma) {
+    return (size_t)(position / sigma + 0.5f) + BILATERAL_GRID_PAD;
+}
+
+// Grid cells along an axis of `length` samples
+static size_t bilateral_extent(size_t length, float sigma) {
+    return (size_t)((float)(length - 1) / sigma) + 2 * BILATERAL_GRID_PAD + 2;
+}
+
+// First image row splatted into grid row `grid_row` or below it
+static size_t bilateral_first_row(const bilateral_job_t* job, size_t grid_row) {
+    size_t lo = 0, hi = job->height;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (bilateral_cell((float)mid, job->spatial_sigma) < grid_row) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Items are grid rows; each band accumulates exactly the image rows that land
+// in its grid rows, in raster order, so sums do not depend on the band split
+static bool splat_grid_rows(void* context, const row_band_t* band) {
+    bilateral_job_t* job = (bilateral_job_t*)context;
+    size_t y_end = bilateral_first_row(job, band->end);
+
+    for (size_t y = bilateral_first_row(job, band->begin); y < y_end; y++) {
+        size_t gy = bilateral_cell((float)y, job->spatial_sigma);
+        float* grid_row = job->grid + gy * job->grid_width * job->grid_depth * job->cell;
+        const unsigned char* guide = job->guide + y * job->guide_stride;
+        size_t offset = y * job->plane_stride;
+
+        for (size_t x = 0; x < job->width; x++) {
+            size_t gz = job->range_cell[guide[x]];
+            float* cell = grid_row + (job->column_cell[x] * job->grid_depth + gz) * job->cell;
+            for (int c = 0; c < job->channels; c++) {
+                cell[c] += job->planes[c][offset + x];
+            }
+            cell[job->channels] += 1.0f;
+        }
+    }
+    return true;
+}
+
+// [1 4 6 4 1] / 16 over elements [begin, end) of a line of `extent` elements,
+// each `length` contiguous floats; elements outside the line are empty
+static void blur_grid_line(const float* src, float* dst, size_t extent, size_t length,
+                           size_t begin, size_t end) {
+    static const float taps[5] = { 1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16 };
+    for (size_t e = begin; e < end; e++) {
+        float* out = dst + e * length;
+        memset(out, 0, length * sizeof(float));
+        size_t k_begin = e < 2 ? 2 - e : 0;
+        size_t k_end = e + 3 > extent ? extent + 2 - e : 5;
+        for (size_t k = k_begin; k < k_end; k++) {
+            const float* in = src + (e + k - 2) * length;
+            for (size_t j = 0; j < length; j++) {
+                out[j] += taps[k] * in[j];
+            }
+        }
+    }
+}
+
+// One blur pass along job->axis over a band of grid rows
+static bool blur_grid_rows(void* context, const row_band_t* band) {
+    const bilateral_job_t* job = (const bilateral_job_t*)context;
+    size_t cell_row = job->grid_depth * job->cell;
+    size_t row_floats = job->grid_width * cell_row;
+
+    if (job->axis == 1) {
+        blur_grid_line(job->src, job->dst, job->grid_height, row_floats, band->begin, band->end);
+        return true;
+    }
+    for (size_t gy = band->begin; gy < band->end; gy++) {
+        const float* src = job->src + gy * row_floats;
+        float* dst = job->dst + gy * row_floats;
+        if (job->axis == 0) {
+            blur_grid_line(src, dst, job->grid_width, cell_row, 0, job->grid_width);
+            continue;
+        }
+        for (size_t gx = 0; gx < job->grid_width; gx++) {
+            blur_grid_line(src + gx * cell_row, dst + gx * cell_row, job->grid_depth, job->cell, 0, job->grid_depth);
+        }
+    }
+    return true;
+}
+
+// Trilinear lookup of the blurred grid at each pixel's position and range
+static bool slice_grid_rows(void* context, const row_band_t* band) {
+    const bilateral_job_t* job = (const bilateral_job_t*)context;
+    size_t z_stride = job->cell;
+    size_t x_stride = job->grid_depth * z_stride;
+    size_t y_stride = job->grid_width * x_stride;
+    float values[4];
+
+    for (size_t y = band->begin; y < band->end; y++) {
+        float fy = (float)y / job->spatial_sigma + BILATERAL_GRID_PAD;
+        size_t gy = (size_t)fy;
+        float wy = fy - (float)gy;
+        const unsigned char* guide = job->guide + y * job->guide_stride;
+        size_t offset = y * job->width;
+        size_t plane_offset = y * job->plane_stride;
+
+        for (size_t x = 0; x < job->width; x++) {
+            unsigned char g = guide[x];
+            float wx = job->column_weight[x], wz = job->range_weight[g];
+            const float* corner = job->src + gy * y_stride + job->column_index[x] * x_stride +
+                                  job->range_index[g] * z_stride;
+
+            for (size_t c = 0; c < job->cell; c++) {
+                const float* p = corner + c;
+                float v00 = p[0] + wz * (p[z_stride] - p[0]);
+                float v01 = p[x_stride] + wz * (p[x_stride + z_stride] - p[x_stride]);
+                float v10 = p[y_stride] + wz * (p[y_stride + z_stride] - p[y_stride]);
+                float v11 = p[y_stride + x_stride] +
+                            wz * (p[y_stride + x_stride + z_stride] - p[y_stride + x_stride]);
+                float v0 = v00 + wx * (v01 - v00);
+                float v1 = v10 + wx * (v11 - v10);
+                values[c] = v0 + wy * (v1 - v0);
+            }
+
+            float weight = values[job->channels];
+            for (int c = 0; c < job->channels; c++) {
+                job->out[c][offset + x] = weight > 1e-6f ? clamp_byte(values[c] / weight)
+                                                         : job->planes[c][plane_offset + x];
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Bilateral grid (Chen, Paris and Durand): splat each pixel into the cell
+ * at (x, y, guide) / (spatial, spatial, range) sigma, blur the grid with a
+ * one-cell Gaussian along each axis and slice it back trilinearly. Work
+ * grows with the pixel count plus the cell count, and the cell count falls
+ * as the sigmas grow. The guide and the planes may be views; the outputs
+ * are packed.
+ */
+static bool bilateral_grid_filter(const unsigned char* guide, size_t guide_stride,
+                                  const unsigned char* const* planes, size_t plane_stride,
+                                  unsigned char* const* out, int channels, size_t width, size_t height,
+                                  float spatial_sigma, float range_sigma) {
+    bilateral_job_t job = {0};
+    job.guide = guide;
+    job.guide_stride = guide_stride;
+    job.planes = planes;
+    job.plane_stride = plane_stride;
+    job.out = out;
+    job.channels = channels;
+    job.width = width;
+    job.height = height;
+    job.spatial_sigma = spatial_sigma;
+    job.range_sigma = range_sigma;
+    job.grid_width = bilateral_extent(width, spatial_sigma);
+    job.grid_height = bilateral_extent(height, spatial_sigma);
+    job.grid_depth = bilateral_extent(256, range_sigma);
+    job.cell = (size_t)channels + 1;
+
+    for (int v = 0; v < 256; v++) {
+        float fz = (float)v / range_sigma + BILATERAL_GRID_PAD;
+        job.range_cell[v] = bilateral_cell((float)v, range_sigma);
+        job.range_index[v] = (size_t)fz;
+        job.range_weight[v] = fz - (float)job.range_index[v];
+    }
+
+    size_t row_floats = job.grid_width * job.grid_depth * job.cell;
+    size_t grid_floats = job.grid_height * row_floats;
+    scratch_mark_t mark = scratch_mark();
+    float* grid = (float*)image_buffer_acquire(grid_floats * sizeof(float));
+    float* scratch = (float*)image_buffer_acquire(grid_floats * sizeof(float));
+    job.column_cell = (size_t*)scratch_alloc(width * sizeof(size_t));
+    job.column_index = (size_t*)scratch_alloc(width * sizeof(size_t));
+    job.column_weight = (float*)scratch_alloc(width * sizeof(float));
+    if (grid == NULL || scratch == NULL || job.column_cell == NULL ||
+        job.column_index == NULL || job.column_weight == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for bilateral grid\n");
+        image_buffer_release(grid);
+        image_buffer_release(scratch);
+        scratch_release(mark);
+        return false;
+    }
+    memset(grid, 0, grid_floats * sizeof(float));
+    for (size_t x = 0; x < width; x++) {
+        float fx = (float)x / spatial_sigma + BILATERAL_GRID_PAD;
+        job.column_cell[x] = bilateral_cell((float)x, spatial_sigma);
+        job.column_index[x] = (size_t)fx;
+        job.column_weight[x] = fx - (float)job.column_index[x];
+    }
+
+    job.grid = grid;
+    size_t splat_cost = ((size_t)spatial_sigma + 1) * width * job.cell;
+    bool ok = parallel_for(job.grid_height, splat_cost, 0, splat_grid_rows, &job);
+
+    // x, y and range passes ping-pong between the grid and the scratch buffer
+    float* buffers[2] = { grid, scratch };
+    for (int axis = 0; axis < 3 && ok; axis++) {
+        job.axis = axis;
+        job.src = buffers[axis % 2];
+        job.dst = buffers[(axis + 1) % 2];
+        ok = parallel_for(job.grid_height, row_floats * 5, axis == 1 ? 2 : 0, blur_grid_rows, &job);
+    }
+
+    if (ok) {
+        job.src = scratch;
+        ok = parallel_for(height, width * job.cell * 8, 0, slice_grid_rows, &job);
+    }
+
+    image_buffer_release(grid);
+    image_buffer_release(scratch);
+    scratch_release(mark);
+    return ok;
+}
+
+static void bilateral_sigmas(size_t width, size_t height, int channels, float* spatial_sigma, float* range_sigma) {
+    if (*spatial_sigma <= 0.0f) *spatial_sigma = DEFAULT_BILATERAL_SPATIAL_SIGMA;
+    if (*range_sigma <= 0.0f) *range_sigma = DEFAULT_BILATERAL_RANGE_SIGMA;
+    // Cells finer than a pixel or a grey level add memory, not accuracy
+    if (*spatial_sigma < 1.0f) *spatial_sigma = 1.0f;
+    if (*range_sigma < 1.0f) *range_sigma = 1.0f;
+    // Small sigmas on a large image would need a grid many times the image's
+    // size; coarsen both until it fits, which smooths more but keeps edges
+    while (bilateral_extent(width, *spatial_sigma) * bilateral_extent(height, *spatial_sigma) *
+           bilateral_extent(256, *range_sigma) * (size_t)(channels + 1) > BILATERAL_MAX_GRID_FLOATS) {
+        *spatial_sigma *= 1.25f;
+        *range_sigma *= 1.25f;
+    }
+}
+
+grayscale_image_t apply_bilateral_filter(const grayscale_image_t* image, float spatial_sigma, float range_sigma) {
+    grayscale_image_t result = {0};
+
+    if (image == NULL || image->data == NULL || image->width == 0 || image->height == 0) {
+        fprintf(stderr, "Error: Invalid input to apply_bilateral_filter\n");
+        return result;
+    }
+
+    result = allocate_grayscale_image(image->width, image->height);
+    if (result.data == NULL) {
+        return result;
+    }
+
+    bilateral_sigmas(image->width, image->height, 1, &spatial_sigma, &range_sigma);
+    const unsigned char* planes[1] = { image->data };
+    unsigned char* out[1] = { result.data };
+    size_t stride = grayscale_stride(image);
+    if (!bilateral_grid_filter(image->data, stride, planes, stride, out, 1, image->width, image->height,
+                               spatial_sigma, range_sigma)) {
+        free_grayscale_image(&result);
+    }
+    return result;
+}
+
+rgb_image_t apply_bilateral_filter_rgb(const rgb_image_t* image, float spatial_sigma, float range_sigma) {
+    rgb_image_t result = {0};
+
+    if (image == NULL || image->r_data == NULL || image->width == 0 || image->height == 0) {
+        fprintf(stderr, "Error: Invalid input to apply_bilateral_filter_rgb\n");
+        return result;
+    }
+
+    // Edges are found on the luma, so all three channels keep the same ones
+    grayscale_image_t luma = rgb_to_grayscale((rgb_image_t*)image);
+    if (luma.data == NULL) {
+        return result;
+    }
+
+    result = allocate_rgb_image(image->width, image->height);
+    bool ok = result.r_data != NULL;
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to allocate memory for bilateral filter\n");
+    } else {
+        bilateral_sigmas(image->width, image->height, 3, &spatial_sigma, &range_sigma);
+        const unsigned char* planes[3] = { image->r_data, image->g_data, image->b_data };
+        unsigned char* out[3] = { result.r_data, result.g_data, result.b_data };
+        ok = bilateral_grid_filter(luma.data, luma.width, planes, rgb_stride(image), out, 3,
+                                   image->width, image->height, spatial_sigma, range_sigma);
+    }
+    free(luma.data);
+
+    if (!ok) {
+        free_rgb_image(&result);
+        return result;
+    }
+
+    return result;
+}
+
+// Columns averaged together in the vertical pass of guided_box_mean
+#define GUIDED_COLUMN_BATCH 256
+
+typedef struct {
+    const float* src;
+    float* dst;
+    size_t width;
+    size_t height;
+    int radius;
+} box_mean_job_t;
+
+// Items are GUIDED_COLUMN_BATCH-wide column batches
+static bool box_mean_columns(void* context, const row_band_t* band) {
+    const box_mean_job_t* job = (const box_mean_job_t*)context;
+    size_t width = job->width, height = job->height;
+    int radius = job->radius;
+    float scale = 1.0f / (float)(2 * radius + 1);
+    float sums[GUIDED_COLUMN_BATCH];
+
+    for (size_t batch = band->begin; batch < band->end; batch++) {
+        size_t x0 = batch * GUIDED_COLUMN_BATCH;
+        size_t count = x0 + GUIDED_COLUMN_BATCH < width ? GUIDED_COLUMN_BATCH : width - x0;
+        const float* src = job->src + x0;
+        float* dst = job->dst + x0;
+
+        memset(sums, 0, sizeof(sums));
+        for (int k = -radius; k <= radius; k++) {
+            size_t y = k < 0 ? 0 : ((size_t)k >= height ? height - 1 : (size_t)k);
+            for (size_t i = 0; i < count; i++) {
+                sums[i] += src[y * width + i];
+            }
+        }
+        for (size_t y = 0; y < height; y++) {
+            const float* entering = src + (y + radius + 1 < height ? y + radius + 1 : height - 1) * width;
+            const float* leaving = src + (y > (size_t)radius ? y - radius : 0) * width;
+            float* out = dst + y * width;
+            size_t i = 0;
+#ifdef TERMIVIEW_SSE2
+            const __m128 scale_v = _mm_set1_ps(scale);
+            for (; i + 4 <= count; i += 4) {
+                __m128 sum = _mm_loadu_ps(sums + i);
+                _mm_storeu_ps(out + i, _mm_mul_ps(sum, scale_v));
+                sum = _mm_add_ps(sum, _mm_sub_ps(_mm_loadu_ps(entering + i), _mm_loadu_ps(leaving + i)));
+                _mm_storeu_ps(sums + i, sum);
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = sums[i] * scale;
+                sums[i] += entering[i] - leaving[i];
+            }
+        }
+    }
+    return true;
+}
+
+static bool box_mean_rows(void* context, const row_band_t* band) {
+    const box_mean_job_t* job = (const box_mean_job_t*)context;
+    size_t width = job->width;
+    int radius = job->radius;
+    float scale = 1.0f / (float)(2 * radius + 1);
+
+    for (size_t y = band->begin; y < band->end; y++) {
+        const float* src = job->src + y * width;
+        float* dst = job->dst + y * width;
+        float sum = 0.0f;
+        for (int k = -radius; k <= radius; k++) {
+            sum += src[k < 0 ? 0 : ((size_t)k >= width ? width - 1 : (size_t)k)];
+        }
+        for (size_t x = 0; x < width; x++) {
+            dst[x] = sum * scale;
+            sum += src[x + radius + 1 < width ? x + radius + 1 : width - 1] - src[x > (size_t)radius ? x - radius : 0];
+        }
+    }
+    return true;
+}
+
+/**
+ * Edge-clamped (2 * radius + 1)^2 box mean of a plane, in place, with
+ * running sums down the columns and along the rows: two additions per
+ * pixel whatever the radius. `scratch` is a plane of the same size.
+ */
+static bool guided_box_mean(float* plane, float* scratch, size_t width, size_t height, int radius) {
+    box_mean_job_t job = { plane, scratch, width, height, radius };
+    size_t batches = (width + GUIDED_COLUMN_BATCH - 1) / GUIDED_COLUMN_BATCH;
+    if (!parallel_for(batches, height * GUIDED_COLUMN_BATCH * 2, 0, box_mean_columns, &job)) {
+        return false;
+    }
+    job.src = scratch;
+    job.dst = plane;
+    return parallel_for(height, width * 2, 0, box_mean_rows, &job);
+}
+
+/**
+ * Guided filter state. Coefficients are fitted on a grid `subsample` times
+ * coarser than the image (the fast guided filter; 1 fits every pixel) and
+ * interpolated back before the guide is applied at full resolution.
+ */
+typedef struct {
+    const unsigned char* const* guide;  // guide_channels full-resolution planes
+    size_t guide_stride;
+    int guide_channels;                 // 1 or 3
+    const unsigned char* input;         // Channel being filtered
+    size_t input_stride;
+    unsigned char* output;              // Packed
+    size_t width;
+    size_t height;
+    int subsample;
+    size_t low_width;
+    size_t low_height;
+    float epsilon;
+    float* mean_guide[3];               // Guide means on the coarse grid, in [0, 1]
+    float* sigma[6];                    // Guide (co)variances rr, rg, rb, gg, gb, bb, then
+                                        // the same entries of (Sigma + eps * I)^-1
+    float* mean_input;
+    float* cross[3];                    // Guide x input means, then the slopes a
+    float* offset;                      // Intercepts b
+    size_t* column_index;               // Coarse column left of each column, and its weight
+    float* column_weight;
+} guided_job_t;
+
+// Average the subsample x subsample block of a plane behind coarse pixel (lx, ly)
+static float guided_block_mean(const unsigned char* plane, size_t stride, const guided_job_t* job,
+                               size_t lx, size_t ly) {
+    size_t s = (size_t)job->subsample;
+    if (s == 1) {
+        return (float)plane[ly * stride + lx] * (1.0f / 255.0f);
+    }
+    size_t x1 = (lx + 1) * s < job->width ? (lx + 1) * s : job->width;
+    size_t y1 = (ly + 1) * s < job->height ? (ly + 1) * s : job->height;
+    unsigned int sum = 0;
+    for (size_t y = ly * s; y < y1; y++) {
+        for (size_t x = lx * s; x < x1; x++) {
+            sum += plane[y * stride + x];
+        }
+    }
+    return (float)sum / (255.0f * (float)((x1 - lx * s) * (y1 - ly * s)));
+}
+
+// Coarse guide and its products, stored in sigma until they are averaged
+static bool guided_prepare_guide_rows(void* context, const row_band_t* band) {
+    const guided_job_t* job = (const guided_job_t*)context;
+    int g = job->guide_channels;
+    for (size_t ly = band->begin; ly < band->end; ly++) {
+        for (size_t lx = 0; lx < job->low_width; lx++) {
+            size_t i = ly * job->low_width + lx;
+            float v[3];
+            for (int c = 0; c < g; c++) {
+                v[c] = guided_block_mean(job->guide[c], job->guide_stride, job, lx, ly);
+                job->mean_guide[c][i] = v[c];
+            }
+            if (g == 1) {
+                job->sigma[0][i] = v[0] * v[0];
+            } else {
+                job->sigma[0][i] = v[0] * v[0];
+                job->sigma[1][i] = v[0] * v[1];
+                job->sigma[2][i] = v[0] * v[2];
+                job->sigma[3][i] = v[1] * v[1];
+                job->sigma[4][i] = v[1] * v[2];
+                job->sigma[5][i] = v[2] * v[2];
+            }
+        }
+    }
+    return true;
+}
 
-    for (size_t y = 0; y < height; y++) {
-        for (size_t x = 0; x < width; x++) {
-            float sum = 0.0f;
+static bool guided_prepare_input_rows(void* context, const row_band_t* band) {
+    const guided_job_t* job = (const guided_job_t*)context;
+    for (size_t ly = band->begin; ly < band->end; ly++) {
+        for (size_t lx = 0; lx < job->low_width; lx++) {
+            size_t i = ly * job->low_width + lx;
+            float p = guided_block_mean(job->input, job->input_stride, job, lx, ly);
+            job->mean_input[i] = p;
+            for (int c = 0; c < job->guide_channels; c++) {
+                job->cross[c][i] = guided_block_mean(job->guide[c], job->guide_stride, job, lx, ly) * p;
+            }
+        }
+    }
+    return true;
+}
 
-            // Apply kernel
-            for (int ky = -(int)k_half; ky <= (int)k_half; ky++) {
-                for (int kx = -(int)k_half; kx <= (int)k_half; kx++) {
-                    // Handle boundary conditions with edge clamping
-                    int px = (int)x + kx;
-                    int py = (int)y + ky;
+// Turn averaged products into (co)variances and invert Sigma + eps * I in
+// place, once per guide; the inverse is symmetric, so six planes hold it
+static bool guided_covariance_rows(void* context, const row_band_t* band) {
+    const guided_job_t* job = (const guided_job_t*)context;
+    float eps = job->epsilon;
+    for (size_t ly = band->begin; ly < band->end; ly++) {
+        for (size_t lx = 0; lx < job->low_width; lx++) {
+            size_t i = ly * job->low_width + lx;
+            const float r = job->mean_guide[0][i];
+            if (job->guide_channels == 1) {
+                job->sigma[0][i] = 1.0f / (job->sigma[0][i] - r * r + eps);
+                continue;
+            }
 
-                    // Clamp to image boundaries
-                    if (px < 0) px = 0;
-                    if (px >= (int)width) px = (int)width - 1;
-                    if (py < 0) py = 0;
-                    if (py >= (int)height) py = (int)height - 1;
+            const float g = job->mean_guide[1][i], b = job->mean_guide[2][i];
+            float rr = job->sigma[0][i] - r * r + eps, rg = job->sigma[1][i] - r * g, rb = job->sigma[2][i] - r * b;
+            float gg = job->sigma[3][i] - g * g + eps, gb = job->sigma[4][i] - g * b, bb = job->sigma[5][i] - b * b + eps;
+            // Cofactors over the determinant
+            float inv_rr = gg * bb - gb * gb, inv_rg = gb * rb - rg * bb, inv_rb = rg * gb - gg * rb;
+            float inv_det = 1.0f / (rr * inv_rr + rg * inv_rg + rb * inv_rb);
+            job->sigma[0][i] = inv_rr * inv_det;
+            job->sigma[1][i] = inv_rg * inv_det;
+            job->sigma[2][i] = inv_rb * inv_det;
+            job->sigma[3][i] = (rr * bb - rb * rb) * inv_det;
+            job->sigma[4][i] = (rb * rg - rr * gb) * inv_det;
+            job->sigma[5][i] = (rr * gg - rg * rg) * inv_det;
+        }
+    }
+    return true;
+}
 
-                    size_t pixel_idx = (size_t)py * width + (size_t)px;
-                    size_t kernel_idx = (size_t)(ky + k_half) * kernel->size + (size_t)(kx + k_half);
+// Per-window linear model input = a . guide + b, by ridge regression
+static bool guided_coefficient_rows(void* context, const row_band_t* band) {
+    const guided_job_t* job = (const guided_job_t*)context;
+    for (size_t ly = band->begin; ly < band->end; ly++) {
+        for (size_t lx = 0; lx < job->low_width; lx++) {
+            size_t i = ly * job->low_width + lx;
+            float mean_p = job->mean_input[i];
+            if (job->guide_channels == 1) {
+                float mean_i = job->mean_guide[0][i];
+                float a = (job->cross[0][i] - mean_i * mean_p) * job->sigma[0][i];
+                job->cross[0][i] = a;
+                job->offset[i] = mean_p - a * mean_i;
+                continue;
+            }
 
-                    sum += (float)input[pixel_idx] * kernel->data[kernel_idx];
-                }
+            float cov[3];
+            for (int c = 0; c < 3; c++) {
+                cov[c] = job->cross[c][i] - job->mean_guide[c][i] * mean_p;
+            }
+            float a[3] = {
+                job->sigma[0][i] * cov[0] + job->sigma[1][i] * cov[1] + job->sigma[2][i] * cov[2],
+                job->sigma[1][i] * cov[0] + job->sigma[3][i] * cov[1] + job->sigma[4][i] * cov[2],
+                job->sigma[2][i] * cov[0] + job->sigma[4][i] * cov[1] + job->sigma[5][i] * cov[2]
+            };
+            float b = mean_p;
+            for (int c = 0; c < 3; c++) {
+                job->cross[c][i] = a[c];
+                b -= a[c] * job->mean_guide[c][i];
+            }
+            job->offset[i] = b;
+        }
+    }
+    return true;
+}
+
+// Lower coarse sample and weight of the next one for full-resolution position `x`
+static size_t guided_coarse_position(size_t x, int subsample, size_t low_size, float* weight) {
+    float f = ((float)x + 0.5f) / (float)subsample - 0.5f;
+    if (f <= 0.0f) {
+        *weight = 0.0f;
+        return 0;
+    }
+    size_t i = (size_t)f;
+    if (i + 1 >= low_size) {
+        *weight = 0.0f;
+        return low_size - 1;
+    }
+    *weight = f - (float)i;
+    return i;
+}
+
+static float guided_lerp(const float* plane, size_t row0, size_t row1, size_t x0, size_t x1, float wx, float wy) {
+    float top = plane[row0 + x0] + wx * (plane[row0 + x1] - plane[row0 + x0]);
+    float bottom = plane[row1 + x0] + wx * (plane[row1 + x1] - plane[row1 + x0]);
+    return top + wy * (bottom - top);
+}
+
+// Bilinearly interpolate the averaged coefficients and apply them to the full guide
+static bool guided_output_rows(void* context, const row_band_t* band) {
+    const guided_job_t* job = (const guided_job_t*)context;
+    size_t lw = job->low_width;
+    for (size_t y = band->begin; y < band->end; y++) {
+        float wy;
+        size_t ly = guided_coarse_position(y, job->subsample, job->low_height, &wy);
+        size_t row0 = ly * lw;
+        size_t row1 = (ly + 1 < job->low_height ? ly + 1 : ly) * lw;
+        for (size_t x = 0; x < job->width; x++) {
+            float wx = job->column_weight[x];
+            size_t lx = job->column_index[x];
+            size_t lx1 = lx + 1 < lw ? lx + 1 : lx;
+            // Coefficients fit [0, 1] intensities, so b scales to grey levels and a does not
+            float q = 255.0f * guided_lerp(job->offset, row0, row1, lx, lx1, wx, wy);
+            for (int c = 0; c < job->guide_channels; c++) {
+                q += guided_lerp(job->cross[c], row0, row1, lx, lx1, wx, wy) *
+                     (float)job->guide[c][y * job->guide_stride + x];
             }
+            job->output[y * job->width + x] = clamp_byte(q);
+        }
+    }
+    return true;
+}
+
+/**
+ * Guided filter (He, Sun and Tang): in every (2 * radius + 1)^2 window the
+ * output is a linear function of the guide, fitted to the input by ridge
+ * regression with regularisation epsilon (intensities scaled to [0, 1]).
+ * Every statistic is a box mean, so the cost per pixel does not depend on
+ * the radius. The guide has one or three channels; with three, edges of any
+ * colour are kept. All `channels` inputs share the guide statistics. Guide
+ * and inputs may be views; the outputs are packed.
+ */
+static bool guided_filter_planes(const unsigned char* const* guide, size_t guide_stride, int guide_channels,
+                                 const unsigned char* const* inputs, size_t input_stride,
+                                 unsigned char* const* outputs, int channels, size_t width, size_t height,
+                                 int radius, float epsilon, int subsample) {
+    guided_job_t job = {0};
+    job.guide = guide;
+    job.guide_stride = guide_stride;
+    job.guide_channels = guide_channels;
+    job.input_stride = input_stride;
+    job.width = width;
+    job.height = height;
+    job.subsample = subsample;
+    job.low_width = (width + (size_t)subsample - 1) / (size_t)subsample;
+    job.low_height = (height + (size_t)subsample - 1) / (size_t)subsample;
+    job.epsilon = epsilon;
+
+    // Radius on the coarse grid; at least one coarse pixel
+    int low_radius = radius / subsample > 0 ? radius / subsample : 1;
+    int sigma_count = guide_channels == 1 ? 1 : 6;
+    size_t plane = job.low_width * job.low_height;
+    size_t plane_count = 2 * (size_t)guide_channels + (size_t)sigma_count + 3;
+    scratch_mark_t mark = scratch_mark();
+    float* block = (float*)image_buffer_acquire(plane * plane_count * sizeof(float));
+    job.column_index = (size_t*)scratch_alloc(width * sizeof(size_t));
+    job.column_weight = (float*)scratch_alloc(width * sizeof(float));
+    if (block == NULL || job.column_index == NULL || job.column_weight == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for guided filter\n");
+        image_buffer_release(block);
+        scratch_release(mark);
+        return false;
+    }
+    for (size_t x = 0; x < width; x++) {
+        job.column_index[x] = guided_coarse_position(x, subsample, job.low_width, &job.column_weight[x]);
+    }
 
-            // Apply divisor and offset
-            sum = sum / kernel->divisor + kernel->offset;
-            output[y * width + x] = clamp_byte(sum);
+    float* next = block;
+    for (int c = 0; c < guide_channels; c++) {
+        job.mean_guide[c] = next; next += plane;
+        job.cross[c] = next; next += plane;
+    }
+    for (int k = 0; k < sigma_count; k++) {
+        job.sigma[k] = next; next += plane;
+    }
+    job.mean_input = next; next += plane;
+    job.offset = next; next += plane;
+    float* scratch = next;
+
+    size_t low_row_cost = job.low_width * (size_t)subsample * (size_t)subsample * (size_t)guide_channels;
+    bool ok = parallel_for(job.low_height, low_row_cost, 0, guided_prepare_guide_rows, &job);
+    for (int c = 0; c < guide_channels && ok; c++) {
+        ok = guided_box_mean(job.mean_guide[c], scratch, job.low_width, job.low_height, low_radius);
+    }
+    for (int k = 0; k < sigma_count && ok; k++) {
+        ok = guided_box_mean(job.sigma[k], scratch, job.low_width, job.low_height, low_radius);
+    }
+    ok = ok && parallel_for(job.low_height, job.low_width * 12, 0, guided_covariance_rows, &job);
+
+    for (int ch = 0; ch < channels && ok; ch++) {
+        job.input = inputs[ch];
+        job.output = outputs[ch];
+        ok = parallel_for(job.low_height, low_row_cost, 0, guided_prepare_input_rows, &job);
+        ok = ok && guided_box_mean(job.mean_input, scratch, job.low_width, job.low_height, low_radius);
+        for (int c = 0; c < guide_channels && ok; c++) {
+            ok = guided_box_mean(job.cross[c], scratch, job.low_width, job.low_height, low_radius);
         }
+        ok = ok && parallel_for(job.low_height, job.low_width * 40, 0, guided_coefficient_rows, &job);
+        for (int c = 0; c < guide_channels && ok; c++) {
+            ok = guided_box_mean(job.cross[c], scratch, job.low_width, job.low_height, low_radius);
+        }
+        ok = ok && guided_box_mean(job.offset, scratch, job.low_width, job.low_height, low_radius);
+        ok = ok && parallel_for(height, width * 4 * (size_t)(guide_channels + 1), 0, guided_output_rows, &job);
     }
 
-    return output;
+    image_buffer_release(block);
+    scratch_release(mark);
+    return ok;
 }
 
-grayscale_image_t apply_convolution_grayscale(const grayscale_image_t* image, const kernel_t* kernel) {
+static void guided_defaults(int* radius, float* epsilon, int* subsample) {
+    if (*radius <= 0) *radius = DEFAULT_GUIDED_RADIUS;
+    if (*epsilon <= 0.0f) *epsilon = DEFAULT_GUIDED_EPSILON;
+    if (*subsample <= 0) *subsample = 1;
+}
+
+grayscale_image_t apply_guided_filter(const grayscale_image_t* image, const grayscale_image_t* guide,
+                                      int radius, float epsilon, int subsample) {
     grayscale_image_t result = {0};
+    if (guide == NULL) {
+        guide = image;
+    }
 
-    if (image == NULL || image->data == NULL || kernel == NULL || kernel->data == NULL) {
-        fprintf(stderr, "Error: Invalid input to apply_convolution_grayscale\n");
+    if (image == NULL || image->data == NULL || image->width == 0 || image->height == 0 ||
+        guide->data == NULL || guide->width != image->width || guide->height != image->height) {
+        fprintf(stderr, "Error: Invalid input to apply_guided_filter\n");
         return result;
     }
 
-    if (kernel->size % 2 == 0) {
-        fprintf(stderr, "Error: Kernel size must be odd\n");
+    result = allocate_grayscale_image(image->width, image->height);
+    if (result.data == NULL) {
         return result;
     }
 
-    result.width = image->width;
-    result.height = image->height;
-    result.data = convolve_channel(image->data, image->width, image->height, kernel);
+    guided_defaults(&radius, &epsilon, &subsample);
+    const unsigned char* guides[1] = { guide->data };
+    const unsigned char* inputs[1] = { image->data };
+    unsigned char* outputs[1] = { result.data };
+    if (!guided_filter_planes(guides, grayscale_stride(guide), 1, inputs, grayscale_stride(image), outputs, 1,
+                              image->width, image->height, radius, epsilon, subsample)) {
+        free_grayscale_image(&result);
+    }
+    return result;
+}
+
+grayscale_image_t apply_guided_filter_color_guide(const grayscale_image_t* image, const rgb_image_t* guide,
+                                                  int radius, float epsilon, int subsample) {
+    grayscale_image_t result = {0};
+
+    if (image == NULL || image->data == NULL || image->width == 0 || image->height == 0 ||
+        guide == NULL || guide->r_data == NULL || guide->width != image->width || guide->height != image->height) {
+        fprintf(stderr, "Error: Invalid input to apply_guided_filter_color_guide\n");
+        return result;
+    }
 
+    result = allocate_grayscale_image(image->width, image->height);
     if (result.data == NULL) {
-        result.width = 0;
-        result.height = 0;
+        return result;
     }
 
+    guided_defaults(&radius, &epsilon, &subsample);
+    const unsigned char* guides[3] = { guide->r_data, guide->g_data, guide->b_data };
+    const unsigned char* inputs[1] = { image->data };
+    unsigned char* outputs[1] = { result.data };
+    if (!guided_filter_planes(guides, rgb_stride(guide), 3, inputs, grayscale_stride(image), outputs, 1,
+                              image->width, image->height, radius, epsilon, subsample)) {
+        free_grayscale_image(&result);
+    }
     return result;
 }
 
-rgb_image_t apply_convolution_rgb(const rgb_image_t* image, const kernel_t* kernel) {
+rgb_image_t apply_guided_filter_rgb(const rgb_image_t* image, const rgb_image_t* guide,
+                                    int radius, float epsilon, int subsample) {
     rgb_image_t result = {0};
-
-    if (image == NULL || image->r_data == NULL || kernel == NULL || kernel->data == NULL) {
-        fprintf(stderr, "Error: Invalid input to apply_convolution_rgb\n");
-        return result;
+    if (guide == NULL) {
+        guide = image;
     }
 
-    if (kernel->size % 2 == 0) {
-        fprintf(stderr, "Error: Kernel size must be odd\n");
+    if (image == NULL || image->r_data == NULL || image->width == 0 || image->height == 0 ||
+        guide->r_data == NULL || guide->width != image->width || guide->height != image->height) {
+        fprintf(stderr, "Error: Invalid input to apply_guided_filter_rgb\n");
         return result;
     }
 
-    result.width = image->width;
-    result.height = image->height;
-
-    // Apply convolution to each channel
-    result.r_data = convolve_channel(image->r_data, image->width, image->height, kernel);
-    result.g_data = convolve_channel(image->g_data, image->width, image->height, kernel);
-    result.b_data = convolve_channel(image->b_data, image->width, image->height, kernel);
+    result = allocate_rgb_image(image->width, image->height);
+    bool ok = result.r_data != NULL;
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to allocate memory for guided filter\n");
+    } else {
+        guided_defaults(&radius, &epsilon, &subsample);
+        const unsigned char* guides[3] = { guide->r_data, guide->g_data, guide->b_data };
+        const unsigned char* inputs[3] = { image->r_data, image->g_data, image->b_data };
+        unsigned char* outputs[3] = { result.r_data, result.g_data, result.b_data };
+        ok = guided_filter_planes(guides, rgb_stride(guide), 3, inputs, rgb_stride(image), outputs, 3,
+                                  image->width, image->height, radius, epsilon, subsample);
+    }
 
-    if (result.r_data == NULL || result.g_data == NULL || result.b_data == NULL) {
-        // Cleanup on failure
-        free(result.r_data);
-        free(result.g_data);
-        free(result.b_data);
-        result.width = 0;
-        result.height = 0;
-        result.r_data = result.g_data = result.b_data = NULL;
+    if (!ok) {
+        free_rgb_image(&result);
+        return result;
     }
 
     return result;
@@ -377,245 +1948,651 @@ void free_kernel(kernel_t* kernel) {
     }
 }
 
-grayscale_image_t apply_sobel_edge_detection(const grayscale_image_t* image) {
-    grayscale_image_t result = {0};
-    if (image == NULL || image->data == NULL) {
-        fprintf(stderr, "Error: Invalid input to apply_sobel_edge_detection\n");
-        return result;
-    }
+// tan(22.5) and tan(67.5) in Q15, so orientation binning needs no atan2
+#define GRADIENT_TAN_22_5_Q15 13573
+#define GRADIENT_TAN_67_5_Q15 79109
 
-    // 1. Create Sobel kernels
-    kernel_t kernel_x = create_sobel_x_kernel();
-    kernel_t kernel_y = create_sobel_y_kernel();
+/**
+ * Bin a gradient into one of four orientations by comparing |gy| against
+ * |gx| scaled by the bin-edge tangents
+ */
+static unsigned char quantize_gradient_direction(int gx, int gy) {
+    int ax = abs(gx);
+    int scaled = abs(gy) * 32768;
+    if (scaled <= ax * GRADIENT_TAN_22_5_Q15) return GRADIENT_DIR_0;
+    if (scaled >= ax * GRADIENT_TAN_67_5_Q15) return GRADIENT_DIR_90;
+    return (gx > 0) == (gy > 0) ? GRADIENT_DIR_45 : GRADIENT_DIR_135;
+}
 
-    // 2. Apply convolutions
-    grayscale_image_t gx_image = apply_convolution_grayscale(image, &kernel_x);
-    grayscale_image_t gy_image = apply_convolution_grayscale(image, &kernel_y);
+/**
+ * Gx/Gy of one pixel. r0/r1/r2 are the rows above, at and below the pixel
+ * (already clamped), xl/xr the clamped neighbour columns.
+ */
+static void gradient_pixel(gradient_operator_t op, const unsigned char* r0, const unsigned char* r1,
+                           const unsigned char* r2, int xl, int x, int xr, int16_t* gx, int16_t* gy) {
+    switch (op) {
+        case GRADIENT_SOBEL:
+            *gx = (int16_t)((r0[xr] - r0[xl]) + 2 * (r1[xr] - r1[xl]) + (r2[xr] - r2[xl]));
+            *gy = (int16_t)((r2[xl] + 2 * r2[x] + r2[xr]) - (r0[xl] + 2 * r0[x] + r0[xr]));
+            break;
+        case GRADIENT_PREWITT:
+            *gx = (int16_t)((r0[xr] - r0[xl]) + (r1[xr] - r1[xl]) + (r2[xr] - r2[xl]));
+            *gy = (int16_t)((r2[xl] + r2[x] + r2[xr]) - (r0[xl] + r0[x] + r0[xr]));
+            break;
+        case GRADIENT_ROBERTS:
+            // Diagonal differences over the 2x2 block ending at (x, y)
+            *gx = (int16_t)(r0[xl] - r1[x]);
+            *gy = (int16_t)(r0[x] - r1[xl]);
+            break;
+    }
+}
 
-    // 3. Combine results
-    result.width = image->width;
-    result.height = image->height;
-    result.data = (unsigned char*)malloc(result.width * result.height);
-    if (result.data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for Sobel result\n");
-        result.width = 0;
-        result.height = 0;
+#ifdef TERMIVIEW_SSE2
+/**
+ * Gx/Gy for pixels [x, x + 8). The caller guarantees x - 1 and x + 8 are
+ * inside the row.
+ */
+static void gradient_block_sse2(gradient_operator_t op, const unsigned char* r0, const unsigned char* r1,
+                                const unsigned char* r2, int x, int16_t* gx, int16_t* gy) {
+    __m128i l0 = load8_u8_epi16(r0 + x - 1), c0 = load8_u8_epi16(r0 + x);
+    __m128i l1 = load8_u8_epi16(r1 + x - 1), c1 = load8_u8_epi16(r1 + x);
+    __m128i dx, dy;
+    if (op == GRADIENT_ROBERTS) {
+        dx = _mm_sub_epi16(l0, c1);
+        dy = _mm_sub_epi16(c0, l1);
     } else {
-        for (size_t i = 0; i < result.width * result.height; i++) {
-            float gx = (float)gx_image.data[i];
-            float gy = (float)gy_image.data[i];
-            float magnitude = sqrtf(gx * gx + gy * gy);
-            result.data[i] = clamp_byte(magnitude);
+        __m128i r0v = load8_u8_epi16(r0 + x + 1), r1v = load8_u8_epi16(r1 + x + 1);
+        __m128i l2 = load8_u8_epi16(r2 + x - 1), c2 = load8_u8_epi16(r2 + x), r2v = load8_u8_epi16(r2 + x + 1);
+        __m128i middle_x = _mm_sub_epi16(r1v, l1);
+        __m128i middle_y_bottom = c2, middle_y_top = c0;
+        if (op == GRADIENT_SOBEL) {
+            middle_x = _mm_add_epi16(middle_x, middle_x);
+            middle_y_bottom = _mm_add_epi16(c2, c2);
+            middle_y_top = _mm_add_epi16(c0, c0);
+        }
+        dx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(r0v, l0), middle_x), _mm_sub_epi16(r2v, l2));
+        dy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(l2, middle_y_bottom), r2v),
+                           _mm_add_epi16(_mm_add_epi16(l0, middle_y_top), r0v));
+    }
+    _mm_storeu_si128((__m128i*)(gx + x), dx);
+    _mm_storeu_si128((__m128i*)(gy + x), dy);
+}
+#endif
+
+/**
+ * Gx/Gy for one row: clamped scalar borders, 8-wide blocks in between
+ */
+static void gradient_row(gradient_operator_t op, const unsigned char* r0, const unsigned char* r1,
+                         const unsigned char* r2, int width, int16_t* gx, int16_t* gy) {
+    // Roberts never reads x + 1, so its interior runs up to the last column
+    int interior_end = op == GRADIENT_ROBERTS ? width : width - 1;
+    int x = 0;
+    while (x < width) {
+#ifdef TERMIVIEW_SSE2
+        if (x >= 1 && x + 8 <= interior_end) {
+            gradient_block_sse2(op, r0, r1, r2, x, gx, gy);
+            x += 8;
+            continue;
         }
+#endif
+        int xl = x > 0 ? x - 1 : 0;
+        int xr = x < width - 1 ? x + 1 : width - 1;
+        gradient_pixel(op, r0, r1, r2, xl, x, xr, gx + x, gy + x);
+        x++;
     }
+}
 
-    // 4. Cleanup
-    free(gx_image.data);
-    free(gy_image.data);
-    free_kernel(&kernel_x);
-    free_kernel(&kernel_y);
+typedef struct {
+    const grayscale_image_t* image;
+    gradient_field_t* field;
+    gradient_operator_t op;
+    gradient_norm_t norm;
+} gradient_job_t;
 
-    return result;
+/**
+ * Derivatives, magnitude and direction of rows [begin, end) of a band
+ */
+static bool gradient_band(void* context, const row_band_t* band) {
+    const gradient_job_t* job = (const gradient_job_t*)context;
+    const gradient_field_t* field = job->field;
+    int width = (int)job->image->width;
+    int height = (int)job->image->height;
+    for (int y = (int)band->begin; y < (int)band->end; y++) {
+        const unsigned char* r0 = grayscale_row(job->image, (size_t)(y > 0 ? y - 1 : 0));
+        const unsigned char* r1 = grayscale_row(job->image, (size_t)y);
+        const unsigned char* r2 = grayscale_row(job->image, (size_t)(y < height - 1 ? y + 1 : height - 1));
+        int16_t* gx = field->gx + (size_t)y * width;
+        int16_t* gy = field->gy + (size_t)y * width;
+        gradient_row(job->op, r0, r1, r2, width, gx, gy);
+
+        // Finish the row while its derivatives are still in cache
+        if (field->magnitude != NULL) {
+            uint16_t* magnitude = field->magnitude + (size_t)y * width;
+            if (job->norm == GRADIENT_NORM_L1) {
+                for (int x = 0; x < width; x++) {
+                    magnitude[x] = (uint16_t)(abs(gx[x]) + abs(gy[x]));
+                }
+            } else {
+                for (int x = 0; x < width; x++) {
+                    float squared = (float)(gx[x] * gx[x] + gy[x] * gy[x]);
+                    magnitude[x] = (uint16_t)(sqrtf(squared) + 0.5f);
+                }
+            }
+        }
+        if (field->direction != NULL) {
+            unsigned char* direction = field->direction + (size_t)y * width;
+            for (int x = 0; x < width; x++) {
+                direction[x] = quantize_gradient_direction(gx[x], gy[x]);
+            }
+        }
+    }
+    return true;
 }
 
-grayscale_image_t apply_prewitt_edge_detection(const grayscale_image_t* image) {
-    grayscale_image_t result = {0};
-    if (image == NULL || image->data == NULL) {
-        fprintf(stderr, "Error: Invalid input to apply_prewitt_edge_detection\n");
-        return result;
+gradient_field_t compute_gradient(const grayscale_image_t* image, gradient_operator_t op,
+                                  gradient_norm_t norm, bool with_direction) {
+    gradient_field_t field = {0};
+    if (image == NULL || image->data == NULL || image->width == 0 || image->height == 0) {
+        fprintf(stderr, "Error: Invalid input to compute_gradient\n");
+        return field;
     }
 
-    // 1. Create Prewitt kernels
-    kernel_t kernel_x = create_prewitt_x_kernel();
-    kernel_t kernel_y = create_prewitt_y_kernel();
+    size_t pixels = image->width * image->height;
+    field.width = image->width;
+    field.height = image->height;
+    field.gx = (int16_t*)image_buffer_acquire(pixels * sizeof(int16_t));
+    field.gy = (int16_t*)image_buffer_acquire(pixels * sizeof(int16_t));
+    if (norm != GRADIENT_NORM_NONE) {
+        field.magnitude = (uint16_t*)image_buffer_acquire(pixels * sizeof(uint16_t));
+    }
+    if (with_direction) {
+        field.direction = (unsigned char*)image_buffer_acquire(pixels);
+    }
+    if (field.gx == NULL || field.gy == NULL ||
+        (norm != GRADIENT_NORM_NONE && field.magnitude == NULL) || (with_direction && field.direction == NULL)) {
+        fprintf(stderr, "Error: Failed to allocate memory for gradient field\n");
+        free_gradient_field(&field);
+        return field;
+    }
 
-    // 2. Apply convolutions
-    grayscale_image_t gx_image = apply_convolution_grayscale(image, &kernel_x);
-    grayscale_image_t gy_image = apply_convolution_grayscale(image, &kernel_y);
+    gradient_job_t job = { image, &field, op, norm };
+    if (!parallel_for(image->height, image->width * 16, 1, gradient_band, &job)) {
+        fprintf(stderr, "Error: Failed to compute gradient field\n");
+        free_gradient_field(&field);
+    }
+    return field;
+}
 
-    // 3. Combine results
-    result.width = image->width;
-    result.height = image->height;
-    result.data = (unsigned char*)malloc(result.width * result.height);
-    if (result.data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for Prewitt result\n");
-        result.width = 0;
-        result.height = 0;
-    } else {
+void free_gradient_field(gradient_field_t* field) {
+    if (field != NULL) {
+        image_buffer_release(field->gx);
+        image_buffer_release(field->gy);
+        image_buffer_release(field->magnitude);
+        image_buffer_release(field->direction);
+        field->gx = NULL;
+        field->gy = NULL;
+        field->magnitude = NULL;
+        field->direction = NULL;
+        field->width = 0;
+        field->height = 0;
+    }
+}
+
+/**
+ * Edge image from the L2 gradient magnitude, saturated to 255
+ */
+static grayscale_image_t gradient_edge_image(const grayscale_image_t* image, gradient_operator_t op) {
+    grayscale_image_t result = {0};
+    gradient_field_t field = compute_gradient(image, op, GRADIENT_NORM_L2, false);
+    if (field.magnitude == NULL) {
+        return result;
+    }
+
+    result = allocate_grayscale_image(image->width, image->height);
+    if (result.data != NULL) {
         for (size_t i = 0; i < result.width * result.height; i++) {
-            float gx = (float)gx_image.data[i];
-            float gy = (float)gy_image.data[i];
-            float magnitude = sqrtf(gx * gx + gy * gy);
-            result.data[i] = clamp_byte(magnitude);
+            result.data[i] = field.magnitude[i] > 255 ? 255 : (unsigned char)field.magnitude[i];
         }
     }
 
-    // 4. Cleanup
-    free(gx_image.data);
-    free(gy_image.data);
-    free_kernel(&kernel_x);
-    free_kernel(&kernel_y);
-
+    free_gradient_field(&field);
     return result;
 }
 
+grayscale_image_t apply_sobel_edge_detection(const grayscale_image_t* image) {
+    if (image == NULL || image->data == NULL) {
+        fprintf(stderr, "Error: Invalid input to apply_sobel_edge_detection\n");
+        return (grayscale_image_t){0};
+    }
+    return gradient_edge_image(image, GRADIENT_SOBEL);
+}
+
+grayscale_image_t apply_prewitt_edge_detection(const grayscale_image_t* image) {
+    if (image == NULL || image->data == NULL) {
+        fprintf(stderr, "Error: Invalid input to apply_prewitt_edge_detection\n");
+        return (grayscale_image_t){0};
+    }
+    return gradient_edge_image(image, GRADIENT_PREWITT);
+}
+
 grayscale_image_t apply_roberts_edge_detection(const grayscale_image_t* image) {
-    grayscale_image_t result = {0};
     if (image == NULL || image->data == NULL) {
         fprintf(stderr, "Error: Invalid input to apply_roberts_edge_detection\n");
-        return result;
+        return (grayscale_image_t){0};
     }
+    return gradient_edge_image(image, GRADIENT_ROBERTS);
+}
 
-    // 1. Create Roberts kernels
-    kernel_t kernel_x = create_roberts_x_kernel();
-    kernel_t kernel_y = create_roberts_y_kernel();
 
-    // 2. Apply convolutions
-    grayscale_image_t gx_image = apply_convolution_grayscale(image, &kernel_x);
-    grayscale_image_t gy_image = apply_convolution_grayscale(image, &kernel_y);
+typedef enum {
+    ROW_FILTER_FIXED,
+    ROW_FILTER_SEPARABLE,
+    ROW_FILTER_DIRECT,
+    ROW_FILTER_GRADIENT
+} row_filter_kind_t;
 
-    // 3. Combine results
-    result.width = image->width;
-    result.height = image->height;
-    result.data = (unsigned char*)malloc(result.width * result.height);
-    if (result.data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for Roberts result\n");
-        result.width = 0;
-        result.height = 0;
-    } else {
-        for (size_t i = 0; i < result.width * result.height; i++) {
-            float gx = (float)gx_image.data[i];
-            float gy = (float)gy_image.data[i];
-            float magnitude = sqrtf(gx * gx + gy * gy);
-            result.data[i] = clamp_byte(magnitude);
+/**
+ * Row filter state. Each kind runs the same row routine as its whole-image
+ * counterpart; the separable kind keeps the same ring of horizontally
+ * filtered rows as convolve_separable.
+ */
+struct row_filter {
+    row_filter_kind_t kind;
+    int width;
+    int height;
+    int radius;
+    fixed_kernel_t fixed;
+    fixed_convolution_fn fixed_convolve;
+    kernel_t kernel;                // Owned copy (direct and separable)
+    float* taps;                    // Separable column taps, then row taps
+    float* ring;                    // Separable: `size` horizontally filtered rows
+    int next_source_row;            // Separable: next input row to filter horizontally, -1 before the first run
+    const unsigned char** rows;
+    const float** float_rows;
+    gradient_operator_t op;
+    int16_t* gx;
+    int16_t* gy;
+};
+
+static row_filter_t* new_row_filter(row_filter_kind_t kind, size_t width, size_t height, int radius) {
+    row_filter_t* filter = (row_filter_t*)calloc(1, sizeof(row_filter_t));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->kind = kind;
+    filter->width = (int)width;
+    filter->height = (int)height;
+    filter->radius = radius;
+    filter->next_source_row = -1;
+    filter->rows = (const unsigned char**)malloc((size_t)(2 * radius + 1) * sizeof(unsigned char*));
+    if (filter->rows == NULL) {
+        free(filter);
+        return NULL;
+    }
+    return filter;
+}
+
+row_filter_t* create_convolution_row_filter(const kernel_t* kernel, size_t width, size_t height) {
+    if (kernel == NULL || kernel->data == NULL || kernel->size % 2 == 0 || width == 0 || height == 0) {
+        fprintf(stderr, "Error: Invalid input to create_convolution_row_filter\n");
+        return NULL;
+    }
+
+    // Same path selection as convolve_channel
+    fixed_kernel_t fixed;
+    fixed_convolution_fn fixed_convolve = select_fixed_convolution(kernel, &fixed);
+    size_t taps = kernel->size * kernel->size;
+    float* separable = NULL;
+    if (fixed_convolve == NULL && kernel->size > 1) {
+        separable = (float*)malloc(2 * kernel->size * sizeof(float));
+        if (separable != NULL && !factor_separable_kernel(kernel, separable, separable + kernel->size)) {
+            free(separable);
+            separable = NULL;
         }
     }
+    if (fixed_convolve == NULL && fft_convolution_preferred(kernel, width, height, separable != NULL)) {
+        free(separable);
+        return NULL;
+    }
 
-    // 4. Cleanup
-    free(gx_image.data);
-    free(gy_image.data);
-    free_kernel(&kernel_x);
-    free_kernel(&kernel_y);
+    row_filter_kind_t kind = fixed_convolve != NULL ? ROW_FILTER_FIXED
+                           : (separable != NULL ? ROW_FILTER_SEPARABLE : ROW_FILTER_DIRECT);
+    row_filter_t* filter = new_row_filter(kind, width, height, (int)kernel->size / 2);
+    if (filter == NULL) {
+        free(separable);
+        return NULL;
+    }
+    filter->fixed = fixed;
+    filter->fixed_convolve = fixed_convolve;
+    filter->taps = separable;
+    filter->kernel = *kernel;
+    filter->kernel.data = (float*)malloc(taps * sizeof(float));
+    if (kind == ROW_FILTER_SEPARABLE) {
+        filter->ring = (float*)malloc(kernel->size * width * sizeof(float));
+        filter->float_rows = (const float**)malloc(kernel->size * sizeof(float*));
+    }
+    if (filter->kernel.data == NULL ||
+        (kind == ROW_FILTER_SEPARABLE && (filter->ring == NULL || filter->float_rows == NULL))) {
+        free_row_filter(filter);
+        return NULL;
+    }
+    memcpy(filter->kernel.data, kernel->data, taps * sizeof(float));
+    return filter;
+}
 
-    return result;
+row_filter_t* create_gradient_row_filter(gradient_operator_t op, size_t width, size_t height) {
+    if (width == 0 || height == 0) {
+        fprintf(stderr, "Error: Invalid input to create_gradient_row_filter\n");
+        return NULL;
+    }
+    row_filter_t* filter = new_row_filter(ROW_FILTER_GRADIENT, width, height, 1);
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->op = op;
+    filter->gx = (int16_t*)malloc(width * sizeof(int16_t));
+    filter->gy = (int16_t*)malloc(width * sizeof(int16_t));
+    if (filter->gx == NULL || filter->gy == NULL) {
+        free_row_filter(filter);
+        return NULL;
+    }
+    return filter;
 }
 
+size_t row_filter_radius(const row_filter_t* filter) {
+    return (size_t)filter->radius;
+}
 
-// Recursive helper for hysteresis
-static void hysteresis_recursive(grayscale_image_t* image, int x, int y) {
-    if (x < 0 || x >= (int)image->width || y < 0 || y >= (int)image->height || image->data[y * image->width + x] != 128) {
+void row_filter_run(row_filter_t* filter, size_t y, row_source_fn source, void* context, unsigned char* out) {
+    int row = (int)y;
+    int width = filter->width;
+    int height = filter->height;
+    int radius = filter->radius;
+    int size = 2 * radius + 1;
+
+    if (filter->kind == ROW_FILTER_SEPARABLE) {
+        const float* col_taps = filter->taps;
+        const float* row_taps = filter->taps + size;
+        if (filter->next_source_row < 0) {
+            filter->next_source_row = row > radius ? row - radius : 0;
+        }
+        int last_needed = row + radius < height ? row + radius : height - 1;
+        while (filter->next_source_row <= last_needed) {
+            int source_row = filter->next_source_row++;
+            convolve_row(source(context, (size_t)source_row), filter->ring + (size_t)(source_row % size) * width,
+                         (size_t)width, row_taps, radius);
+        }
+        for (int k = 0; k < size; k++) {
+            int py = row + k - radius;
+            py = py < 0 ? 0 : (py >= height ? height - 1 : py);
+            filter->float_rows[k] = filter->ring + (size_t)(py % size) * width;
+        }
+        convolution_kernels()->taps_col(filter->float_rows, out, width, col_taps, size, filter->kernel.divisor,
+                                        filter->kernel.offset);
         return;
     }
 
-    image->data[y * image->width + x] = 255; // Mark as strong edge
+    for (int k = 0; k < size; k++) {
+        int py = row + k - radius;
+        filter->rows[k] = source(context, (size_t)(py < 0 ? 0 : (py >= height ? height - 1 : py)));
+    }
+    switch (filter->kind) {
+        case ROW_FILTER_FIXED:
+            filter->fixed_convolve(filter->rows, out, width, &filter->fixed);
+            break;
+        case ROW_FILTER_DIRECT:
+            convolve_direct_row(filter->rows, out, width, &filter->kernel);
+            break;
+        case ROW_FILTER_GRADIENT:
+            gradient_row(filter->op, filter->rows[0], filter->rows[1], filter->rows[2], width, filter->gx, filter->gy);
+            for (int x = 0; x < width; x++) {
+                float squared = (float)(filter->gx[x] * filter->gx[x] + filter->gy[x] * filter->gy[x]);
+                uint16_t magnitude = (uint16_t)(sqrtf(squared) + 0.5f);
+                out[x] = magnitude > 255 ? 255 : (unsigned char)magnitude;
+            }
+            break;
+        default:
+            break;
+    }
+}
 
-    // Check 8 neighbors
-    for (int dy = -1; dy <= 1; dy++) {
-        for (int dx = -1; dx <= 1; dx++) {
-            if (dx == 0 && dy == 0) continue;
-            hysteresis_recursive(image, x + dx, y + dy);
-        }
+void free_row_filter(row_filter_t* filter) {
+    if (filter != NULL) {
+        free(filter->kernel.data);
+        free(filter->taps);
+        free(filter->ring);
+        free(filter->rows);
+        free(filter->float_rows);
+        free(filter->gx);
+        free(filter->gy);
+        free(filter);
+    }
+}
+
+// Rows per hysteresis band; bands are labelled independently and merged at their seams
+#define HYSTERESIS_BAND_ROWS 64
+
+#define EDGE_WEAK 128
+#define EDGE_STRONG 255
+
+/**
+ * Union-find root lookup with path halving
+ */
+static uint32_t edge_find(uint32_t* parent, uint32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+/**
+ * Merge two edge components, keeping the smaller index as root so every
+ * band-local union stays inside its band. A component is strong as soon
+ * as any of its pixels is.
+ */
+static void edge_union(uint32_t* parent, unsigned char* strong, uint32_t a, uint32_t b) {
+    a = edge_find(parent, a);
+    b = edge_find(parent, b);
+    if (a == b) return;
+    if (a > b) {
+        uint32_t tmp = a;
+        a = b;
+        b = tmp;
     }
+    parent[b] = a;
+    strong[a] |= strong[b];
 }
 
-static void hysteresis_edge_tracking(grayscale_image_t* image) {
-    for (size_t y = 0; y < image->height; y++) {
-        for (size_t x = 0; x < image->width; x++) {
-            if (image->data[y * image->width + x] == 255) {
-                hysteresis_recursive(image, (int)x, (int)y);
+/**
+ * Label the 8-connected weak/strong components of rows [y0, y1)
+ */
+static void label_edge_band(const unsigned char* edges, uint32_t* parent, unsigned char* strong,
+                            int width, int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t i = (uint32_t)y * width + x;
+            if (edges[i] == 0) continue;
+            parent[i] = i;
+            strong[i] = edges[i] == EDGE_STRONG;
+
+            // Neighbours already visited in scan order: W, and NW/N/NE when inside the band
+            if (x > 0 && edges[i - 1]) edge_union(parent, strong, i, i - 1);
+            if (y > y0) {
+                uint32_t above = i - width;
+                if (x > 0 && edges[above - 1]) edge_union(parent, strong, i, above - 1);
+                if (edges[above]) edge_union(parent, strong, i, above);
+                if (x < width - 1 && edges[above + 1]) edge_union(parent, strong, i, above + 1);
             }
         }
     }
+}
+
+/**
+ * Root lookup without path compression, safe while other threads read the forest
+ */
+static uint32_t edge_root(const uint32_t* parent, uint32_t i) {
+    while (parent[i] != i) {
+        i = parent[i];
+    }
+    return i;
+}
+
+typedef struct {
+    unsigned char* edges;
+    uint32_t* parent;
+    unsigned char* strong;
+    int width;
+    int height;
+} hysteresis_job_t;
+
+// Items are whole HYSTERESIS_BAND_ROWS bands; unions never leave their band
+static bool label_edge_bands(void* context, const row_band_t* band) {
+    const hysteresis_job_t* job = (const hysteresis_job_t*)context;
+    for (size_t b = band->begin; b < band->end; b++) {
+        int y0 = (int)b * HYSTERESIS_BAND_ROWS;
+        int y1 = y0 + HYSTERESIS_BAND_ROWS < job->height ? y0 + HYSTERESIS_BAND_ROWS : job->height;
+        label_edge_band(job->edges, job->parent, job->strong, job->width, y0, y1);
+    }
+    return true;
+}
 
-    // Clean up any remaining weak edges
-    for (size_t i = 0; i < image->width * image->height; i++) {
-        if (image->data[i] == 128) {
-            image->data[i] = 0;
+static bool resolve_edge_rows(void* context, const row_band_t* band) {
+    const hysteresis_job_t* job = (const hysteresis_job_t*)context;
+    for (size_t i = band->begin * job->width; i < band->end * job->width; i++) {
+        if (job->edges[i] != 0) {
+            job->edges[i] = job->strong[edge_root(job->parent, (uint32_t)i)] ? EDGE_STRONG : 0;
         }
     }
+    return true;
 }
 
-static grayscale_image_t double_thresholding(const grayscale_image_t* image, float low_ratio, float high_ratio) {
-    grayscale_image_t result = {0};
-    result.width = image->width;
-    result.height = image->height;
-    result.data = (unsigned char*)calloc(image->width * image->height, sizeof(unsigned char));
+/**
+ * Hysteresis edge tracking: weak pixels survive only when connected to a
+ * strong pixel. Components are found with union-find per row band, one
+ * thread per group of bands, then joined across band seams, so memory use
+ * is bounded and there is no recursion regardless of edge length.
+ */
+static bool hysteresis_edge_tracking(grayscale_image_t* image) {
+    int width = (int)image->width;
+    int height = (int)image->height;
+    size_t pixels = image->width * image->height;
+    uint32_t* parent = (uint32_t*)image_buffer_acquire(pixels * sizeof(uint32_t));
+    unsigned char* strong = (unsigned char*)image_buffer_acquire(pixels);
+    if (parent == NULL || strong == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for hysteresis\n");
+        image_buffer_release(parent);
+        image_buffer_release(strong);
+        return false;
+    }
+
+    hysteresis_job_t job = { image->data, parent, strong, width, height };
+    size_t bands = (size_t)(height + HYSTERESIS_BAND_ROWS - 1) / HYSTERESIS_BAND_ROWS;
+    bool ok = parallel_for(bands, image->width * HYSTERESIS_BAND_ROWS, 0, label_edge_bands, &job);
+
+    // Join components across each seam: first row of a band against the last row of the one above
+    for (int y = HYSTERESIS_BAND_ROWS; ok && y < height; y += HYSTERESIS_BAND_ROWS) {
+        for (int x = 0; x < width; x++) {
+            uint32_t i = (uint32_t)y * width + x;
+            if (image->data[i] == 0) continue;
+            uint32_t above = i - width;
+            if (x > 0 && image->data[above - 1]) edge_union(parent, strong, i, above - 1);
+            if (image->data[above]) edge_union(parent, strong, i, above);
+            if (x < width - 1 && image->data[above + 1]) edge_union(parent, strong, i, above + 1);
+        }
+    }
+
+    ok = ok && parallel_for(image->height, image->width, 0, resolve_edge_rows, &job);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to track edges by hysteresis\n");
+    }
+
+    image_buffer_release(parent);
+    image_buffer_release(strong);
+    return ok;
+}
 
+static grayscale_image_t double_thresholding(const uint16_t* magnitude, size_t width, size_t height,
+                                             float low_ratio, float high_ratio) {
+    grayscale_image_t result = allocate_grayscale_image(width, height);
     if (result.data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for thresholding result\n");
-        result.width = 0;
-        result.height = 0;
         return result;
     }
+    memset(result.data, 0, width * height);
 
     // Find the maximum magnitude to scale thresholds
-    float max_mag = 0;
-    for (size_t i = 0; i < image->width * image->height; i++) {
-        if (image->data[i] > max_mag) {
-            max_mag = image->data[i];
+    uint16_t max_mag = 0;
+    for (size_t i = 0; i < width * height; i++) {
+        if (magnitude[i] > max_mag) {
+            max_mag = magnitude[i];
         }
     }
 
     float high_threshold = max_mag * high_ratio;
     float low_threshold = high_threshold * low_ratio;
 
-    const unsigned char WEAK = 128;
-    const unsigned char STRONG = 255;
-
-    for (size_t i = 0; i < image->width * image->height; i++) {
-        if (image->data[i] >= high_threshold) {
-            result.data[i] = STRONG;
-        } else if (image->data[i] >= low_threshold) {
-            result.data[i] = WEAK;
+    for (size_t i = 0; i < width * height; i++) {
+        if (magnitude[i] >= high_threshold) {
+            result.data[i] = EDGE_STRONG;
+        } else if (magnitude[i] >= low_threshold && magnitude[i] > 0) {
+            result.data[i] = EDGE_WEAK;
         }
     }
 
     return result;
 }
 
-static grayscale_image_t non_maximum_suppression(size_t width, size_t height, const float* magnitude, const float* orientation) {
-    grayscale_image_t result = {0};
-    result.width = width;
-    result.height = height;
-    result.data = (unsigned char*)calloc(width * height, sizeof(unsigned char));
-    if (result.data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for non-maximum suppression\n");
-        result.width = 0;
-        result.height = 0;
-        return result;
-    }
-
-    for (size_t y = 1; y < height - 1; y++) {
-        for (size_t x = 1; x < width - 1; x++) {
+typedef struct {
+    const gradient_field_t* gradient;
+    uint16_t* suppressed;
+} suppression_job_t;
+
+static bool suppress_rows(void* context, const row_band_t* band) {
+    const suppression_job_t* job = (const suppression_job_t*)context;
+    const gradient_field_t* gradient = job->gradient;
+    uint16_t* result = job->suppressed;
+    size_t width = gradient->width;
+    size_t height = gradient->height;
+    const ptrdiff_t w = (ptrdiff_t)width;
+    const ptrdiff_t neighbour_offset[4] = { 1, w + 1, w, w - 1 };
+    size_t y_begin = band->begin > 1 ? band->begin : 1;
+    size_t y_end = band->end + 1 < height ? band->end : height - 1;
+    for (size_t y = y_begin; y < y_end; y++) {
+        for (size_t x = 1; x + 1 < width; x++) {
             size_t i = y * width + x;
-            float angle = orientation[i] * 180.0f / M_PI;
-            if (angle < 0) angle += 180;
-
-            float mag = magnitude[i];
-            float q = 255.0f;
-            float r = 255.0f;
-
-            // Find neighbors in the gradient direction
-            if ((0 <= angle && angle < 22.5) || (157.5 <= angle && angle <= 180)) {
-                q = magnitude[i + 1];
-                r = magnitude[i - 1];
-            } else if (22.5 <= angle && angle < 67.5) {
-                q = magnitude[i - width + 1];
-                r = magnitude[i + width - 1];
-            } else if (67.5 <= angle && angle < 112.5) {
-                q = magnitude[i - width];
-                r = magnitude[i + width];
-            } else if (112.5 <= angle && angle < 157.5) {
-                q = magnitude[i - width - 1];
-                r = magnitude[i + width + 1];
-            }
+            uint16_t mag = gradient->magnitude[i];
+            if (mag == 0) continue;
 
-            // Suppress if not a local maximum
-            if (mag >= q && mag >= r) {
-                result.data[i] = clamp_byte(mag);
+            ptrdiff_t offset = neighbour_offset[gradient->direction[i]];
+            if (mag >= gradient->magnitude[i + offset] && mag >= gradient->magnitude[i - offset]) {
+                result[i] = mag;
             }
         }
     }
+    return true;
+}
+
+/**
+ * Keep only magnitudes that are maximal along their quantized gradient
+ * direction. Image rows grow downwards, so a 45-degree gradient points to
+ * the lower-right neighbour.
+ * Returns a pooled plane, to be released with image_buffer_release
+ */
+static uint16_t* non_maximum_suppression(const gradient_field_t* gradient) {
+    size_t bytes = gradient->width * gradient->height * sizeof(uint16_t);
+    uint16_t* result = (uint16_t*)image_buffer_acquire(bytes);
+    if (result == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for non-maximum suppression\n");
+        return NULL;
+    }
+    memset(result, 0, bytes);
+
+    suppression_job_t job = { gradient, result };
+    if (!parallel_for(gradient->height, gradient->width * 4, 1, suppress_rows, &job)) {
+        fprintf(stderr, "Error: Failed to suppress non-maximum gradients\n");
+        image_buffer_release(result);
+        return NULL;
+    }
     return result;
 }
 
@@ -632,85 +2609,55 @@ grayscale_image_t apply_canny_edge_detection(const grayscale_image_t* image, flo
     if (sigma <= 0) sigma = 1.4f; // Default sigma if not provided or invalid
     if (kernel_size % 2 == 0) kernel_size++; // Ensure odd kernel size
 
+    // The intermediate planes up to the thresholded image come from the buffer pool
     kernel_t gaussian_kernel = create_gaussian_blur_kernel(kernel_size, sigma);
-    grayscale_image_t blurred_image = apply_convolution_grayscale(image, &gaussian_kernel);
+    grayscale_image_t blurred_image = {
+        .width = image->width,
+        .height = image->height,
+        .data = (unsigned char*)image_buffer_acquire(image->width * image->height),
+        .borrowed = true
+    };
+    bool blurred = gaussian_kernel.data != NULL && blurred_image.data != NULL &&
+                   convolve_channel_into(image->data, grayscale_stride(image), blurred_image.data, image->width,
+                                         image->height, &gaussian_kernel);
     free_kernel(&gaussian_kernel);
 
-    if (blurred_image.data == NULL) {
-        return result;
-    }
-
-
-    // Step 2: Calculate Gradient Magnitude and Direction
-    grayscale_image_t gx_image, gy_image;
-    float* magnitude = (float*)malloc(image->width * image->height * sizeof(float));
-    float* orientation = (float*)malloc(image->width * image->height * sizeof(float));
-
-    if (magnitude == NULL || orientation == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for gradient calculation\n");
-        free(blurred_image.data);
-        free(magnitude);
-        free(orientation);
+    if (!blurred) {
+        image_buffer_release(blurred_image.data);
         return result;
     }
 
-    kernel_t sobel_x = create_sobel_x_kernel();
-    kernel_t sobel_y = create_sobel_y_kernel();
-
-    gx_image = apply_convolution_grayscale(&blurred_image, &sobel_x);
-    gy_image = apply_convolution_grayscale(&blurred_image, &sobel_y);
-
-    free_kernel(&sobel_x);
-    free_kernel(&sobel_y);
-
-    if (gx_image.data == NULL || gy_image.data == NULL) {
-        free(blurred_image.data);
-        free(gx_image.data);
-        free(gy_image.data);
-        free(magnitude);
-        free(orientation);
+    // Step 2: Signed Sobel gradient with magnitude and quantized direction in one pass
+    gradient_field_t gradient = compute_gradient(&blurred_image, GRADIENT_SOBEL, GRADIENT_NORM_L2, true);
+    image_buffer_release(blurred_image.data);
+    if (gradient.magnitude == NULL) {
         return result;
     }
 
-    for (size_t i = 0; i < image->width * image->height; i++) {
-        float gx = (float)gx_image.data[i];
-        float gy = (float)gy_image.data[i];
-        magnitude[i] = sqrtf(gx * gx + gy * gy);
-        orientation[i] = atan2f(gy, gx);
-    }
-    
-    free(gx_image.data);
-    free(gy_image.data);
-
     // Step 3: Non-Maximum Suppression
-    grayscale_image_t nms_image = non_maximum_suppression(image->width, image->height, magnitude, orientation);
-    
-    // Cleanup allocated memory for gradient
-    free(magnitude);
-    free(orientation);
-    
-    if (nms_image.data == NULL) {
-        free(blurred_image.data);
+    uint16_t* suppressed = non_maximum_suppression(&gradient);
+    free_gradient_field(&gradient);
+    if (suppressed == NULL) {
         return result;
     }
 
     // Step 4: Double Thresholding
-    grayscale_image_t thresholded_image = double_thresholding(&nms_image, low_threshold_ratio, high_threshold_ratio);
-    free(nms_image.data);
+    grayscale_image_t thresholded_image = double_thresholding(suppressed, image->width, image->height,
+                                                              low_threshold_ratio, high_threshold_ratio);
+    image_buffer_release(suppressed);
 
     if(thresholded_image.data == NULL){
-        free(blurred_image.data);
         return result;
     }
 
     // Step 5: Edge Tracking by Hysteresis
-    hysteresis_edge_tracking(&thresholded_image);
+    if (!hysteresis_edge_tracking(&thresholded_image)) {
+        free_grayscale_image(&thresholded_image);
+        return result;
+    }
 
     // Final result is the thresholded image after hysteresis
     result = thresholded_image; 
-    
-    // Cleanup allocated memory
-    free(blurred_image.data);
 
     return result;
 }
@@ -736,6 +2683,24 @@ filter_type_t parse_filter_type(const char* filter_str) {
         return FILTER_EDGE_LAPLACIAN;
     } else if (strcmp(filter_str, "salt-pepper") == 0) {
         return FILTER_SALT_PEPPER;
+    } else if (strcmp(filter_str, "bilateral") == 0) {
+        return FILTER_BILATERAL;
+    } else if (strcmp(filter_str, "guided") == 0) {
+        return FILTER_GUIDED;
+    } else if (strcmp(filter_str, "nlmeans") == 0 || strcmp(filter_str, "nl-means") == 0) {
+        return FILTER_NL_MEANS;
+    } else if (strcmp(filter_str, "median") == 0) {
+        return FILTER_MEDIAN;
+    } else if (strcmp(filter_str, "erode") == 0) {
+        return FILTER_ERODE;
+    } else if (strcmp(filter_str, "dilate") == 0) {
+        return FILTER_DILATE;
+    } else if (strcmp(filter_str, "open") == 0) {
+        return FILTER_OPEN;
+    } else if (strcmp(filter_str, "close") == 0) {
+        return FILTER_CLOSE;
+    } else if (strcmp(filter_str, "tophat") == 0 || strcmp(filter_str, "top-hat") == 0) {
+        return FILTER_TOPHAT;
     } else if (strcmp(filter_str, "ideal-lowpass") == 0) {
         return FILTER_IDEAL_LOWPASS;
     } else if (strcmp(filter_str, "ideal-highpass") == 0) {
@@ -747,7 +2712,7 @@ filter_type_t parse_filter_type(const char* filter_str) {
     } else if (strcmp(filter_str, "none") == 0) {
         return FILTER_NONE;
     } else {
-        fprintf(stderr, "Warning: Unknown filter type '%s', using none\n", filter_str);
+        fprintf(stderr, "Error: Unknown filter type '%s'\n", filter_str);
         return FILTER_NONE;
     }
 }
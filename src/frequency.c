@@ -1,5 +1,6 @@
 #define _USE_MATH_DEFINES // For M_PI on some systems
 #include "../include/frequency.h"
+#include "../include/image_alloc.h"
 #include <fftw3.h>
 #include <math.h>
 #ifndef M_PI
@@ -38,20 +39,23 @@ grayscale_image_t dft_grayscale(grayscale_image_t* image) {
     size_t height = image->height;
     size_t num_pixels = width * height;
 
-    // Allocate FFTW arrays
-    fftw_complex* in = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * num_pixels);
-    fftw_complex* out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * num_pixels);
+    // Allocate FFTW arrays; pooled buffers are aligned for FFTW's SIMD codelets
+    fftw_complex* in = (fftw_complex*)image_buffer_acquire(sizeof(fftw_complex) * num_pixels);
+    fftw_complex* out = (fftw_complex*)image_buffer_acquire(sizeof(fftw_complex) * num_pixels);
 
     if (in == NULL || out == NULL) {
-        fftw_free(in);
-        fftw_free(out);
+        image_buffer_release(in);
+        image_buffer_release(out);
         return result;
     }
 
     // Prepare input data
-    for (size_t i = 0; i < num_pixels; i++) {
-        in[i][0] = (double)image->data[i];
-        in[i][1] = 0.0;
+    for (size_t y = 0; y < height; y++) {
+        const unsigned char* row = grayscale_row(image, y);
+        for (size_t x = 0; x < width; x++) {
+            in[y * width + x][0] = (double)row[x];
+            in[y * width + x][1] = 0.0;
+        }
     }
 
     // Create and execute FFTW plan
@@ -59,11 +63,11 @@ grayscale_image_t dft_grayscale(grayscale_image_t* image) {
     fftw_execute(plan);
 
     // Calculate magnitude spectrum
-    double* magnitude = (double*)malloc(sizeof(double) * num_pixels);
+    double* magnitude = (double*)image_buffer_acquire(sizeof(double) * num_pixels);
     if (magnitude == NULL) {
         fftw_destroy_plan(plan);
-        fftw_free(in);
-        fftw_free(out);
+        image_buffer_release(in);
+        image_buffer_release(out);
         return result;
     }
 
@@ -85,9 +89,7 @@ grayscale_image_t dft_grayscale(grayscale_image_t* image) {
         }
     }
 
-    result.width = width;
-    result.height = height;
-    result.data = (unsigned char*)malloc(num_pixels);
+    result = allocate_grayscale_image(width, height);
     if (result.data != NULL) {
         if (max_mag > 0) {
             for (size_t i = 0; i < num_pixels; i++) {
@@ -99,10 +101,10 @@ grayscale_image_t dft_grayscale(grayscale_image_t* image) {
     }
 
     // Cleanup
-    free(magnitude);
+    image_buffer_release(magnitude);
     fftw_destroy_plan(plan);
-    fftw_free(in);
-    fftw_free(out);
+    image_buffer_release(in);
+    image_buffer_release(out);
 
     return result;
 }
@@ -127,7 +129,7 @@ grayscale_image_t dct_grayscale(grayscale_image_t* image) {
     size_t num_pixels = width * height;
 
     // DCT coefficients will be double
-    double* dct_coeffs = (double*)malloc(sizeof(double) * num_pixels);
+    double* dct_coeffs = (double*)image_buffer_acquire(sizeof(double) * num_pixels);
     if (dct_coeffs == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for DCT coefficients\n");
         return result;
@@ -137,8 +139,9 @@ grayscale_image_t dct_grayscale(grayscale_image_t* image) {
         for (size_t v = 0; v < width; v++) { // v corresponds to columns
             double sum = 0.0;
             for (size_t x = 0; x < height; x++) { // x corresponds to rows
+                const unsigned char* row = grayscale_row(image, x);
                 for (size_t y = 0; y < width; y++) { // y corresponds to columns
-                    sum += (double)image->data[x * width + y] *
+                    sum += (double)row[y] *
                            cos(((2.0 * x + 1.0) * u * M_PI) / (2.0 * height)) *
                            cos(((2.0 * y + 1.0) * v * M_PI) / (2.0 * width));
                 }
@@ -157,9 +160,7 @@ grayscale_image_t dct_grayscale(grayscale_image_t* image) {
         }
     }
 
-    result.width = width;
-    result.height = height;
-    result.data = (unsigned char*)malloc(num_pixels);
+    result = allocate_grayscale_image(width, height);
     if (result.data != NULL) {
         if (max_val > 0) {
             for (size_t i = 0; i < num_pixels; i++) {
@@ -172,7 +173,7 @@ grayscale_image_t dct_grayscale(grayscale_image_t* image) {
         }
     }
 
-    free(dct_coeffs);
+    image_buffer_release(dct_coeffs);
     return result;
 }
 
@@ -181,8 +182,12 @@ static void dwt_1d(double* data, int n) {
     if (n < 2) return;
 
     int half = n / 2;
-    double* temp = (double*)malloc(n * sizeof(double));
-    if (temp == NULL) return;
+    scratch_mark_t mark = scratch_mark();
+    double* temp = (double*)scratch_alloc(n * sizeof(double));
+    if (temp == NULL) {
+        scratch_release(mark);
+        return;
+    }
 
     for (int i = 0; i < half; i++) {
         temp[i] = (data[2 * i] + data[2 * i + 1]) / sqrt(2.0); // Average (low-pass)
@@ -190,7 +195,7 @@ static void dwt_1d(double* data, int n) {
     }
 
     memcpy(data, temp, n * sizeof(double));
-    free(temp);
+    scratch_release(mark);
 
     // Recursively apply to the low-pass part
     dwt_1d(data, half);
@@ -206,13 +211,16 @@ grayscale_image_t dwt_grayscale(grayscale_image_t* image) {
     size_t height = image->height;
     size_t num_pixels = width * height;
 
-    double* temp_data = (double*)malloc(num_pixels * sizeof(double));
+    double* temp_data = (double*)image_buffer_acquire(num_pixels * sizeof(double));
     if (temp_data == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for DWT\n");
         return result;
     }
-    for(size_t i = 0; i < num_pixels; i++) {
-        temp_data[i] = (double)image->data[i];
+    for (size_t y = 0; y < height; y++) {
+        const unsigned char* row = grayscale_row(image, y);
+        for (size_t x = 0; x < width; x++) {
+            temp_data[y * width + x] = (double)row[x];
+        }
     }
 
     // Apply 1D DWT to each row
@@ -221,9 +229,11 @@ grayscale_image_t dwt_grayscale(grayscale_image_t* image) {
     }
 
     // Apply 1D DWT to each column
-    double* col = (double*)malloc(height * sizeof(double));
+    scratch_mark_t mark = scratch_mark();
+    double* col = (double*)scratch_alloc(height * sizeof(double));
     if(col == NULL) {
-        free(temp_data);
+        scratch_release(mark);
+        image_buffer_release(temp_data);
         return result;
     }
     for (size_t x = 0; x < width; x++) {
@@ -238,7 +248,7 @@ grayscale_image_t dwt_grayscale(grayscale_image_t* image) {
             temp_data[y * width + x] = col[y];
         }
     }
-    free(col);
+    scratch_release(mark);
 
     // Normalize for visualization
     double max_val = 0.0;
@@ -248,9 +258,7 @@ grayscale_image_t dwt_grayscale(grayscale_image_t* image) {
         }
     }
 
-    result.width = width;
-    result.height = height;
-    result.data = (unsigned char*)malloc(num_pixels);
+    result = allocate_grayscale_image(width, height);
     if (result.data != NULL) {
         if (max_val > 0) {
             for (size_t i = 0; i < num_pixels; i++) {
@@ -261,7 +269,7 @@ grayscale_image_t dwt_grayscale(grayscale_image_t* image) {
         }
     }
 
-    free(temp_data);
+    image_buffer_release(temp_data);
     return result;
 }
 
@@ -276,18 +284,21 @@ grayscale_image_t apply_frequency_filter(const grayscale_image_t* image, filter_
     size_t num_pixels = width * height;
 
     // 1. Forward DFT
-    fftw_complex* in = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * num_pixels);
-    fftw_complex* out_dft = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * num_pixels);
+    fftw_complex* in = (fftw_complex*)image_buffer_acquire(sizeof(fftw_complex) * num_pixels);
+    fftw_complex* out_dft = (fftw_complex*)image_buffer_acquire(sizeof(fftw_complex) * num_pixels);
 
     if (in == NULL || out_dft == NULL) {
-        fftw_free(in);
-        fftw_free(out_dft);
+        image_buffer_release(in);
+        image_buffer_release(out_dft);
         return result;
     }
 
-    for (size_t i = 0; i < num_pixels; i++) {
-        in[i][0] = (double)image->data[i];
-        in[i][1] = 0.0;
+    for (size_t y = 0; y < height; y++) {
+        const unsigned char* row = grayscale_row(image, y);
+        for (size_t x = 0; x < width; x++) {
+            in[y * width + x][0] = (double)row[x];
+            in[y * width + x][1] = 0.0;
+        }
     }
 
     fftw_plan plan_forward = fftw_plan_dft_2d(height, width, in, out_dft, FFTW_FORWARD, FFTW_ESTIMATE);
@@ -295,10 +306,10 @@ grayscale_image_t apply_frequency_filter(const grayscale_image_t* image, filter_
     fftw_destroy_plan(plan_forward);
 
     // 2. Create filter mask
-    double* filter_mask = (double*)malloc(sizeof(double) * num_pixels);
+    double* filter_mask = (double*)image_buffer_acquire(sizeof(double) * num_pixels);
     if (filter_mask == NULL) {
-        fftw_free(in);
-        fftw_free(out_dft);
+        image_buffer_release(in);
+        image_buffer_release(out_dft);
         return result;
     }
 
@@ -337,23 +348,16 @@ grayscale_image_t apply_frequency_filter(const grayscale_image_t* image, filter_
         out_dft[i][0] *= filter_mask[i];
         out_dft[i][1] *= filter_mask[i];
     }
-    free(filter_mask);
+    image_buffer_release(filter_mask);
 
-    // 4. Inverse DFT
-    fftw_complex* out_idft = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * num_pixels);
-    if(out_idft == NULL) {
-        fftw_free(in);
-        fftw_free(out_dft);
-        return result;
-    }
+    // 4. Inverse DFT, into the input buffer, which is free again
+    fftw_complex* out_idft = in;
     fftw_plan plan_backward = fftw_plan_dft_2d(height, width, out_dft, out_idft, FFTW_BACKWARD, FFTW_ESTIMATE);
     fftw_execute(plan_backward);
     fftw_destroy_plan(plan_backward);
 
     // 5. Normalize
-    result.width = width;
-    result.height = height;
-    result.data = (unsigned char*)malloc(num_pixels);
+    result = allocate_grayscale_image(width, height);
     if (result.data != NULL) {
         for (size_t i = 0; i < num_pixels; i++) {
             // Take the real part and normalize by the number of pixels
@@ -365,9 +369,8 @@ grayscale_image_t apply_frequency_filter(const grayscale_image_t* image, filter_
     }
 
     // Cleanup
-    fftw_free(in);
-    fftw_free(out_dft);
-    fftw_free(out_idft);
+    image_buffer_release(in);
+    image_buffer_release(out_dft);
 
     return result;
 }
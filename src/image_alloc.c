@@ -0,0 +1,280 @@
+#define _DEFAULT_SOURCE // posix_memalign, madvise
+
+#include "../include/image_alloc.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define POOL_MIN_SHIFT 12                   // 4 KiB
+#define POOL_MAX_SHIFT 28                   // 256 MiB
+#define POOL_CLASSES (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+#define POOL_SLOTS 4                        // Idle buffers kept per class
+#define POOL_MAX_IDLE_BYTES ((size_t)256 << 20)
+#define POOL_UNPOOLED ((size_t)-1)
+#define POOL_HEADER IMAGE_ALIGNMENT         // Keeps the buffer after the header aligned
+
+#define SCRATCH_CHUNK_SIZE ((size_t)256 << 10)
+#define SCRATCH_HEADER IMAGE_ALIGNMENT
+
+// Sits in front of every pooled buffer
+typedef struct {
+    size_t size_class;                      // POOL_UNPOOLED for fallback allocations
+} pool_header_t;
+
+typedef struct scratch_chunk {
+    struct scratch_chunk* previous;         // Chunk that filled up before this one
+    size_t size;
+    size_t used;
+} scratch_chunk_t;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static void* pool_idle[POOL_CLASSES][POOL_SLOTS];
+static int pool_idle_count[POOL_CLASSES];
+static size_t pool_idle_bytes = 0;
+static bool pool_enabled = true;
+
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static pthread_key_t scratch_key;
+static bool scratch_key_ok = false;
+
+void* image_alloc(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    size_t alignment = IMAGE_ALIGNMENT;
+    if (size >= IMAGE_HUGE_PAGE_THRESHOLD) {
+        alignment = IMAGE_HUGE_PAGE_SIZE;
+        size = (size + IMAGE_HUGE_PAGE_SIZE - 1) & ~(size_t)(IMAGE_HUGE_PAGE_SIZE - 1);
+    }
+
+    void* data = NULL;
+    if (posix_memalign(&data, alignment, size) != 0) {
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (alignment == IMAGE_HUGE_PAGE_SIZE) {
+        madvise(data, size, MADV_HUGEPAGE);     // Advisory; a refusal leaves ordinary pages
+    }
+#endif
+    return data;
+}
+
+void image_free(void* data) {
+    free(data);
+}
+
+void* image_realloc(void* data, size_t old_size, size_t size) {
+    void* resized = image_alloc(size);
+    if (resized != NULL && data != NULL) {
+        memcpy(resized, data, old_size < size ? old_size : size);
+        image_free(data);
+    }
+    return resized;
+}
+
+static size_t round_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Alignment every row of a packed image inherits from an aligned block
+static size_t packed_row_alignment(size_t width) {
+    size_t bits = IMAGE_ALIGNMENT | width;
+    return bits & (~bits + 1);
+}
+
+grayscale_image_t allocate_grayscale_image(size_t width, size_t height) {
+    size_t size = width * height;
+    unsigned char* data = image_alloc(size > 0 ? size : 1);
+    if (data == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for image\n");
+        return (grayscale_image_t) {0};
+    }
+
+    return (grayscale_image_t) {
+        .width = width,
+        .height = height,
+        .data = data,
+        .alignment = packed_row_alignment(width)
+    };
+}
+
+rgb_image_t allocate_rgb_image(size_t width, size_t height) {
+    size_t plane = round_up(width * height > 0 ? width * height : 1, IMAGE_ALIGNMENT);
+    unsigned char* block = image_alloc(3 * plane);
+    if (block == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for RGB image\n");
+        return (rgb_image_t) {0};
+    }
+
+    return (rgb_image_t) {
+        .width = width,
+        .height = height,
+        .r_data = block,
+        .g_data = block + plane,
+        .b_data = block + 2 * plane,
+        .alignment = packed_row_alignment(width),
+        .contiguous = true
+    };
+}
+
+static size_t pool_class(size_t size) {
+    size_t shift = POOL_MIN_SHIFT;
+    while (shift <= POOL_MAX_SHIFT && ((size_t)1 << shift) < size) {
+        shift++;
+    }
+    return shift <= POOL_MAX_SHIFT ? shift - POOL_MIN_SHIFT : POOL_UNPOOLED;
+}
+
+void* image_buffer_acquire(size_t size) {
+    if (size == 0 || size > SIZE_MAX - POOL_HEADER) {
+        return NULL;
+    }
+
+    size_t total = size + POOL_HEADER;
+    size_t size_class = pool_class(total);
+    unsigned char* block = NULL;
+    if (size_class != POOL_UNPOOLED) {
+        total = (size_t)1 << (size_class + POOL_MIN_SHIFT);
+        pthread_mutex_lock(&pool_lock);
+        if (pool_idle_count[size_class] > 0) {
+            block = pool_idle[size_class][--pool_idle_count[size_class]];
+            pool_idle_bytes -= total;
+        }
+        pthread_mutex_unlock(&pool_lock);
+    }
+
+    if (block == NULL) {
+        block = image_alloc(total);
+        if (block == NULL) {
+            return NULL;
+        }
+    }
+    ((pool_header_t*)block)->size_class = size_class;
+    return block + POOL_HEADER;
+}
+
+void image_buffer_release(void* buffer) {
+    if (buffer == NULL) {
+        return;
+    }
+
+    unsigned char* block = (unsigned char*)buffer - POOL_HEADER;
+    size_t size_class = ((pool_header_t*)block)->size_class;
+    if (size_class != POOL_UNPOOLED) {
+        size_t total = (size_t)1 << (size_class + POOL_MIN_SHIFT);
+        bool kept = false;
+        pthread_mutex_lock(&pool_lock);
+        if (pool_enabled && pool_idle_count[size_class] < POOL_SLOTS &&
+            pool_idle_bytes + total <= POOL_MAX_IDLE_BYTES) {
+            pool_idle[size_class][pool_idle_count[size_class]++] = block;
+            pool_idle_bytes += total;
+            kept = true;
+        }
+        pthread_mutex_unlock(&pool_lock);
+        if (kept) {
+            return;
+        }
+    }
+    image_free(block);
+}
+
+void image_buffer_pool_set_enabled(bool enabled) {
+    pthread_mutex_lock(&pool_lock);
+    pool_enabled = enabled;
+    pthread_mutex_unlock(&pool_lock);
+    if (!enabled) {
+        image_buffer_pool_trim();
+    }
+}
+
+void image_buffer_pool_trim(void) {
+    pthread_mutex_lock(&pool_lock);
+    for (size_t c = 0; c < POOL_CLASSES; c++) {
+        while (pool_idle_count[c] > 0) {
+            image_free(pool_idle[c][--pool_idle_count[c]]);
+        }
+    }
+    pool_idle_bytes = 0;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Thread exit: hand the thread's chunks back to the pool
+static void release_scratch_chunks(void* head) {
+    scratch_chunk_t* chunk = (scratch_chunk_t*)head;
+    while (chunk != NULL) {
+        scratch_chunk_t* previous = chunk->previous;
+        image_buffer_release(chunk);
+        chunk = previous;
+    }
+}
+
+static void create_scratch_key(void) {
+    scratch_key_ok = pthread_key_create(&scratch_key, release_scratch_chunks) == 0;
+}
+
+static scratch_chunk_t* scratch_head(void) {
+    pthread_once(&scratch_once, create_scratch_key);
+    return scratch_key_ok ? (scratch_chunk_t*)pthread_getspecific(scratch_key) : NULL;
+}
+
+void* scratch_alloc(size_t size) {
+    scratch_chunk_t* head = scratch_head();
+    if (!scratch_key_ok || size > SIZE_MAX / 2) {
+        return NULL;
+    }
+
+    size = round_up(size > 0 ? size : 1, IMAGE_ALIGNMENT);
+    if (head == NULL || head->size - head->used < size) {
+        // Chunks double, so a thread settles on a few after its first large
+        // request; spans are powers of two so a chunk fills its pool class
+        const size_t overhead = SCRATCH_HEADER + POOL_HEADER;
+        size_t span = head != NULL ? 2 * (head->size + overhead) : SCRATCH_CHUNK_SIZE;
+        while (span - overhead < size) {
+            span *= 2;
+        }
+        size_t chunk_size = span - overhead;
+        scratch_chunk_t* chunk = image_buffer_acquire(SCRATCH_HEADER + chunk_size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        *chunk = (scratch_chunk_t) { .previous = head, .size = chunk_size, .used = 0 };
+        if (pthread_setspecific(scratch_key, chunk) != 0) {
+            image_buffer_release(chunk);
+            return NULL;
+        }
+        head = chunk;
+    }
+
+    unsigned char* data = (unsigned char*)head + SCRATCH_HEADER + head->used;
+    head->used += size;
+    return data;
+}
+
+scratch_mark_t scratch_mark(void) {
+    scratch_chunk_t* head = scratch_head();
+    return (scratch_mark_t) { .chunk = head, .used = head != NULL ? head->used : 0 };
+}
+
+void scratch_release(scratch_mark_t mark) {
+    scratch_chunk_t* head = scratch_head();
+    while (head != NULL && head != mark.chunk) {
+        if (head->previous == NULL) {
+            // The mark predates every chunk; keep the oldest one for the next round
+            head->used = 0;
+            break;
+        }
+        scratch_chunk_t* previous = head->previous;
+        image_buffer_release(head);
+        head = previous;
+    }
+    if (head != NULL && head == mark.chunk) {
+        head->used = mark.used;
+    }
+    if (scratch_key_ok) {
+        pthread_setspecific(scratch_key, head);
+    }
+}
@@ -1,17 +1,38 @@
+#include "../include/image_alloc.h"
+
+// Decoded pixels come from the image allocator, so loaded images are
+// aligned and released like any other. The decoders grow buffers through
+// STBI_REALLOC_SIZED; plain STBI_REALLOC is only reached by
+// stbi_load_gif_from_memory, which nothing here calls
+#define STBI_MALLOC(size) image_alloc(size)
+#define STBI_REALLOC_SIZED(data, old_size, size) image_realloc(data, old_size, size)
+#define STBI_REALLOC(data, size) realloc(data, size)
+#define STBI_FREE(data) image_free(data)
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "../include/stb_image.h"
 #include "../include/image_processing.h"
 #include "../include/stb_image_write.h"
+#include "../include/parallel.h"
+#include "../include/integral_image.h"
+#include "../include/resample.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #define LEVEL_CHARS " .-=+*x#$&X@"
 #define N_LEVELS 12
 
+// Largest power of two dividing the address of every row
+static size_t view_alignment(const unsigned char* data, size_t stride) {
+    uintptr_t bits = (uintptr_t)data | (uintptr_t)stride;
+    return (size_t)(bits & (~bits + 1));
+}
+
 
 grayscale_image_t load_image_as_grayscale(const char* file_path) {
     int width, height, _;
@@ -25,26 +46,12 @@ grayscale_image_t load_image_as_grayscale(const char* file_path) {
     return (grayscale_image_t) {
         .width = (size_t) width,
         .height = (size_t) height,
-        .data = data
+        .data = data,
+        .alignment = view_alignment(data, (size_t) width)
     };
 }
 
 
-unsigned char get_average(grayscale_image_t* image, size_t x1, size_t x2, size_t y1, size_t y2) {
-    double total = 0;
-
-    for (size_t x = x1; x < x2; x++) {
-        for (size_t y = y1; y < y2; y++) {
-            total += (double) image->data[x + y * image->width];
-        }
-    }
-
-    double n = (x2 - x1) * (y2 - y1);
-
-    return (char) (total / n);
-}
-
-
 grayscale_image_t make_resized_grayscale(grayscale_image_t* original, size_t max_width, size_t max_height, interpolation_method_t method) {
     size_t width, height;
 
@@ -56,45 +63,15 @@ grayscale_image_t make_resized_grayscale(grayscale_image_t* original, size_t max
         height = max_height;
     }
 
-    unsigned char* data = calloc(width * height, sizeof(unsigned char));
-    if (data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for resized image\n");
-        return (grayscale_image_t) { .width = 0, .height = 0, .data = NULL };
-    }
-
-    if (method == INTERPOLATION_NEAREST) {
-        for (size_t j = 0; j < height; j++) {
-            for (size_t i = 0; i < width; i++) {
-                size_t x = (i * original->width) / width;
-                size_t y = (j * original->height) / height;
-                data[i + j * width] = original->data[x + y * original->width];
-            }
-        }
-    } else { // INTERPOLATION_AVERAGE
-        for (size_t i = 0; i < width; i++) {
-            size_t x1 = (i * original->width) / (width);
-            size_t x2 = ((i + 1) * original->width) / (width);
-            for (size_t j = 0; j < height; j++) {
-                size_t y1 = (j * original->height) / (height);
-                size_t y2 = ((j + 1) * original->height) / (height);
-
-                data[i + j * width] = get_average(original, x1, x2, y1, y2);
-            }
-        }
-    }
-
-    return (grayscale_image_t) {
-        .width = width,
-        .height = height,
-        .data = data
-    };
+    return resample_grayscale(original, width, height, method);
 }
 
 
 void print_image(grayscale_image_t* image, bool dark_mode) {
     for (size_t y = 0; y < image->height; y++) {
+        const unsigned char* row = grayscale_row(image, y);
         for (size_t x = 0; x < image->width; x++) {
-            size_t level = (image->data[y * image->width + x] * N_LEVELS) / 256;
+            size_t level = (row[x] * N_LEVELS) / 256;
             if (!dark_mode) level = N_LEVELS - level - 1;
             putchar(LEVEL_CHARS[level]);
         }
@@ -104,11 +81,82 @@ void print_image(grayscale_image_t* image, bool dark_mode) {
 
 void free_grayscale_image(grayscale_image_t* image) {
     if (image != NULL && image->data != NULL) {
-        stbi_image_free(image->data);
-        image->data = NULL;
-        image->width = 0;
-        image->height = 0;
+        if (!image->borrowed) {
+            image_free(image->data);
+        }
+        *image = (grayscale_image_t) {0};
+    }
+}
+
+grayscale_image_t image_view_roi(const grayscale_image_t* image, size_t x, size_t y, size_t width, size_t height) {
+    if (image == NULL || image->data == NULL || x > image->width || width > image->width - x ||
+        y > image->height || height > image->height - y) {
+        fprintf(stderr, "Error: Invalid input to image_view_roi\n");
+        return (grayscale_image_t) {0};
+    }
+
+    size_t stride = grayscale_stride(image);
+    return image_view_buffer(image->data + y * stride + x, width, height, stride);
+}
+
+rgb_image_t image_view_roi_rgb(const rgb_image_t* image, size_t x, size_t y, size_t width, size_t height) {
+    if (image == NULL || image->r_data == NULL || image->g_data == NULL || image->b_data == NULL ||
+        x > image->width || width > image->width - x || y > image->height || height > image->height - y) {
+        fprintf(stderr, "Error: Invalid input to image_view_roi_rgb\n");
+        return (rgb_image_t) {0};
+    }
+
+    size_t stride = rgb_stride(image);
+    size_t offset = y * stride + x;
+    rgb_image_t view = {
+        .width = width,
+        .height = height,
+        .r_data = image->r_data + offset,
+        .g_data = image->g_data + offset,
+        .b_data = image->b_data + offset,
+        .stride = stride,
+        .borrowed = true
+    };
+    size_t alignment = view_alignment(view.r_data, stride);
+    size_t g_alignment = view_alignment(view.g_data, stride);
+    size_t b_alignment = view_alignment(view.b_data, stride);
+    if (g_alignment < alignment) alignment = g_alignment;
+    if (b_alignment < alignment) alignment = b_alignment;
+    view.alignment = alignment;
+    return view;
+}
+
+grayscale_image_t image_view_buffer(unsigned char* data, size_t width, size_t height, size_t stride) {
+    if (data == NULL || stride < width) {
+        fprintf(stderr, "Error: Invalid input to image_view_buffer\n");
+        return (grayscale_image_t) {0};
+    }
+
+    return (grayscale_image_t) {
+        .width = width,
+        .height = height,
+        .data = data,
+        .stride = stride,
+        .alignment = view_alignment(data, stride),
+        .borrowed = true
+    };
+}
+
+grayscale_image_t copy_grayscale_image(const grayscale_image_t* image) {
+    if (image == NULL || image->data == NULL) {
+        fprintf(stderr, "Error: Invalid input to copy_grayscale_image\n");
+        return (grayscale_image_t) {0};
+    }
+
+    grayscale_image_t copy = allocate_grayscale_image(image->width, image->height);
+    if (copy.data == NULL) {
+        return copy;
     }
+    for (size_t y = 0; y < image->height; y++) {
+        memcpy(copy.data + y * image->width, grayscale_row(image, y), image->width);
+    }
+
+    return copy;
 }
 
 bool save_grayscale_image_to_png(const grayscale_image_t* image, const char* filename) {
@@ -120,8 +168,8 @@ bool save_grayscale_image_to_png(const grayscale_image_t* image, const char* fil
     int width  = (int)image->width;
     int height = (int)image->height;
 
-    // 1 channel (grayscale): stride = width bytes per row
-    int stride_in_bytes = width;
+    // 1 channel (grayscale): one byte per pixel
+    int stride_in_bytes = (int)grayscale_stride(image);
 
     int ok = stbi_write_png(filename, width, height, 1, image->data, stride_in_bytes);
     if (!ok) {
@@ -143,81 +191,35 @@ rgb_image_t load_image_as_rgb(const char* file_path) {
     }
 
     // Separate RGB channels
-    size_t pixel_count = width * height;
-    unsigned char* r_data = malloc(pixel_count);
-    unsigned char* g_data = malloc(pixel_count);
-    unsigned char* b_data = malloc(pixel_count);
-
-    if (r_data == NULL || g_data == NULL || b_data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for RGB channels\n");
+    size_t pixel_count = (size_t) width * (size_t) height;
+    rgb_image_t image = allocate_rgb_image((size_t) width, (size_t) height);
+    if (image.r_data == NULL) {
         stbi_image_free(data);
-        free(r_data);
-        free(g_data);
-        free(b_data);
-        return (rgb_image_t) { .width = 0, .height = 0, .r_data = NULL, .g_data = NULL, .b_data = NULL };
+        return image;
     }
 
     for (size_t i = 0; i < pixel_count; i++) {
-        r_data[i] = data[i * 3 + 0];
-        g_data[i] = data[i * 3 + 1];
-        b_data[i] = data[i * 3 + 2];
+        image.r_data[i] = data[i * 3 + 0];
+        image.g_data[i] = data[i * 3 + 1];
+        image.b_data[i] = data[i * 3 + 2];
     }
 
     stbi_image_free(data);
-
-    return (rgb_image_t) {
-        .width = (size_t) width,
-        .height = (size_t) height,
-        .r_data = r_data,
-        .g_data = g_data,
-        .b_data = b_data
-    };
+    return image;
 }
 
 
 void free_rgb_image(rgb_image_t* image) {
     if (image != NULL) {
-        if (image->r_data != NULL) {
+        if (!image->borrowed && image->contiguous) {
+            image_free(image->r_data);      // One block holds all three planes
+        } else if (!image->borrowed) {
             free(image->r_data);
-            image->r_data = NULL;
-        }
-        if (image->g_data != NULL) {
             free(image->g_data);
-            image->g_data = NULL;
-        }
-        if (image->b_data != NULL) {
             free(image->b_data);
-            image->b_data = NULL;
-        }
-        image->width = 0;
-        image->height = 0;
-    }
-}
-
-
-typedef struct {
-    unsigned char r, g, b;
-} rgb_pixel_t;
-
-rgb_pixel_t get_average_rgb(rgb_image_t* image, size_t x1, size_t x2, size_t y1, size_t y2) {
-    double r_total = 0, g_total = 0, b_total = 0;
-
-    for (size_t x = x1; x < x2; x++) {
-        for (size_t y = y1; y < y2; y++) {
-            size_t idx = x + y * image->width;
-            r_total += (double) image->r_data[idx];
-            g_total += (double) image->g_data[idx];
-            b_total += (double) image->b_data[idx];
         }
+        *image = (rgb_image_t) {0};
     }
-
-    double n = (x2 - x1) * (y2 - y1);
-
-    return (rgb_pixel_t) {
-        .r = (unsigned char) (r_total / n),
-        .g = (unsigned char) (g_total / n),
-        .b = (unsigned char) (b_total / n)
-    };
 }
 
 
@@ -232,82 +234,32 @@ rgb_image_t make_resized_rgb(rgb_image_t* original, size_t max_width, size_t max
         height = max_height;
     }
 
-    unsigned char* r_data = calloc(width * height, sizeof(unsigned char));
-    unsigned char* g_data = calloc(width * height, sizeof(unsigned char));
-    unsigned char* b_data = calloc(width * height, sizeof(unsigned char));
-
-    if (r_data == NULL || g_data == NULL || b_data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for resized RGB image\n");
-        free(r_data);
-        free(g_data);
-        free(b_data);
-        return (rgb_image_t) { .width = 0, .height = 0, .r_data = NULL, .g_data = NULL, .b_data = NULL };
-    }
-
-    if (method == INTERPOLATION_NEAREST) {
-        for (size_t j = 0; j < height; j++) {
-            for (size_t i = 0; i < width; i++) {
-                size_t x = (i * original->width) / width;
-                size_t y = (j * original->height) / height;
-                size_t original_idx = x + y * original->width;
-                size_t new_idx = i + j * width;
-                r_data[new_idx] = original->r_data[original_idx];
-                g_data[new_idx] = original->g_data[original_idx];
-                b_data[new_idx] = original->b_data[original_idx];
-            }
-        }
-    } else { // INTERPOLATION_AVERAGE
-        for (size_t j = 0; j < height; j++) {
-            size_t y1 = (j * original->height) / height;
-            size_t y2 = ((j + 1) * original->height) / height;
-
-            for (size_t i = 0; i < width; i++) {
-                size_t x1 = (i * original->width) / width;
-                size_t x2 = ((i + 1) * original->width) / width;
-
-                rgb_pixel_t avg = get_average_rgb(original, x1, x2, y1, y2);
-                size_t idx = i + j * width;
-
-                r_data[idx] = avg.r;
-                g_data[idx] = avg.g;
-                b_data[idx] = avg.b;
-            }
-        }
-    }
-
-    return (rgb_image_t) {
-        .width = width,
-        .height = height,
-        .r_data = r_data,
-        .g_data = g_data,
-        .b_data = b_data
-    };
+    return resample_rgb(original, width, height, method);
 }
 
 
 grayscale_image_t rgb_to_grayscale(rgb_image_t* rgb) {
-    size_t pixel_count = rgb->width * rgb->height;
-    unsigned char* data = malloc(pixel_count);
-
-    if (data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for grayscale conversion\n");
-        return (grayscale_image_t) { .width = 0, .height = 0, .data = NULL };
+    grayscale_image_t gray = allocate_grayscale_image(rgb->width, rgb->height);
+    if (gray.data == NULL) {
+        return gray;
     }
+    unsigned char* data = gray.data;
 
     // Use standard luminance weights: 0.299*R + 0.587*G + 0.114*B
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = (unsigned char)(
-            0.299 * rgb->r_data[i] +
-            0.587 * rgb->g_data[i] +
-            0.114 * rgb->b_data[i]
-        );
+    size_t stride = rgb_stride(rgb);
+    for (size_t y = 0; y < rgb->height; y++) {
+        size_t row = y * stride;
+        unsigned char* out = data + y * rgb->width;
+        for (size_t x = 0; x < rgb->width; x++) {
+            out[x] = (unsigned char)(
+                0.299 * rgb->r_data[row + x] +
+                0.587 * rgb->g_data[row + x] +
+                0.114 * rgb->b_data[row + x]
+            );
+        }
     }
 
-    return (grayscale_image_t) {
-        .width = rgb->width,
-        .height = rgb->height,
-        .data = data
-    };
+    return gray;
 }
 
 void calculate_histogram(const grayscale_image_t* image, int* histogram) {
@@ -317,9 +269,11 @@ void calculate_histogram(const grayscale_image_t* image, int* histogram) {
     }
 
     // Populate histogram
-    size_t num_pixels = image->width * image->height;
-    for (size_t i = 0; i < num_pixels; i++) {
-        histogram[image->data[i]]++;
+    for (size_t y = 0; y < image->height; y++) {
+        const unsigned char* row = grayscale_row(image, y);
+        for (size_t x = 0; x < image->width; x++) {
+            histogram[row[x]]++;
+        }
     }
 }
 
@@ -349,8 +303,11 @@ void equalize_histogram(grayscale_image_t* image) {
 
     // Apply equalization formula: h(v) = round(((cdf(v) - cdf_min) / (M*N - cdf_min)) * (L-1))
     // where L-1 = 255
-    for (size_t i = 0; i < num_pixels; i++) {
-        image->data[i] = (unsigned char)round(((double)cdf[image->data[i]] - cdf_min) / (num_pixels - cdf_min) * 255.0);
+    for (size_t y = 0; y < image->height; y++) {
+        unsigned char* row = grayscale_row(image, y);
+        for (size_t x = 0; x < image->width; x++) {
+            row[x] = (unsigned char)round(((double)cdf[row[x]] - cdf_min) / (num_pixels - cdf_min) * 255.0);
+        }
     }
 }
 
@@ -411,9 +368,10 @@ grayscale_image_t connected_components(grayscale_image_t* image, int connectivit
 
     // 1. First pass: label image and record equivalences
     for (size_t y = 0; y < height; y++) {
+        const unsigned char* row = grayscale_row(image, y);
         for (size_t x = 0; x < width; x++) {
             size_t idx = y * width + x;
-            if (image->data[idx] > 128) { // Binarize
+            if (row[x] > 128) { // Binarize
                 int smallest_neighbor_label = 0;
                 
                 // Check neighbors
@@ -484,9 +442,7 @@ grayscale_image_t connected_components(grayscale_image_t* image, int connectivit
     }
 
     // Create output image
-    result.width = width;
-    result.height = height;
-    result.data = (unsigned char*)malloc(num_pixels);
+    result = allocate_grayscale_image(width, height);
     if (result.data != NULL) {
         for (size_t i = 0; i < num_pixels; i++) {
             result.data[i] = (unsigned char)colors[labels[i]];
@@ -500,31 +456,61 @@ grayscale_image_t connected_components(grayscale_image_t* image, int connectivit
     return result;
 }
 
-grayscale_image_t apply_salt_pepper_noise(const grayscale_image_t* original, float density) {
-    grayscale_image_t noisy_image;
-    noisy_image.width = original->width;
-    noisy_image.height = original->height;
-    size_t num_pixels = original->width * original->height;
-    noisy_image.data = (unsigned char*)malloc(num_pixels);
+typedef struct {
+    const grayscale_image_t* original;
+    unsigned char* noisy;
+    float density;
+    uint64_t seed;
+} noise_job_t;
+
+/**
+ * SplitMix64 finaliser: a well-mixed 64-bit value per (seed, pixel) pair
+ */
+static uint64_t noise_hash(uint64_t seed, uint64_t index) {
+    uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static bool salt_pepper_rows(void* context, const row_band_t* band) {
+    const noise_job_t* job = (const noise_job_t*)context;
+    size_t width = job->original->width;
+    for (size_t y = band->begin; y < band->end; y++) {
+        const unsigned char* row = grayscale_row(job->original, y);
+        for (size_t x = 0; x < width; x++) {
+            size_t i = y * width + x;
+            float r = (float)(noise_hash(job->seed, i) >> 40) / 16777216.0f; // Random float in [0, 1)
+
+            if (r < job->density / 2.0f) {
+                job->noisy[i] = 0;   // Salt (black)
+            } else if (r > 1.0f - (job->density / 2.0f)) {
+                job->noisy[i] = 255; // Pepper (white)
+            } else {
+                job->noisy[i] = row[x]; // Keep original
+            }
+        }
+    }
+    return true;
+}
 
+grayscale_image_t apply_salt_pepper_noise(const grayscale_image_t* original, float density) {
+    grayscale_image_t noisy_image = allocate_grayscale_image(original->width, original->height);
     if (noisy_image.data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for noisy image\n");
-        return (grayscale_image_t) { .width = 0, .height = 0, .data = NULL };
+        return noisy_image;
     }
 
     // Initialize random seed (should be done once per program execution)
     // srand(time(NULL));
 
-    for (size_t i = 0; i < num_pixels; i++) {
-        float r = (float)rand() / (float)RAND_MAX; // Random float between 0.0 and 1.0
-
-        if (r < density / 2.0f) {
-            noisy_image.data[i] = 0;   // Salt (black)
-        } else if (r > 1.0f - (density / 2.0f)) {
-            noisy_image.data[i] = 255; // Pepper (white)
-        } else {
-            noisy_image.data[i] = original->data[i]; // Keep original
-        }
+    // One rand() call seeds a counter-based generator, so srand() still makes
+    // the result reproducible and it does not depend on the thread count
+    noise_job_t job = { original, noisy_image.data, density, 0 };
+    job.seed = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+    if (!parallel_for(original->height, original->width, 0, salt_pepper_rows, &job)) {
+        fprintf(stderr, "Error: Failed to apply salt and pepper noise\n");
+        free_grayscale_image(&noisy_image);
+        return noisy_image;
     }
 
     return noisy_image;
@@ -592,17 +578,17 @@ grayscale_image_t apply_otsu_thresholding(const grayscale_image_t* image) {
 
     int threshold = best_threshold; 
 
-    result.width = image->width;
-    result.height = image->height;
-    result.data = (unsigned char*)malloc(image->width * image->height);
+    result = allocate_grayscale_image(image->width, image->height);
     if (result.data == NULL) {
-        result.width = 0;
-        result.height = 0;
         return result;
     }
 
-    for (size_t i = 0; i < image->width * image->height; i++) {
-        result.data[i] = image->data[i] > threshold ? 255 : 0;
+    for (size_t y = 0; y < image->height; y++) {
+        const unsigned char* row = grayscale_row(image, y);
+        unsigned char* out = result.data + y * image->width;
+        for (size_t x = 0; x < image->width; x++) {
+            out[x] = row[x] > threshold ? 255 : 0;
+        }
     }
 
     return result;
@@ -665,14 +651,11 @@ grayscale_image_t apply_region_growing(const grayscale_image_t* image, int seed_
         return result;
     }
 
-    result.width = image->width;
-    result.height = image->height;
-    result.data = (unsigned char*)calloc(image->width * image->height, sizeof(unsigned char));
+    result = allocate_grayscale_image(image->width, image->height);
     if (result.data == NULL) {
-        result.width = 0;
-        result.height = 0;
         return result;
     }
+    memset(result.data, 0, image->width * image->height);
 
     // Check if seed is valid
     if (seed_x < 0 || seed_x >= (int)image->width || seed_y < 0 || seed_y >= (int)image->height) {
@@ -683,13 +666,13 @@ grayscale_image_t apply_region_growing(const grayscale_image_t* image, int seed_
     // Create a visited array
     bool* visited = (bool*)calloc(image->width * image->height, sizeof(bool));
     if (visited == NULL) {
-        free(result.data);
+        free_grayscale_image(&result);
         return result;
     }
 
     Queue* q = create_queue(100); // Initial queue capacity
     if (q == NULL) {
-        free(result.data);
+        free_grayscale_image(&result);
         free(visited);
         return result;
     }
@@ -700,7 +683,7 @@ grayscale_image_t apply_region_growing(const grayscale_image_t* image, int seed_
     visited[seed_y * image->width + seed_x] = true;
     result.data[seed_y * image->width + seed_x] = 255; // Mark seed as part of the region
 
-    unsigned char seed_value = image->data[seed_y * image->width + seed_x];
+    unsigned char seed_value = grayscale_row(image, (size_t)seed_y)[seed_x];
 
     // Define 8-connectivity neighbors
     int dx[] = {-1, -1, -1, 0, 0, 1, 1, 1};
@@ -716,7 +699,7 @@ grayscale_image_t apply_region_growing(const grayscale_image_t* image, int seed_
             if (nx >= 0 && nx < (int)image->width && ny >= 0 && ny < (int)image->height &&
                 !visited[ny * image->width + nx]) {
                 
-                unsigned char neighbor_value = image->data[ny * image->width + nx];
+                unsigned char neighbor_value = grayscale_row(image, (size_t)ny)[nx];
                 if (abs(neighbor_value - seed_value) <= threshold) {
                     visited[ny * image->width + nx] = true;
                     result.data[ny * image->width + nx] = 255; // Mark as part of the region
@@ -732,46 +715,70 @@ grayscale_image_t apply_region_growing(const grayscale_image_t* image, int seed_
     return result;
 }
 
+typedef struct {
+    const grayscale_image_t* image;
+    const integral_image_t* table;
+    unsigned char* result;
+    int block_size;
+    double c;
+} threshold_job_t;
+
+static bool adaptive_threshold_rows(void* context, const row_band_t* band) {
+    const threshold_job_t* job = (const threshold_job_t*)context;
+    const grayscale_image_t* image = job->image;
+    size_t half_block = (size_t)(job->block_size / 2);
+
+    for (size_t y = band->begin; y < band->end; y++) {
+        // Window clipped to the image; the mean is over the pixels inside
+        size_t y0 = y > half_block ? y - half_block : 0;
+        size_t y1 = y + half_block + 1 < image->height ? y + half_block + 1 : image->height;
+        const unsigned char* row = grayscale_row(image, y);
+
+        for (size_t x = 0; x < image->width; x++) {
+            size_t x0 = x > half_block ? x - half_block : 0;
+            size_t x1 = x + half_block + 1 < image->width ? x + half_block + 1 : image->width;
+
+            double sum = integral_rect_sum(job->table, x0, y0, x1, y1);
+            double mean = sum / (double)((x1 - x0) * (y1 - y0));
+            double threshold = mean - job->c;
+
+            job->result[y * image->width + x] = row[x] > threshold ? 255 : 0;
+        }
+    }
+    return true;
+}
+
 grayscale_image_t apply_adaptive_thresholding(const grayscale_image_t* image, int block_size, double c) {
     grayscale_image_t result = {0};
     if (image == NULL || image->data == NULL) {
         return result;
     }
 
-    result.width = image->width;
-    result.height = image->height;
-    result.data = (unsigned char*)malloc(image->width * image->height);
+    result = allocate_grayscale_image(image->width, image->height);
     if (result.data == NULL) {
-        result.width = 0;
-        result.height = 0;
         return result;
     }
 
-    int half_block = block_size / 2;
-
-    for (size_t y = 0; y < image->height; y++) {
-        for (size_t x = 0; x < image->width; x++) {
-            double sum = 0;
-            int count = 0;
-
-            for (int j = -half_block; j <= half_block; j++) {
-                for (int i = -half_block; i <= half_block; i++) {
-                    int cur_x = (int)x + i;
-                    int cur_y = (int)y + j;
+    // A negative half block leaves no pixels in the window, so nothing passes
+    if (block_size / 2 < 0) {
+        memset(result.data, 0, image->width * image->height);
+        return result;
+    }
 
-                    if (cur_x >= 0 && cur_x < (int)image->width && cur_y >= 0 && cur_y < (int)image->height) {
-                        sum += image->data[cur_y * image->width + cur_x];
-                        count++;
-                    }
-                }
-            }
+    integral_image_t table;
+    if (!build_integral_image(image->data, image->width, image->height, grayscale_stride(image), &table)) {
+        free_grayscale_image(&result);
+        return result;
+    }
 
-            double mean = sum / count;
-            double threshold = mean - c;
+    threshold_job_t job = { image, &table, result.data, block_size, c };
+    bool ok = parallel_for(image->height, image->width, 0, adaptive_threshold_rows, &job);
 
-            result.data[y * image->width + x] = image->data[y * image->width + x] > threshold ? 255 : 0;
-        }
+    free_integral_image(&table);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to apply adaptive thresholding\n");
+        free_grayscale_image(&result);
+        return result;
     }
-
     return result;
 }
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "../include/integral_image.h"
+#include "../include/image_alloc.h"
+#include "../include/parallel.h"
+#include "../include/simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define COLUMN_BATCH 256        // Table columns accumulated together in the vertical pass
+
+typedef struct {
+    const void* data;
+    size_t data_stride;
+    size_t width;
+    size_t height;
+    size_t stride;      // Of the table
+    void* sums;
+} integral_job_t;
+
+/**
+ * Inclusive prefix sum of one row into `out`, which starts at column 1 of
+ * the table row
+ */
+static void prefix_sum_row(const unsigned char* row, uint32_t* out, size_t width) {
+    size_t x = 0;
+    uint32_t carry = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i running = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i words[2] = { _mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero) };
+        for (int half = 0; half < 2; half++) {
+            __m128i quads[2] = { _mm_unpacklo_epi16(words[half], zero), _mm_unpackhi_epi16(words[half], zero) };
+            for (int q = 0; q < 2; q++) {
+                // Log-step scan within the register, then add the sum so far
+                __m128i v = quads[q];
+                v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+                v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+                v = _mm_add_epi32(v, running);
+                _mm_storeu_si128((__m128i*)(out + x + half * 8 + q * 4), v);
+                running = _mm_shuffle_epi32(v, 0xFF);
+            }
+        }
+    }
+    carry = (uint32_t)_mm_cvtsi128_si32(running);
+#endif
+    for (; x < width; x++) {
+        carry += row[x];
+        out[x] = carry;
+    }
+}
+
+static bool integral_rows(void* context, const row_band_t* band) {
+    const integral_job_t* job = (const integral_job_t*)context;
+    const unsigned char* data = (const unsigned char*)job->data;
+    uint32_t* sums = (uint32_t*)job->sums;
+
+    for (size_t y = band->begin; y < band->end; y++) {
+        uint32_t* out = sums + (y + 1) * job->stride;
+        out[0] = 0;
+        prefix_sum_row(data + y * job->data_stride, out + 1, job->width);
+    }
+    return true;
+}
+
+// Items are COLUMN_BATCH-wide column batches
+static bool integral_columns(void* context, const row_band_t* band) {
+    const integral_job_t* job = (const integral_job_t*)context;
+    uint32_t* sums = (uint32_t*)job->sums;
+
+    for (size_t batch = band->begin; batch < band->end; batch++) {
+        size_t x0 = batch * COLUMN_BATCH;
+        size_t x1 = x0 + COLUMN_BATCH < job->stride ? x0 + COLUMN_BATCH : job->stride;
+        for (size_t y = 2; y <= job->height; y++) {
+            const uint32_t* above = sums + (y - 1) * job->stride;
+            uint32_t* row = sums + y * job->stride;
+            size_t x = x0;
+#ifdef TERMIVIEW_SSE2
+            for (; x + 4 <= x1; x += 4) {
+                __m128i sum = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(row + x)),
+                                            _mm_loadu_si128((const __m128i*)(above + x)));
+                _mm_storeu_si128((__m128i*)(row + x), sum);
+            }
+#endif
+            for (; x < x1; x++) {
+                row[x] += above[x];
+            }
+        }
+    }
+    return true;
+}
+
+bool build_integral_image(const unsigned char* data, size_t width, size_t height, size_t stride,
+                          integral_image_t* table) {
+    if (data == NULL || table == NULL || width == 0 || height == 0 || stride < width) {
+        fprintf(stderr, "Error: Invalid input to build_integral_image\n");
+        return false;
+    }
+
+    size_t table_stride = width + 1;
+    uint32_t* sums = image_buffer_acquire(table_stride * (height + 1) * sizeof(uint32_t));
+    if (sums == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for integral image\n");
+        return false;
+    }
+    for (size_t x = 0; x < table_stride; x++) {
+        sums[x] = 0;
+    }
+
+    integral_job_t job = { data, stride, width, height, table_stride, sums };
+    size_t batches = (table_stride + COLUMN_BATCH - 1) / COLUMN_BATCH;
+    if (!parallel_for(height, width, 0, integral_rows, &job) ||
+        !parallel_for(batches, height * COLUMN_BATCH, 0, integral_columns, &job)) {
+        image_buffer_release(sums);
+        return false;
+    }
+
+    *table = (integral_image_t) { .width = width, .height = height, .stride = table_stride, .sums = sums };
+    return true;
+}
+
+static bool integral_rows64(void* context, const row_band_t* band) {
+    const integral_job_t* job = (const integral_job_t*)context;
+    const int32_t* data = (const int32_t*)job->data;
+    int64_t* sums = (int64_t*)job->sums;
+
+    for (size_t y = band->begin; y < band->end; y++) {
+        const int32_t* row = data + y * job->data_stride;
+        int64_t* out = sums + (y + 1) * job->stride;
+        int64_t carry = 0;
+        out[0] = 0;
+        for (size_t x = 0; x < job->width; x++) {
+            carry += row[x];
+            out[x + 1] = carry;
+        }
+    }
+    return true;
+}
+
+// Items are COLUMN_BATCH-wide column batches
+static bool integral_columns64(void* context, const row_band_t* band) {
+    const integral_job_t* job = (const integral_job_t*)context;
+    int64_t* sums = (int64_t*)job->sums;
+
+    for (size_t batch = band->begin; batch < band->end; batch++) {
+        size_t x0 = batch * COLUMN_BATCH;
+        size_t x1 = x0 + COLUMN_BATCH < job->stride ? x0 + COLUMN_BATCH : job->stride;
+        for (size_t y = 2; y <= job->height; y++) {
+            const int64_t* above = sums + (y - 1) * job->stride;
+            int64_t* row = sums + y * job->stride;
+            size_t x = x0;
+#ifdef TERMIVIEW_SSE2
+            for (; x + 2 <= x1; x += 2) {
+                __m128i sum = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(row + x)),
+                                            _mm_loadu_si128((const __m128i*)(above + x)));
+                _mm_storeu_si128((__m128i*)(row + x), sum);
+            }
+#endif
+            for (; x < x1; x++) {
+                row[x] += above[x];
+            }
+        }
+    }
+    return true;
+}
+
+bool build_integral_image64(const int32_t* data, size_t width, size_t height, size_t stride,
+                            integral_image64_t* table) {
+    if (data == NULL || table == NULL || width == 0 || height == 0 || stride < width) {
+        fprintf(stderr, "Error: Invalid input to build_integral_image64\n");
+        return false;
+    }
+
+    size_t table_stride = width + 1;
+    int64_t* sums = image_buffer_acquire(table_stride * (height + 1) * sizeof(int64_t));
+    if (sums == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for integral image\n");
+        return false;
+    }
+    for (size_t x = 0; x < table_stride; x++) {
+        sums[x] = 0;
+    }
+
+    integral_job_t job = { data, stride, width, height, table_stride, sums };
+    size_t batches = (table_stride + COLUMN_BATCH - 1) / COLUMN_BATCH;
+    if (!parallel_for(height, width, 0, integral_rows64, &job) ||
+        !parallel_for(batches, height * COLUMN_BATCH, 0, integral_columns64, &job)) {
+        image_buffer_release(sums);
+        return false;
+    }
+
+    *table = (integral_image64_t) { .width = width, .height = height, .stride = table_stride, .sums = sums };
+    return true;
+}
+
+void free_integral_image(integral_image_t* table) {
+    if (table != NULL) {
+        image_buffer_release(table->sums);
+        table->sums = NULL;
+        table->width = 0;
+        table->height = 0;
+        table->stride = 0;
+    }
+}
+
+void free_integral_image64(integral_image64_t* table) {
+    if (table != NULL) {
+        image_buffer_release(table->sums);
+        table->sums = NULL;
+        table->width = 0;
+        table->height = 0;
+        table->stride = 0;
+    }
+}
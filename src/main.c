@@ -1,14 +1,24 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <getopt.h>
 #include "../include/image_processing.h"
 #include "../include/color_output.h"
 #include "../include/filters.h"
+#include "../include/blur.h"
+#include "../include/median.h"
+#include "../include/nlmeans.h"
+#include "../include/morphology.h"
+#include "../include/filter_chain.h"
+#include "../include/parallel.h"
 #include "../include/frequency.h"
 #include "../include/compression.h"
 #include "../include/video_processing.h" // Include for video processing functions
+#include "../include/video_codec.h"
 
 typedef enum {
     COMPRESSION_NONE,
@@ -18,7 +28,8 @@ typedef enum {
     COMPRESSION_RLE,
     COMPRESSION_DCT_BASED,
     COMPRESSION_JPEG,
-    COMPRESSION_WAVELET
+    COMPRESSION_WAVELET,
+    COMPRESSION_VIDEO
 } compression_type_t;
 
 typedef enum {
@@ -29,6 +40,16 @@ typedef enum {
 #define VERSION "0.3.0"
 #define DEFAULT_MAX_WIDTH 64
 #define DEFAULT_MAX_HEIGHT 48
+#define DEFAULT_GOP_SIZE 12
+#define DEFAULT_VIDEO_QUALITY 50
+#define CHANGE_TILE_SIZE 32     // Tile edge for static-frame detection
+#define VIDEO_FILTER_RADIUS 2   // Largest kernel radius among the tile-local video filters
+#define DEFAULT_SCENE_THRESHOLD 0.3
+#define STORYBOARD_THUMB_WIDTH 160
+#define STORYBOARD_COLUMNS 4
+#define BACKGROUND_LEARNING_SHIFT 5   // Background adapts with alpha = 1/32
+#define DEFAULT_BACKGROUND_SIGMA 2.5
+#define DEFAULT_BLUR_SIGMA 1.0f
 
 void print_usage(const char* program_name) {
     printf("TermiView v%s - Display images as colorized ASCII art in your terminal\n\n", VERSION);
@@ -39,7 +60,7 @@ void print_usage(const char* program_name) {
     printf("  -c, --color <mode>     Color mode: none, 16, 256, truecolor (default: truecolor)\n");
     printf("  -L, --levels <n>       Number of quantization levels per channel (2-256, for truecolor mode)\n");
     printf("  -q, --quantize <n>     Number of grayscale quantization levels (2-256)\n");
-    printf("  -i, --interpolation <m> Interpolation method: nearest, average (default: average)\n");
+    printf("  -i, --interpolation <m> Interpolation method: nearest, average, bilinear, bicubic, lanczos3 (default: average)\n");
     printf("  -C, --connectivity <t> Find connected components (4 or 8 connectivity)\n");
     printf("  -F, --dft              Compute and display the 2D DFT magnitude spectrum\n");
     printf("  -D, --dct              Compute and display the 2D DCT magnitude spectrum\n");
@@ -48,9 +69,37 @@ void print_usage(const char* program_name) {
     printf("  -d, --dark             Use dark mode (default)\n");
     printf("  -l, --light            Use light mode\n");
     printf("  -o, --output <file>    Save output to file instead of stdout\n");
-    printf("  -f, --filter <type>    Apply filter: blur, sharpen, sobel, laplacian, salt-pepper, ideal-lowpass, ideal-highpass, gaussian-lowpass, gaussian-highpass (default: none)\n");
+    printf("  -f, --filter <type>    Apply filter: blur, sharpen, sobel, laplacian, salt-pepper, median, bilateral, guided, nlmeans, erode, dilate, open, close, tophat, ideal-lowpass, ideal-highpass, gaussian-lowpass, gaussian-highpass (default: none)\n");
+    printf("                         A comma-separated list (e.g. blur,sharpen,sobel) applies up to %d filters in order\n", MAX_CHAIN_FILTERS);
     printf("  -N, --noise <density>  Apply salt-and-pepper noise (density: 0.0-1.0)\n");
     printf("  --cutoff <value>     Cutoff frequency for frequency domain filters (e.g., 20.0)\n");
+    printf("  --blur-mode <m>        Blur implementation: kernel, iir, box (default: kernel)\n");
+    printf("  --blur-sigma <s>       Standard deviation of the blur filter (default: %.1f)\n", DEFAULT_BLUR_SIGMA);
+    printf("  --threads <num>        Worker threads for filters, 0 for one per CPU (default: 0)\n");
+    printf("  --radius <r>           Window radius of the median filter, 1-%d (default: %d)\n", MAX_MEDIAN_RADIUS, DEFAULT_MEDIAN_RADIUS);
+    printf("  --spatial-sigma <s>    Spatial standard deviation of the bilateral filter in pixels (default: %.0f)\n", DEFAULT_BILATERAL_SPATIAL_SIGMA);
+    printf("  --range-sigma <s>      Range standard deviation of the bilateral filter in grey levels (default: %.0f)\n", DEFAULT_BILATERAL_RANGE_SIGMA);
+    printf("  --guided-radius <r>    Window radius of the guided filter (default: %d)\n", DEFAULT_GUIDED_RADIUS);
+    printf("  --guided-eps <e>       Regularisation of the guided filter on [0, 1] intensities (default: %.2f)\n", DEFAULT_GUIDED_EPSILON);
+    printf("  --guided-subsample <s> Fit the guided filter on a grid s times coarser, for speed (default: 1)\n");
+    printf("  --nlm-search <r>       Search window radius of non-local means, 1-%d (default: %d)\n", MAX_NLM_SEARCH_RADIUS, DEFAULT_NLM_SEARCH_RADIUS);
+    printf("  --nlm-patch <r>        Patch radius of non-local means, 0-%d (default: %d)\n", MAX_NLM_PATCH_RADIUS, DEFAULT_NLM_PATCH_RADIUS);
+    printf("  --nlm-strength <h>     Non-local means strength in grey levels; larger removes more noise (default: %.0f)\n", DEFAULT_NLM_STRENGTH);
+    printf("  --element <w>x<h>      Rectangular element of the morphology filters, or <n> for n x n (default: %dx%d)\n", DEFAULT_ELEMENT_SIZE, DEFAULT_ELEMENT_SIZE);
+    printf("  --motion-estimate      Estimate block motion between video frames\n");
+    printf("  --motion-compensate    Display motion-compensated video frames\n");
+    printf("  --block-size <num>     Block size for motion estimation (default: 8)\n");
+    printf("  --search-window <num>  Search window for motion estimation (default: 8)\n");
+    printf("  --subpel <1|2|4>       Motion vector precision: integer, half or quarter pel (default: 1)\n");
+    printf("  --compress video       Encode a video with the motion-compensated codec (needs -o)\n");
+    printf("  --decompress video     Decode and play a stream written by --compress video\n");
+    printf("  --gop <num>            Frames per group of pictures for video compression (default: %d)\n", DEFAULT_GOP_SIZE);
+    printf("  --quality <1-100>      Quantization quality for video compression (default: %d)\n", DEFAULT_VIDEO_QUALITY);
+    printf("  --static-threshold <v> Skip video frames whose tiles change by at most v mean luma levels (default: off)\n");
+    printf("  --scenes               Detect shots from keyframes and show a contact sheet (saved as PNG with -o)\n");
+    printf("  --scene-threshold <v>  Histogram distance (0-1] that marks a scene cut (default: %.1f)\n", DEFAULT_SCENE_THRESHOLD);
+    printf("  --background           Show labelled foreground blobs from running-Gaussian background subtraction\n");
+    printf("  --background-threshold <s> Foreground distance in standard deviations (default: %.1f)\n", DEFAULT_BACKGROUND_SIGMA);
     printf("  -v, --version          Show version information\n");
     printf("  --help                 Show this help message\n\n");
     printf("Examples:\n");
@@ -82,6 +131,378 @@ color_mode_t parse_color_mode(const char* mode_str) {
     }
 }
 
+static double elapsed_seconds(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Encode every frame of a video with the predictive codec and report encoder throughput
+static int compress_video_stream(const char* input_file, const char* output_file,
+                                 int gop_size, int quality, int search_window) {
+    VideoContext* vid_ctx = open_video(input_file);
+    if (vid_ctx == NULL) {
+        return 1;
+    }
+    FILE* out = fopen(output_file, "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open output file '%s'.\n", output_file);
+        close_video(vid_ctx);
+        return 1;
+    }
+
+    VideoEncoder* encoder = NULL;
+    int frame_count = 0, intra_count = 0;
+    size_t total_bytes = 0;
+    size_t total_pixels = 0;
+    int status = 0;
+    double encode_seconds = 0.0;
+
+    rgb_image_t rgb_frame;
+    while (read_video_frame(vid_ctx, &rgb_frame)) {
+        grayscale_image_t gray_frame = rgb_to_grayscale(&rgb_frame);
+        free_rgb_image(&rgb_frame);
+        if (gray_frame.data == NULL) {
+            status = 1;
+            break;
+        }
+        if (encoder == NULL) {
+            encoder = video_encoder_create((int)gray_frame.width, (int)gray_frame.height,
+                                           gop_size, quality, search_window);
+            if (encoder == NULL || !write_video_stream_header(out, &encoder->header)) {
+                free_grayscale_image(&gray_frame);
+                status = 1;
+                break;
+            }
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        size_t packet_len = 0;
+        unsigned char* packet = video_encode_frame(encoder, &gray_frame, &packet_len);
+        encode_seconds += elapsed_seconds(&start);
+        total_pixels += gray_frame.width * gray_frame.height;
+        free_grayscale_image(&gray_frame);
+
+        if (packet == NULL || !write_video_packet(out, packet, packet_len)) {
+            fprintf(stderr, "Error: Failed to encode frame %d\n", frame_count);
+            free(packet);
+            status = 1;
+            break;
+        }
+        if (packet[0] == VIDEO_FRAME_INTRA) {
+            intra_count++;
+        }
+        total_bytes += packet_len;
+        free(packet);
+        frame_count++;
+    }
+
+    if (status == 0 && frame_count > 0) {
+        fprintf(stderr, "Encoded %d frames (%d I, %d P) in %.3f s: %.1f fps, %zu bytes, %.3f bits/pixel\n",
+                frame_count, intra_count, frame_count - intra_count, encode_seconds,
+                encode_seconds > 0.0 ? frame_count / encode_seconds : 0.0,
+                total_bytes, 8.0 * total_bytes / total_pixels);
+    } else if (status == 0) {
+        fprintf(stderr, "Error: No frames decoded from '%s'\n", input_file);
+        status = 1;
+    }
+
+    video_encoder_free(encoder);
+    fclose(out);
+    close_video(vid_ctx);
+    return status;
+}
+
+// Decode a stream written by compress_video_stream, render each frame and report decoder throughput
+static int play_video_stream(const char* input_file, size_t max_width, size_t max_height,
+                             interpolation_method_t interpolation_method, bool dark_mode,
+                             color_mode_t color_mode, int quantization_levels) {
+    FILE* in = fopen(input_file, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: Cannot open input file '%s'.\n", input_file);
+        return 1;
+    }
+    VideoStreamHeader header;
+    VideoDecoder* decoder = NULL;
+    if (!read_video_stream_header(in, &header) || (decoder = video_decoder_create(&header)) == NULL) {
+        fclose(in);
+        return 1;
+    }
+
+    int frame_count = 0;
+    int status = 0;
+    double decode_seconds = 0.0;
+    size_t packet_len;
+    unsigned char* packet;
+    while ((packet = read_video_packet(in, &packet_len)) != NULL) {
+        grayscale_image_t frame;
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool decoded = video_decode_frame(decoder, packet, packet_len, &frame);
+        decode_seconds += elapsed_seconds(&start);
+        free(packet);
+        if (!decoded) {
+            status = 1;
+            break;
+        }
+
+        grayscale_image_t resized_frame = make_resized_grayscale(&frame, max_width, max_height, interpolation_method);
+        free_grayscale_image(&frame);
+        if (resized_frame.data == NULL) {
+            status = 1;
+            break;
+        }
+        if (color_mode == COLOR_MODE_NONE) {
+            print_image(&resized_frame, dark_mode);
+        } else {
+            print_grayscale_colored(&resized_frame, dark_mode, color_mode, quantization_levels);
+        }
+        free_grayscale_image(&resized_frame);
+        frame_count++;
+    }
+
+    fprintf(stderr, "Decoded %d frames in %.3f s: %.1f fps\n", frame_count, decode_seconds,
+            decode_seconds > 0.0 ? frame_count / decode_seconds : 0.0);
+
+    video_decoder_free(decoder);
+    fclose(in);
+    return status;
+}
+
+// Decode keyframes only, keep one thumbnail per shot and show or save them as a contact sheet
+static int storyboard_video(const char* video_file, const char* output_file, double scene_threshold,
+                            size_t max_width, size_t max_height, interpolation_method_t interpolation_method,
+                            bool dark_mode, color_mode_t color_mode, int quantization_levels) {
+    VideoContext* vid_ctx = open_video(video_file);
+    if (vid_ctx == NULL) {
+        return 1;
+    }
+    set_video_keyframes_only(vid_ctx, true);
+
+    grayscale_image_t* thumbnails = NULL;
+    int num_shots = 0, capacity = 0, keyframes = 0;
+    unsigned int histogram[SCENE_HISTOGRAM_BINS];
+    unsigned int previous_histogram[SCENE_HISTOGRAM_BINS];
+    int status = 0;
+
+    rgb_image_t rgb_frame;
+    while (read_video_frame(vid_ctx, &rgb_frame)) {
+        grayscale_image_t gray_frame = rgb_to_grayscale(&rgb_frame);
+        free_rgb_image(&rgb_frame);
+        if (gray_frame.data == NULL) {
+            status = 1;
+            break;
+        }
+
+        compute_luma_histogram(&gray_frame, histogram);
+        bool cut = keyframes == 0 || histogram_chi_square_distance(previous_histogram, histogram) > scene_threshold;
+        memcpy(previous_histogram, histogram, sizeof(histogram));
+        keyframes++;
+
+        if (cut) {
+            if (num_shots == capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                grayscale_image_t* grown = (grayscale_image_t*)realloc(thumbnails, sizeof(grayscale_image_t) * capacity);
+                if (grown == NULL) {
+                    fprintf(stderr, "Error: Failed to allocate storyboard\n");
+                    free_grayscale_image(&gray_frame);
+                    status = 1;
+                    break;
+                }
+                thumbnails = grown;
+            }
+            thumbnails[num_shots] = make_thumbnail(&gray_frame, STORYBOARD_THUMB_WIDTH);
+            if (thumbnails[num_shots].data != NULL) {
+                num_shots++;
+            }
+        }
+        free_grayscale_image(&gray_frame);
+    }
+    close_video(vid_ctx);
+
+    if (status == 0 && num_shots > 0) {
+        fprintf(stderr, "Detected %d shots in %d keyframes\n", num_shots, keyframes);
+        grayscale_image_t sheet = make_contact_sheet(thumbnails, num_shots, STORYBOARD_COLUMNS);
+        if (sheet.data == NULL) {
+            status = 1;
+        } else if (output_file != NULL) {
+            if (!save_grayscale_image_to_png(&sheet, output_file)) {
+                status = 1;
+            } else {
+                fprintf(stderr, "Saved contact sheet to %s\n", output_file);
+            }
+        } else {
+            grayscale_image_t resized = make_resized_grayscale(&sheet, max_width, max_height, interpolation_method);
+            if (resized.data == NULL) {
+                status = 1;
+            } else if (color_mode == COLOR_MODE_NONE) {
+                print_image(&resized, dark_mode);
+            } else {
+                print_grayscale_colored(&resized, dark_mode, color_mode, quantization_levels);
+            }
+            free_grayscale_image(&resized);
+        }
+        free_grayscale_image(&sheet);
+    } else if (status == 0) {
+        fprintf(stderr, "Error: No keyframes decoded from '%s'\n", video_file);
+        status = 1;
+    }
+
+    for (int i = 0; i < num_shots; i++) {
+        free_grayscale_image(&thumbnails[i]);
+    }
+    free(thumbnails);
+    return status;
+}
+
+// Apply the selected spatial filter to a video frame. Filters that have no
+// video path leave out->data NULL; returns false if the filter failed.
+static bool apply_video_filter(const grayscale_image_t* frame, filter_type_t filter_type,
+                               const filter_chain_params_t* params, grayscale_image_t* out) {
+    kernel_t kernel = {0};
+    morphology_op_t morphology_op;
+    *out = (grayscale_image_t){0};
+    if (morphology_op_for_filter(filter_type, &morphology_op)) {
+        *out = apply_morphology(frame, morphology_op, (size_t)params->element_width, (size_t)params->element_height);
+        return out->data != NULL;
+    }
+    switch (filter_type) {
+        case FILTER_BLUR:
+            *out = apply_gaussian_blur(frame, params->blur_sigma, params->blur_mode);
+            return out->data != NULL;
+        case FILTER_SHARPEN:
+            kernel = create_sharpen_kernel();
+            break;
+        case FILTER_EDGE_LAPLACIAN:
+            kernel = create_laplacian_kernel();
+            break;
+        case FILTER_EDGE_SOBEL:
+            *out = apply_sobel_edge_detection(frame);
+            return out->data != NULL;
+        case FILTER_EDGE_PREWITT:
+            *out = apply_prewitt_edge_detection(frame);
+            return out->data != NULL;
+        case FILTER_EDGE_ROBERTS:
+            *out = apply_roberts_edge_detection(frame);
+            return out->data != NULL;
+        case FILTER_SALT_PEPPER:
+            *out = apply_salt_pepper_noise(frame, params->noise_density);
+            return out->data != NULL;
+        case FILTER_MEDIAN:
+            *out = apply_median_filter(frame, params->median_radius);
+            return out->data != NULL;
+        case FILTER_BILATERAL:
+            *out = apply_bilateral_filter(frame, params->spatial_sigma, params->range_sigma);
+            return out->data != NULL;
+        case FILTER_GUIDED:
+            *out = apply_guided_filter(frame, NULL, params->guided_radius, params->guided_epsilon,
+                                       params->guided_subsample);
+            return out->data != NULL;
+        case FILTER_NL_MEANS:
+            *out = apply_nl_means(frame, params->nlm_search_radius, params->nlm_patch_radius, params->nlm_strength);
+            return out->data != NULL;
+        case FILTER_IDEAL_LOWPASS:
+        case FILTER_IDEAL_HIGHPASS:
+        case FILTER_GAUSSIAN_LOWPASS:
+        case FILTER_GAUSSIAN_HIGHPASS:
+            *out = apply_frequency_filter(frame, filter_type, params->cutoff);
+            return out->data != NULL;
+        default:
+            return true;
+    }
+    if (kernel.data == NULL) {
+        return false;
+    }
+    *out = apply_convolution_grayscale(frame, &kernel);
+    free_kernel(&kernel);
+    return out->data != NULL;
+}
+
+// Filters whose output pixel depends only on a small neighbourhood can be
+// recomputed tile by tile; noise and frequency-domain filters cannot, and
+// neither can blurs, medians or erosions wider than VIDEO_FILTER_RADIUS, nor
+// recursive blurs, nor openings and closings (two passes, twice the reach).
+static bool filter_is_tile_local(filter_type_t filter_type, const filter_chain_params_t* params) {
+    switch (filter_type) {
+        case FILTER_BLUR:
+            return params->blur_mode == BLUR_MODE_KERNEL &&
+                   gaussian_kernel_size(params->blur_sigma) / 2 <= VIDEO_FILTER_RADIUS;
+        case FILTER_MEDIAN:
+            return params->median_radius <= VIDEO_FILTER_RADIUS;
+        case FILTER_ERODE:
+        case FILTER_DILATE:
+            return params->element_width / 2 <= VIDEO_FILTER_RADIUS && params->element_height / 2 <= VIDEO_FILTER_RADIUS;
+        case FILTER_SHARPEN:
+        case FILTER_EDGE_SOBEL:
+        case FILTER_EDGE_PREWITT:
+        case FILTER_EDGE_ROBERTS:
+        case FILTER_EDGE_LAPLACIAN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Re-filter runs of dirty tiles and patch them into the previous filtered frame.
+// The written area grows by the kernel radius so neighbours of a changed tile
+// pick up the new content, and the filtered area by twice that so the written
+// pixels see the same neighbourhood as a full-frame pass.
+static bool refilter_dirty_tiles(const FrameChangeDetector* detector, const grayscale_image_t* frame,
+                                 grayscale_image_t* filtered, filter_type_t filter_type,
+                                 const filter_chain_params_t* params) {
+    int width = (int)frame->width;
+    int height = (int)frame->height;
+    int tile = detector->tile_size;
+
+    for (int tile_y = 0; tile_y < detector->tiles_y; tile_y++) {
+        for (int tile_x = 0; tile_x < detector->tiles_x; tile_x++) {
+            if (!detector->dirty[tile_y * detector->tiles_x + tile_x]) {
+                continue;
+            }
+            int run_end = tile_x;
+            while (run_end + 1 < detector->tiles_x && detector->dirty[tile_y * detector->tiles_x + run_end + 1]) {
+                run_end++;
+            }
+
+            int write_x0 = tile_x * tile - VIDEO_FILTER_RADIUS;
+            int write_y0 = tile_y * tile - VIDEO_FILTER_RADIUS;
+            int write_x1 = (run_end + 1) * tile + VIDEO_FILTER_RADIUS;
+            int write_y1 = (tile_y + 1) * tile + VIDEO_FILTER_RADIUS;
+            if (write_x0 < 0) write_x0 = 0;
+            if (write_y0 < 0) write_y0 = 0;
+            if (write_x1 > width) write_x1 = width;
+            if (write_y1 > height) write_y1 = height;
+
+            int roi_x0 = write_x0 - VIDEO_FILTER_RADIUS < 0 ? 0 : write_x0 - VIDEO_FILTER_RADIUS;
+            int roi_y0 = write_y0 - VIDEO_FILTER_RADIUS < 0 ? 0 : write_y0 - VIDEO_FILTER_RADIUS;
+            int roi_x1 = write_x1 + VIDEO_FILTER_RADIUS > width ? width : write_x1 + VIDEO_FILTER_RADIUS;
+            int roi_y1 = write_y1 + VIDEO_FILTER_RADIUS > height ? height : write_y1 + VIDEO_FILTER_RADIUS;
+
+            // The filters read through the view's stride, so the tile is not copied
+            grayscale_image_t roi = image_view_roi(frame, (size_t)roi_x0, (size_t)roi_y0,
+                                                   (size_t)(roi_x1 - roi_x0), (size_t)(roi_y1 - roi_y0));
+            if (roi.data == NULL) {
+                return false;
+            }
+
+            grayscale_image_t roi_filtered;
+            bool ok = apply_video_filter(&roi, filter_type, params, &roi_filtered);
+            if (!ok || roi_filtered.data == NULL) {
+                return false;
+            }
+            for (int y = write_y0; y < write_y1; y++) {
+                memcpy(filtered->data + (size_t)y * width + write_x0,
+                       roi_filtered.data + (size_t)(y - roi_y0) * roi_filtered.width + (write_x0 - roi_x0),
+                       (size_t)(write_x1 - write_x0));
+            }
+            free_grayscale_image(&roi_filtered);
+            tile_x = run_end;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     // Default values
     size_t max_width = DEFAULT_MAX_WIDTH;
@@ -91,6 +512,7 @@ int main(int argc, char* argv[]) {
     char* output_file = NULL;
     char* input_file = NULL;
     filter_type_t filter_type = FILTER_NONE;
+    filter_chain_t filter_chain = {0}; // Set when -f names more than one filter
     int quantization_levels = 256;
     int grayscale_quantization_levels = 0;
     interpolation_method_t interpolation_method = INTERPOLATION_AVERAGE;
@@ -115,6 +537,28 @@ int main(int argc, char* argv[]) {
     bool motion_compensate_mode = false; // Enable motion compensation
     int block_size = 8; // Default block size for motion estimation
     int search_window = 8; // Default search window for motion estimation
+    int subpel_precision = 1; // 1 = integer-pel, 2 = half-pel, 4 = quarter-pel
+    int gop_size = DEFAULT_GOP_SIZE; // Frames per intra period for video compression
+    int video_quality = DEFAULT_VIDEO_QUALITY;
+    double static_threshold = -1.0; // Negative disables static-frame skipping
+    bool scene_mode = false; // Build a storyboard of detected shots
+    double scene_threshold = DEFAULT_SCENE_THRESHOLD;
+    bool background_mode = false; // Show foreground blobs from background subtraction
+    double background_sigma = DEFAULT_BACKGROUND_SIGMA;
+    blur_mode_t blur_mode = BLUR_MODE_KERNEL;
+    float blur_sigma = DEFAULT_BLUR_SIGMA;
+    int thread_count = 0;
+    int median_radius = DEFAULT_MEDIAN_RADIUS;
+    int element_width = DEFAULT_ELEMENT_SIZE;
+    int element_height = DEFAULT_ELEMENT_SIZE;
+    float spatial_sigma = DEFAULT_BILATERAL_SPATIAL_SIGMA;
+    float range_sigma = DEFAULT_BILATERAL_RANGE_SIGMA;
+    int guided_radius = DEFAULT_GUIDED_RADIUS;
+    float guided_epsilon = DEFAULT_GUIDED_EPSILON;
+    int guided_subsample = 1;
+    int nlm_search_radius = DEFAULT_NLM_SEARCH_RADIUS;
+    int nlm_patch_radius = DEFAULT_NLM_PATCH_RADIUS;
+    float nlm_strength = DEFAULT_NLM_STRENGTH;
 
     // Long options
     static struct option long_options[] = {
@@ -147,6 +591,31 @@ int main(int argc, char* argv[]) {
         {"output-frame-pattern", required_argument, 0, 9},
         {"temporal-filter", required_argument, 0, 10},
         {"temporal-filter-size", required_argument, 0, 11},
+        {"motion-estimate", no_argument, 0, 12},
+        {"motion-compensate", no_argument, 0, 13},
+        {"block-size", required_argument, 0, 14},
+        {"search-window", required_argument, 0, 15},
+        {"subpel", required_argument, 0, 16},
+        {"gop", required_argument, 0, 17},
+        {"quality", required_argument, 0, 18},
+        {"static-threshold", required_argument, 0, 19},
+        {"scenes", no_argument, 0, 20},
+        {"scene-threshold", required_argument, 0, 21},
+        {"background", no_argument, 0, 22},
+        {"background-threshold", required_argument, 0, 23},
+        {"blur-mode", required_argument, 0, 24},
+        {"blur-sigma", required_argument, 0, 25},
+        {"threads", required_argument, 0, 26},
+        {"radius",  required_argument, 0, 27},
+        {"element", required_argument, 0, 28},
+        {"spatial-sigma", required_argument, 0, 29},
+        {"range-sigma", required_argument, 0, 30},
+        {"guided-radius", required_argument, 0, 31},
+        {"guided-eps", required_argument, 0, 32},
+        {"guided-subsample", required_argument, 0, 33},
+        {"nlm-search", required_argument, 0, 34},
+        {"nlm-patch", required_argument, 0, 35},
+        {"nlm-strength", required_argument, 0, 36},
         {0, 0, 0, 0}
     };
 
@@ -182,6 +651,8 @@ int main(int argc, char* argv[]) {
                     compression_type = COMPRESSION_JPEG;
                 } else if (strcmp(optarg, "wavelet") == 0) {
                     compression_type = COMPRESSION_WAVELET;
+                } else if (strcmp(optarg, "video") == 0) {
+                    compression_type = COMPRESSION_VIDEO;
                 } else {
                     fprintf(stderr, "Error: Unknown compression type '%s'\\n", optarg);
                     return 1;
@@ -203,6 +674,8 @@ int main(int argc, char* argv[]) {
                     compression_type = COMPRESSION_JPEG;
                 } else if (strcmp(optarg, "wavelet") == 0) {
                     compression_type = COMPRESSION_WAVELET;
+                } else if (strcmp(optarg, "video") == 0) {
+                    compression_type = COMPRESSION_VIDEO;
                 } else {
                     fprintf(stderr, "Error: Unknown compression type '%s'\\n", optarg);
                     return 1;
@@ -277,6 +750,149 @@ int main(int argc, char* argv[]) {
                     return 1;
                 }
                 break;
+            case 16: // --subpel
+                subpel_precision = atoi(optarg);
+                if (subpel_precision != 1 && subpel_precision != 2 && subpel_precision != 4) {
+                    fprintf(stderr, "Error: Sub-pixel precision must be 1, 2 or 4\n");
+                    return 1;
+                }
+                break;
+            case 17: // --gop
+                gop_size = atoi(optarg);
+                if (gop_size < 1) {
+                    fprintf(stderr, "Error: GOP size must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 18: // --quality
+                video_quality = atoi(optarg);
+                if (video_quality < 1 || video_quality > 100) {
+                    fprintf(stderr, "Error: Quality must be between 1 and 100\n");
+                    return 1;
+                }
+                break;
+            case 19: // --static-threshold
+                static_threshold = atof(optarg);
+                if (static_threshold < 0.0) {
+                    fprintf(stderr, "Error: Static threshold must be non-negative\n");
+                    return 1;
+                }
+                break;
+            case 20: // --scenes
+                scene_mode = true;
+                break;
+            case 21: // --scene-threshold
+                scene_threshold = atof(optarg);
+                if (scene_threshold <= 0.0 || scene_threshold > 1.0) {
+                    fprintf(stderr, "Error: Scene threshold must be in (0, 1]\n");
+                    return 1;
+                }
+                break;
+            case 22: // --background
+                background_mode = true;
+                break;
+            case 23: // --background-threshold
+                background_sigma = atof(optarg);
+                if (background_sigma <= 0.0 || background_sigma > 10.0) {
+                    fprintf(stderr, "Error: Background threshold must be in (0, 10] standard deviations\n");
+                    return 1;
+                }
+                break;
+            case 24: // --blur-mode
+                if (!parse_blur_mode(optarg, &blur_mode)) {
+                    fprintf(stderr, "Error: Unknown blur mode '%s' (use kernel, iir or box)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 25: // --blur-sigma
+                blur_sigma = (float)atof(optarg);
+                if (blur_sigma <= 0.0f || blur_sigma > 200.0f) {
+                    fprintf(stderr, "Error: Blur sigma must be in (0, 200]\n");
+                    return 1;
+                }
+                break;
+            case 26: // --threads
+                thread_count = atoi(optarg);
+                if (thread_count < 0 || thread_count > 256) {
+                    fprintf(stderr, "Error: Thread count must be in [0, 256]\n");
+                    return 1;
+                }
+                break;
+            case 27: // --radius
+                median_radius = atoi(optarg);
+                if (median_radius < 1 || median_radius > MAX_MEDIAN_RADIUS) {
+                    fprintf(stderr, "Error: Median radius must be in [1, %d]\n", MAX_MEDIAN_RADIUS);
+                    return 1;
+                }
+                break;
+            case 28: { // --element
+                int matched = sscanf(optarg, "%dx%d", &element_width, &element_height);
+                if (matched == 1) {
+                    element_height = element_width;
+                }
+                if (matched < 1 || element_width < 1 || element_width > MAX_ELEMENT_SIZE ||
+                    element_height < 1 || element_height > MAX_ELEMENT_SIZE) {
+                    fprintf(stderr, "Error: Element must be <w>x<h> or <n>, with sides in [1, %d]\n", MAX_ELEMENT_SIZE);
+                    return 1;
+                }
+                break;
+            }
+            case 29: // --spatial-sigma
+                spatial_sigma = (float)atof(optarg);
+                if (spatial_sigma < 1.0f || spatial_sigma > 200.0f) {
+                    fprintf(stderr, "Error: Spatial sigma must be in [1, 200]\n");
+                    return 1;
+                }
+                break;
+            case 30: // --range-sigma
+                range_sigma = (float)atof(optarg);
+                if (range_sigma < 1.0f || range_sigma > 255.0f) {
+                    fprintf(stderr, "Error: Range sigma must be in [1, 255]\n");
+                    return 1;
+                }
+                break;
+            case 31: // --guided-radius
+                guided_radius = atoi(optarg);
+                if (guided_radius < 1 || guided_radius > 1000) {
+                    fprintf(stderr, "Error: Guided filter radius must be in [1, 1000]\n");
+                    return 1;
+                }
+                break;
+            case 32: // --guided-eps
+                guided_epsilon = (float)atof(optarg);
+                if (guided_epsilon <= 0.0f || guided_epsilon > 1.0f) {
+                    fprintf(stderr, "Error: Guided filter epsilon must be in (0, 1]\n");
+                    return 1;
+                }
+                break;
+            case 33: // --guided-subsample
+                guided_subsample = atoi(optarg);
+                if (guided_subsample < 1 || guided_subsample > 64) {
+                    fprintf(stderr, "Error: Guided filter subsampling must be in [1, 64]\n");
+                    return 1;
+                }
+                break;
+            case 34: // --nlm-search
+                nlm_search_radius = atoi(optarg);
+                if (nlm_search_radius < 1 || nlm_search_radius > MAX_NLM_SEARCH_RADIUS) {
+                    fprintf(stderr, "Error: Non-local means search radius must be in [1, %d]\n", MAX_NLM_SEARCH_RADIUS);
+                    return 1;
+                }
+                break;
+            case 35: // --nlm-patch
+                nlm_patch_radius = atoi(optarg);
+                if (nlm_patch_radius < 0 || nlm_patch_radius > MAX_NLM_PATCH_RADIUS) {
+                    fprintf(stderr, "Error: Non-local means patch radius must be in [0, %d]\n", MAX_NLM_PATCH_RADIUS);
+                    return 1;
+                }
+                break;
+            case 36: // --nlm-strength
+                nlm_strength = (float)atof(optarg);
+                if (nlm_strength <= 0.0f || nlm_strength > 255.0f) {
+                    fprintf(stderr, "Error: Non-local means strength must be in (0, 255]\n");
+                    return 1;
+                }
+                break;
             case 'h':
                 max_height = (size_t) atoi(optarg);
                 if (max_height == 0) {
@@ -306,6 +922,12 @@ int main(int argc, char* argv[]) {
                     interpolation_method = INTERPOLATION_NEAREST;
                 } else if (strcmp(optarg, "average") == 0) {
                     interpolation_method = INTERPOLATION_AVERAGE;
+                } else if (strcmp(optarg, "bilinear") == 0) {
+                    interpolation_method = INTERPOLATION_BILINEAR;
+                } else if (strcmp(optarg, "bicubic") == 0) {
+                    interpolation_method = INTERPOLATION_BICUBIC;
+                } else if (strcmp(optarg, "lanczos3") == 0 || strcmp(optarg, "lanczos") == 0) {
+                    interpolation_method = INTERPOLATION_LANCZOS3;
                 } else {
                     fprintf(stderr, "Error: Unknown interpolation method '%s'\n", optarg);
                     return 1;
@@ -340,7 +962,12 @@ int main(int argc, char* argv[]) {
                 output_file = optarg;
                 break;
             case 'f':
-                filter_type = parse_filter_type(optarg);
+                if (!parse_filter_chain(optarg, &filter_chain)) {
+                    fprintf(stderr, "Error: Invalid filter list '%s' (at most %d comma-separated known filters)\n",
+                            optarg, MAX_CHAIN_FILTERS);
+                    return 1;
+                }
+                filter_type = filter_chain.count == 1 ? filter_chain.filters[0] : FILTER_NONE;
                 break;
             case 'N':
                 noise_density = atof(optarg);
@@ -361,15 +988,42 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    set_thread_count(thread_count);
+    bool chained = filter_chain.count > 1;
+    filter_chain_params_t chain_params = { blur_mode, blur_sigma, noise_density, cutoff, median_radius,
+                                           element_width, element_height, spatial_sigma, range_sigma,
+                                           guided_radius, guided_epsilon, guided_subsample,
+                                           nlm_search_radius, nlm_patch_radius, nlm_strength };
+
     // Get input file (remaining argument)
     if (optind < argc) {
         input_file = argv[optind];
-    } else {
+    } else if (video_input_file == NULL) {
         fprintf(stderr, "Error: No input image specified\n");
         fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
         return 1;
     }
 
+    if (compression_type == COMPRESSION_VIDEO) {
+        // The encoder can read the video named by --video; playback needs the encoded stream
+        if (input_file == NULL && !decompress_mode) {
+            input_file = video_input_file;
+        }
+        if (input_file == NULL) {
+            fprintf(stderr, "Error: An input file must be specified for video decompression.\n");
+            return 1;
+        }
+        if (decompress_mode) {
+            return play_video_stream(input_file, max_width, max_height, interpolation_method,
+                                     dark_mode, color_mode, quantization_levels);
+        }
+        if (!output_file) {
+            fprintf(stderr, "Error: An output file must be specified for video compression.\n");
+            return 1;
+        }
+        return compress_video_stream(input_file, output_file, gop_size, video_quality, search_window);
+    }
+
     if (compression_type != COMPRESSION_NONE) {
         if (!input_file || !output_file) {
             fprintf(stderr, "Error: Both input and output files must be specified for compression/decompression.\n");
@@ -513,6 +1167,11 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    if (video_input_file != NULL && scene_mode) {
+        return storyboard_video(video_input_file, output_file, scene_threshold, max_width, max_height,
+                                interpolation_method, dark_mode, color_mode, quantization_levels);
+    }
+
     if (video_input_file != NULL) {
         VideoContext* vid_ctx = open_video(video_input_file);
         if (vid_ctx == NULL) {
@@ -572,6 +1231,10 @@ int main(int argc, char* argv[]) {
         } else {
             rgb_image_t rgb_frame;
             int frame_count = 0;
+            int skipped_frames = 0;
+            FrameChangeDetector* change_detector = NULL;
+            BackgroundModel* background_model = NULL;
+            grayscale_image_t cached_filtered = {0}; // Last full-resolution filter output, patched per dirty tile
             
             while (read_video_frame(vid_ctx, &rgb_frame)) {
                 if (extract_frame_num != -1 && frame_count != extract_frame_num) {
@@ -607,20 +1270,68 @@ int main(int argc, char* argv[]) {
                 grayscale_image_t gray_frame = rgb_to_grayscale(&rgb_frame);
                 free_rgb_image(&rgb_frame);
 
+                // Skip frames whose tiles all stayed within the static threshold
+                int dirty_tiles = -1; // -1: no change detection, process the whole frame
+                if (static_threshold >= 0.0 && gray_frame.data != NULL) {
+                    if (change_detector == NULL) {
+                        change_detector = create_frame_change_detector((int)gray_frame.width, (int)gray_frame.height, CHANGE_TILE_SIZE);
+                    }
+                    if (change_detector != NULL) {
+                        dirty_tiles = detect_frame_changes(change_detector, &gray_frame, static_threshold);
+                    }
+                    if (dirty_tiles == 0) {
+                        free_grayscale_image(&gray_frame);
+                        skipped_frames++;
+                        frame_count++;
+                        continue;
+                    }
+                }
+
                 grayscale_image_t* frame_to_process = &gray_frame;
                 MotionVectorField* mv_field = NULL;
                 grayscale_image_t* compensated_frame = NULL;
 
+                SubpelReference* subpel_ref = NULL;
+
                 if (motion_estimate_mode && previous_frame != NULL) {
-                    mv_field = estimate_motion(&gray_frame, previous_frame, block_size, search_window);
+                    if (subpel_precision > 1) {
+                        // Interpolate the reference once; estimation and compensation share the planes
+                        subpel_ref = build_subpel_reference(previous_frame);
+                    }
+                    if (subpel_ref != NULL) {
+                        mv_field = estimate_motion_subpel(&gray_frame, subpel_ref, block_size, search_window, subpel_precision);
+                    } else {
+                        mv_field = estimate_motion(&gray_frame, previous_frame, block_size, search_window);
+                    }
                 }
 
                 if (motion_compensate_mode && mv_field != NULL) {
-                    compensated_frame = compensate_motion(previous_frame, mv_field, block_size);
+                    if (subpel_ref != NULL) {
+                        compensated_frame = compensate_motion_subpel(subpel_ref, mv_field, block_size);
+                    } else {
+                        compensated_frame = compensate_motion(previous_frame, mv_field, block_size);
+                    }
                     if (compensated_frame != NULL) {
                         frame_to_process = compensated_frame;
                     }
                 }
+                free_subpel_reference(subpel_ref);
+
+                // Foreground mask from the background model, labelled into blobs
+                grayscale_image_t blobs = {0};
+                if (background_mode && gray_frame.data != NULL) {
+                    if (background_model == NULL) {
+                        background_model = create_background_model((int)gray_frame.width, (int)gray_frame.height,
+                                                                   BACKGROUND_LEARNING_SHIFT, background_sigma);
+                    }
+                    grayscale_image_t* foreground = background_model ? subtract_background(background_model, &gray_frame) : NULL;
+                    if (foreground != NULL) {
+                        blobs = connected_components(foreground, connectivity > 0 ? connectivity : 8);
+                    }
+                    if (blobs.data != NULL) {
+                        frame_to_process = &blobs;
+                    }
+                }
 
                 // Free the previous frame if it exists
                 if (previous_frame != NULL) {
@@ -633,81 +1344,55 @@ int main(int argc, char* argv[]) {
                 // Ensure to free the data if gray_frame.data was re-allocated internally somewhere
                 // (e.g., if gray_frame was a temporary variable whose data might be reallocated)
 
-                // Apply filter if specified
+                // Apply filter if specified; tile-local filters on a partially changed
+                // frame only recompute the dirty tiles of the cached result
                 grayscale_image_t filtered = {0};
                 grayscale_image_t* to_resize = frame_to_process;
-                
-                if (filter_type != FILTER_NONE) {
-                    kernel_t kernel = {0};
-                    switch (filter_type) {
-                        case FILTER_BLUR:
-                            kernel = create_gaussian_blur_kernel(5, 1.0f);
-                            break;
-                        case FILTER_SHARPEN:
-                            kernel = create_sharpen_kernel();
-                            break;
-                        case FILTER_EDGE_SOBEL:
-                            filtered = apply_sobel_edge_detection(frame_to_process);
-                            to_resize = &filtered;
-                            break;
-                        case FILTER_EDGE_PREWITT:
-                            filtered = apply_prewitt_edge_detection(frame_to_process);
-                            to_resize = &filtered;
-                            break;
-                        case FILTER_EDGE_ROBERTS:
-                            filtered = apply_roberts_edge_detection(frame_to_process);
-                            to_resize = &filtered;
-                            break;
-                        case FILTER_EDGE_LAPLACIAN:
-                            kernel = create_laplacian_kernel();
-                            break;
-                        case FILTER_SALT_PEPPER:
-                            filtered = apply_salt_pepper_noise(frame_to_process, noise_density);
-                            to_resize = &filtered;
-                            break;
-                        case FILTER_IDEAL_LOWPASS:
-                        case FILTER_IDEAL_HIGHPASS:
-                        case FILTER_GAUSSIAN_LOWPASS:
-                        case FILTER_GAUSSIAN_HIGHPASS:
-                            filtered = apply_frequency_filter(frame_to_process, filter_type, cutoff);
-                            to_resize = &filtered;
-                            break;
-                        default:
-                            break;
-                    }
-                    
-                    if (kernel.data != NULL) {
-                        filtered = apply_convolution_grayscale(frame_to_process, &kernel);
-                        free_kernel(&kernel);
-                        if (filtered.data != NULL) {
-                            to_resize = &filtered;
+                bool cache_filtered = dirty_tiles > 0 && filter_is_tile_local(filter_type, &chain_params) &&
+                                      !motion_compensate_mode && !background_mode;
+
+                if (chained) {
+                    filtered = apply_filter_chain(frame_to_process, &filter_chain, &chain_params);
+                    to_resize = filtered.data != NULL ? &filtered : NULL;
+                } else if (filter_type != FILTER_NONE) {
+                    bool filter_ok;
+                    if (cache_filtered && cached_filtered.data != NULL &&
+                        dirty_tiles < change_detector->tiles_x * change_detector->tiles_y) {
+                        filter_ok = refilter_dirty_tiles(change_detector, frame_to_process, &cached_filtered,
+                                                         filter_type, &chain_params);
+                    } else {
+                        filter_ok = apply_video_filter(frame_to_process, filter_type, &chain_params, &filtered);
+                        if (filter_ok && cache_filtered && filtered.data != NULL) {
+                            free_grayscale_image(&cached_filtered);
+                            cached_filtered = filtered;
+                            filtered = (grayscale_image_t){0};
                         }
-                    } else if ((filter_type == FILTER_EDGE_SOBEL || filter_type == FILTER_SALT_PEPPER) && filtered.data == NULL) {
-                        // Sobel or Salt-Pepper failed, so we should not proceed
+                    }
+                    if (!filter_ok) {
                         to_resize = NULL;
+                    } else if (cache_filtered && cached_filtered.data != NULL) {
+                        to_resize = &cached_filtered;
+                    } else if (filtered.data != NULL) {
+                        to_resize = &filtered;
                     }
                 }
 
                 if (to_resize == NULL) {
-                    free_grayscale_image(&gray_frame);
                     if (mv_field) free_motion_vector_field(mv_field);
                     if (compensated_frame) { free_grayscale_image(compensated_frame); free(compensated_frame); }
+                    free_grayscale_image(&blobs);
+                    free_grayscale_image(&cached_filtered);
+                    free_frame_change_detector(change_detector);
+                    free_background_model(background_model);
+                    free_grayscale_image(previous_frame);
+                    free(previous_frame);
                     close_video(vid_ctx);
                     return 1;
                 }
 
                 grayscale_image_t resized_frame = make_resized_grayscale(to_resize, max_width, max_height, interpolation_method);
                 if (filtered.data != NULL) free_grayscale_image(&filtered);
-                // The gray_frame data is now owned by previous_frame, do not free here if it was used for that.
-                // It will be freed in the next iteration or after the loop.
-                // But if motion compensation happened, frame_to_process is compensated_frame, and gray_frame itself needs freeing.
-                if (compensated_frame != NULL && frame_to_process == compensated_frame) {
-                    // compensated_frame will be freed after resized_frame is processed
-                } else {
-                    // gray_frame has its data copied to previous_frame, original gray_frame.data must be freed here
-                    free_grayscale_image(&gray_frame);
-                }
-
+                // gray_frame's data is owned by previous_frame from here on and is freed with it
 
                 // Output processed frame to file if pattern is provided
                 if (output_file != NULL && output_frame_pattern != NULL) {
@@ -718,6 +1403,12 @@ int main(int argc, char* argv[]) {
                         free_grayscale_image(&resized_frame);
                         if (mv_field) free_motion_vector_field(mv_field);
                         if (compensated_frame) { free_grayscale_image(compensated_frame); free(compensated_frame); }
+                        free_grayscale_image(&blobs);
+                        free_grayscale_image(&cached_filtered);
+                        free_frame_change_detector(change_detector);
+                        free_background_model(background_model);
+                        free_grayscale_image(previous_frame);
+                        free(previous_frame);
                         close_video(vid_ctx);
                         return 1;
                     }
@@ -733,10 +1424,17 @@ int main(int argc, char* argv[]) {
                 free_grayscale_image(&resized_frame);
                 if (mv_field) free_motion_vector_field(mv_field);
                 if (compensated_frame) { free_grayscale_image(compensated_frame); free(compensated_frame); }
+                free_grayscale_image(&blobs);
                 frame_count++;
                 // Optionally add a delay here for video playback speed control
                 // usleep(1000000 / vid_ctx->fps); // Requires #include <unistd.h> and vid_ctx->fps to be populated
             }
+            free_grayscale_image(&cached_filtered);
+            free_frame_change_detector(change_detector);
+            free_background_model(background_model);
+            if (skipped_frames > 0) {
+                fprintf(stderr, "Skipped %d static frames of %d\n", skipped_frames, frame_count);
+            }
         }
         if (previous_frame != NULL) {
             free_grayscale_image(previous_frame);
@@ -920,11 +1618,18 @@ int main(int argc, char* argv[]) {
         grayscale_image_t filtered = {0};
         grayscale_image_t* to_resize = &gray_original;
         
-        if (filter_type != FILTER_NONE) {
+        if (chained) {
+            filtered = apply_filter_chain(&gray_original, &filter_chain, &chain_params);
+            to_resize = filtered.data != NULL ? &filtered : NULL;
+        } else if (filter_type != FILTER_NONE) {
             kernel_t kernel = {0};
+            morphology_op_t morphology_op;
             switch (filter_type) {
                 case FILTER_BLUR:
-                    kernel = create_gaussian_blur_kernel(5, 1.0f);
+                    filtered = apply_gaussian_blur(&gray_original, blur_sigma, blur_mode);
+                    if (filtered.data != NULL) {
+                        to_resize = &filtered;
+                    }
                     break;
                 case FILTER_SHARPEN:
                     kernel = create_sharpen_kernel();
@@ -948,6 +1653,22 @@ int main(int argc, char* argv[]) {
                     filtered = apply_salt_pepper_noise(&gray_original, noise_density);
                     to_resize = &filtered;
                     break;
+                case FILTER_MEDIAN:
+                    filtered = apply_median_filter(&gray_original, median_radius);
+                    to_resize = &filtered;
+                    break;
+                case FILTER_BILATERAL:
+                    filtered = apply_bilateral_filter(&gray_original, spatial_sigma, range_sigma);
+                    to_resize = &filtered;
+                    break;
+                case FILTER_GUIDED:
+                    filtered = apply_guided_filter(&gray_original, NULL, guided_radius, guided_epsilon, guided_subsample);
+                    to_resize = &filtered;
+                    break;
+                case FILTER_NL_MEANS:
+                    filtered = apply_nl_means(&gray_original, nlm_search_radius, nlm_patch_radius, nlm_strength);
+                    to_resize = &filtered;
+                    break;
                 case FILTER_IDEAL_LOWPASS:
                 case FILTER_IDEAL_HIGHPASS:
                 case FILTER_GAUSSIAN_LOWPASS:
@@ -956,6 +1677,10 @@ int main(int argc, char* argv[]) {
                     to_resize = &filtered;
                     break;
                 default:
+                    if (morphology_op_for_filter(filter_type, &morphology_op)) {
+                        filtered = apply_morphology(&gray_original, morphology_op, element_width, element_height);
+                        to_resize = &filtered;
+                    }
                     break;
             }
             
@@ -965,8 +1690,12 @@ int main(int argc, char* argv[]) {
                 if (filtered.data != NULL) {
                     to_resize = &filtered;
                 }
-            } else if ((filter_type == FILTER_EDGE_SOBEL || filter_type == FILTER_SALT_PEPPER) && filtered.data == NULL) {
-                // Sobel or Salt-Pepper failed, so we should not proceed
+            } else if ((filter_type == FILTER_EDGE_SOBEL || filter_type == FILTER_SALT_PEPPER ||
+                        filter_type == FILTER_MEDIAN || filter_type == FILTER_BILATERAL ||
+                        filter_type == FILTER_GUIDED || filter_type == FILTER_NL_MEANS ||
+                        morphology_op_for_filter(filter_type, &morphology_op)) &&
+                       filtered.data == NULL) {
+                // Sobel, Salt-Pepper, Median, edge-aware smoothing or morphology failed, so we should not proceed
                 to_resize = NULL;
             }
         }
@@ -1014,7 +1743,24 @@ int main(int argc, char* argv[]) {
         rgb_image_t* to_resize_rgb = &rgb_original;
         grayscale_image_t* to_print_gray = NULL;
 
-        if (filter_type != FILTER_NONE) {
+        if (chained) {
+            // Chains of blurs, sharpens, medians, edge-aware smoothing and morphology keep colour; any other filter works on luma
+            if (filter_chain_preserves_color(&filter_chain)) {
+                filtered_rgb = apply_filter_chain_rgb(&rgb_original, &filter_chain, &chain_params);
+                if (filtered_rgb.r_data != NULL) {
+                    to_resize_rgb = &filtered_rgb;
+                }
+            } else {
+                grayscale_image_t gray_temp = rgb_to_grayscale(&rgb_original);
+                if (gray_temp.data != NULL) {
+                    filtered_gray = apply_filter_chain(&gray_temp, &filter_chain, &chain_params);
+                    free(gray_temp.data);
+                    if (filtered_gray.data != NULL) {
+                        to_print_gray = &filtered_gray;
+                    }
+                }
+            }
+        } else if (filter_type != FILTER_NONE) {
             if (filter_type == FILTER_EDGE_SOBEL || filter_type == FILTER_EDGE_LAPLACIAN || filter_type == FILTER_EDGE_PREWITT || filter_type == FILTER_EDGE_ROBERTS) {
                 // These filters work on grayscale images
                 grayscale_image_t gray_temp = rgb_to_grayscale(&rgb_original);
@@ -1039,13 +1785,42 @@ int main(int argc, char* argv[]) {
             } else {
                 // Apply filter to RGB channels
                 kernel_t kernel = {0};
+                morphology_op_t morphology_op;
                 switch (filter_type) {
                     case FILTER_BLUR:
-                        kernel = create_gaussian_blur_kernel(5, 1.0f);
+                        filtered_rgb = apply_gaussian_blur_rgb(&rgb_original, blur_sigma, blur_mode);
+                        if (filtered_rgb.r_data != NULL) {
+                            to_resize_rgb = &filtered_rgb;
+                        }
                         break;
                     case FILTER_SHARPEN:
                         kernel = create_sharpen_kernel();
                         break;
+                    case FILTER_MEDIAN:
+                        filtered_rgb = apply_median_filter_rgb(&rgb_original, median_radius);
+                        if (filtered_rgb.r_data != NULL) {
+                            to_resize_rgb = &filtered_rgb;
+                        }
+                        break;
+                    case FILTER_BILATERAL:
+                        filtered_rgb = apply_bilateral_filter_rgb(&rgb_original, spatial_sigma, range_sigma);
+                        if (filtered_rgb.r_data != NULL) {
+                            to_resize_rgb = &filtered_rgb;
+                        }
+                        break;
+                    case FILTER_GUIDED:
+                        filtered_rgb = apply_guided_filter_rgb(&rgb_original, NULL, guided_radius, guided_epsilon,
+                                                               guided_subsample);
+                        if (filtered_rgb.r_data != NULL) {
+                            to_resize_rgb = &filtered_rgb;
+                        }
+                        break;
+                    case FILTER_NL_MEANS:
+                        filtered_rgb = apply_nl_means_rgb(&rgb_original, nlm_search_radius, nlm_patch_radius, nlm_strength);
+                        if (filtered_rgb.r_data != NULL) {
+                            to_resize_rgb = &filtered_rgb;
+                        }
+                        break;
                     case FILTER_SALT_PEPPER:
                         // Apply to grayscale conversion of RGB image
                         grayscale_image_t gray_temp = rgb_to_grayscale(&rgb_original);
@@ -1067,6 +1842,12 @@ int main(int argc, char* argv[]) {
                         }
                         break;
                     default:
+                        if (morphology_op_for_filter(filter_type, &morphology_op)) {
+                            filtered_rgb = apply_morphology_rgb(&rgb_original, morphology_op, element_width, element_height);
+                            if (filtered_rgb.r_data != NULL) {
+                                to_resize_rgb = &filtered_rgb;
+                            }
+                        }
                         break;
                 }
                 
@@ -0,0 +1,340 @@
+#include "../include/median.h"
+#include "../include/image_alloc.h"
+#include "../include/parallel.h"
+#include "../include/simd.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FINE_BINS 256
+#define COARSE_BINS 16          // Each coarse bin counts 16 consecutive fine bins
+#define NETWORK_MAX_RADIUS 2    // Larger windows use sliding histograms
+
+/**
+ * Compare-exchange pairs (min to the first index, max to the second) that
+ * leave the median of 9 values at index 4 (Devillard's 19-exchange network)
+ */
+static const unsigned char median9_network[][2] = {
+    {1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2}, {4, 5}, {7, 8}, {0, 3},
+    {5, 8}, {4, 7}, {3, 6}, {1, 4}, {2, 5}, {4, 7}, {4, 2}, {6, 4}, {4, 2}
+};
+
+/**
+ * Median of 25 values at index 12: Batcher's odd-even merge sort for 32
+ * inputs, without the exchanges against the 7 missing (infinite) inputs and
+ * those that cannot reach index 12
+ */
+static const unsigned char median25_network[][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19},
+    {20, 21}, {22, 23}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15},
+    {16, 18}, {17, 19}, {20, 22}, {21, 23}, {1, 2}, {5, 6}, {9, 10}, {13, 14}, {17, 18}, {21, 22},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21},
+    {18, 22}, {19, 23}, {2, 4}, {3, 5}, {10, 12}, {11, 13}, {18, 20}, {19, 21}, {1, 2}, {3, 4},
+    {5, 6}, {9, 10}, {11, 12}, {13, 14}, {17, 18}, {19, 20}, {21, 22}, {0, 8}, {1, 9}, {2, 10},
+    {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24}, {4, 8}, {5, 9}, {6, 10}, {7, 11},
+    {20, 24}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {18, 20}, {19, 21}, {22, 24},
+    {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10}, {11, 12}, {13, 14}, {17, 18}, {19, 20}, {21, 22},
+    {23, 24}, {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24},
+    {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21}, {6, 10}, {7, 11}, {12, 16}, {13, 17},
+    {10, 12}, {11, 13}, {11, 12}
+};
+
+typedef struct {
+    const unsigned char (*pairs)[2];
+    size_t count;
+} median_network_t;
+
+typedef struct {
+    const unsigned char* input;
+    size_t input_stride;
+    unsigned char* output;      // Packed
+    int width;
+    int height;
+    int radius;
+} median_job_t;
+
+static int clamp_index(int i, int n) {
+    return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+static median_network_t network_for_radius(int radius) {
+    median_network_t network;
+    if (radius == 1) {
+        network.pairs = median9_network;
+        network.count = sizeof(median9_network) / sizeof(median9_network[0]);
+    } else {
+        network.pairs = median25_network;
+        network.count = sizeof(median25_network) / sizeof(median25_network[0]);
+    }
+    return network;
+}
+
+/**
+ * Median of the window at column x through the network, with clamped columns
+ */
+static unsigned char median_network_pixel(const unsigned char* const* rows, int width, int radius, int x,
+                                          const median_network_t* network) {
+    unsigned char v[25];
+    int size = 2 * radius + 1;
+    for (int dy = 0; dy < size; dy++) {
+        for (int dx = 0; dx < size; dx++) {
+            v[dy * size + dx] = rows[dy][clamp_index(x + dx - radius, width)];
+        }
+    }
+    for (size_t i = 0; i < network->count; i++) {
+        unsigned char a = v[network->pairs[i][0]], b = v[network->pairs[i][1]];
+        v[network->pairs[i][0]] = a < b ? a : b;
+        v[network->pairs[i][1]] = a < b ? b : a;
+    }
+    return v[size * size / 2];
+}
+
+#if defined(TERMIVIEW_SSE2)
+typedef __m128i median_vec_t;
+#define MEDIAN_LANES 16
+#define median_load(p) _mm_loadu_si128((const __m128i*)(p))
+#define median_store(p, v) _mm_storeu_si128((__m128i*)(p), (v))
+#define median_min(a, b) _mm_min_epu8((a), (b))
+#define median_max(a, b) _mm_max_epu8((a), (b))
+#elif defined(TERMIVIEW_NEON)
+typedef uint8x16_t median_vec_t;
+#define MEDIAN_LANES 16
+#define median_load(p) vld1q_u8(p)
+#define median_store(p, v) vst1q_u8((p), (v))
+#define median_min(a, b) vminq_u8((a), (b))
+#define median_max(a, b) vmaxq_u8((a), (b))
+#endif
+
+#ifdef MEDIAN_LANES
+/**
+ * Medians of MEDIAN_LANES neighbouring windows at once: the network runs on
+ * whole vectors, one lane per output pixel. The caller guarantees
+ * x - radius and x + MEDIAN_LANES - 1 + radius are inside the row.
+ */
+static void median_network_block(const unsigned char* const* rows, int radius, int x, unsigned char* out,
+                                 const median_network_t* network) {
+    median_vec_t v[25];
+    int size = 2 * radius + 1;
+    for (int dy = 0; dy < size; dy++) {
+        for (int dx = 0; dx < size; dx++) {
+            v[dy * size + dx] = median_load(rows[dy] + x + dx - radius);
+        }
+    }
+    for (size_t i = 0; i < network->count; i++) {
+        median_vec_t a = v[network->pairs[i][0]], b = v[network->pairs[i][1]];
+        v[network->pairs[i][0]] = median_min(a, b);
+        v[network->pairs[i][1]] = median_max(a, b);
+    }
+    median_store(out + x, v[size * size / 2]);
+}
+#endif
+
+static bool median_network_rows(void* context, const row_band_t* band) {
+    const median_job_t* job = (const median_job_t*)context;
+    median_network_t network = network_for_radius(job->radius);
+    const unsigned char* rows[2 * NETWORK_MAX_RADIUS + 1];
+    int size = 2 * job->radius + 1;
+
+    for (int y = (int)band->begin; y < (int)band->end; y++) {
+        for (int k = 0; k < size; k++) {
+            rows[k] = job->input + (size_t)clamp_index(y + k - job->radius, job->height) * job->input_stride;
+        }
+        unsigned char* out = job->output + (size_t)y * job->width;
+        int x = 0;
+        while (x < job->width) {
+#ifdef MEDIAN_LANES
+            if (x >= job->radius && x + MEDIAN_LANES + job->radius <= job->width) {
+                median_network_block(rows, job->radius, x, out, &network);
+                x += MEDIAN_LANES;
+                continue;
+            }
+#endif
+            out[x] = median_network_pixel(rows, job->width, job->radius, x, &network);
+            x++;
+        }
+    }
+    return true;
+}
+
+/**
+ * histogram += add - remove over `bins` 16-bit counters
+ */
+static void histogram_slide(uint16_t* histogram, const uint16_t* add, const uint16_t* remove, int bins) {
+    int i = 0;
+#ifdef TERMIVIEW_SSE2
+    for (; i + 8 <= bins; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i*)(histogram + i));
+        h = _mm_add_epi16(h, _mm_loadu_si128((const __m128i*)(add + i)));
+        h = _mm_sub_epi16(h, _mm_loadu_si128((const __m128i*)(remove + i)));
+        _mm_storeu_si128((__m128i*)(histogram + i), h);
+    }
+#endif
+    for (; i < bins; i++) {
+        histogram[i] = (uint16_t)(histogram[i] + add[i] - remove[i]);
+    }
+}
+
+/**
+ * Bring segment `segment` of the window's fine histogram to the window at
+ * column x, from the column it was last brought to (-1 if never this row):
+ * slide it column by column, or rebuild it when the window has moved
+ * further than its width since
+ */
+static void sync_fine_segment(uint16_t* fine, int* synced_at, int segment, int x, const uint16_t* column_fine,
+                              int width, int radius) {
+    const int segment_bins = FINE_BINS / COARSE_BINS;
+    uint16_t* bins = fine + segment * segment_bins;
+    const uint16_t* columns = column_fine + segment * segment_bins;
+    int last = synced_at[segment];
+    if (last < 0 || x - last > 2 * radius + 1) {
+        memset(bins, 0, segment_bins * sizeof(uint16_t));
+        for (int dx = -radius; dx <= radius; dx++) {
+            const uint16_t* column = columns + (size_t)clamp_index(x + dx, width) * FINE_BINS;
+            for (int i = 0; i < segment_bins; i++) bins[i] += column[i];
+        }
+    } else {
+        for (int step = last + 1; step <= x; step++) {
+            size_t entering = (size_t)clamp_index(step + radius, width);
+            size_t leaving = (size_t)clamp_index(step - radius - 1, width);
+            histogram_slide(bins, columns + entering * FINE_BINS, columns + leaving * FINE_BINS, segment_bins);
+        }
+    }
+    synced_at[segment] = x;
+}
+
+/**
+ * Perreault-Hebert median over rows [begin, end): one histogram per column
+ * covers the 2r + 1 rows of the current output row and moves down one row
+ * at a time; the window histogram moves right by adding one column
+ * histogram and removing another. Histograms have 16 coarse bins, kept
+ * current, over 256 fine bins, of which only the 16-bin segment holding
+ * the median is brought up to date at each pixel.
+ */
+static bool median_histogram_rows(void* context, const row_band_t* band) {
+    const median_job_t* job = (const median_job_t*)context;
+    int width = job->width;
+    int height = job->height;
+    int radius = job->radius;
+    scratch_mark_t mark = scratch_mark();
+    uint16_t* column_fine = (uint16_t*)scratch_alloc((size_t)width * FINE_BINS * sizeof(uint16_t));
+    uint16_t* column_coarse = (uint16_t*)scratch_alloc((size_t)width * COARSE_BINS * sizeof(uint16_t));
+    if (column_fine == NULL || column_coarse == NULL) {
+        scratch_release(mark);
+        return false;
+    }
+    memset(column_fine, 0, (size_t)width * FINE_BINS * sizeof(uint16_t));
+    memset(column_coarse, 0, (size_t)width * COARSE_BINS * sizeof(uint16_t));
+
+    // Column histograms for the window of the band's first row, border rows repeated
+    int begin = (int)band->begin;
+    for (int dy = -radius; dy <= radius; dy++) {
+        const unsigned char* row = job->input + (size_t)clamp_index(begin + dy, height) * job->input_stride;
+        for (int x = 0; x < width; x++) {
+            column_fine[(size_t)x * FINE_BINS + row[x]]++;
+            column_coarse[(size_t)x * COARSE_BINS + (row[x] >> 4)]++;
+        }
+    }
+
+    int rank = (2 * radius + 1) * (2 * radius + 1) / 2;
+    for (int y = begin; y < (int)band->end; y++) {
+        if (y > begin) {
+            size_t stride = job->input_stride;
+            const unsigned char* leaving = job->input + (size_t)clamp_index(y - radius - 1, height) * stride;
+            const unsigned char* entering = job->input + (size_t)clamp_index(y + radius, height) * stride;
+            for (int x = 0; x < width; x++) {
+                column_fine[(size_t)x * FINE_BINS + leaving[x]]--;
+                column_coarse[(size_t)x * COARSE_BINS + (leaving[x] >> 4)]--;
+                column_fine[(size_t)x * FINE_BINS + entering[x]]++;
+                column_coarse[(size_t)x * COARSE_BINS + (entering[x] >> 4)]++;
+            }
+        }
+
+        uint16_t fine[FINE_BINS];
+        uint16_t coarse[COARSE_BINS] = {0};
+        int synced_at[COARSE_BINS];
+        for (int i = 0; i < COARSE_BINS; i++) {
+            synced_at[i] = -1;
+        }
+        for (int dx = -radius; dx <= radius; dx++) {
+            const uint16_t* column = column_coarse + (size_t)clamp_index(dx, width) * COARSE_BINS;
+            for (int i = 0; i < COARSE_BINS; i++) coarse[i] += column[i];
+        }
+
+        unsigned char* out = job->output + (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            if (x > 0) {
+                size_t entering = (size_t)clamp_index(x + radius, width);
+                size_t leaving = (size_t)clamp_index(x - radius - 1, width);
+                histogram_slide(coarse, column_coarse + entering * COARSE_BINS, column_coarse + leaving * COARSE_BINS,
+                                COARSE_BINS);
+            }
+
+            int below = 0;
+            int segment = 0;
+            while (below + coarse[segment] <= rank) {
+                below += coarse[segment++];
+            }
+            sync_fine_segment(fine, synced_at, segment, x, column_fine, width, radius);
+            int bin = segment * (FINE_BINS / COARSE_BINS);
+            while (below + fine[bin] <= rank) {
+                below += fine[bin++];
+            }
+            out[x] = (unsigned char)bin;
+        }
+    }
+
+    scratch_release(mark);
+    return true;
+}
+
+static bool median_channel(const unsigned char* input, size_t input_stride, unsigned char* output,
+                           int width, int height, int radius) {
+    median_job_t job = { input, input_stride, output, width, height, radius };
+    if (radius <= NETWORK_MAX_RADIUS) {
+        size_t taps = (size_t)(2 * radius + 1) * (2 * radius + 1);
+        return parallel_for((size_t)height, (size_t)width * taps, (size_t)radius, median_network_rows, &job);
+    }
+    return parallel_for((size_t)height, (size_t)width * 2 * FINE_BINS, (size_t)radius, median_histogram_rows, &job);
+}
+
+grayscale_image_t apply_median_filter(const grayscale_image_t* image, int radius) {
+    grayscale_image_t result = {0};
+    if (image == NULL || image->data == NULL || radius < 1 || radius > MAX_MEDIAN_RADIUS) {
+        fprintf(stderr, "Error: Invalid input to apply_median_filter\n");
+        return result;
+    }
+
+    result = allocate_grayscale_image(image->width, image->height);
+    if (result.data == NULL ||
+        !median_channel(image->data, grayscale_stride(image), result.data, (int)image->width, (int)image->height,
+                        radius)) {
+        fprintf(stderr, "Error: Failed to allocate memory for median filter\n");
+        free_grayscale_image(&result);
+        return (grayscale_image_t){0};
+    }
+    return result;
+}
+
+rgb_image_t apply_median_filter_rgb(const rgb_image_t* image, int radius) {
+    rgb_image_t result = {0};
+    if (image == NULL || image->r_data == NULL || image->g_data == NULL || image->b_data == NULL ||
+        radius < 1 || radius > MAX_MEDIAN_RADIUS) {
+        fprintf(stderr, "Error: Invalid input to apply_median_filter_rgb\n");
+        return result;
+    }
+
+    int width = (int)image->width;
+    int height = (int)image->height;
+    size_t stride = rgb_stride(image);
+    result = allocate_rgb_image(image->width, image->height);
+    if (result.r_data == NULL ||
+        !median_channel(image->r_data, stride, result.r_data, width, height, radius) ||
+        !median_channel(image->g_data, stride, result.g_data, width, height, radius) ||
+        !median_channel(image->b_data, stride, result.b_data, width, height, radius)) {
+        fprintf(stderr, "Error: Failed to allocate memory for median filter\n");
+        free_rgb_image(&result);
+        return (rgb_image_t){0};
+    }
+    return result;
+}
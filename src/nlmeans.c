@@ -0,0 +1,444 @@
+#include "../include/nlmeans.h"
+#include "../include/image_alloc.h"
+#include "../include/parallel.h"
+#include "../include/simd.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WEIGHT_BITS 12              // Q12 weights: integer sums are exact in any order
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+#define WEIGHT_TABLE_SIZE 4096
+#define NLM_MEMORY_BUDGET ((size_t)128 << 20)  // Accumulator bytes of all offset groups together
+
+/**
+ * Accumulators owned by one group of search offsets for the current strip
+ * of rows, plus its scratch
+ */
+typedef struct {
+    uint32_t* weight_sum;
+    uint32_t* value_sum[3];
+    uint16_t* weight_max;           // Largest weight seen, used for the centre pixel
+    uint32_t* integral;             // Integral image of squared differences
+    uint32_t* distances;            // One row of squared differences, then of patch distances
+    uint16_t* weights;              // One row of weights
+} nlm_band_t;
+
+typedef struct {
+    const unsigned char* padded[3]; // Channels with `margin` clamped pixels on every side
+    int channels;
+    size_t width;
+    size_t height;
+    size_t padded_width;
+    int margin;                     // search_radius + patch_radius
+    int search_radius;
+    int patch_radius;
+    uint16_t weight_table[WEIGHT_TABLE_SIZE];
+    int table_shift;                // Patch distance >> table_shift indexes weight_table
+    uint32_t cutoff;                // Distances from here on weigh zero
+    size_t offsets;                 // Search offsets, the centre excluded
+    nlm_band_t* bands;              // One per group of search offsets
+    size_t band_count;
+    size_t strip_y;                 // Image rows [strip_y, strip_y + strip_rows) are being filtered
+    size_t strip_rows;
+    unsigned char* output[3];
+} nlm_job_t;
+
+static int clamp_index(int i, int n) {
+    return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+static unsigned char* pad_channel(const unsigned char* channel, size_t stride, size_t width, size_t height,
+                                  int margin) {
+    size_t padded_width = width + 2 * (size_t)margin;
+    unsigned char* padded = (unsigned char*)image_buffer_acquire(padded_width * (height + 2 * (size_t)margin));
+    if (padded == NULL) {
+        return NULL;
+    }
+    for (int y = -margin; y < (int)height + margin; y++) {
+        const unsigned char* src = channel + (size_t)clamp_index(y, (int)height) * stride;
+        unsigned char* dst = padded + (size_t)(y + margin) * padded_width;
+        memset(dst, src[0], (size_t)margin);
+        memcpy(dst + margin, src, width);
+        memset(dst + margin + width, src[width - 1], (size_t)margin);
+    }
+    return padded;
+}
+
+/**
+ * Weight of a patch distance (sum of squared differences over `samples`
+ * pixel values) as exp(-mean / strength^2) in Q12, tabulated in buckets of
+ * 2^table_shift distances up to the point where it rounds to zero
+ */
+static void build_weight_table(nlm_job_t* job, size_t samples, float strength) {
+    double scale = (double)samples * (double)strength * (double)strength;
+    double cutoff = scale * log(2.0 * WEIGHT_ONE);
+    job->cutoff = cutoff < (double)UINT32_MAX ? (uint32_t)cutoff : UINT32_MAX;
+    job->table_shift = 0;
+    while ((job->cutoff >> job->table_shift) >= WEIGHT_TABLE_SIZE) {
+        job->table_shift++;
+    }
+    for (uint32_t i = 0; i < WEIGHT_TABLE_SIZE; i++) {
+        double distance = (double)((uint64_t)i << job->table_shift);
+        job->weight_table[i] = (uint16_t)(exp(-distance / scale) * WEIGHT_ONE + 0.5);
+    }
+}
+
+// squares[x] += (a[x] - b[x])^2
+static void add_squared_differences(const unsigned char* a, const unsigned char* b, size_t count, uint32_t* squares) {
+    size_t x = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= count; x += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        // |a - b| <= 255, so the squares fit in 16 bits
+        __m128i lo = _mm_unpacklo_epi8(diff, zero);
+        __m128i hi = _mm_unpackhi_epi8(diff, zero);
+        lo = _mm_mullo_epi16(lo, lo);
+        hi = _mm_mullo_epi16(hi, hi);
+        __m128i* out = (__m128i*)(squares + x);
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), _mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), _mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), _mm_unpackhi_epi16(hi, zero)));
+    }
+#endif
+    for (; x < count; x++) {
+        int diff = (int)a[x] - (int)b[x];
+        squares[x] += (uint32_t)(diff * diff);
+    }
+}
+
+/**
+ * Integral image of the squared differences between each pixel of the
+ * current strip grown by patch_radius and its neighbour at (dx, dy). Sums
+ * wrap modulo 2^32, which box sums below 2^32 tolerate. `squares` holds one
+ * row of the grown strip.
+ */
+static void difference_integral(const nlm_job_t* job, uint32_t* integral, uint32_t* squares, int dx, int dy) {
+    int patch = job->patch_radius;
+    size_t span_width = job->width + 2 * (size_t)patch;
+    size_t span_height = job->strip_rows + 2 * (size_t)patch;
+    size_t stride = span_width + 1;
+    ptrdiff_t offset = (ptrdiff_t)dy * (ptrdiff_t)job->padded_width + dx;
+    size_t skip = (size_t)(job->margin - patch);
+
+    memset(integral, 0, stride * sizeof(uint32_t));
+    for (size_t r = 0; r < span_height; r++) {
+        const uint32_t* above = integral + r * stride;
+        uint32_t* row = integral + (r + 1) * stride;
+        size_t start = (job->strip_y + r + skip) * job->padded_width + skip;
+
+        memset(squares, 0, span_width * sizeof(uint32_t));
+        for (int c = 0; c < job->channels; c++) {
+            const unsigned char* a = job->padded[c] + start;
+            add_squared_differences(a, a + offset, span_width, squares);
+        }
+
+        uint32_t run = 0;
+        row[0] = 0;
+        for (size_t x = 0; x < span_width; x++) {
+            run += squares[x];
+            row[x + 1] = above[x + 1] + run;
+        }
+    }
+}
+
+// Patch distance of each pixel of row y from the integral image
+static void patch_distance_row(const uint32_t* integral, size_t stride, size_t y, size_t width, int patch,
+                               uint32_t* distances) {
+    size_t size = 2 * (size_t)patch + 1;
+    const uint32_t* top = integral + y * stride;
+    const uint32_t* bottom = integral + (y + size) * stride;
+    size_t x = 0;
+#ifdef TERMIVIEW_SSE2
+    for (; x + 4 <= width; x += 4) {
+        __m128i d = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(bottom + x + size)),
+                                  _mm_loadu_si128((const __m128i*)(top + x + size)));
+        d = _mm_add_epi32(_mm_sub_epi32(d, _mm_loadu_si128((const __m128i*)(bottom + x))),
+                          _mm_loadu_si128((const __m128i*)(top + x)));
+        _mm_storeu_si128((__m128i*)(distances + x), d);
+    }
+#endif
+    for (; x < width; x++) {
+        distances[x] = bottom[x + size] - top[x + size] - bottom[x] + top[x];
+    }
+}
+
+// weight_sum += w, value_sum += w * neighbour, weight_max = max(weight_max, w)
+static void accumulate_row(const uint16_t* weights, const unsigned char* neighbours, size_t width,
+                           uint32_t* weight_sum, uint32_t* value_sum, uint16_t* weight_max) {
+    size_t x = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 8 <= width; x += 8) {
+        __m128i w = _mm_loadu_si128((const __m128i*)(weights + x));
+        __m128i q = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(neighbours + x)), zero);
+        __m128i lo = _mm_mullo_epi16(w, q);
+        __m128i hi = _mm_mulhi_epu16(w, q);
+        __m128i* values = (__m128i*)(value_sum + x);
+        _mm_storeu_si128(values, _mm_add_epi32(_mm_loadu_si128(values), _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(values + 1, _mm_add_epi32(_mm_loadu_si128(values + 1), _mm_unpackhi_epi16(lo, hi)));
+        if (weight_sum != NULL) {
+            __m128i* sums = (__m128i*)(weight_sum + x);
+            _mm_storeu_si128(sums, _mm_add_epi32(_mm_loadu_si128(sums), _mm_unpacklo_epi16(w, zero)));
+            _mm_storeu_si128(sums + 1, _mm_add_epi32(_mm_loadu_si128(sums + 1), _mm_unpackhi_epi16(w, zero)));
+            // Weights stay below 2^15, so the signed maximum is exact
+            __m128i* maxima = (__m128i*)(weight_max + x);
+            _mm_storeu_si128(maxima, _mm_max_epi16(_mm_loadu_si128(maxima), w));
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        value_sum[x] += (uint32_t)weights[x] * neighbours[x];
+        if (weight_sum != NULL) {
+            weight_sum[x] += weights[x];
+            if (weights[x] > weight_max[x]) {
+                weight_max[x] = weights[x];
+            }
+        }
+    }
+}
+
+// Items are groups of search offsets, each with its own accumulators; offsets
+// are numbered in raster order over the window without the centre
+static bool nl_means_offsets(void* context, const row_band_t* band) {
+    const nlm_job_t* job = (const nlm_job_t*)context;
+    int side = 2 * job->search_radius + 1;
+    int centre = side * side / 2;
+    size_t stride = job->width + 2 * (size_t)job->patch_radius + 1;
+
+    for (size_t group = band->begin; group < band->end; group++) {
+        const nlm_band_t* acc = &job->bands[group];
+        size_t first = job->offsets * group / job->band_count;
+        size_t last = job->offsets * (group + 1) / job->band_count;
+        for (size_t item = first; item < last; item++) {
+            int k = (int)item < centre ? (int)item : (int)item + 1;
+            int dx = k % side - job->search_radius;
+            int dy = k / side - job->search_radius;
+            difference_integral(job, acc->integral, acc->distances, dx, dy);
+
+            for (size_t y = 0; y < job->strip_rows; y++) {
+                patch_distance_row(acc->integral, stride, y, job->width, job->patch_radius, acc->distances);
+                for (size_t x = 0; x < job->width; x++) {
+                    uint32_t d = acc->distances[x];
+                    acc->weights[x] = d < job->cutoff ? job->weight_table[d >> job->table_shift] : 0;
+                }
+
+                size_t row = y * job->width;
+                size_t padded_row = job->strip_y + y + (size_t)job->margin;
+                size_t neighbour = (size_t)((ptrdiff_t)padded_row + dy) * job->padded_width +
+                                   (size_t)((ptrdiff_t)job->margin + dx);
+                for (int c = 0; c < job->channels; c++) {
+                    accumulate_row(acc->weights, job->padded[c] + neighbour, job->width,
+                                   c == 0 ? acc->weight_sum + row : NULL, acc->value_sum[c] + row,
+                                   acc->weight_max + row);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Combine the groups' sums for rows of the strip and divide; the centre
+// pixel weighs as much as its best match
+static bool nl_means_output_rows(void* context, const row_band_t* band) {
+    const nlm_job_t* job = (const nlm_job_t*)context;
+
+    for (size_t strip_row = band->begin; strip_row < band->end; strip_row++) {
+        size_t y = job->strip_y + strip_row;
+        for (size_t x = 0; x < job->width; x++) {
+            size_t i = strip_row * job->width + x;
+            uint32_t weight = 0;
+            uint32_t centre = 0;
+            uint32_t values[3] = { 0, 0, 0 };
+            for (size_t b = 0; b < job->band_count; b++) {
+                const nlm_band_t* acc = &job->bands[b];
+                weight += acc->weight_sum[i];
+                if (acc->weight_max[i] > centre) {
+                    centre = acc->weight_max[i];
+                }
+                for (int c = 0; c < job->channels; c++) {
+                    values[c] += acc->value_sum[c][i];
+                }
+            }
+            if (centre == 0) {
+                centre = WEIGHT_ONE;
+            }
+            weight += centre;
+
+            size_t padded = (y + (size_t)job->margin) * job->padded_width + x + (size_t)job->margin;
+            for (int c = 0; c < job->channels; c++) {
+                uint32_t value = values[c] + centre * job->padded[c][padded];
+                job->output[c][y * job->width + x] = (unsigned char)((value + weight / 2) / weight);
+            }
+        }
+    }
+    return true;
+}
+
+static void free_nlm_bands(nlm_band_t* bands, size_t count) {
+    for (size_t b = 0; b < count; b++) {
+        image_buffer_release(bands[b].weight_sum);
+        for (int c = 0; c < 3; c++) {
+            image_buffer_release(bands[b].value_sum[c]);
+        }
+        image_buffer_release(bands[b].weight_max);
+        image_buffer_release(bands[b].integral);
+        image_buffer_release(bands[b].distances);
+        image_buffer_release(bands[b].weights);
+    }
+    free(bands);
+}
+
+// Inputs are read once, into padded copies, so they may be views; outputs are packed
+static bool nl_means_planes(const unsigned char* const* inputs, size_t input_stride, unsigned char* const* outputs,
+                            int channels, size_t width, size_t height, int search_radius, int patch_radius,
+                            float strength) {
+    if (search_radius < 1 || search_radius > MAX_NLM_SEARCH_RADIUS ||
+        patch_radius < 0 || patch_radius > MAX_NLM_PATCH_RADIUS || !(strength > 0.0f)) {
+        fprintf(stderr, "Error: Non-local means radii must be in [1, %d] and [0, %d], with a positive strength\n",
+                MAX_NLM_SEARCH_RADIUS, MAX_NLM_PATCH_RADIUS);
+        return false;
+    }
+
+    nlm_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.channels = channels;
+    job.width = width;
+    job.height = height;
+    job.search_radius = search_radius;
+    job.patch_radius = patch_radius;
+    job.margin = search_radius + patch_radius;
+    job.padded_width = width + 2 * (size_t)job.margin;
+    size_t patch_size = 2 * (size_t)patch_radius + 1;
+    build_weight_table(&job, patch_size * patch_size * (size_t)channels, strength);
+
+    // Every group of offsets accumulates its own sums, so memory grows with
+    // the group count: filter the image in strips of rows sized to keep all
+    // groups' accumulators within NLM_MEMORY_BUDGET, and use fewer groups
+    // when even a minimal strip would not fit
+    size_t offsets = (2 * (size_t)search_radius + 1) * (2 * (size_t)search_radius + 1) - 1;
+    size_t offset_cost = width * height * (size_t)(channels + 4);
+    size_t band_count = parallel_band_count(offsets, offset_cost);
+    size_t row_bytes = width * (sizeof(uint32_t) * (1 + (size_t)channels) + sizeof(uint16_t)) +
+                       (width + patch_size) * sizeof(uint32_t);
+    size_t min_rows = height < 4 * patch_size ? height : 4 * patch_size;
+    if (band_count * row_bytes * min_rows > NLM_MEMORY_BUDGET) {
+        band_count = NLM_MEMORY_BUDGET / (row_bytes * min_rows);
+        band_count = band_count > 0 ? band_count : 1;
+    }
+    size_t strip_rows = NLM_MEMORY_BUDGET / (band_count * row_bytes);
+    strip_rows = strip_rows < min_rows ? min_rows : (strip_rows > height ? height : strip_rows);
+    size_t strip_pixels = width * strip_rows;
+    size_t integral_size = (width + patch_size) * (strip_rows + patch_size);
+
+    job.offsets = offsets;
+    job.band_count = band_count;
+    job.bands = (nlm_band_t*)calloc(band_count, sizeof(nlm_band_t));
+    bool ok = job.bands != NULL;
+    for (size_t b = 0; ok && b < band_count; b++) {
+        nlm_band_t* acc = &job.bands[b];
+        acc->weight_sum = (uint32_t*)image_buffer_acquire(strip_pixels * sizeof(uint32_t));
+        acc->weight_max = (uint16_t*)image_buffer_acquire(strip_pixels * sizeof(uint16_t));
+        acc->integral = (uint32_t*)image_buffer_acquire(integral_size * sizeof(uint32_t));
+        acc->distances = (uint32_t*)image_buffer_acquire((width + patch_size) * sizeof(uint32_t));
+        acc->weights = (uint16_t*)image_buffer_acquire(width * sizeof(uint16_t));
+        ok = acc->weight_sum != NULL && acc->weight_max != NULL && acc->integral != NULL &&
+             acc->distances != NULL && acc->weights != NULL;
+        for (int c = 0; ok && c < channels; c++) {
+            acc->value_sum[c] = (uint32_t*)image_buffer_acquire(strip_pixels * sizeof(uint32_t));
+            ok = acc->value_sum[c] != NULL;
+        }
+    }
+    for (int c = 0; ok && c < channels; c++) {
+        job.padded[c] = pad_channel(inputs[c], input_stride, width, height, job.margin);
+        job.output[c] = outputs[c];
+        ok = job.padded[c] != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to allocate memory for non-local means\n");
+    }
+
+    size_t group_cost = offset_cost / height * strip_rows * (offsets / band_count);
+    for (size_t y = 0; ok && y < height; y += strip_rows) {
+        job.strip_y = y;
+        job.strip_rows = height - y < strip_rows ? height - y : strip_rows;
+        size_t pixels = width * job.strip_rows;
+        for (size_t b = 0; b < band_count; b++) {
+            memset(job.bands[b].weight_sum, 0, pixels * sizeof(uint32_t));
+            memset(job.bands[b].weight_max, 0, pixels * sizeof(uint16_t));
+            for (int c = 0; c < channels; c++) {
+                memset(job.bands[b].value_sum[c], 0, pixels * sizeof(uint32_t));
+            }
+        }
+        ok = parallel_for(band_count, group_cost, 0, nl_means_offsets, &job);
+        ok = ok && parallel_for(job.strip_rows, width * band_count * (size_t)(channels + 2), 0,
+                                nl_means_output_rows, &job);
+    }
+
+    for (int c = 0; c < channels; c++) {
+        image_buffer_release((void*)job.padded[c]);
+    }
+    if (job.bands != NULL) {
+        free_nlm_bands(job.bands, band_count);
+    }
+    return ok;
+}
+
+grayscale_image_t apply_nl_means(const grayscale_image_t* image, int search_radius, int patch_radius,
+                                 float strength) {
+    grayscale_image_t result = {0};
+
+    if (image == NULL || image->data == NULL || image->width == 0 || image->height == 0) {
+        fprintf(stderr, "Error: Invalid input to apply_nl_means\n");
+        return result;
+    }
+
+    result = allocate_grayscale_image(image->width, image->height);
+    if (result.data == NULL) {
+        return result;
+    }
+
+    const unsigned char* inputs[1] = { image->data };
+    unsigned char* outputs[1] = { result.data };
+    if (!nl_means_planes(inputs, grayscale_stride(image), outputs, 1, image->width, image->height, search_radius,
+                         patch_radius, strength)) {
+        free_grayscale_image(&result);
+    }
+    return result;
+}
+
+rgb_image_t apply_nl_means_rgb(const rgb_image_t* image, int search_radius, int patch_radius,
+                               float strength) {
+    rgb_image_t result = {0};
+
+    if (image == NULL || image->r_data == NULL || image->g_data == NULL || image->b_data == NULL ||
+        image->width == 0 || image->height == 0) {
+        fprintf(stderr, "Error: Invalid input to apply_nl_means_rgb\n");
+        return result;
+    }
+
+    result = allocate_rgb_image(image->width, image->height);
+    bool ok = result.r_data != NULL;
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to allocate memory for non-local means\n");
+    } else {
+        const unsigned char* inputs[3] = { image->r_data, image->g_data, image->b_data };
+        unsigned char* outputs[3] = { result.r_data, result.g_data, result.b_data };
+        ok = nl_means_planes(inputs, rgb_stride(image), outputs, 3, image->width, image->height, search_radius,
+                             patch_radius, strength);
+    }
+
+    if (!ok) {
+        free_rgb_image(&result);
+        return result;
+    }
+
+    return result;
+}
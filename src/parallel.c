@@ -0,0 +1,158 @@
+#define _POSIX_C_SOURCE 200809L // sysconf
+
+#include "../include/parallel.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256
+
+static int configured_threads = 0;
+
+/**
+ * One parallel_for call: its bands are handed out by index to whichever
+ * thread asks first, the caller included
+ */
+typedef struct band_batch {
+    row_band_fn fn;
+    void* context;
+    size_t rows;
+    size_t halo;
+    size_t bands;
+    size_t next_band;               // Next band to hand out
+    size_t pending;                 // Bands handed out or not, still unfinished
+    bool ok;
+    struct band_batch* next;        // Queue link while bands are left to hand out
+} band_batch_t;
+
+// Worker pool, started on the first parallel_for that splits its rows and
+// kept for the rest of the process. Batches with bands left to hand out
+// wait in `queue`; all fields are guarded by pool_lock.
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t band_done = PTHREAD_COND_INITIALIZER;
+static band_batch_t* queue = NULL;
+static int pool_workers = 0;
+
+void set_thread_count(int threads) {
+    configured_threads = threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+int get_thread_count(void) {
+    if (configured_threads > 0) {
+        return configured_threads;
+    }
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) {
+        return 1;
+    }
+    return online > MAX_THREADS ? MAX_THREADS : (int)online;
+}
+
+size_t parallel_band_count(size_t rows, size_t row_cost) {
+    if (rows == 0) {
+        return 0;
+    }
+    size_t cost = rows * (row_cost > 0 ? row_cost : 1);
+    size_t bands = cost / PARALLEL_MIN_BAND_COST;
+    size_t threads = (size_t)get_thread_count();
+    if (bands > threads) bands = threads;
+    if (bands > rows) bands = rows;
+    return bands > 0 ? bands : 1;
+}
+
+static void run_band(band_batch_t* batch, size_t index) {
+    row_band_t band;
+    band.index = index;
+    band.begin = batch->rows * index / batch->bands;
+    band.end = batch->rows * (index + 1) / batch->bands;
+    band.halo_begin = band.begin > batch->halo ? band.begin - batch->halo : 0;
+    band.halo_end = batch->rows - band.end > batch->halo ? band.end + batch->halo : batch->rows;
+    bool ok = batch->fn(batch->context, &band);
+
+    pthread_mutex_lock(&pool_lock);
+    batch->ok = batch->ok && ok;
+    if (--batch->pending == 0) {
+        pthread_cond_broadcast(&band_done);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/**
+ * Hand out the batch's next band, dropping the batch from the queue once
+ * its last band is taken. Called with pool_lock held
+ */
+static size_t claim_band(band_batch_t* batch) {
+    size_t index = batch->next_band++;
+    if (batch->next_band == batch->bands) {
+        band_batch_t** link = &queue;
+        while (*link != batch) link = &(*link)->next;
+        *link = batch->next;
+    }
+    return index;
+}
+
+static void* pool_worker(void* arg) {
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (queue == NULL) {
+            pthread_cond_wait(&work_ready, &pool_lock);
+        }
+        band_batch_t* batch = queue;
+        size_t index = claim_band(batch);
+        pthread_mutex_unlock(&pool_lock);
+        run_band(batch, index);
+        pthread_mutex_lock(&pool_lock);
+    }
+    return NULL;
+}
+
+/**
+ * Start workers until there is one per thread beyond the caller's. The pool
+ * only grows: a lower thread count just caps the bands per call. Called
+ * with pool_lock held
+ */
+static void grow_pool(void) {
+    int wanted = get_thread_count() - 1;
+    while (pool_workers < wanted) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, pool_worker, NULL) != 0) {
+            break;
+        }
+        pthread_detach(thread);
+        pool_workers++;
+    }
+}
+
+bool parallel_for(size_t rows, size_t row_cost, size_t halo, row_band_fn fn, void* context) {
+    size_t bands = parallel_band_count(rows, row_cost);
+    if (bands == 0) {
+        return true;
+    }
+
+    band_batch_t batch = { fn, context, rows, halo, bands, 0, bands, true, NULL };
+    if (bands == 1) {
+        run_band(&batch, 0);
+        return batch.ok;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    grow_pool();
+    batch.next = queue;
+    queue = &batch;
+    pthread_cond_broadcast(&work_ready);
+
+    // The caller takes bands of its own batch as well, so the batch finishes
+    // even without workers and a band may call parallel_for itself
+    while (batch.next_band < bands) {
+        size_t index = claim_band(&batch);
+        pthread_mutex_unlock(&pool_lock);
+        run_band(&batch, index);
+        pthread_mutex_lock(&pool_lock);
+    }
+    while (batch.pending > 0) {
+        pthread_cond_wait(&band_done, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return batch.ok;
+}
@@ -0,0 +1,511 @@
+#include "../include/resample.h"
+#include "../include/image_alloc.h"
+#include "../include/parallel.h"
+#include "../include/simd.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define WEIGHT_BITS 14          // Weights of one destination pixel sum to 1 << WEIGHT_BITS
+#define INTERMEDIATE_BITS 6     // Fraction bits kept between the horizontal and vertical passes
+#define HORIZONTAL_SHIFT (WEIGHT_BITS - INTERMEDIATE_BITS)
+#define OUTPUT_SHIFT (WEIGHT_BITS + INTERMEDIATE_BITS)
+
+/**
+ * Filter weights along one axis: destination pixel i reads source pixels
+ * [first[i], first[i] + taps) with weights[i * taps ..]. Every window lies
+ * inside the source, so the inner loops need no bounds checks.
+ */
+typedef struct {
+    size_t taps;
+    size_t* first;
+    int16_t* weights;
+    int16_t* pair_weights;      // SSE2 layout for 2, 4 or 6 taps (see filter_row), or NULL
+} resample_axis_t;
+
+/**
+ * Weight tables for the last AXIS_CACHE_SIZE (source size, destination
+ * size, method) triples, replaced round robin. Video frames all share one
+ * size, so after the first frame no weights are recomputed. The cache is
+ * guarded by axis_cache_lock; a table stays alive while any resample still
+ * holds it, even after it has been replaced.
+ */
+#define AXIS_CACHE_SIZE 8
+
+typedef struct {
+    size_t src_size;
+    size_t dst_size;
+    interpolation_method_t method;
+    resample_axis_t axis;
+    size_t users;               // Resamples holding the table, plus one while it is cached
+} cached_axis_t;
+
+static cached_axis_t* axis_cache[AXIS_CACHE_SIZE];
+static size_t axis_cache_next;
+static pthread_mutex_t axis_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void free_axis(resample_axis_t* axis) {
+    free(axis->first);
+    free(axis->weights);
+    free(axis->pair_weights);
+    axis->first = NULL;
+    axis->weights = NULL;
+    axis->pair_weights = NULL;
+}
+
+// Support of the filter kernel in source pixels, before any stretching
+static double kernel_radius(interpolation_method_t method) {
+    switch (method) {
+        case INTERPOLATION_BILINEAR: return 1.0;
+        case INTERPOLATION_BICUBIC: return 2.0;
+        case INTERPOLATION_LANCZOS3: return 3.0;
+        default: return 0.5;
+    }
+}
+
+static double sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static double kernel_value(interpolation_method_t method, double x) {
+    x = fabs(x);
+    switch (method) {
+        case INTERPOLATION_BILINEAR:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case INTERPOLATION_BICUBIC:
+            // Keys cubic convolution with a = -0.5
+            if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+            if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+            return 0.0;
+        case INTERPOLATION_LANCZOS3:
+            return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+        default:
+            return 0.0;
+    }
+}
+
+/**
+ * Source pixels [*begin, *end) read by destination pixel i. Area averages
+ * cover exactly the destination pixel; the other kernels are centred on it
+ * and, when shrinking, stretched by the scale factor so they also average
+ * out the pixels in between. Windows are clipped to the source.
+ */
+static void axis_span(size_t i, size_t src_size, size_t dst_size, interpolation_method_t method,
+                      size_t* begin, size_t* end) {
+    if (method == INTERPOLATION_NEAREST) {
+        *begin = (i * src_size) / dst_size;
+        *end = *begin + 1;
+        return;
+    }
+    if (method == INTERPOLATION_AVERAGE) {
+        *begin = (i * src_size) / dst_size;
+        *end = ((i + 1) * src_size + dst_size - 1) / dst_size;
+        return;
+    }
+
+    double scale = (double)src_size / dst_size;
+    double support = kernel_radius(method) * (scale > 1.0 ? scale : 1.0);
+    double center = (i + 0.5) * scale;
+    double lo = floor(center - support + 0.5);
+    double hi = floor(center + support + 0.5);
+    *begin = lo > 0.0 ? (size_t)lo : 0;
+    *end = hi < (double)src_size ? (size_t)hi : src_size;
+    if (*end <= *begin) {
+        // Only possible far outside the source; keep the nearest edge pixel
+        *begin = *begin < src_size ? *begin : src_size - 1;
+        *end = *begin + 1;
+    }
+}
+
+// Weight of source pixel x for destination pixel i, before normalisation
+static double axis_weight(size_t i, size_t x, size_t src_size, size_t dst_size, interpolation_method_t method) {
+    if (method == INTERPOLATION_NEAREST) {
+        return 1.0;
+    }
+    if (method == INTERPOLATION_AVERAGE) {
+        // Overlap of [x, x + 1) and [i, i + 1) * src_size / dst_size, scaled by dst_size
+        size_t lo = i * src_size > x * dst_size ? i * src_size : x * dst_size;
+        size_t hi = (i + 1) * src_size < (x + 1) * dst_size ? (i + 1) * src_size : (x + 1) * dst_size;
+        return hi > lo ? (double)(hi - lo) : 0.0;
+    }
+
+    double scale = (double)src_size / dst_size;
+    double stretch = scale > 1.0 ? scale : 1.0;
+    double center = (i + 0.5) * scale;
+    return kernel_value(method, (x + 0.5 - center) / stretch);
+}
+
+static bool build_axis(size_t src_size, size_t dst_size, interpolation_method_t method, resample_axis_t* axis) {
+    size_t taps = 1;
+    for (size_t i = 0; i < dst_size; i++) {
+        size_t begin, end;
+        axis_span(i, src_size, dst_size, method, &begin, &end);
+        if (end - begin > taps) taps = end - begin;
+    }
+
+    axis->taps = taps;
+    axis->pair_weights = NULL;
+    axis->first = malloc(dst_size * sizeof(size_t));
+    axis->weights = calloc(dst_size * taps, sizeof(int16_t));
+    double* values = malloc(taps * sizeof(double));
+    if (axis->first == NULL || axis->weights == NULL || values == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for resampling weights\n");
+        free_axis(axis);
+        free(values);
+        return false;
+    }
+
+    for (size_t i = 0; i < dst_size; i++) {
+        int16_t* weights = axis->weights + i * taps;
+        size_t begin, end;
+        axis_span(i, src_size, dst_size, method, &begin, &end);
+
+        // Slide the window back at the far edge; the skipped taps stay zero
+        size_t first = begin + taps <= src_size ? begin : src_size - taps;
+        axis->first[i] = first;
+
+        double total = 0.0;
+        for (size_t x = begin; x < end; x++) {
+            values[x - begin] = axis_weight(i, x, src_size, dst_size, method);
+            total += values[x - begin];
+        }
+        if (total == 0.0) {
+            values[0] = total = 1.0;
+        }
+
+        // Round each normalised weight, then give the rounding error to the largest
+        int sum = 0;
+        size_t largest = begin - first;
+        for (size_t x = begin; x < end; x++) {
+            int weight = (int)lround(values[x - begin] / total * (1 << WEIGHT_BITS));
+            weights[x - first] = (int16_t)weight;
+            sum += weight;
+            if (weight > weights[largest]) largest = x - first;
+        }
+        weights[largest] = (int16_t)(weights[largest] + (1 << WEIGHT_BITS) - sum);
+    }
+    free(values);
+
+#ifdef TERMIVIEW_SSE2
+    // Groups of four destination pixels, weights interleaved a tap pair at
+    // a time: pair p of each of the four, then pair p + 1. Without the
+    // table filter_row stays scalar.
+    if (taps % 2 == 0 && taps < 8 && dst_size >= 4) {
+        size_t groups = dst_size / 4;
+        axis->pair_weights = malloc(groups * 4 * taps * sizeof(int16_t));
+        for (size_t g = 0; axis->pair_weights != NULL && g < groups; g++) {
+            int16_t* group = axis->pair_weights + g * 4 * taps;
+            for (size_t k = 0; k < taps; k += 2) {
+                for (size_t j = 0; j < 4; j++) {
+                    const int16_t* weights = axis->weights + (g * 4 + j) * taps;
+                    group[k * 4 + j * 2] = weights[k];
+                    group[k * 4 + j * 2 + 1] = weights[k + 1];
+                }
+            }
+        }
+    }
+#endif
+    return true;
+}
+
+static cached_axis_t* find_axis(size_t src_size, size_t dst_size, interpolation_method_t method) {
+    for (size_t slot = 0; slot < AXIS_CACHE_SIZE; slot++) {
+        cached_axis_t* entry = axis_cache[slot];
+        if (entry != NULL && entry->src_size == src_size && entry->dst_size == dst_size && entry->method == method) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void release_axis(cached_axis_t* entry) {
+    if (entry == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&axis_cache_lock);
+    bool last = --entry->users == 0;
+    pthread_mutex_unlock(&axis_cache_lock);
+    if (last) {
+        free_axis(&entry->axis);
+        free(entry);
+    }
+}
+
+/**
+ * Weights for one axis, from the cache when this size pair was seen before.
+ * The caller hands the table back with release_axis.
+ * Returns NULL on allocation failure
+ */
+static cached_axis_t* acquire_axis(size_t src_size, size_t dst_size, interpolation_method_t method) {
+    pthread_mutex_lock(&axis_cache_lock);
+    cached_axis_t* entry = find_axis(src_size, dst_size, method);
+    if (entry != NULL) {
+        entry->users++;
+    }
+    pthread_mutex_unlock(&axis_cache_lock);
+    if (entry != NULL) {
+        return entry;
+    }
+
+    // Built outside the lock; if another thread cached the same table
+    // meanwhile, that one is used instead
+    entry = malloc(sizeof(cached_axis_t));
+    if (entry == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for resampling weights\n");
+        return NULL;
+    }
+    if (!build_axis(src_size, dst_size, method, &entry->axis)) {
+        free(entry);
+        return NULL;
+    }
+    entry->src_size = src_size;
+    entry->dst_size = dst_size;
+    entry->method = method;
+    entry->users = 2;
+
+    pthread_mutex_lock(&axis_cache_lock);
+    cached_axis_t* existing = find_axis(src_size, dst_size, method);
+    cached_axis_t* evicted = NULL;
+    if (existing != NULL) {
+        existing->users++;
+    } else {
+        evicted = axis_cache[axis_cache_next];
+        axis_cache[axis_cache_next] = entry;
+        axis_cache_next = (axis_cache_next + 1) % AXIS_CACHE_SIZE;
+    }
+    pthread_mutex_unlock(&axis_cache_lock);
+
+    if (existing != NULL) {
+        free_axis(&entry->axis);
+        free(entry);
+        return existing;
+    }
+    release_axis(evicted);
+    return entry;
+}
+
+/**
+ * Horizontal pass over one source row: fixed-point output with
+ * INTERMEDIATE_BITS fraction bits
+ */
+static void filter_row(const unsigned char* src, const resample_axis_t* axis, size_t width, int16_t* out) {
+    size_t taps = axis->taps;
+    size_t i = 0;
+
+#ifdef TERMIVIEW_SSE2
+    if (axis->pair_weights != NULL) {
+        // Short kernels, four destination pixels at a time: each tap pair of
+        // the four windows against the interleaved weights, one multiply-add
+        // per pair
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i half = _mm_set1_epi32(1 << (HORIZONTAL_SHIFT - 1));
+        const int16_t* weights = axis->pair_weights;
+        for (; i + 4 <= width; i += 4) {
+            const unsigned char* p0 = src + axis->first[i];
+            const unsigned char* p1 = src + axis->first[i + 1];
+            const unsigned char* p2 = src + axis->first[i + 2];
+            const unsigned char* p3 = src + axis->first[i + 3];
+            __m128i acc = half;
+            for (size_t k = 0; k < taps; k += 2, weights += 8) {
+                __m128i pixels = _mm_set_epi16(0, 0, 0, 0, (short)(p3[k] | p3[k + 1] << 8), (short)(p2[k] | p2[k + 1] << 8),
+                                               (short)(p1[k] | p1[k + 1] << 8), (short)(p0[k] | p0[k + 1] << 8));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero),
+                                                        _mm_loadu_si128((const __m128i*)weights)));
+            }
+            acc = _mm_srai_epi32(acc, HORIZONTAL_SHIFT);
+            _mm_storel_epi64((__m128i*)(out + i), _mm_packs_epi32(acc, acc));
+        }
+    }
+#endif
+    for (; i < width; i++) {
+        const unsigned char* pixels = src + axis->first[i];
+        const int16_t* weights = axis->weights + i * taps;
+        int32_t sum = 0;
+        size_t k = 0;
+#ifdef TERMIVIEW_SSE2
+        if (taps >= 8) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i acc = _mm_setzero_si128();
+            for (; k + 8 <= taps; k += 8) {
+                __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pixels + k)), zero);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_loadu_si128((const __m128i*)(weights + k))));
+            }
+            acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+            acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+            sum = _mm_cvtsi128_si32(acc);
+        }
+#endif
+        for (; k < taps; k++) {
+            sum += pixels[k] * weights[k];
+        }
+        out[i] = (int16_t)((sum + (1 << (HORIZONTAL_SHIFT - 1))) >> HORIZONTAL_SHIFT);
+    }
+}
+
+// acc[i] += weight * row[i]
+static void accumulate_row(const int16_t* row, int16_t weight, int32_t* acc, size_t width) {
+    size_t i = 0;
+#ifdef TERMIVIEW_SSE2
+    // Pairs of (row, 0) against (weight, 0) multiply-add to row * weight
+    const __m128i weight_pairs = _mm_set1_epi32((uint16_t)weight);
+    for (; i + 8 <= width; i += 8) {
+        __m128i values = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i sign = _mm_srai_epi16(values, 15);
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(values, sign), weight_pairs);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(values, sign), weight_pairs);
+        _mm_storeu_si128((__m128i*)(acc + i), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i)), lo));
+        _mm_storeu_si128((__m128i*)(acc + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i + 4)), hi));
+    }
+#endif
+    for (; i < width; i++) {
+        acc[i] += row[i] * weight;
+    }
+}
+
+// Round the accumulated rows to bytes, saturating
+static void store_row(const int32_t* acc, unsigned char* out, size_t width) {
+    size_t i = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i half = _mm_set1_epi32(1 << (OUTPUT_SHIFT - 1));
+    for (; i + 8 <= width; i += 8) {
+        __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i)), half), OUTPUT_SHIFT);
+        __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i + 4)), half), OUTPUT_SHIFT);
+        __m128i words = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(words, words));
+    }
+#endif
+    for (; i < width; i++) {
+        int32_t value = (acc[i] + (1 << (OUTPUT_SHIFT - 1))) >> OUTPUT_SHIFT;
+        out[i] = (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+}
+
+typedef struct {
+    const unsigned char* planes[3];
+    unsigned char* outputs[3];
+    int channels;
+    size_t src_width;
+    size_t src_stride;
+    size_t width;
+    const resample_axis_t* horizontal;
+    const resample_axis_t* vertical;
+} resample_job_t;
+
+static bool resample_rows(void* context, const row_band_t* band) {
+    const resample_job_t* job = (const resample_job_t*)context;
+    const resample_axis_t* vertical = job->vertical;
+    size_t taps = vertical->taps;
+
+    // Horizontally filtered source rows, slot r % taps holding row r, so
+    // output rows whose windows overlap filter each source row only once
+    scratch_mark_t mark = scratch_mark();
+    int16_t* rows = scratch_alloc((size_t)job->channels * taps * job->width * sizeof(int16_t));
+    size_t* tags = scratch_alloc((size_t)job->channels * taps * sizeof(size_t));
+    int32_t* acc = scratch_alloc(job->width * sizeof(int32_t));
+    if (rows == NULL || tags == NULL || acc == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for resampling\n");
+        scratch_release(mark);
+        return false;
+    }
+    for (size_t slot = 0; slot < (size_t)job->channels * taps; slot++) {
+        tags[slot] = SIZE_MAX;
+    }
+
+    for (size_t y = band->begin; y < band->end; y++) {
+        const int16_t* weights = vertical->weights + y * taps;
+
+        for (int c = 0; c < job->channels; c++) {
+            memset(acc, 0, job->width * sizeof(int32_t));
+            for (size_t k = 0; k < taps; k++) {
+                if (weights[k] == 0) continue;
+                size_t src_row = vertical->first[y] + k;
+                size_t slot = (size_t)c * taps + src_row % taps;
+                int16_t* row = rows + slot * job->width;
+                if (tags[slot] != src_row) {
+                    filter_row(job->planes[c] + src_row * job->src_stride, job->horizontal, job->width, row);
+                    tags[slot] = src_row;
+                }
+                accumulate_row(row, weights[k], acc, job->width);
+            }
+            store_row(acc, job->outputs[c] + y * job->width, job->width);
+        }
+    }
+
+    scratch_release(mark);
+    return true;
+}
+
+/**
+ * Resample `channels` planes of src_width x src_height into width x height
+ */
+static bool resample_planes(resample_job_t* job, size_t src_height, size_t height, interpolation_method_t method) {
+    cached_axis_t* horizontal = acquire_axis(job->src_width, job->width, method);
+    cached_axis_t* vertical = horizontal != NULL ? acquire_axis(src_height, height, method) : NULL;
+    if (vertical == NULL) {
+        release_axis(horizontal);
+        return false;
+    }
+
+    job->horizontal = &horizontal->axis;
+    job->vertical = &vertical->axis;
+    size_t row_cost = job->width * (horizontal->axis.taps + vertical->axis.taps) * (size_t)job->channels;
+    bool ok = parallel_for(height, row_cost, 0, resample_rows, job);
+    release_axis(horizontal);
+    release_axis(vertical);
+    return ok;
+}
+
+grayscale_image_t resample_grayscale(const grayscale_image_t* image, size_t width, size_t height,
+                                     interpolation_method_t method) {
+    if (image == NULL || image->data == NULL || image->width == 0 || image->height == 0) {
+        fprintf(stderr, "Error: Invalid input to resample_grayscale\n");
+        return (grayscale_image_t) {0};
+    }
+
+    grayscale_image_t resized = allocate_grayscale_image(width, height);
+    if (resized.data == NULL) {
+        return resized;
+    }
+
+    resample_job_t job = { { image->data }, { resized.data }, 1, image->width, grayscale_stride(image), width, NULL, NULL };
+    if (width > 0 && height > 0 && !resample_planes(&job, image->height, height, method)) {
+        free_grayscale_image(&resized);
+        return (grayscale_image_t) {0};
+    }
+
+    return resized;
+}
+
+rgb_image_t resample_rgb(const rgb_image_t* image, size_t width, size_t height,
+                         interpolation_method_t method) {
+    if (image == NULL || image->r_data == NULL || image->g_data == NULL || image->b_data == NULL ||
+        image->width == 0 || image->height == 0) {
+        fprintf(stderr, "Error: Invalid input to resample_rgb\n");
+        return (rgb_image_t) {0};
+    }
+
+    rgb_image_t resized = allocate_rgb_image(width, height);
+    if (resized.r_data == NULL) {
+        return resized;
+    }
+
+    resample_job_t job = {
+        { image->r_data, image->g_data, image->b_data }, { resized.r_data, resized.g_data, resized.b_data }, 3,
+        image->width, rgb_stride(image), width, NULL, NULL
+    };
+    if (width > 0 && height > 0 && !resample_planes(&job, image->height, height, method)) {
+        free_rgb_image(&resized);
+        return (rgb_image_t) {0};
+    }
+
+    return resized;
+}
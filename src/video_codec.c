@@ -0,0 +1,731 @@
+#include "../include/video_codec.h"
+#include "../include/video_processing.h"
+#include "../include/compression.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define CODEC_BLOCK 8          // Residual transform block size
+#define CODEC_MACROBLOCK 16    // Motion compensation block size
+#define CODEC_SUBPEL 4         // Motion vectors are coded in quarter-pel units
+#define CODEC_EOB 64           // Run value that terminates a block
+#define CODEC_MAX_LEVEL 2047   // Largest quantized coefficient magnitude
+#define CODEC_MAX_PACKET (256u * 1024u * 1024u)
+
+static const char video_stream_magic[4] = { 'T', 'V', 'C', '1' };
+
+static float dct_basis[CODEC_BLOCK][CODEC_BLOCK];
+static unsigned char scan_to_natural[64];
+static pthread_once_t codec_tables_once = PTHREAD_ONCE_INIT;
+
+// Orthonormal DCT-II basis and the inverse of the zig-zag table
+static void build_codec_tables(void) {
+    for (int u = 0; u < CODEC_BLOCK; u++) {
+        float alpha = u == 0 ? sqrtf(1.0f / CODEC_BLOCK) : sqrtf(2.0f / CODEC_BLOCK);
+        for (int x = 0; x < CODEC_BLOCK; x++) {
+            dct_basis[u][x] = alpha * cosf((float)((2 * x + 1) * u) * (float)M_PI / (2.0f * CODEC_BLOCK));
+        }
+    }
+    for (int n = 0; n < 64; n++) {
+        scan_to_natural[zigzag_order[n]] = (unsigned char)n;
+    }
+}
+
+// Encoders and decoders may start on several threads at once
+static void init_codec_tables(void) {
+    pthread_once(&codec_tables_once, build_codec_tables);
+}
+
+// Separable 8x8 forward DCT (rows, then columns)
+static void forward_dct_8x8(const float* in, float* out) {
+    float tmp[64];
+    for (int y = 0; y < 8; y++) {
+        for (int u = 0; u < 8; u++) {
+            float sum = 0.0f;
+            for (int x = 0; x < 8; x++) {
+                sum += dct_basis[u][x] * in[y * 8 + x];
+            }
+            tmp[y * 8 + u] = sum;
+        }
+    }
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+            float sum = 0.0f;
+            for (int y = 0; y < 8; y++) {
+                sum += dct_basis[v][y] * tmp[y * 8 + u];
+            }
+            out[v * 8 + u] = sum;
+        }
+    }
+}
+
+// Separable 8x8 inverse DCT (columns, then rows)
+static void inverse_dct_8x8(const float* in, float* out) {
+    float tmp[64];
+    for (int y = 0; y < 8; y++) {
+        for (int u = 0; u < 8; u++) {
+            float sum = 0.0f;
+            for (int v = 0; v < 8; v++) {
+                sum += dct_basis[v][y] * in[v * 8 + u];
+            }
+            tmp[y * 8 + u] = sum;
+        }
+    }
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            float sum = 0.0f;
+            for (int u = 0; u < 8; u++) {
+                sum += dct_basis[u][x] * tmp[y * 8 + u];
+            }
+            out[y * 8 + x] = sum;
+        }
+    }
+}
+
+// IJG-style quality scaling of the intra (JPEG luminance) and flat inter tables
+static void scale_quant_tables(int quality, unsigned short* intra, unsigned short* inter) {
+    int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    for (int i = 0; i < 64; i++) {
+        int intra_q = (default_luminance_quant_table[i] * scale + 50) / 100;
+        int inter_q = (16 * scale + 50) / 100;
+        intra[i] = (unsigned short)(intra_q < 1 ? 1 : (intra_q > 255 ? 255 : intra_q));
+        inter[i] = (unsigned short)(inter_q < 1 ? 1 : (inter_q > 255 ? 255 : inter_q));
+    }
+}
+
+// Growable byte buffer for symbol streams and packets
+typedef struct {
+    unsigned char* data;
+    size_t len;
+    size_t capacity;
+    bool failed;
+} ByteBuffer;
+
+static void buffer_put(ByteBuffer* buf, unsigned char byte) {
+    if (buf->failed) {
+        return;
+    }
+    if (buf->len == buf->capacity) {
+        size_t new_capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        unsigned char* grown = (unsigned char*)realloc(buf->data, new_capacity);
+        if (grown == NULL) {
+            buf->failed = true;
+            return;
+        }
+        buf->data = grown;
+        buf->capacity = new_capacity;
+    }
+    buf->data[buf->len++] = byte;
+}
+
+static void buffer_put_u32(ByteBuffer* buf, unsigned int value) {
+    for (int i = 0; i < 4; i++) {
+        buffer_put(buf, (unsigned char)(value >> (8 * i)));
+    }
+}
+
+static void buffer_put_uvarint(ByteBuffer* buf, unsigned int value) {
+    while (value >= 0x80) {
+        buffer_put(buf, (unsigned char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer_put(buf, (unsigned char)value);
+}
+
+// Signed values are zig-zag mapped (0, -1, 1, -2, ...) so small magnitudes stay one byte
+static void buffer_put_svarint(ByteBuffer* buf, int value) {
+    buffer_put_uvarint(buf, value < 0 ? ((unsigned int)(-value) << 1) - 1 : (unsigned int)value << 1);
+}
+
+typedef struct {
+    const unsigned char* data;
+    size_t len;
+    size_t pos;
+    bool failed;
+} ByteReader;
+
+static unsigned int reader_get(ByteReader* reader) {
+    if (reader->pos >= reader->len) {
+        reader->failed = true;
+        return 0;
+    }
+    return reader->data[reader->pos++];
+}
+
+static unsigned int reader_get_u32(ByteReader* reader) {
+    unsigned int value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= reader_get(reader) << (8 * i);
+    }
+    return value;
+}
+
+static unsigned int reader_get_uvarint(ByteReader* reader) {
+    unsigned int value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        unsigned int byte = reader_get(reader);
+        value |= (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+static int reader_get_svarint(ByteReader* reader) {
+    unsigned int value = reader_get_uvarint(reader);
+    return (value & 1) ? -(int)((value + 1) >> 1) : (int)(value >> 1);
+}
+
+// Huffman-code a symbol stream: raw length, symbol frequencies, bit length, bits
+static bool entropy_encode(const ByteBuffer* symbols, ByteBuffer* packet) {
+    unsigned int frequencies[256];
+    calculate_frequencies(symbols->data, symbols->len, frequencies);
+
+    // A one-symbol alphabet would give a zero-length code; add a dummy sibling
+    int distinct = 0;
+    int last_symbol = 0;
+    for (int i = 0; i < 256; i++) {
+        if (frequencies[i] > 0) {
+            distinct++;
+            last_symbol = i;
+        }
+    }
+    if (distinct == 1) {
+        frequencies[(last_symbol + 1) & 0xFF] = 1;
+        distinct = 2;
+    }
+
+    huffman_codes_t* codes = build_huffman_codes(frequencies);
+    if (codes == NULL) {
+        return false;
+    }
+    size_t encoded_len_bits = 0;
+    unsigned char* encoded = huffman_encode(symbols->data, symbols->len, codes, &encoded_len_bits);
+    free_huffman_codes(codes);
+    if (encoded == NULL) {
+        return false;
+    }
+
+    buffer_put_u32(packet, (unsigned int)symbols->len);
+    buffer_put_uvarint(packet, (unsigned int)distinct);
+    for (int i = 0; i < 256; i++) {
+        if (frequencies[i] > 0) {
+            buffer_put(packet, (unsigned char)i);
+            buffer_put_uvarint(packet, frequencies[i]);
+        }
+    }
+    buffer_put_u32(packet, (unsigned int)encoded_len_bits);
+    size_t encoded_len_bytes = (encoded_len_bits + 7) / 8;
+    for (size_t i = 0; i < encoded_len_bytes; i++) {
+        buffer_put(packet, encoded[i]);
+    }
+    free(encoded);
+    return !packet->failed;
+}
+
+// Inverse of entropy_encode; returns the symbol stream
+static unsigned char* entropy_decode(ByteReader* reader, size_t* symbols_len) {
+    unsigned int frequencies[256] = {0};
+    size_t raw_len = reader_get_u32(reader);
+    unsigned int distinct = reader_get_uvarint(reader);
+    if (distinct > 256) {
+        return NULL;
+    }
+    for (unsigned int i = 0; i < distinct; i++) {
+        unsigned int symbol = reader_get(reader);
+        frequencies[symbol] = reader_get_uvarint(reader);
+    }
+    size_t encoded_len_bits = reader_get_u32(reader);
+    size_t encoded_len_bytes = (encoded_len_bits + 7) / 8;
+    if (reader->failed || raw_len == 0 || reader->len - reader->pos < encoded_len_bytes) {
+        return NULL;
+    }
+
+    HuffmanNode* tree = build_huffman_tree(frequencies);
+    if (tree == NULL) {
+        return NULL;
+    }
+    size_t decoded_len = 0;
+    unsigned char* decoded = huffman_decode(reader->data + reader->pos, encoded_len_bits, tree, &decoded_len);
+    free_huffman_tree(tree);
+    reader->pos += encoded_len_bytes;
+
+    if (decoded == NULL || decoded_len != raw_len) {
+        free(decoded);
+        return NULL;
+    }
+    *symbols_len = decoded_len;
+    return decoded;
+}
+
+// Transform, quantize and run-length code one residual block; returns its reconstruction
+static void encode_block(ByteBuffer* symbols, const float* residual, const unsigned short* quant, float* reconstructed) {
+    float coeffs[64];
+    float dequantized[64];
+    forward_dct_8x8(residual, coeffs);
+
+    int run = 0;
+    for (int k = 0; k < 64; k++) {
+        int n = scan_to_natural[k];
+        int level = (int)roundf(coeffs[n] / quant[n]);
+        if (level > CODEC_MAX_LEVEL) level = CODEC_MAX_LEVEL;
+        if (level < -CODEC_MAX_LEVEL) level = -CODEC_MAX_LEVEL;
+        dequantized[n] = (float)(level * quant[n]);
+        if (level == 0) {
+            run++;
+            continue;
+        }
+        buffer_put(symbols, (unsigned char)run);
+        buffer_put_svarint(symbols, level);
+        run = 0;
+    }
+    buffer_put(symbols, CODEC_EOB);
+
+    inverse_dct_8x8(dequantized, reconstructed);
+}
+
+static bool decode_block(ByteReader* reader, const unsigned short* quant, float* reconstructed) {
+    float dequantized[64] = {0};
+    int k = 0;
+    for (;;) {
+        unsigned int run = reader_get(reader);
+        if (reader->failed) {
+            return false;
+        }
+        if (run == CODEC_EOB) {
+            break;
+        }
+        k += (int)run;
+        if (k >= 64) {
+            return false;
+        }
+        int n = scan_to_natural[k];
+        dequantized[n] = (float)(reader_get_svarint(reader) * quant[n]);
+        k++;
+    }
+    inverse_dct_8x8(dequantized, reconstructed);
+    return !reader->failed;
+}
+
+// Gather the residual of an 8x8 block; edge blocks replicate the last row/column
+static void gather_residual(const grayscale_image_t* frame, const unsigned char* prediction,
+                            int block_x, int block_y, float* residual) {
+    int width = frame->width;
+    int height = frame->height;
+    for (int y = 0; y < CODEC_BLOCK; y++) {
+        int sy = block_y + y < height ? block_y + y : height - 1;
+        for (int x = 0; x < CODEC_BLOCK; x++) {
+            int sx = block_x + x < width ? block_x + x : width - 1;
+            size_t idx = (size_t)sy * width + sx;
+            residual[y * CODEC_BLOCK + x] = (float)frame->data[idx] - (float)prediction[idx];
+        }
+    }
+}
+
+// Add a decoded residual to the prediction for the pixels inside the frame
+static void reconstruct_block(grayscale_image_t* recon, const unsigned char* prediction,
+                              int block_x, int block_y, const float* residual) {
+    int width = recon->width;
+    int height = recon->height;
+    for (int y = 0; y < CODEC_BLOCK && block_y + y < height; y++) {
+        for (int x = 0; x < CODEC_BLOCK && block_x + x < width; x++) {
+            size_t idx = (size_t)(block_y + y) * width + (block_x + x);
+            int value = prediction[idx] + (int)lroundf(residual[y * CODEC_BLOCK + x]);
+            recon->data[idx] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+    }
+}
+
+// Motion vectors in quarter-pel units, predicted from the left neighbour in each macroblock row
+static int macroblocks_per_row(int width) {
+    return (width + CODEC_MACROBLOCK - 1) / CODEC_MACROBLOCK;
+}
+
+VideoEncoder* video_encoder_create(int width, int height, int gop_size, int quality, int search_window) {
+    if (width <= 0 || height <= 0 || gop_size < 1 || quality < 1 || quality > 100 || search_window < 0) {
+        fprintf(stderr, "Error: Invalid input to video_encoder_create\n");
+        return NULL;
+    }
+    init_codec_tables();
+
+    VideoEncoder* encoder = (VideoEncoder*)calloc(1, sizeof(VideoEncoder));
+    if (encoder == NULL) {
+        fprintf(stderr, "Error: Failed to allocate VideoEncoder\n");
+        return NULL;
+    }
+    encoder->header.width = width;
+    encoder->header.height = height;
+    encoder->header.gop_size = gop_size;
+    encoder->header.quality = quality;
+    encoder->search_window = search_window;
+    encoder->reference.width = width;
+    encoder->reference.height = height;
+    encoder->reference.data = (unsigned char*)calloc((size_t)width * height, sizeof(unsigned char));
+    if (encoder->reference.data == NULL) {
+        fprintf(stderr, "Error: Failed to allocate encoder reference frame\n");
+        free(encoder);
+        return NULL;
+    }
+    scale_quant_tables(quality, encoder->intra_quant, encoder->inter_quant);
+    return encoder;
+}
+
+unsigned char* video_encode_frame(VideoEncoder* encoder, const grayscale_image_t* frame, size_t* encoded_len_bytes) {
+    if (encoder == NULL || frame == NULL || frame->data == NULL || encoded_len_bytes == NULL ||
+        (int)frame->width != encoder->header.width || (int)frame->height != encoder->header.height) {
+        fprintf(stderr, "Error: Invalid input to video_encode_frame\n");
+        return NULL;
+    }
+
+    int width = encoder->header.width;
+    int height = encoder->header.height;
+    size_t num_pixels = (size_t)width * height;
+    bool intra = encoder->frame_index % encoder->header.gop_size == 0;
+    const unsigned short* quant = intra ? encoder->intra_quant : encoder->inter_quant;
+
+    ByteBuffer symbols = {0};
+    grayscale_image_t* prediction = NULL;
+    unsigned char* flat_prediction = NULL;
+    const unsigned char* predicted = NULL;
+
+    if (intra) {
+        flat_prediction = (unsigned char*)malloc(num_pixels);
+        if (flat_prediction == NULL) {
+            fprintf(stderr, "Error: Failed to allocate intra prediction\n");
+            return NULL;
+        }
+        memset(flat_prediction, 128, num_pixels);
+        predicted = flat_prediction;
+    } else {
+        // Motion search runs against the reconstruction so encoder and decoder stay in step
+        SubpelReference* subpel_ref = build_subpel_reference(&encoder->reference);
+        if (subpel_ref == NULL) {
+            return NULL;
+        }
+        MotionVectorField* mv_field = estimate_motion_subpel(frame, subpel_ref, CODEC_MACROBLOCK,
+                                                             encoder->search_window, CODEC_SUBPEL);
+        if (mv_field != NULL) {
+            prediction = compensate_motion_subpel(subpel_ref, mv_field, CODEC_MACROBLOCK);
+        }
+        free_subpel_reference(subpel_ref);
+        if (prediction == NULL) {
+            free_motion_vector_field(mv_field);
+            return NULL;
+        }
+
+        int mbs_x = macroblocks_per_row(width);
+        int pred_qx = 0, pred_qy = 0;
+        for (int i = 0; i < mv_field->num_vectors; i++) {
+            if (i % mbs_x == 0) {
+                pred_qx = pred_qy = 0;
+            }
+            const MotionVector* mv = &mv_field->vectors[i];
+            int qx = mv->dx * CODEC_SUBPEL + mv->frac_dx;
+            int qy = mv->dy * CODEC_SUBPEL + mv->frac_dy;
+            buffer_put_svarint(&symbols, qx - pred_qx);
+            buffer_put_svarint(&symbols, qy - pred_qy);
+            pred_qx = (int)qx;
+            pred_qy = (int)qy;
+        }
+        free_motion_vector_field(mv_field);
+        predicted = prediction->data;
+    }
+
+    // Residual blocks; the reconstruction becomes the next reference
+    grayscale_image_t recon = { .width = width, .height = height };
+    recon.data = (unsigned char*)malloc(num_pixels);
+    if (recon.data == NULL) {
+        fprintf(stderr, "Error: Failed to allocate reconstructed frame\n");
+        free(flat_prediction);
+        if (prediction) { free_grayscale_image(prediction); free(prediction); }
+        free(symbols.data);
+        return NULL;
+    }
+
+    float residual[64];
+    float reconstructed[64];
+    for (int block_y = 0; block_y < height; block_y += CODEC_BLOCK) {
+        for (int block_x = 0; block_x < width; block_x += CODEC_BLOCK) {
+            gather_residual(frame, predicted, block_x, block_y, residual);
+            encode_block(&symbols, residual, quant, reconstructed);
+            reconstruct_block(&recon, predicted, block_x, block_y, reconstructed);
+        }
+    }
+
+    free(flat_prediction);
+    if (prediction) { free_grayscale_image(prediction); free(prediction); }
+
+    ByteBuffer packet = {0};
+    buffer_put(&packet, intra ? VIDEO_FRAME_INTRA : VIDEO_FRAME_PREDICTED);
+    bool ok = !symbols.failed && entropy_encode(&symbols, &packet);
+    free(symbols.data);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to entropy code video frame\n");
+        free(packet.data);
+        free(recon.data);
+        return NULL;
+    }
+
+    free(encoder->reference.data);
+    encoder->reference = recon;
+    encoder->frame_index++;
+
+    *encoded_len_bytes = packet.len;
+    return packet.data;
+}
+
+void video_encoder_free(VideoEncoder* encoder) {
+    if (encoder) {
+        free(encoder->reference.data);
+        free(encoder);
+    }
+}
+
+VideoDecoder* video_decoder_create(const VideoStreamHeader* header) {
+    if (header == NULL || header->width <= 0 || header->height <= 0 || header->gop_size < 1 ||
+        header->quality < 1 || header->quality > 100) {
+        fprintf(stderr, "Error: Invalid input to video_decoder_create\n");
+        return NULL;
+    }
+    init_codec_tables();
+
+    VideoDecoder* decoder = (VideoDecoder*)calloc(1, sizeof(VideoDecoder));
+    if (decoder == NULL) {
+        fprintf(stderr, "Error: Failed to allocate VideoDecoder\n");
+        return NULL;
+    }
+    decoder->header = *header;
+    decoder->reference.width = header->width;
+    decoder->reference.height = header->height;
+    decoder->reference.data = (unsigned char*)calloc((size_t)header->width * header->height, sizeof(unsigned char));
+    if (decoder->reference.data == NULL) {
+        fprintf(stderr, "Error: Failed to allocate decoder reference frame\n");
+        free(decoder);
+        return NULL;
+    }
+    scale_quant_tables(header->quality, decoder->intra_quant, decoder->inter_quant);
+    return decoder;
+}
+
+bool video_decode_frame(VideoDecoder* decoder, const unsigned char* packet, size_t packet_len, grayscale_image_t* out_frame) {
+    if (decoder == NULL || packet == NULL || packet_len < 1 || out_frame == NULL) {
+        fprintf(stderr, "Error: Invalid input to video_decode_frame\n");
+        return false;
+    }
+
+    int width = decoder->header.width;
+    int height = decoder->header.height;
+    size_t num_pixels = (size_t)width * height;
+    bool intra = packet[0] == VIDEO_FRAME_INTRA;
+    if (!intra && packet[0] != VIDEO_FRAME_PREDICTED) {
+        fprintf(stderr, "Error: Unknown video frame type '%c'\n", packet[0]);
+        return false;
+    }
+    const unsigned short* quant = intra ? decoder->intra_quant : decoder->inter_quant;
+
+    ByteReader packet_reader = { .data = packet, .len = packet_len, .pos = 1 };
+    size_t symbols_len = 0;
+    unsigned char* symbols = entropy_decode(&packet_reader, &symbols_len);
+    if (symbols == NULL) {
+        fprintf(stderr, "Error: Corrupt video frame packet\n");
+        return false;
+    }
+    ByteReader reader = { .data = symbols, .len = symbols_len };
+
+    grayscale_image_t* prediction = NULL;
+    unsigned char* flat_prediction = NULL;
+    const unsigned char* predicted = NULL;
+
+    if (intra) {
+        flat_prediction = (unsigned char*)malloc(num_pixels);
+        if (flat_prediction == NULL) {
+            fprintf(stderr, "Error: Failed to allocate intra prediction\n");
+            free(symbols);
+            return false;
+        }
+        memset(flat_prediction, 128, num_pixels);
+        predicted = flat_prediction;
+    } else {
+        int mbs_x = macroblocks_per_row(width);
+        int mbs_y = (height + CODEC_MACROBLOCK - 1) / CODEC_MACROBLOCK;
+        MotionVectorField mv_field = { .num_vectors = mbs_x * mbs_y };
+        mv_field.vectors = (MotionVector*)malloc(sizeof(MotionVector) * mv_field.num_vectors);
+        SubpelReference* subpel_ref = build_subpel_reference(&decoder->reference);
+        if (mv_field.vectors == NULL || subpel_ref == NULL) {
+            free(mv_field.vectors);
+            free_subpel_reference(subpel_ref);
+            free(symbols);
+            return false;
+        }
+
+        int pred_qx = 0, pred_qy = 0;
+        for (int i = 0; i < mv_field.num_vectors; i++) {
+            if (i % mbs_x == 0) {
+                pred_qx = pred_qy = 0;
+            }
+            long qx = (long)pred_qx + reader_get_svarint(&reader);
+            long qy = (long)pred_qy + reader_get_svarint(&reader);
+            // The encoder never points outside the frame; anything larger is corrupt
+            if (labs(qx) > (long)width * CODEC_SUBPEL || labs(qy) > (long)height * CODEC_SUBPEL) {
+                fprintf(stderr, "Error: Motion vector out of range in video frame\n");
+                reader.failed = true;
+                break;
+            }
+            MotionVector* mv = &mv_field.vectors[i];
+            mv->block_x = (i % mbs_x) * CODEC_MACROBLOCK;
+            mv->block_y = (i / mbs_x) * CODEC_MACROBLOCK;
+            mv->frac_dx = ((qx % CODEC_SUBPEL) + CODEC_SUBPEL) % CODEC_SUBPEL;
+            mv->frac_dy = ((qy % CODEC_SUBPEL) + CODEC_SUBPEL) % CODEC_SUBPEL;
+            mv->dx = (qx - mv->frac_dx) / CODEC_SUBPEL;
+            mv->dy = (qy - mv->frac_dy) / CODEC_SUBPEL;
+            pred_qx = (int)qx;
+            pred_qy = (int)qy;
+        }
+
+        if (!reader.failed) {
+            prediction = compensate_motion_subpel(subpel_ref, &mv_field, CODEC_MACROBLOCK);
+        }
+        free(mv_field.vectors);
+        free_subpel_reference(subpel_ref);
+        if (prediction == NULL) {
+            free(symbols);
+            return false;
+        }
+        predicted = prediction->data;
+    }
+
+    grayscale_image_t recon = { .width = width, .height = height };
+    recon.data = (unsigned char*)malloc(num_pixels);
+    bool ok = recon.data != NULL;
+
+    float reconstructed[64];
+    for (int block_y = 0; ok && block_y < height; block_y += CODEC_BLOCK) {
+        for (int block_x = 0; ok && block_x < width; block_x += CODEC_BLOCK) {
+            ok = decode_block(&reader, quant, reconstructed);
+            if (ok) {
+                reconstruct_block(&recon, predicted, block_x, block_y, reconstructed);
+            }
+        }
+    }
+
+    free(symbols);
+    free(flat_prediction);
+    if (prediction) { free_grayscale_image(prediction); free(prediction); }
+
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to decode video frame residual\n");
+        free(recon.data);
+        return false;
+    }
+
+    // Hand the caller its own copy; the reconstruction stays as the next reference
+    *out_frame = (grayscale_image_t) {0};
+    out_frame->width = width;
+    out_frame->height = height;
+    out_frame->data = (unsigned char*)malloc(num_pixels);
+    if (out_frame->data == NULL) {
+        fprintf(stderr, "Error: Failed to allocate decoded frame\n");
+        free(recon.data);
+        out_frame->width = 0;
+        out_frame->height = 0;
+        return false;
+    }
+    memcpy(out_frame->data, recon.data, num_pixels);
+
+    free(decoder->reference.data);
+    decoder->reference = recon;
+    decoder->frame_index++;
+    return true;
+}
+
+void video_decoder_free(VideoDecoder* decoder) {
+    if (decoder) {
+        free(decoder->reference.data);
+        free(decoder);
+    }
+}
+
+static bool write_u32(FILE* out, unsigned int value) {
+    unsigned char bytes[4] = {
+        (unsigned char)value, (unsigned char)(value >> 8),
+        (unsigned char)(value >> 16), (unsigned char)(value >> 24)
+    };
+    return fwrite(bytes, 1, 4, out) == 4;
+}
+
+static bool read_u32(FILE* in, unsigned int* value) {
+    unsigned char bytes[4];
+    if (fread(bytes, 1, 4, in) != 4) {
+        return false;
+    }
+    *value = (unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) |
+             ((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+    return true;
+}
+
+bool write_video_stream_header(FILE* out, const VideoStreamHeader* header) {
+    if (out == NULL || header == NULL) {
+        return false;
+    }
+    return fwrite(video_stream_magic, 1, 4, out) == 4 &&
+           write_u32(out, (unsigned int)header->width) &&
+           write_u32(out, (unsigned int)header->height) &&
+           write_u32(out, (unsigned int)header->gop_size) &&
+           write_u32(out, (unsigned int)header->quality);
+}
+
+bool read_video_stream_header(FILE* in, VideoStreamHeader* header) {
+    char magic[4];
+    unsigned int width, height, gop_size, quality;
+    if (in == NULL || header == NULL || fread(magic, 1, 4, in) != 4 ||
+        memcmp(magic, video_stream_magic, 4) != 0) {
+        fprintf(stderr, "Error: Not a TermiView video stream\n");
+        return false;
+    }
+    if (!read_u32(in, &width) || !read_u32(in, &height) || !read_u32(in, &gop_size) || !read_u32(in, &quality)) {
+        fprintf(stderr, "Error: Truncated video stream header\n");
+        return false;
+    }
+    header->width = (int)width;
+    header->height = (int)height;
+    header->gop_size = (int)gop_size;
+    header->quality = (int)quality;
+    return true;
+}
+
+bool write_video_packet(FILE* out, const unsigned char* packet, size_t packet_len) {
+    if (out == NULL || packet == NULL || packet_len > CODEC_MAX_PACKET) {
+        return false;
+    }
+    return write_u32(out, (unsigned int)packet_len) && fwrite(packet, 1, packet_len, out) == packet_len;
+}
+
+unsigned char* read_video_packet(FILE* in, size_t* packet_len) {
+    unsigned int len;
+    if (in == NULL || packet_len == NULL || !read_u32(in, &len)) {
+        return NULL; // End of stream
+    }
+    if (len == 0 || len > CODEC_MAX_PACKET) {
+        fprintf(stderr, "Error: Invalid video packet length %u\n", len);
+        return NULL;
+    }
+    unsigned char* packet = (unsigned char*)malloc(len);
+    if (packet == NULL) {
+        fprintf(stderr, "Error: Failed to allocate video packet\n");
+        return NULL;
+    }
+    if (fread(packet, 1, len, in) != len) {
+        fprintf(stderr, "Error: Truncated video packet\n");
+        free(packet);
+        return NULL;
+    }
+    *packet_len = len;
+    return packet;
+}
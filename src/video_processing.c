@@ -1,11 +1,16 @@
 #include "../include/video_processing.h"
 #include "../include/image_processing.h"
+#include "../include/image_alloc.h"
+#include "../include/simd.h"
+#include "../include/integral_image.h"
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 // Initialize FFmpeg and open video file
 VideoContext* open_video(const char* filename) {
@@ -129,7 +134,8 @@ bool read_video_frame(VideoContext* vid_ctx, rgb_image_t* out_rgb_frame) {
     int num_bytes;
 
     while (av_read_frame(vid_ctx->fmt_ctx, vid_ctx->packet) >= 0) {
-        if (vid_ctx->packet->stream_index == vid_ctx->video_stream_idx) {
+        if (vid_ctx->packet->stream_index == vid_ctx->video_stream_idx &&
+            (!vid_ctx->keyframes_only || (vid_ctx->packet->flags & AV_PKT_FLAG_KEY))) {
             response = avcodec_send_packet(vid_ctx->codec_ctx, vid_ctx->packet);
             if (response < 0) {
                 fprintf(stderr, "Error while sending a packet to the decoder\n");
@@ -177,15 +183,10 @@ bool read_video_frame(VideoContext* vid_ctx, rgb_image_t* out_rgb_frame) {
                 );
 
                 // Populate out_rgb_frame
-                out_rgb_frame->width = vid_ctx->width;
-                out_rgb_frame->height = vid_ctx->height;
-                out_rgb_frame->r_data = (unsigned char*)malloc(num_bytes / 3);
-                out_rgb_frame->g_data = (unsigned char*)malloc(num_bytes / 3);
-                out_rgb_frame->b_data = (unsigned char*)malloc(num_bytes / 3);
+                *out_rgb_frame = allocate_rgb_image(vid_ctx->width, vid_ctx->height);
 
-                if (!out_rgb_frame->r_data || !out_rgb_frame->g_data || !out_rgb_frame->b_data) {
+                if (!out_rgb_frame->r_data) {
                     fprintf(stderr, "Error: Could not allocate RGB data for out_rgb_frame\n");
-                    free(out_rgb_frame->r_data); free(out_rgb_frame->g_data); free(out_rgb_frame->b_data);
                     av_free(buffer);
                     av_frame_free(&pFrameRGB);
                     av_packet_unref(vid_ctx->packet);
@@ -213,6 +214,15 @@ bool read_video_frame(VideoContext* vid_ctx, rgb_image_t* out_rgb_frame) {
     return false; // EOF or error
 }
 
+// Restrict decoding to keyframes
+void set_video_keyframes_only(VideoContext* vid_ctx, bool keyframes_only) {
+    if (vid_ctx == NULL) {
+        return;
+    }
+    vid_ctx->keyframes_only = keyframes_only;
+    vid_ctx->codec_ctx->skip_frame = keyframes_only ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+}
+
 // Close video context and free resources
 void close_video(VideoContext* vid_ctx) {
     if (vid_ctx) {
@@ -258,17 +268,32 @@ grayscale_image_t temporal_average(grayscale_image_t** frames, int num_frames) {
     return result;
 }
 
-// Helper function to calculate Mean Absolute Difference (MAD) between two blocks
-static double calculate_mad(const unsigned char* block1, int block1_stride,
-                           const unsigned char* block2, int block2_stride,
-                           int block_size) {
-    double mad = 0.0;
-    for (int y = 0; y < block_size; y++) {
-        for (int x = 0; x < block_size; x++) {
-            mad += abs(block1[y * block1_stride + x] - block2[y * block2_stride + x]);
+// Sum of absolute differences between a block and a reference plane region
+static unsigned int block_sad(const unsigned char* block, int block_stride,
+                              const unsigned char* ref, int ref_stride,
+                              int block_w, int block_h) {
+    unsigned int sad = 0;
+    for (int y = 0; y < block_h; y++) {
+        const unsigned char* a = block + (size_t)y * block_stride;
+        const unsigned char* b = ref + (size_t)y * ref_stride;
+        int x = 0;
+#ifdef TERMIVIEW_SSE2
+        __m128i acc = _mm_setzero_si128();
+        for (; x + 16 <= block_w; x += 16) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(a + x)),
+                                                  _mm_loadu_si128((const __m128i*)(b + x))));
+        }
+        for (; x + 8 <= block_w; x += 8) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadl_epi64((const __m128i*)(a + x)),
+                                                  _mm_loadl_epi64((const __m128i*)(b + x))));
+        }
+        sad += (unsigned int)_mm_cvtsi128_si32(acc) + (unsigned int)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+        for (; x < block_w; x++) {
+            sad += (unsigned int)abs(a[x] - b[x]);
         }
     }
-    return mad / (block_size * block_size);
+    return sad;
 }
 
 // Function to estimate motion between two frames using Block Matching
@@ -309,7 +334,13 @@ MotionVectorField* estimate_motion(const grayscale_image_t* current_frame,
             int current_block_x = bx * block_size;
             int current_block_y = by * block_size;
 
-            double min_mad = -1.0;
+            // Edge blocks are clipped to the part inside the frame
+            int block_w = width - current_block_x < block_size ? width - current_block_x : block_size;
+            int block_h = height - current_block_y < block_size ? height - current_block_y : block_size;
+            const unsigned char* current_block = current_frame->data + (size_t)current_block_y * width + current_block_x;
+
+            unsigned int min_sad = 0;
+            bool found = false;
             int best_dx = 0;
             int best_dy = 0;
 
@@ -322,67 +353,30 @@ MotionVectorField* estimate_motion(const grayscale_image_t* current_frame,
             // Clamp search area to frame boundaries
             if (search_start_x < 0) search_start_x = 0;
             if (search_start_y < 0) search_start_y = 0;
-            if (search_end_x + block_size > width) search_end_x = width - block_size;
-            if (search_end_y + block_size > height) search_end_y = height - block_size;
-
-
-            // Extract current block data
-            unsigned char* current_block_data = (unsigned char*)malloc(block_size * block_size);
-            if (current_block_data == NULL) {
-                // Handle error
-                fprintf(stderr, "Error: Failed to allocate current_block_data\n");
-                free(mv_field->vectors);
-                free(mv_field);
-                return NULL;
-            }
-            for (int y = 0; y < block_size; y++) {
-                if (current_block_y + y < height && current_block_x < width) { // Ensure within bounds
-                    memcpy(current_block_data + y * block_size, 
-                           current_frame->data + (current_block_y + y) * width + current_block_x, 
-                           block_size);
-                } else { // Fill with padding if outside image bounds
-                    memset(current_block_data + y * block_size, 0, block_size);
-                }
-            }
-
+            if (search_end_x + block_w > width) search_end_x = width - block_w;
+            if (search_end_y + block_h > height) search_end_y = height - block_h;
 
+            // Candidates are compared in place; SAD ranks blocks the same way MAD does
             for (int ref_y = search_start_y; ref_y <= search_end_y; ref_y++) {
                 for (int ref_x = search_start_x; ref_x <= search_end_x; ref_x++) {
-                    if (ref_x + block_size > width || ref_y + block_size > height) {
-                        continue; // Skip if candidate block goes out of bounds
-                    }
-
-                    unsigned char* ref_block_data = (unsigned char*)malloc(block_size * block_size);
-                    if (ref_block_data == NULL) {
-                        // Handle error
-                        fprintf(stderr, "Error: Failed to allocate ref_block_data\n");
-                        free(current_block_data);
-                        free(mv_field->vectors);
-                        free(mv_field);
-                        return NULL;
-                    }
-                    for (int y = 0; y < block_size; y++) {
-                        memcpy(ref_block_data + y * block_size, 
-                               reference_frame->data + (ref_y + y) * width + ref_x, 
-                               block_size);
-                    }
+                    const unsigned char* ref_block = reference_frame->data + (size_t)ref_y * width + ref_x;
+                    unsigned int sad = block_sad(current_block, width, ref_block, width, block_w, block_h);
 
-                    double mad = calculate_mad(current_block_data, block_size, ref_block_data, block_size, block_size);
-                    
-                    if (min_mad == -1.0 || mad < min_mad) {
-                        min_mad = mad;
+                    if (!found || sad < min_sad) {
+                        found = true;
+                        min_sad = sad;
                         best_dx = ref_x - current_block_x;
                         best_dy = ref_y - current_block_y;
                     }
-                    free(ref_block_data);
                 }
             }
-            free(current_block_data);
 
             mv_field->vectors[vector_idx].block_x = current_block_x;
             mv_field->vectors[vector_idx].block_y = current_block_y;
             mv_field->vectors[vector_idx].dx = best_dx;
             mv_field->vectors[vector_idx].dy = best_dy;
+            mv_field->vectors[vector_idx].frac_dx = 0;
+            mv_field->vectors[vector_idx].frac_dy = 0;
             vector_idx++;
         }
     }
@@ -397,22 +391,33 @@ grayscale_image_t* compensate_motion(const grayscale_image_t* reference_frame, c
         return NULL;
     }
 
+    // Fractional vectors need the interpolated planes; build them once for the whole frame
+    for (int i = 0; i < mv_field->num_vectors; i++) {
+        if (mv_field->vectors[i].frac_dx != 0 || mv_field->vectors[i].frac_dy != 0) {
+            SubpelReference* subpel_ref = build_subpel_reference(reference_frame);
+            if (subpel_ref == NULL) {
+                return NULL;
+            }
+            grayscale_image_t* subpel_frame = compensate_motion_subpel(subpel_ref, mv_field, block_size);
+            free_subpel_reference(subpel_ref);
+            return subpel_frame;
+        }
+    }
+
     int width = reference_frame->width;
     int height = reference_frame->height;
 
-    grayscale_image_t* compensated_frame = (grayscale_image_t*)malloc(sizeof(grayscale_image_t));
+    grayscale_image_t* compensated_frame = (grayscale_image_t*)calloc(1, sizeof(grayscale_image_t));
     if (compensated_frame == NULL) {
         fprintf(stderr, "Error: Failed to allocate compensated_frame\n");
         return NULL;
     }
-    compensated_frame->width = width;
-    compensated_frame->height = height;
-    compensated_frame->data = (unsigned char*)calloc(width * height, sizeof(unsigned char));
+    *compensated_frame = allocate_grayscale_image((size_t)width, (size_t)height);
     if (compensated_frame->data == NULL) {
-        fprintf(stderr, "Error: Failed to allocate compensated_frame data\n");
         free(compensated_frame);
         return NULL;
     }
+    memset(compensated_frame->data, 0, (size_t)width * height);
 
     for (int i = 0; i < mv_field->num_vectors; i++) {
         MotionVector mv = mv_field->vectors[i];
@@ -446,6 +451,384 @@ grayscale_image_t* compensate_motion(const grayscale_image_t* reference_frame, c
     return compensated_frame;
 }
 
+// Edge padding around the reference for the 6-tap filter (taps reach -2..+3)
+#define SUBPEL_PAD 3
+
+static inline unsigned char clamp_pixel(int value) {
+    if (value < 0) return 0;
+    if (value > 255) return 255;
+    return (unsigned char)value;
+}
+
+// Horizontal 6-tap (1, -5, 20, 20, -5, 1) over one padded row, kept unrounded in 16 bits
+static void sixtap_row_h(const unsigned char* src, short* dst, int width) {
+    int x = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i five = _mm_set1_epi16(5);
+    const __m128i twenty = _mm_set1_epi16(20);
+    for (; x + 8 <= width; x += 8) {
+        __m128i p0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + x - 2)), zero);
+        __m128i p1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + x - 1)), zero);
+        __m128i p2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + x)), zero);
+        __m128i p3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + x + 1)), zero);
+        __m128i p4 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + x + 2)), zero);
+        __m128i p5 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + x + 3)), zero);
+        __m128i sum = _mm_add_epi16(p0, p5);
+        sum = _mm_sub_epi16(sum, _mm_mullo_epi16(_mm_add_epi16(p1, p4), five));
+        sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_add_epi16(p2, p3), twenty));
+        _mm_storeu_si128((__m128i*)(dst + x), sum);
+    }
+#endif
+    for (; x < width; x++) {
+        dst[x] = (short)(src[x - 2] + src[x + 3] - 5 * (src[x - 1] + src[x + 2]) + 20 * (src[x] + src[x + 1]));
+    }
+}
+
+// Vertical 6-tap over six padded byte rows, rounded back to pixels
+static void sixtap_rows_v(const unsigned char* const rows[6], unsigned char* dst, int width) {
+    int x = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i five = _mm_set1_epi16(5);
+    const __m128i twenty = _mm_set1_epi16(20);
+    const __m128i round = _mm_set1_epi16(16);
+    for (; x + 8 <= width; x += 8) {
+        __m128i p0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[0] + x)), zero);
+        __m128i p1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[1] + x)), zero);
+        __m128i p2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[2] + x)), zero);
+        __m128i p3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[3] + x)), zero);
+        __m128i p4 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[4] + x)), zero);
+        __m128i p5 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[5] + x)), zero);
+        __m128i sum = _mm_add_epi16(p0, p5);
+        sum = _mm_sub_epi16(sum, _mm_mullo_epi16(_mm_add_epi16(p1, p4), five));
+        sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_add_epi16(p2, p3), twenty));
+        sum = _mm_srai_epi16(_mm_add_epi16(sum, round), 5);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(sum, sum));
+    }
+#endif
+    for (; x < width; x++) {
+        int sum = rows[0][x] + rows[5][x] - 5 * (rows[1][x] + rows[4][x]) + 20 * (rows[2][x] + rows[3][x]);
+        dst[x] = clamp_pixel((sum + 16) >> 5);
+    }
+}
+
+// Vertical 6-tap over six rows of horizontal sums, giving the centre half-pel phase
+static void sixtap_sums_v(const short* const rows[6], unsigned char* dst, int width) {
+    int x = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i minus_five = _mm_set1_epi16(-5);
+    const __m128i twenty = _mm_set1_epi16(20);
+    const __m128i round = _mm_set1_epi32(512);
+    for (; x + 8 <= width; x += 8) {
+        __m128i r0 = _mm_loadu_si128((const __m128i*)(rows[0] + x));
+        __m128i r1 = _mm_loadu_si128((const __m128i*)(rows[1] + x));
+        __m128i r2 = _mm_loadu_si128((const __m128i*)(rows[2] + x));
+        __m128i r3 = _mm_loadu_si128((const __m128i*)(rows[3] + x));
+        __m128i r4 = _mm_loadu_si128((const __m128i*)(rows[4] + x));
+        __m128i r5 = _mm_loadu_si128((const __m128i*)(rows[5] + x));
+        // Interleaving symmetric rows lets madd produce the 32-bit tap sums directly
+        __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r0, r5), ones),
+                                   _mm_madd_epi16(_mm_unpacklo_epi16(r1, r4), minus_five));
+        lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(r2, r3), twenty));
+        __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r0, r5), ones),
+                                   _mm_madd_epi16(_mm_unpackhi_epi16(r1, r4), minus_five));
+        hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(r2, r3), twenty));
+        lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 10);
+        hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 10);
+        __m128i packed = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(packed, packed));
+    }
+#endif
+    for (; x < width; x++) {
+        int sum = rows[0][x] + rows[5][x] - 5 * (rows[1][x] + rows[4][x]) + 20 * (rows[2][x] + rows[3][x]);
+        dst[x] = clamp_pixel((sum + 512) >> 10);
+    }
+}
+
+// Rounded average of two rows, (a + b + 1) >> 1 as in H.264 quarter-pel interpolation
+static void average_rows(const unsigned char* a, const unsigned char* b, unsigned char* dst, int width) {
+    int x = 0;
+#ifdef TERMIVIEW_SSE2
+    for (; x + 16 <= width; x += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_avg_epu8(va, vb));
+    }
+#endif
+    for (; x < width; x++) {
+        dst[x] = (unsigned char)((a[x] + b[x] + 1) >> 1);
+    }
+}
+
+// Plane index of a half-pel grid point: 0 = integer, 2 = horizontal, 8 = vertical, 10 = centre
+static int half_grid_plane(int hx, int hy) {
+    return (hx & 1) * 2 + (hy & 1) * 8;
+}
+
+// Fill one quarter-pel plane as the average of two half-pel grid points (hx, hy in half-pel units)
+static void average_half_grid(SubpelReference* ref, unsigned char* dst,
+                              int ax, int ay, int bx, int by) {
+    int width = ref->width;
+    int height = ref->height;
+    const unsigned char* plane_a = ref->planes[half_grid_plane(ax, ay)];
+    const unsigned char* plane_b = ref->planes[half_grid_plane(bx, by)];
+    int off_ax = ax >> 1, off_ay = ay >> 1;
+    int off_bx = bx >> 1, off_by = by >> 1;
+
+    for (int y = 0; y < height; y++) {
+        int ya = y + off_ay < height ? y + off_ay : height - 1;
+        int yb = y + off_by < height ? y + off_by : height - 1;
+        const unsigned char* row_a = plane_a + (size_t)ya * width;
+        const unsigned char* row_b = plane_b + (size_t)yb * width;
+        unsigned char* row_dst = dst + (size_t)y * width;
+
+        // Interior columns are a straight shifted average; the last column clamps to the edge
+        average_rows(row_a + off_ax, row_b + off_bx, row_dst, width - 1);
+        int xa = width - 1 + off_ax < width ? width - 1 + off_ax : width - 1;
+        int xb = width - 1 + off_bx < width ? width - 1 + off_bx : width - 1;
+        row_dst[width - 1] = (unsigned char)((row_a[xa] + row_b[xb] + 1) >> 1);
+    }
+}
+
+// Function to interpolate every sub-pixel phase of a reference frame once
+SubpelReference* build_subpel_reference(const grayscale_image_t* reference_frame) {
+    if (reference_frame == NULL || reference_frame->data == NULL ||
+        reference_frame->width == 0 || reference_frame->height == 0) {
+        fprintf(stderr, "Error: Invalid input to build_subpel_reference\n");
+        return NULL;
+    }
+
+    int width = reference_frame->width;
+    int height = reference_frame->height;
+    size_t plane_size = (size_t)width * height;
+    int padded_width = width + 2 * SUBPEL_PAD;
+    int padded_height = height + 2 * SUBPEL_PAD;
+
+    SubpelReference* ref = (SubpelReference*)malloc(sizeof(SubpelReference));
+    if (ref == NULL) {
+        fprintf(stderr, "Error: Failed to allocate SubpelReference\n");
+        return NULL;
+    }
+    ref->width = width;
+    ref->height = height;
+    ref->buffer = (unsigned char*)malloc(plane_size * 16);
+    unsigned char* padded = (unsigned char*)image_buffer_acquire((size_t)padded_width * padded_height);
+    short* h_sums = (short*)image_buffer_acquire(sizeof(short) * (size_t)width * padded_height);
+    if (ref->buffer == NULL || padded == NULL || h_sums == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sub-pixel planes\n");
+        free(ref->buffer);
+        image_buffer_release(padded);
+        image_buffer_release(h_sums);
+        free(ref);
+        return NULL;
+    }
+    for (int i = 0; i < 16; i++) {
+        ref->planes[i] = ref->buffer + plane_size * i;
+    }
+
+    // Integer phase is the reference itself; the padded copy replicates edge pixels
+    memcpy(ref->planes[0], reference_frame->data, plane_size);
+    for (int py = 0; py < padded_height; py++) {
+        int sy = py - SUBPEL_PAD;
+        if (sy < 0) sy = 0;
+        if (sy >= height) sy = height - 1;
+        const unsigned char* src_row = reference_frame->data + (size_t)sy * width;
+        unsigned char* dst_row = padded + (size_t)py * padded_width;
+        memset(dst_row, src_row[0], SUBPEL_PAD);
+        memcpy(dst_row + SUBPEL_PAD, src_row, width);
+        memset(dst_row + SUBPEL_PAD + width, src_row[width - 1], SUBPEL_PAD);
+    }
+
+    // Horizontal half-pel sums for every padded row (the centre phase filters these vertically)
+    for (int py = 0; py < padded_height; py++) {
+        sixtap_row_h(padded + (size_t)py * padded_width + SUBPEL_PAD, h_sums + (size_t)py * width, width);
+    }
+
+    for (int y = 0; y < height; y++) {
+        // Horizontal half-pel
+        const short* sums = h_sums + (size_t)(y + SUBPEL_PAD) * width;
+        unsigned char* h_row = ref->planes[2] + (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            h_row[x] = clamp_pixel((sums[x] + 16) >> 5);
+        }
+
+        // Vertical half-pel
+        const unsigned char* rows[6];
+        const short* sum_rows[6];
+        for (int k = 0; k < 6; k++) {
+            rows[k] = padded + (size_t)(y + SUBPEL_PAD - 2 + k) * padded_width + SUBPEL_PAD;
+            sum_rows[k] = h_sums + (size_t)(y + SUBPEL_PAD - 2 + k) * width;
+        }
+        sixtap_rows_v(rows, ref->planes[8] + (size_t)y * width, width);
+
+        // Centre half-pel from the unrounded horizontal sums
+        sixtap_sums_v(sum_rows, ref->planes[10] + (size_t)y * width, width);
+    }
+
+    image_buffer_release(padded);
+    image_buffer_release(h_sums);
+
+    // Quarter-pel phases average the two nearest half-pel grid points
+    for (int fy = 0; fy < 4; fy++) {
+        for (int fx = 0; fx < 4; fx++) {
+            if ((fx & 1) == 0 && (fy & 1) == 0) {
+                continue; // Integer and half-pel phases are already filled
+            }
+            int hx = fx >> 1;
+            int hy = fy >> 1;
+            unsigned char* dst = ref->planes[fy * 4 + fx];
+            if ((fy & 1) == 0) {
+                average_half_grid(ref, dst, hx, hy, hx + 1, hy);
+            } else if ((fx & 1) == 0) {
+                average_half_grid(ref, dst, hx, hy, hx, hy + 1);
+            } else if (((hx + hy) & 1) != 0) {
+                // Diagonal positions pair the two half-pel (not integer or centre) samples
+                average_half_grid(ref, dst, hx, hy, hx + 1, hy + 1);
+            } else {
+                average_half_grid(ref, dst, hx + 1, hy, hx, hy + 1);
+            }
+        }
+    }
+
+    return ref;
+}
+
+// Function to free SubpelReference
+void free_subpel_reference(SubpelReference* subpel_ref) {
+    if (subpel_ref) {
+        free(subpel_ref->buffer);
+        free(subpel_ref);
+    }
+}
+
+// SAD of a block against the reference at a quarter-pel position (qx, qy in quarter-pel units)
+static unsigned int subpel_block_sad(const SubpelReference* ref, const unsigned char* block, int block_stride,
+                                     int qx, int qy, int block_w, int block_h) {
+    const unsigned char* plane = ref->planes[(qy & 3) * 4 + (qx & 3)];
+    const unsigned char* origin = plane + (size_t)(qy >> 2) * ref->width + (qx >> 2);
+    return block_sad(block, block_stride, origin, ref->width, block_w, block_h);
+}
+
+// Function to estimate motion with sub-pixel refinement
+MotionVectorField* estimate_motion_subpel(const grayscale_image_t* current_frame, const SubpelReference* reference,
+                                          int block_size, int search_window, int precision) {
+    if (current_frame == NULL || current_frame->data == NULL || reference == NULL ||
+        (int)current_frame->width != reference->width || (int)current_frame->height != reference->height ||
+        (precision != 1 && precision != 2 && precision != 4)) {
+        fprintf(stderr, "Error: Invalid input to estimate_motion_subpel\n");
+        return NULL;
+    }
+
+    // Integer-pel block matching first; the integer plane is the reference frame itself
+    grayscale_image_t integer_reference = {
+        .width = (size_t)reference->width,
+        .height = (size_t)reference->height,
+        .data = reference->planes[0]
+    };
+    MotionVectorField* mv_field = estimate_motion(current_frame, &integer_reference, block_size, search_window);
+    if (mv_field == NULL || precision == 1) {
+        return mv_field;
+    }
+
+    int width = reference->width;
+    int height = reference->height;
+
+    for (int i = 0; i < mv_field->num_vectors; i++) {
+        MotionVector* mv = &mv_field->vectors[i];
+        int block_w = width - mv->block_x < block_size ? width - mv->block_x : block_size;
+        int block_h = height - mv->block_y < block_size ? height - mv->block_y : block_size;
+        const unsigned char* block = current_frame->data + (size_t)mv->block_y * width + mv->block_x;
+
+        // Absolute candidate position in quarter-pel units
+        int best_qx = 4 * (mv->block_x + mv->dx);
+        int best_qy = 4 * (mv->block_y + mv->dy);
+        if (best_qx < 0 || best_qy < 0 || best_qx / 4 + block_w > width || best_qy / 4 + block_h > height) {
+            continue; // Integer search could not place the block; nothing to refine
+        }
+        unsigned int best_sad = subpel_block_sad(reference, block, width, best_qx, best_qy, block_w, block_h);
+
+        // Half-pel step around the integer winner, then quarter-pel around the half-pel winner
+        for (int step = 2; step >= 4 / precision; step /= 2) {
+            int center_qx = best_qx;
+            int center_qy = best_qy;
+            for (int sy = -1; sy <= 1; sy++) {
+                for (int sx = -1; sx <= 1; sx++) {
+                    if (sx == 0 && sy == 0) continue;
+                    int qx = center_qx + sx * step;
+                    int qy = center_qy + sy * step;
+                    // Interpolated samples are read from the block's floor position
+                    if (qx < 0 || qy < 0 || (qx >> 2) + block_w > width || (qy >> 2) + block_h > height) {
+                        continue;
+                    }
+                    unsigned int sad = subpel_block_sad(reference, block, width, qx, qy, block_w, block_h);
+                    if (sad < best_sad) {
+                        best_sad = sad;
+                        best_qx = qx;
+                        best_qy = qy;
+                    }
+                }
+            }
+        }
+
+        mv->dx = (best_qx >> 2) - mv->block_x;
+        mv->dy = (best_qy >> 2) - mv->block_y;
+        mv->frac_dx = best_qx & 3;
+        mv->frac_dy = best_qy & 3;
+    }
+
+    return mv_field;
+}
+
+// Function to compensate motion using fractional motion vectors
+grayscale_image_t* compensate_motion_subpel(const SubpelReference* reference, const MotionVectorField* mv_field, int block_size) {
+    if (reference == NULL || mv_field == NULL || block_size <= 0) {
+        fprintf(stderr, "Error: Invalid input to compensate_motion_subpel\n");
+        return NULL;
+    }
+
+    int width = reference->width;
+    int height = reference->height;
+
+    grayscale_image_t* compensated_frame = (grayscale_image_t*)calloc(1, sizeof(grayscale_image_t));
+    if (compensated_frame == NULL) {
+        fprintf(stderr, "Error: Failed to allocate compensated_frame\n");
+        return NULL;
+    }
+    *compensated_frame = allocate_grayscale_image((size_t)width, (size_t)height);
+    if (compensated_frame->data == NULL) {
+        free(compensated_frame);
+        return NULL;
+    }
+    memset(compensated_frame->data, 0, (size_t)width * height);
+
+    for (int i = 0; i < mv_field->num_vectors; i++) {
+        MotionVector mv = mv_field->vectors[i];
+        if (mv.block_x >= width || mv.block_y >= height) continue;
+
+        int block_w = width - mv.block_x < block_size ? width - mv.block_x : block_size;
+        int block_h = height - mv.block_y < block_size ? height - mv.block_y : block_size;
+        int ref_block_x = mv.block_x + mv.dx;
+        int ref_block_y = mv.block_y + mv.dy;
+
+        // Ensure block is within reference frame boundaries
+        if (ref_block_x < 0) ref_block_x = 0;
+        if (ref_block_y < 0) ref_block_y = 0;
+        if (ref_block_x + block_w > width) ref_block_x = width - block_w;
+        if (ref_block_y + block_h > height) ref_block_y = height - block_h;
+
+        const unsigned char* plane = reference->planes[(mv.frac_dy & 3) * 4 + (mv.frac_dx & 3)];
+        for (int y = 0; y < block_h; y++) {
+            memcpy(compensated_frame->data + (size_t)(mv.block_y + y) * width + mv.block_x,
+                   plane + (size_t)(ref_block_y + y) * width + ref_block_x,
+                   block_w);
+        }
+    }
+
+    return compensated_frame;
+}
+
 // Function to compute optical flow between two grayscale frames (Lucas-Kanade)
 OpticalFlowField* compute_optical_flow(const grayscale_image_t* frame1, const grayscale_image_t* frame2, int window_size) {
     if (frame1 == NULL || frame2 == NULL || frame1->width != frame2->width || frame1->height != frame2->height || window_size <= 0) {
@@ -471,46 +854,69 @@ OpticalFlowField* compute_optical_flow(const grayscale_image_t* frame1, const gr
         return NULL;
     }
 
-    // Allocate memory for gradients
-    double* Ix = (double*)calloc(width * height, sizeof(double));
-    double* Iy = (double*)calloc(width * height, sizeof(double));
-    double* It = (double*)calloc(width * height, sizeof(double));
-    if (Ix == NULL || Iy == NULL || It == NULL) {
+    // Gradients at twice their size (Ix = gx / 2, Iy = gy / 2), so they and
+    // their products stay integers; borders keep zero gradients
+    size_t pixel_count = (size_t)width * height;
+    int32_t* gx = (int32_t*)image_buffer_acquire(pixel_count * sizeof(int32_t));
+    int32_t* gy = (int32_t*)image_buffer_acquire(pixel_count * sizeof(int32_t));
+    int32_t* gt = (int32_t*)image_buffer_acquire(pixel_count * sizeof(int32_t));
+    int32_t* product = (int32_t*)image_buffer_acquire(pixel_count * sizeof(int32_t));
+    if (gx == NULL || gy == NULL || gt == NULL || product == NULL) {
         fprintf(stderr, "Error: Failed to allocate gradient arrays\n");
-        free(Ix); free(Iy); free(It);
+        image_buffer_release(gx); image_buffer_release(gy); image_buffer_release(gt); image_buffer_release(product);
         free(flow_field->flow_vectors); free(flow_field);
         return NULL;
     }
+    memset(gx, 0, pixel_count * sizeof(int32_t));
+    memset(gy, 0, pixel_count * sizeof(int32_t));
+    memset(gt, 0, pixel_count * sizeof(int32_t));
 
     // Calculate gradients Ix, Iy, It
     for (int y = 1; y < height - 1; y++) {
         for (int x = 1; x < width - 1; x++) {
             size_t idx = y * width + x;
-            // Ix (Sobel filter in X direction)
-            Ix[idx] = (double)(frame1->data[idx + 1] - frame1->data[idx - 1]) / 2.0;
-            // Iy (Sobel filter in Y direction)
-            Iy[idx] = (double)(frame1->data[idx + width] - frame1->data[idx - width]) / 2.0;
-            // It (Temporal gradient)
-            It[idx] = (double)(frame2->data[idx] - frame1->data[idx]);
+            gx[idx] = frame1->data[idx + 1] - frame1->data[idx - 1];
+            gy[idx] = frame1->data[idx + width] - frame1->data[idx - width];
+            gt[idx] = frame2->data[idx] - frame1->data[idx];
+        }
+    }
+
+    // Summed-area tables of the five products make each window sum four lookups
+    enum { PRODUCT_XX, PRODUCT_YY, PRODUCT_XY, PRODUCT_XT, PRODUCT_YT, PRODUCT_COUNT };
+    const int32_t* factors[PRODUCT_COUNT][2] = {
+        { gx, gx }, { gy, gy }, { gx, gy }, { gx, gt }, { gy, gt }
+    };
+    integral_image64_t tables[PRODUCT_COUNT] = {{0}};
+    bool built = true;
+    for (int p = 0; p < PRODUCT_COUNT && built; p++) {
+        for (size_t i = 0; i < pixel_count; i++) {
+            product[i] = factors[p][0][i] * factors[p][1][i];
+        }
+        built = build_integral_image64(product, (size_t)width, (size_t)height, (size_t)width, &tables[p]);
+    }
+    image_buffer_release(gx); image_buffer_release(gy); image_buffer_release(gt); image_buffer_release(product);
+    if (!built) {
+        for (int p = 0; p < PRODUCT_COUNT; p++) {
+            free_integral_image64(&tables[p]);
         }
+        free(flow_field->flow_vectors); free(flow_field);
+        return NULL;
     }
 
     // Compute flow vectors for each pixel
     for (int y = half_window; y < height - half_window; y++) {
+        size_t y0 = (size_t)(y - half_window);
+        size_t y1 = (size_t)(y + half_window + 1);
         for (int x = half_window; x < width - half_window; x++) {
-            double sum_Ix2 = 0, sum_Iy2 = 0, sum_IxIy = 0, sum_IxIt = 0, sum_IyIt = 0;
-
-            // Sum gradients over the window
-            for (int wy = -half_window; wy <= half_window; wy++) {
-                for (int wx = -half_window; wx <= half_window; wx++) {
-                    size_t idx = (y + wy) * width + (x + wx);
-                    sum_Ix2 += Ix[idx] * Ix[idx];
-                    sum_Iy2 += Iy[idx] * Iy[idx];
-                    sum_IxIy += Ix[idx] * Iy[idx];
-                    sum_IxIt += Ix[idx] * It[idx];
-                    sum_IyIt += Iy[idx] * It[idx];
-                }
-            }
+            size_t x0 = (size_t)(x - half_window);
+            size_t x1 = (size_t)(x + half_window + 1);
+
+            // Sum gradients over the window, undoing the doubling
+            double sum_Ix2 = (double)integral_rect_sum64(&tables[PRODUCT_XX], x0, y0, x1, y1) / 4.0;
+            double sum_Iy2 = (double)integral_rect_sum64(&tables[PRODUCT_YY], x0, y0, x1, y1) / 4.0;
+            double sum_IxIy = (double)integral_rect_sum64(&tables[PRODUCT_XY], x0, y0, x1, y1) / 4.0;
+            double sum_IxIt = (double)integral_rect_sum64(&tables[PRODUCT_XT], x0, y0, x1, y1) / 2.0;
+            double sum_IyIt = (double)integral_rect_sum64(&tables[PRODUCT_YT], x0, y0, x1, y1) / 2.0;
 
             // Construct and solve the 2x2 system:
             // [ Gxx Gxy ] [ vx ] = [ -bxx ]
@@ -530,7 +936,9 @@ OpticalFlowField* compute_optical_flow(const grayscale_image_t* frame1, const gr
         }
     }
 
-    free(Ix); free(Iy); free(It);
+    for (int p = 0; p < PRODUCT_COUNT; p++) {
+        free_integral_image64(&tables[p]);
+    }
     return flow_field;
 }
 
@@ -549,3 +957,442 @@ void free_optical_flow_field(OpticalFlowField* flow_field) {
         free(flow_field);
     }
 }
+
+#define CHANGE_DOWNSAMPLE 4
+
+// Rounded average of four rows, matching two levels of _mm_avg_epu8
+static void average_four_rows(const unsigned char* const rows[4], unsigned char* dst, int width) {
+    int x = 0;
+#ifdef TERMIVIEW_SSE2
+    for (; x + 16 <= width; x += 16) {
+        __m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(rows[0] + x)),
+                                 _mm_loadu_si128((const __m128i*)(rows[1] + x)));
+        __m128i b = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(rows[2] + x)),
+                                 _mm_loadu_si128((const __m128i*)(rows[3] + x)));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_avg_epu8(a, b));
+    }
+#endif
+    for (; x < width; x++) {
+        int a = (rows[0][x] + rows[1][x] + 1) >> 1;
+        int b = (rows[2][x] + rows[3][x] + 1) >> 1;
+        dst[x] = (unsigned char)((a + b + 1) >> 1);
+    }
+}
+
+// Average groups of four horizontal samples; the last group replicates the edge pixel
+static void average_four_columns(const unsigned char* src, unsigned char* dst, int width, int thumb_width) {
+    int tx = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i bias = _mm_set1_epi32(2);
+    for (; (tx + 4) * CHANGE_DOWNSAMPLE <= width; tx += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + tx * CHANGE_DOWNSAMPLE));
+        __m128i pairs = _mm_add_epi16(_mm_and_si128(v, low_bytes), _mm_srli_epi16(v, 8));
+        __m128i quads = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, ones), bias), 2);
+        __m128i packed = _mm_packs_epi32(quads, quads);
+        packed = _mm_packus_epi16(packed, packed);
+        int out = _mm_cvtsi128_si32(packed);
+        memcpy(dst + tx, &out, 4);
+    }
+#endif
+    for (; tx < thumb_width; tx++) {
+        int sum = 0;
+        for (int i = 0; i < CHANGE_DOWNSAMPLE; i++) {
+            int x = tx * CHANGE_DOWNSAMPLE + i;
+            sum += src[x < width ? x : width - 1];
+        }
+        dst[tx] = (unsigned char)((sum + 2) >> 2);
+    }
+}
+
+// Sum of absolute differences between two signature rows
+static unsigned int row_sad(const unsigned char* a, const unsigned char* b, int width) {
+    unsigned int sad = 0;
+    int x = 0;
+#ifdef TERMIVIEW_SSE2
+    for (; x + 8 <= width; x += 8) {
+        __m128i va = _mm_loadl_epi64((const __m128i*)(a + x));
+        __m128i vb = _mm_loadl_epi64((const __m128i*)(b + x));
+        sad += (unsigned int)_mm_cvtsi128_si32(_mm_sad_epu8(va, vb));
+    }
+#endif
+    for (; x < width; x++) {
+        sad += (unsigned int)abs((int)a[x] - (int)b[x]);
+    }
+    return sad;
+}
+
+FrameChangeDetector* create_frame_change_detector(int width, int height, int tile_size) {
+    if (width <= 0 || height <= 0 || tile_size < CHANGE_DOWNSAMPLE || tile_size % CHANGE_DOWNSAMPLE != 0) {
+        fprintf(stderr, "Error: Invalid input to create_frame_change_detector\n");
+        return NULL;
+    }
+
+    FrameChangeDetector* detector = (FrameChangeDetector*)calloc(1, sizeof(FrameChangeDetector));
+    if (detector == NULL) {
+        fprintf(stderr, "Error: Failed to allocate FrameChangeDetector\n");
+        return NULL;
+    }
+    detector->width = width;
+    detector->height = height;
+    detector->tile_size = tile_size;
+    detector->tiles_x = (width + tile_size - 1) / tile_size;
+    detector->tiles_y = (height + tile_size - 1) / tile_size;
+    detector->thumb_width = (width + CHANGE_DOWNSAMPLE - 1) / CHANGE_DOWNSAMPLE;
+    detector->thumb_height = (height + CHANGE_DOWNSAMPLE - 1) / CHANGE_DOWNSAMPLE;
+
+    size_t thumb_size = (size_t)detector->thumb_width * detector->thumb_height;
+    detector->reference = (unsigned char*)image_alloc(thumb_size);
+    detector->current = (unsigned char*)image_alloc(thumb_size);
+    detector->dirty = (unsigned char*)malloc((size_t)detector->tiles_x * detector->tiles_y);
+    if (detector->reference == NULL || detector->current == NULL || detector->dirty == NULL) {
+        fprintf(stderr, "Error: Failed to allocate change detector buffers\n");
+        free_frame_change_detector(detector);
+        return NULL;
+    }
+    return detector;
+}
+
+int detect_frame_changes(FrameChangeDetector* detector, const grayscale_image_t* frame, double threshold) {
+    if (detector == NULL || frame == NULL || frame->data == NULL ||
+        (int)frame->width != detector->width || (int)frame->height != detector->height) {
+        fprintf(stderr, "Error: Invalid input to detect_frame_changes\n");
+        return -1;
+    }
+
+    int width = detector->width;
+    int height = detector->height;
+    scratch_mark_t mark = scratch_mark();
+    unsigned char* row_buffer = (unsigned char*)scratch_alloc((size_t)width);
+    if (row_buffer == NULL) {
+        fprintf(stderr, "Error: Failed to allocate change detector row buffer\n");
+        scratch_release(mark);
+        return -1;
+    }
+
+    // Downsample to the signature
+    for (int ty = 0; ty < detector->thumb_height; ty++) {
+        const unsigned char* rows[4];
+        for (int i = 0; i < CHANGE_DOWNSAMPLE; i++) {
+            int y = ty * CHANGE_DOWNSAMPLE + i;
+            rows[i] = grayscale_row(frame, (size_t)(y < height ? y : height - 1));
+        }
+        average_four_rows(rows, row_buffer, width);
+        average_four_columns(row_buffer, detector->current + (size_t)ty * detector->thumb_width,
+                             width, detector->thumb_width);
+    }
+    scratch_release(mark);
+
+    // Compare each tile against its reference and adopt the new signature where it changed
+    int thumb_tile = detector->tile_size / CHANGE_DOWNSAMPLE;
+    int dirty_count = 0;
+    for (int tile_y = 0; tile_y < detector->tiles_y; tile_y++) {
+        int y0 = tile_y * thumb_tile;
+        int rows = detector->thumb_height - y0 < thumb_tile ? detector->thumb_height - y0 : thumb_tile;
+        for (int tile_x = 0; tile_x < detector->tiles_x; tile_x++) {
+            int x0 = tile_x * thumb_tile;
+            int cols = detector->thumb_width - x0 < thumb_tile ? detector->thumb_width - x0 : thumb_tile;
+            bool dirty = !detector->has_reference;
+
+            if (!dirty) {
+                unsigned int sad = 0;
+                for (int y = 0; y < rows; y++) {
+                    size_t offset = (size_t)(y0 + y) * detector->thumb_width + x0;
+                    sad += row_sad(detector->current + offset, detector->reference + offset, cols);
+                }
+                dirty = (double)sad > threshold * rows * cols;
+            }
+
+            detector->dirty[tile_y * detector->tiles_x + tile_x] = dirty;
+            if (dirty) {
+                dirty_count++;
+                for (int y = 0; y < rows; y++) {
+                    size_t offset = (size_t)(y0 + y) * detector->thumb_width + x0;
+                    memcpy(detector->reference + offset, detector->current + offset, (size_t)cols);
+                }
+            }
+        }
+    }
+    detector->has_reference = true;
+    return dirty_count;
+}
+
+// Function to free FrameChangeDetector
+void free_frame_change_detector(FrameChangeDetector* detector) {
+    if (detector) {
+        image_free(detector->reference);
+        image_free(detector->current);
+        free(detector->dirty);
+        free(detector);
+    }
+}
+
+#define SCENE_BIN_SHIFT 2 // 256 levels -> SCENE_HISTOGRAM_BINS bins
+
+// Histogram with four interleaved sub-histograms so consecutive pixels landing
+// in the same bin do not serialize on one counter
+void compute_luma_histogram(const grayscale_image_t* frame, unsigned int* histogram) {
+    unsigned int banks[4][SCENE_HISTOGRAM_BINS];
+    memset(banks, 0, sizeof(banks));
+    memset(histogram, 0, sizeof(unsigned int) * SCENE_HISTOGRAM_BINS);
+    if (frame == NULL || frame->data == NULL) {
+        return;
+    }
+
+    size_t num_pixels = frame->width * frame->height;
+    const unsigned char* data = frame->data;
+    size_t i = 0;
+    for (; i + 4 <= num_pixels; i += 4) {
+        banks[0][data[i] >> SCENE_BIN_SHIFT]++;
+        banks[1][data[i + 1] >> SCENE_BIN_SHIFT]++;
+        banks[2][data[i + 2] >> SCENE_BIN_SHIFT]++;
+        banks[3][data[i + 3] >> SCENE_BIN_SHIFT]++;
+    }
+    for (; i < num_pixels; i++) {
+        banks[0][data[i] >> SCENE_BIN_SHIFT]++;
+    }
+    for (int b = 0; b < SCENE_HISTOGRAM_BINS; b++) {
+        histogram[b] = banks[0][b] + banks[1][b] + banks[2][b] + banks[3][b];
+    }
+}
+
+static double histogram_total(const unsigned int* histogram) {
+    double total = 0.0;
+    for (int b = 0; b < SCENE_HISTOGRAM_BINS; b++) {
+        total += histogram[b];
+    }
+    return total;
+}
+
+double histogram_chi_square_distance(const unsigned int* hist_a, const unsigned int* hist_b) {
+    double total_a = histogram_total(hist_a);
+    double total_b = histogram_total(hist_b);
+    if (total_a == 0.0 || total_b == 0.0) {
+        return total_a == total_b ? 0.0 : 1.0;
+    }
+    double distance = 0.0;
+    for (int b = 0; b < SCENE_HISTOGRAM_BINS; b++) {
+        double pa = hist_a[b] / total_a;
+        double pb = hist_b[b] / total_b;
+        if (pa + pb > 0.0) {
+            distance += (pa - pb) * (pa - pb) / (pa + pb);
+        }
+    }
+    return distance / 2.0;
+}
+
+double histogram_intersection_distance(const unsigned int* hist_a, const unsigned int* hist_b) {
+    double total_a = histogram_total(hist_a);
+    double total_b = histogram_total(hist_b);
+    if (total_a == 0.0 || total_b == 0.0) {
+        return total_a == total_b ? 0.0 : 1.0;
+    }
+    double overlap = 0.0;
+    for (int b = 0; b < SCENE_HISTOGRAM_BINS; b++) {
+        overlap += fmin(hist_a[b] / total_a, hist_b[b] / total_b);
+    }
+    return 1.0 - overlap;
+}
+
+grayscale_image_t make_thumbnail(const grayscale_image_t* frame, int thumb_width) {
+    grayscale_image_t thumb = {0};
+    if (frame == NULL || frame->data == NULL || thumb_width <= 0) {
+        fprintf(stderr, "Error: Invalid input to make_thumbnail\n");
+        return thumb;
+    }
+
+    size_t width = (size_t)thumb_width < frame->width ? (size_t)thumb_width : frame->width;
+    size_t height = (frame->height * width + frame->width / 2) / frame->width;
+    if (height == 0) height = 1;
+    thumb = allocate_grayscale_image(width, height);
+    if (thumb.data == NULL) {
+        return thumb;
+    }
+
+    for (size_t j = 0; j < height; j++) {
+        size_t y1 = j * frame->height / height;
+        size_t y2 = (j + 1) * frame->height / height;
+        for (size_t i = 0; i < width; i++) {
+            size_t x1 = i * frame->width / width;
+            size_t x2 = (i + 1) * frame->width / width;
+            unsigned long sum = 0;
+            for (size_t y = y1; y < y2; y++) {
+                for (size_t x = x1; x < x2; x++) {
+                    sum += frame->data[y * frame->width + x];
+                }
+            }
+            size_t count = (y2 - y1) * (x2 - x1);
+            thumb.data[j * width + i] = (unsigned char)((sum + count / 2) / count);
+        }
+    }
+    return thumb;
+}
+
+grayscale_image_t make_contact_sheet(const grayscale_image_t* thumbnails, int num_thumbnails, int columns) {
+    grayscale_image_t sheet = {0};
+    if (thumbnails == NULL || num_thumbnails <= 0 || columns <= 0) {
+        fprintf(stderr, "Error: Invalid input to make_contact_sheet\n");
+        return sheet;
+    }
+
+    // Cells are sized to the largest thumbnail
+    size_t cell_width = 0, cell_height = 0;
+    for (int i = 0; i < num_thumbnails; i++) {
+        if (thumbnails[i].width > cell_width) cell_width = thumbnails[i].width;
+        if (thumbnails[i].height > cell_height) cell_height = thumbnails[i].height;
+    }
+    if (columns > num_thumbnails) columns = num_thumbnails;
+    int rows = (num_thumbnails + columns - 1) / columns;
+
+    sheet = allocate_grayscale_image(columns * (cell_width + 1) + 1, rows * (cell_height + 1) + 1);
+    if (sheet.data == NULL) {
+        return sheet;
+    }
+    memset(sheet.data, 0, sheet.width * sheet.height);
+
+    for (int i = 0; i < num_thumbnails; i++) {
+        const grayscale_image_t* thumb = &thumbnails[i];
+        if (thumb->data == NULL) {
+            continue;
+        }
+        size_t x0 = (i % columns) * (cell_width + 1) + 1;
+        size_t y0 = (i / columns) * (cell_height + 1) + 1;
+        for (size_t y = 0; y < thumb->height; y++) {
+            memcpy(sheet.data + (y0 + y) * sheet.width + x0, thumb->data + y * thumb->width, thumb->width);
+        }
+    }
+    return sheet;
+}
+
+#define BACKGROUND_MIN_VARIANCE 16      // Noise floor (sigma = 4 luma levels)
+#define BACKGROUND_INITIAL_VARIANCE 64  // Variance assumed for the first frame
+
+BackgroundModel* create_background_model(int width, int height, int learning_shift, double threshold_sigma) {
+    if (width <= 0 || height <= 0 || learning_shift < 1 || learning_shift > 15 ||
+        threshold_sigma <= 0.0 || threshold_sigma * threshold_sigma * 256.0 > 32767.0) {
+        fprintf(stderr, "Error: Invalid input to create_background_model\n");
+        return NULL;
+    }
+
+    BackgroundModel* model = (BackgroundModel*)calloc(1, sizeof(BackgroundModel));
+    if (model == NULL) {
+        fprintf(stderr, "Error: Failed to allocate BackgroundModel\n");
+        return NULL;
+    }
+    size_t num_pixels = (size_t)width * height;
+    model->width = width;
+    model->height = height;
+    model->learning_shift = learning_shift;
+    model->threshold_q8 = (unsigned short)lround(threshold_sigma * threshold_sigma * 256.0);
+    model->min_variance = BACKGROUND_MIN_VARIANCE;
+    model->mean = (unsigned short*)image_alloc(num_pixels * sizeof(unsigned short));
+    model->variance = (unsigned short*)image_alloc(num_pixels * sizeof(unsigned short));
+    model->mask = allocate_grayscale_image((size_t)width, (size_t)height);
+    if (model->mean == NULL || model->variance == NULL || model->mask.data == NULL) {
+        fprintf(stderr, "Error: Failed to allocate background model planes\n");
+        free_background_model(model);
+        return NULL;
+    }
+    memset(model->mask.data, 0, num_pixels);
+    return model;
+}
+
+// Classify and update one pixel; the SSE2 path below computes exactly the same values
+static inline void background_update_pixel(BackgroundModel* model, size_t i, unsigned char pixel) {
+    unsigned int mean = model->mean[i];
+    unsigned int variance = model->variance[i];
+    unsigned int target = (unsigned int)pixel << 8;
+    int shift = model->learning_shift;
+
+    int diff = (int)pixel - (int)(mean >> 8);
+    unsigned int diff_sq = (unsigned int)(diff * diff);
+    unsigned int threshold = (variance * model->threshold_q8) >> 8;
+    if (threshold > 0xFFFF) threshold = 0xFFFF;
+    model->mask.data[i] = diff_sq > threshold ? 255 : 0;
+
+    mean = mean + ((target > mean ? target - mean : 0) >> shift) - ((mean > target ? mean - target : 0) >> shift);
+    variance = variance + ((diff_sq > variance ? diff_sq - variance : 0) >> shift)
+                        - ((variance > diff_sq ? variance - diff_sq : 0) >> shift);
+    if (variance < model->min_variance) variance = model->min_variance;
+
+    model->mean[i] = (unsigned short)mean;
+    model->variance[i] = (unsigned short)variance;
+}
+
+grayscale_image_t* subtract_background(BackgroundModel* model, const grayscale_image_t* frame) {
+    if (model == NULL || frame == NULL || frame->data == NULL ||
+        (int)frame->width != model->width || (int)frame->height != model->height) {
+        fprintf(stderr, "Error: Invalid input to subtract_background\n");
+        return NULL;
+    }
+
+    size_t num_pixels = (size_t)model->width * model->height;
+    const unsigned char* pixels = frame->data;
+
+    if (!model->initialized) {
+        for (size_t i = 0; i < num_pixels; i++) {
+            model->mean[i] = (unsigned short)(pixels[i] << 8);
+            model->variance[i] = BACKGROUND_INITIAL_VARIANCE;
+        }
+        memset(model->mask.data, 0, num_pixels);
+        model->initialized = true;
+        return &model->mask;
+    }
+
+    size_t i = 0;
+#ifdef TERMIVIEW_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sign_bit = _mm_set1_epi16((short)0x8000);
+    const __m128i threshold_q8 = _mm_set1_epi16((short)model->threshold_q8);
+    const __m128i min_variance = _mm_set1_epi16((short)model->min_variance);
+    const __m128i saturated_hi = _mm_set1_epi16(0xFF);
+    const __m128i shift = _mm_cvtsi32_si128(model->learning_shift);
+    for (; i + 8 <= num_pixels; i += 8) {
+        __m128i pixel = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pixels + i)), zero);
+        __m128i mean = _mm_loadu_si128((const __m128i*)(model->mean + i));
+        __m128i variance = _mm_loadu_si128((const __m128i*)(model->variance + i));
+        __m128i target = _mm_slli_epi16(pixel, 8);
+
+        // Squared distance to the mean in whole luma levels (fits 16 bits unsigned)
+        __m128i diff = _mm_sub_epi16(pixel, _mm_srli_epi16(mean, 8));
+        __m128i diff_sq = _mm_mullo_epi16(diff, diff);
+
+        // threshold = min(0xFFFF, variance * k^2): 32-bit product shifted right by 8
+        __m128i prod_lo = _mm_mullo_epi16(variance, threshold_q8);
+        __m128i prod_hi = _mm_mulhi_epu16(variance, threshold_q8);
+        __m128i threshold = _mm_or_si128(_mm_slli_epi16(prod_hi, 8), _mm_srli_epi16(prod_lo, 8));
+        threshold = _mm_or_si128(threshold, _mm_cmpgt_epi16(prod_hi, saturated_hi));
+
+        // Unsigned 16-bit compare via the sign-bit flip
+        __m128i foreground = _mm_cmpgt_epi16(_mm_xor_si128(diff_sq, sign_bit), _mm_xor_si128(threshold, sign_bit));
+        _mm_storel_epi64((__m128i*)(model->mask.data + i), _mm_packs_epi16(foreground, foreground));
+
+        // Blend towards the new sample; saturating subtraction splits the signed step
+        __m128i mean_up = _mm_srl_epi16(_mm_subs_epu16(target, mean), shift);
+        __m128i mean_down = _mm_srl_epi16(_mm_subs_epu16(mean, target), shift);
+        mean = _mm_sub_epi16(_mm_add_epi16(mean, mean_up), mean_down);
+        __m128i variance_up = _mm_srl_epi16(_mm_subs_epu16(diff_sq, variance), shift);
+        __m128i variance_down = _mm_srl_epi16(_mm_subs_epu16(variance, diff_sq), shift);
+        variance = _mm_sub_epi16(_mm_add_epi16(variance, variance_up), variance_down);
+        variance = _mm_add_epi16(variance, _mm_subs_epu16(min_variance, variance));
+
+        _mm_storeu_si128((__m128i*)(model->mean + i), mean);
+        _mm_storeu_si128((__m128i*)(model->variance + i), variance);
+    }
+#endif
+    for (; i < num_pixels; i++) {
+        background_update_pixel(model, i, pixels[i]);
+    }
+    return &model->mask;
+}
+
+// Function to free BackgroundModel
+void free_background_model(BackgroundModel* model) {
+    if (model) {
+        image_free(model->mean);
+        image_free(model->variance);
+        free_grayscale_image(&model->mask);
+        free(model);
+    }
+}
@@ -164,6 +164,19 @@ char *test_jpeg_grayscale_compression() {
     mu_assert("JPEG encoded data should not be NULL", encoded_data != NULL);
     mu_assert("JPEG encoded length should be greater than 0", encoded_len_bytes > 0);
 
+    // A view is encoded in place, as its packed copy would be
+    grayscale_image_t view = image_view_roi(&original_image, 3, 2, 11, 13);
+    grayscale_image_t packed = copy_grayscale_image(&view);
+    size_t view_len, packed_len;
+    unsigned char* view_data = jpeg_encode(&view, 50, &view_len);
+    unsigned char* packed_data = jpeg_encode(&packed, 50, &packed_len);
+    mu_assert("JPEG of a view should match its packed copy",
+              view_data != NULL && packed_data != NULL && view_len == packed_len &&
+              memcmp(view_data, packed_data, view_len) == 0);
+    free(view_data);
+    free(packed_data);
+    free(packed.data);
+
     // No decoding part yet, just testing encoding
     
     // Cleanup
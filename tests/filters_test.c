@@ -1,7 +1,62 @@
 #include "minunit.h"
 #include "../include/filters.h"
+#include "../include/filter_chain.h"
+#include "../include/fft_convolution.h"
+#include "../include/frequency.h"
+#include "../include/blur.h"
+#include "../include/median.h"
+#include "../include/morphology.h"
+#include "../include/nlmeans.h"
 #include "../include/image_processing.h"
+#include "../include/image_alloc.h"
+#include "../include/parallel.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Textured test image with edges, gradients and noise
+static grayscale_image_t make_test_image(int width, int height) {
+    grayscale_image_t image = { .width = (size_t)width, .height = (size_t)height };
+    image.data = (unsigned char*)malloc((size_t)width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int value = (x * 7 + y * 3) % 200 + ((x / 8 + y / 8) % 2) * 40 + (x * 31 + y * 17) % 13;
+            image.data[y * width + x] = (unsigned char)(value > 255 ? 255 : value);
+        }
+    }
+    return image;
+}
+
+// Straightforward K x K edge-clamped convolution used as ground truth
+static unsigned char reference_convolve_pixel(const grayscale_image_t* image, const kernel_t* kernel, int x, int y) {
+    int half = (int)kernel->size / 2;
+    double sum = 0.0;
+    for (int ky = -half; ky <= half; ky++) {
+        for (int kx = -half; kx <= half; kx++) {
+            int px = x + kx < 0 ? 0 : (x + kx >= (int)image->width ? (int)image->width - 1 : x + kx);
+            int py = y + ky < 0 ? 0 : (y + ky >= (int)image->height ? (int)image->height - 1 : y + ky);
+            sum += image->data[py * image->width + px] * kernel->data[(ky + half) * kernel->size + (kx + half)];
+        }
+    }
+    sum = sum / kernel->divisor + kernel->offset;
+    return (unsigned char)(sum < 0.0 ? 0 : (sum > 255.0 ? 255 : sum + 0.5));
+}
+
+// Largest absolute difference between a filter result and the reference
+static int max_reference_error(const grayscale_image_t* image, const kernel_t* kernel, const grayscale_image_t* result) {
+    int max_error = 0;
+    for (int y = 0; y < (int)image->height; y++) {
+        for (int x = 0; x < (int)image->width; x++) {
+            int error = abs((int)result->data[y * image->width + x] - (int)reference_convolve_pixel(image, kernel, x, y));
+            if (error > max_error) max_error = error;
+        }
+    }
+    return max_error;
+}
 
 char *test_canny_edge_detector() {
     int width = 10;
@@ -47,8 +102,889 @@ char *test_canny_edge_detector() {
     return 0;
 }
 
+char *test_separable_convolution() {
+    grayscale_image_t image = make_test_image(61, 37);
+    mu_assert("Test image allocation failed", image.data != NULL);
+
+    // Gaussian kernels are rank 1 and take the two-pass path
+    kernel_t gaussian = create_gaussian_blur_kernel(9, 2.0f);
+    grayscale_image_t blurred = apply_convolution_grayscale(&image, &gaussian);
+    mu_assert("Blurred image should not be NULL", blurred.data != NULL);
+    mu_assert("Separable blur should match the 2D reference", max_reference_error(&image, &gaussian, &blurred) <= 1);
+
+    // Kernel larger than the image exercises clamping on both sides of every row
+    kernel_t wide = create_gaussian_blur_kernel(41, 8.0f);
+    grayscale_image_t wide_blurred = apply_convolution_grayscale(&image, &wide);
+    mu_assert("Wide blur should match the 2D reference", max_reference_error(&image, &wide, &wide_blurred) <= 1);
+
+    // Sharpen is not separable and keeps the direct path
+    kernel_t sharpen = create_sharpen_kernel();
+    grayscale_image_t sharpened = apply_convolution_grayscale(&image, &sharpen);
+    mu_assert("Direct sharpen should match the 2D reference", max_reference_error(&image, &sharpen, &sharpened) == 0);
+
+    free(blurred.data);
+    free(wide_blurred.data);
+    free(sharpened.data);
+    free_kernel(&gaussian);
+    free_kernel(&wide);
+    free_kernel(&sharpen);
+    free(image.data);
+    return 0;
+}
+
+// Signed edge-clamped correlation of a 3x3 kernel at (x, y)
+static int reference_gradient(const grayscale_image_t* image, const kernel_t* kernel, int x, int y) {
+    float sum = 0.0f;
+    for (int ky = -1; ky <= 1; ky++) {
+        for (int kx = -1; kx <= 1; kx++) {
+            int px = x + kx < 0 ? 0 : (x + kx >= (int)image->width ? (int)image->width - 1 : x + kx);
+            int py = y + ky < 0 ? 0 : (y + ky >= (int)image->height ? (int)image->height - 1 : y + ky);
+            sum += image->data[py * image->width + px] * kernel->data[(ky + 1) * 3 + (kx + 1)];
+        }
+    }
+    return (int)sum;
+}
+
+char *test_gradient_field() {
+    grayscale_image_t image = make_test_image(45, 23);
+    mu_assert("Test image allocation failed", image.data != NULL);
+
+    gradient_operator_t ops[] = { GRADIENT_SOBEL, GRADIENT_PREWITT, GRADIENT_ROBERTS };
+    kernel_t kx[] = { create_sobel_x_kernel(), create_prewitt_x_kernel(), create_roberts_x_kernel() };
+    kernel_t ky[] = { create_sobel_y_kernel(), create_prewitt_y_kernel(), create_roberts_y_kernel() };
+    int negative_seen = 0;
+    for (int k = 0; k < 3; k++) {
+        gradient_field_t l2 = compute_gradient(&image, ops[k], GRADIENT_NORM_L2, true);
+        gradient_field_t l1 = compute_gradient(&image, ops[k], GRADIENT_NORM_L1, false);
+        mu_assert("Gradient planes should be allocated", l2.gx != NULL && l2.magnitude != NULL && l2.direction != NULL);
+        mu_assert("L1 field should skip orientation", l1.magnitude != NULL && l1.direction == NULL);
+
+        for (int y = 0; y < (int)image.height; y++) {
+            for (int x = 0; x < (int)image.width; x++) {
+                size_t i = y * image.width + x;
+                int gx = reference_gradient(&image, &kx[k], x, y);
+                int gy = reference_gradient(&image, &ky[k], x, y);
+                mu_assert("Gx should match the signed kernel response", l2.gx[i] == gx);
+                mu_assert("Gy should match the signed kernel response", l2.gy[i] == gy);
+                mu_assert("L1 magnitude should be |gx| + |gy|", l1.magnitude[i] == abs(gx) + abs(gy));
+                mu_assert("L2 magnitude should be rounded hypot", l2.magnitude[i] == (int)lroundf(sqrtf((float)(gx * gx + gy * gy))));
+
+                float angle = atan2f((float)gy, (float)gx) * 180.0f / (float)M_PI;
+                if (angle < 0) angle += 180.0f;
+                int expected = angle < 22.5f || angle >= 157.5f ? GRADIENT_DIR_0 :
+                               angle < 67.5f ? GRADIENT_DIR_45 : angle < 112.5f ? GRADIENT_DIR_90 : GRADIENT_DIR_135;
+                mu_assert("Orientation bin should match atan2", l2.direction[i] == expected);
+                if (gx < 0 || gy < 0) negative_seen = 1;
+            }
+        }
+        free_gradient_field(&l2);
+        free_gradient_field(&l1);
+        free_kernel(&kx[k]);
+        free_kernel(&ky[k]);
+    }
+    mu_assert("Negative gradients should be preserved", negative_seen);
+
+    free(image.data);
+    return 0;
+}
+
+char *test_canny_hysteresis_long_edges() {
+    // A vertical step whose contrast fades from 200 to 40 down a tall image:
+    // only the top is strong, the rest must be kept through connectivity
+    // across every hysteresis band. A second, uniformly faint step is never
+    // connected to a strong pixel and must vanish.
+    int width = 200;
+    int height = 1500;
+    grayscale_image_t image = { .width = (size_t)width, .height = (size_t)height };
+    image.data = (unsigned char*)malloc((size_t)width * height);
+    mu_assert("Test image allocation failed", image.data != NULL);
+    for (int y = 0; y < height; y++) {
+        int contrast = 200 - (160 * y) / height;
+        for (int x = 0; x < width; x++) {
+            int value = 20;
+            if (x >= 50) value += contrast;
+            if (x >= 150) value += 40;
+            image.data[y * width + x] = (unsigned char)(value > 255 ? 255 : value);
+        }
+    }
+
+    grayscale_image_t edges = apply_canny_edge_detection(&image, 1.4f, 0.1f, 0.5f);
+    mu_assert("Canny image data is null", edges.data != NULL);
+
+    int connected_rows = 0;
+    int isolated_pixels = 0;
+    for (int y = 2; y < height - 2; y++) {
+        int found = 0;
+        for (int x = 45; x <= 55; x++) found |= edges.data[y * width + x] == 255;
+        connected_rows += found;
+        for (int x = 140; x <= 160; x++) isolated_pixels += edges.data[y * width + x] != 0;
+    }
+    mu_assert("Faded edge should be tracked down the whole image", connected_rows == height - 4);
+    mu_assert("Unconnected weak edge should be removed", isolated_pixels == 0);
+
+    free(edges.data);
+    free(image.data);
+    return 0;
+}
+
+char *test_constant_cost_blurs() {
+    grayscale_image_t image = make_test_image(97, 61);
+    mu_assert("Test image allocation failed", image.data != NULL);
+
+    // Kernel mode keeps the historical 5x5 blur at sigma 1
+    kernel_t legacy = create_gaussian_blur_kernel(5, 1.0f);
+    grayscale_image_t legacy_blur = apply_convolution_grayscale(&image, &legacy);
+    grayscale_image_t kernel_blur = apply_gaussian_blur(&image, 1.0f, BLUR_MODE_KERNEL);
+    mu_assert("Kernel blur should not be NULL", kernel_blur.data != NULL);
+    mu_assert("Kernel mode should match the 5x5 kernel",
+              memcmp(legacy_blur.data, kernel_blur.data, image.width * image.height) == 0);
+
+    // Recursive and box blurs approximate a wide Gaussian
+    float sigma = 5.0f;
+    kernel_t wide = create_gaussian_blur_kernel(31, sigma);
+    grayscale_image_t exact = apply_convolution_grayscale(&image, &wide);
+    blur_mode_t modes[] = { BLUR_MODE_RECURSIVE, BLUR_MODE_BOX };
+    for (int m = 0; m < 2; m++) {
+        grayscale_image_t approx = apply_gaussian_blur(&image, sigma, modes[m]);
+        mu_assert("Approximate blur should not be NULL", approx.data != NULL);
+        long total_error = 0;
+        for (size_t i = 0; i < image.width * image.height; i++) {
+            total_error += abs((int)approx.data[i] - (int)exact.data[i]);
+        }
+        mu_assert("Approximate blur should stay close to the Gaussian",
+                  total_error < (long)(image.width * image.height) * 2);
+        free(approx.data);
+    }
+
+    // A flat image is a fixed point of every mode
+    memset(image.data, 173, image.width * image.height);
+    for (int m = 0; m < 2; m++) {
+        grayscale_image_t flat = apply_gaussian_blur(&image, 12.0f, modes[m]);
+        mu_assert("Flat blur should not be NULL", flat.data != NULL);
+        int flat_ok = 1;
+        for (size_t i = 0; i < image.width * image.height; i++) flat_ok &= flat.data[i] == 173;
+        mu_assert("Flat image should be unchanged by the blur", flat_ok);
+        free(flat.data);
+    }
+
+    blur_mode_t parsed;
+    mu_assert("iir should parse", parse_blur_mode("iir", &parsed) && parsed == BLUR_MODE_RECURSIVE);
+    mu_assert("Unknown blur mode should be rejected", !parse_blur_mode("fast", &parsed));
+
+    free(legacy_blur.data);
+    free(kernel_blur.data);
+    free(exact.data);
+    free_kernel(&legacy);
+    free_kernel(&wide);
+    free(image.data);
+    return 0;
+}
+
+char *test_fixed_point_convolution() {
+    grayscale_image_t image = make_test_image(53, 29);
+    mu_assert("Test image allocation failed", image.data != NULL);
+
+    // Built-in integer kernels take the constant specialisations and stay exact
+    kernel_t fixed_kernels[] = { create_sharpen_kernel(), create_laplacian_kernel(), create_sobel_x_kernel(),
+                                 create_prewitt_y_kernel(), create_roberts_x_kernel() };
+    for (int k = 0; k < 5; k++) {
+        grayscale_image_t result = apply_convolution_grayscale(&image, &fixed_kernels[k]);
+        mu_assert("Constant kernel result should not be NULL", result.data != NULL);
+        mu_assert("Constant kernel should match the reference exactly",
+                  max_reference_error(&image, &fixed_kernels[k], &result) == 0);
+        free(result.data);
+        free_kernel(&fixed_kernels[k]);
+    }
+
+    // A non-separable 5x5 integer kernel with an offset stays exact in 16-bit sums
+    float log_values[25] = {
+         0,  0, -1,  0,  0,
+         0, -1, -2, -1,  0,
+        -1, -2, 16, -2, -1,
+         0, -1, -2, -1,  0,
+         0,  0, -1,  0,  0
+    };
+    kernel_t log5 = { .size = 5, .divisor = 1.0f, .offset = 128.0f };
+    log5.data = log_values;
+    grayscale_image_t log_result = apply_convolution_grayscale(&image, &log5);
+    mu_assert("LoG result should not be NULL", log_result.data != NULL);
+    mu_assert("Integer 5x5 kernel should match the reference exactly", max_reference_error(&image, &log5, &log_result) == 0);
+    free(log_result.data);
+
+    // Fractional non-separable 7x7 kernel is quantized to fixed point within one level
+    float ring_values[49];
+    for (int i = 0; i < 49; i++) {
+        int dx = i % 7 - 3, dy = i / 7 - 3;
+        ring_values[i] = (dx * dx + dy * dy <= 9 ? 1.0f : 0.0f) + 0.01f * (float)(dx * dy);
+    }
+    kernel_t ring = { .size = 7, .divisor = 29.0f, .offset = 0.5f };
+    ring.data = ring_values;
+    grayscale_image_t ring_result = apply_convolution_grayscale(&image, &ring);
+    mu_assert("Ring result should not be NULL", ring_result.data != NULL);
+    mu_assert("Fixed-point 7x7 kernel should stay within one level", max_reference_error(&image, &ring, &ring_result) <= 1);
+    free(ring_result.data);
+
+    free(image.data);
+    return 0;
+}
+
+char *test_thread_count_invariance() {
+    grayscale_image_t image = make_test_image(640, 480);
+    mu_assert("Test image allocation failed", image.data != NULL);
+    kernel_t gaussian = create_gaussian_blur_kernel(9, 2.0f);
+    kernel_t sharpen = create_sharpen_kernel();
+    grayscale_image_t results[2][5];
+
+    // Five threads split every operation into several bands, which must not show in the output
+    int thread_counts[2] = { 1, 5 };
+    for (int t = 0; t < 2; t++) {
+        set_thread_count(thread_counts[t]);
+        results[t][0] = apply_convolution_grayscale(&image, &gaussian);
+        results[t][1] = apply_convolution_grayscale(&image, &sharpen);
+        results[t][2] = apply_canny_edge_detection(&image, 1.4f, 0.4f, 0.2f);
+        results[t][3] = apply_gaussian_blur(&image, 4.0f, BLUR_MODE_RECURSIVE);
+        results[t][4] = apply_gaussian_blur(&image, 4.0f, BLUR_MODE_BOX);
+    }
+    mu_assert("Test image should be split into several bands", parallel_band_count(image.height, image.width * 9) > 1);
+    set_thread_count(0);
+
+    for (int i = 0; i < 5; i++) {
+        mu_assert("Threaded result should not be NULL", results[0][i].data != NULL && results[1][i].data != NULL);
+        mu_assert("Result should not depend on the thread count",
+                  memcmp(results[0][i].data, results[1][i].data, image.width * image.height) == 0);
+        free(results[0][i].data);
+        free(results[1][i].data);
+    }
+
+    free_kernel(&gaussian);
+    free_kernel(&sharpen);
+    free(image.data);
+    return 0;
+}
+
+char *test_fft_convolution() {
+    grayscale_image_t image = make_test_image(150, 90);
+    mu_assert("Test image allocation failed", image.data != NULL);
+
+    // Non-separable 21x21 kernel: far cheaper through spectra than 441 taps per pixel
+    float values[21 * 21];
+    for (int i = 0; i < 21 * 21; i++) {
+        int dx = i % 21 - 10, dy = i / 21 - 10;
+        values[i] = (float)((dx * dx + dy * dy) % 7) - 2.5f + 0.1f * (float)dx;
+    }
+    kernel_t kernel = { .size = 21, .divisor = 180.0f, .offset = 100.0f };
+    kernel.data = values;
+    mu_assert("Large kernel should take the FFT path", fft_convolution_preferred(&kernel, image.width, image.height, false));
+    mu_assert("Small kernel should stay spatial", !fft_convolution_preferred(&(kernel_t){ .size = 5, .divisor = 1.0f },
+                                                                             image.width, image.height, false));
+
+    grayscale_image_t result = apply_convolution_grayscale(&image, &kernel);
+    mu_assert("FFT convolution result should not be NULL", result.data != NULL);
+    mu_assert("FFT convolution should match the spatial reference within one level",
+              max_reference_error(&image, &kernel, &result) <= 1);
+
+    free(result.data);
+    free(image.data);
+    return 0;
+}
+
+// Apply the filters of a chain one at a time through the whole-image functions
+static grayscale_image_t apply_filters_sequentially(const grayscale_image_t* image, const filter_chain_t* chain,
+                                                    const filter_chain_params_t* params) {
+    grayscale_image_t current = { .width = image->width, .height = image->height, .data = (unsigned char*)malloc(image->width * image->height) };
+    memcpy(current.data, image->data, image->width * image->height);
+    for (size_t i = 0; i < chain->count; i++) {
+        grayscale_image_t next = {0};
+        kernel_t kernel = {0};
+        switch (chain->filters[i]) {
+            case FILTER_BLUR: next = apply_gaussian_blur(&current, params->blur_sigma, params->blur_mode); break;
+            case FILTER_SHARPEN: kernel = create_sharpen_kernel(); break;
+            case FILTER_EDGE_LAPLACIAN: kernel = create_laplacian_kernel(); break;
+            case FILTER_EDGE_SOBEL: next = apply_sobel_edge_detection(&current); break;
+            case FILTER_EDGE_PREWITT: next = apply_prewitt_edge_detection(&current); break;
+            case FILTER_EDGE_ROBERTS: next = apply_roberts_edge_detection(&current); break;
+            default: break;
+        }
+        if (kernel.data != NULL) {
+            next = apply_convolution_grayscale(&current, &kernel);
+            free_kernel(&kernel);
+        }
+        free(current.data);
+        current = next;
+    }
+    return current;
+}
+
+char *test_filter_chain() {
+    grayscale_image_t image = make_test_image(403, 301);
+    mu_assert("Test image allocation failed", image.data != NULL);
+
+    filter_chain_t chain;
+    mu_assert("Chain should parse", parse_filter_chain("blur,sharpen,sobel", &chain) && chain.count == 3);
+    mu_assert("Empty chain entries should be rejected", !parse_filter_chain("blur,,sobel", &chain));
+    mu_assert("Unknown filter names should be rejected", !parse_filter_chain("blur,nosuchfilter", &chain));
+    mu_assert("None entries should be dropped", parse_filter_chain("none,sobel", &chain) && chain.count == 1);
+
+    // Fully streamed chains, and one whose recursive blur splits it into two fused runs
+    const char* chains[3] = { "blur,sharpen,sobel", "sharpen,laplacian,roberts,prewitt", "laplacian,blur,prewitt,sharpen" };
+    blur_mode_t modes[3] = { BLUR_MODE_KERNEL, BLUR_MODE_KERNEL, BLUR_MODE_RECURSIVE };
+    for (int c = 0; c < 3; c++) {
+        filter_chain_params_t params = { .blur_mode = modes[c], .blur_sigma = 2.0f, .noise_density = 0.0f,
+                                         .cutoff = 20.0 };
+        mu_assert("Chain should parse", parse_filter_chain(chains[c], &chain));
+        grayscale_image_t expected = apply_filters_sequentially(&image, &chain, &params);
+        mu_assert("Sequential result should not be NULL", expected.data != NULL);
+
+        int thread_counts[2] = { 1, 5 };
+        for (int t = 0; t < 2; t++) {
+            set_thread_count(thread_counts[t]);
+            grayscale_image_t result = apply_filter_chain(&image, &chain, &params);
+            mu_assert("Chain result should not be NULL", result.data != NULL);
+            mu_assert("Chain should match applying its filters one by one",
+                      memcmp(result.data, expected.data, image.width * image.height) == 0);
+            free(result.data);
+        }
+        set_thread_count(0);
+        free(expected.data);
+    }
+
+    // Colour-aware stages of an RGB chain see the whole image, as they do on their own
+    grayscale_image_t green = make_test_image(97, 71), blue = make_test_image(71, 97);
+    rgb_image_t rgb = { .width = 97, .height = 71, .r_data = green.data, .g_data = green.data, .b_data = blue.data };
+    rgb.r_data = (unsigned char*)malloc(97 * 71);
+    mu_assert("Test image allocation failed", green.data != NULL && blue.data != NULL && rgb.r_data != NULL);
+    for (size_t i = 0; i < 97 * 71; i++) {
+        rgb.r_data[i] = (unsigned char)(255 - green.data[i]);
+    }
+    filter_chain_params_t rgb_params = { .blur_mode = BLUR_MODE_KERNEL, .blur_sigma = 2.0f,
+                                         .spatial_sigma = 4.0f, .range_sigma = 20.0f,
+                                         .guided_radius = 3, .guided_epsilon = 0.01f, .guided_subsample = 1,
+                                         .nlm_search_radius = 3, .nlm_patch_radius = 1, .nlm_strength = 15.0f };
+    mu_assert("Chain should parse", parse_filter_chain("sharpen", &chain));
+    rgb_image_t sharpened = apply_filter_chain_rgb(&rgb, &chain, &rgb_params);
+    rgb_image_t smoothed = apply_bilateral_filter_rgb(&sharpened, rgb_params.spatial_sigma, rgb_params.range_sigma);
+    rgb_image_t guided = apply_guided_filter_rgb(&smoothed, NULL, rgb_params.guided_radius,
+                                                 rgb_params.guided_epsilon, rgb_params.guided_subsample);
+    rgb_image_t expected_rgb = apply_nl_means_rgb(&guided, rgb_params.nlm_search_radius, rgb_params.nlm_patch_radius,
+                                                  rgb_params.nlm_strength);
+    mu_assert("Chain should parse", parse_filter_chain("sharpen,bilateral,guided,nlmeans", &chain));
+    rgb_image_t chained = apply_filter_chain_rgb(&rgb, &chain, &rgb_params);
+    mu_assert("RGB chain result should not be NULL", chained.r_data != NULL && expected_rgb.r_data != NULL);
+    mu_assert("RGB chain should match the colour-aware filters",
+              memcmp(chained.r_data, expected_rgb.r_data, 97 * 71) == 0 &&
+              memcmp(chained.g_data, expected_rgb.g_data, 97 * 71) == 0 &&
+              memcmp(chained.b_data, expected_rgb.b_data, 97 * 71) == 0);
+
+    free_rgb_image(&chained);
+    free_rgb_image(&expected_rgb);
+    free_rgb_image(&guided);
+    free_rgb_image(&smoothed);
+    free_rgb_image(&sharpened);
+    free(rgb.r_data);
+    free(green.data);
+    free(blue.data);
+    free(image.data);
+    return 0;
+}
+
+static int compare_bytes(const void* a, const void* b) {
+    return *(const unsigned char*)a - *(const unsigned char*)b;
+}
+
+char *test_median_filter() {
+    grayscale_image_t image = make_test_image(131, 77);
+    mu_assert("Test image allocation failed", image.data != NULL);
+    int width = (int)image.width, height = (int)image.height;
+
+    // Radii 1 and 2 take the selection networks, larger ones the sliding histograms
+    int radii[4] = { 1, 2, 3, 9 };
+    unsigned char window[19 * 19];
+    for (int r = 0; r < 4; r++) {
+        int radius = radii[r];
+        set_thread_count(r + 1);
+        grayscale_image_t result = apply_median_filter(&image, radius);
+        mu_assert("Median result should not be NULL", result.data != NULL);
+        int mismatches = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                int n = 0;
+                for (int dy = -radius; dy <= radius; dy++) {
+                    for (int dx = -radius; dx <= radius; dx++) {
+                        int sy = y + dy < 0 ? 0 : (y + dy >= height ? height - 1 : y + dy);
+                        int sx = x + dx < 0 ? 0 : (x + dx >= width ? width - 1 : x + dx);
+                        window[n++] = image.data[sy * width + sx];
+                    }
+                }
+                qsort(window, (size_t)n, 1, compare_bytes);
+                mismatches += window[n / 2] != result.data[y * width + x];
+            }
+        }
+        mu_assert("Median should match a sorted window", mismatches == 0);
+        free(result.data);
+    }
+    set_thread_count(0);
+
+    // Sparse impulse noise on a flat image is removed entirely
+    memset(image.data, 90, image.width * image.height);
+    for (size_t i = 0; i < image.width * image.height; i += 23) {
+        image.data[i] = (i / 23) % 2 ? 255 : 0;
+    }
+    grayscale_image_t cleaned = apply_median_filter(&image, 1);
+    mu_assert("Median result should not be NULL", cleaned.data != NULL);
+    for (size_t i = 0; i < image.width * image.height; i++) {
+        mu_assert("Median should remove isolated impulses", cleaned.data[i] == 90);
+    }
+    mu_assert("Radius zero should be rejected", apply_median_filter(&image, 0).data == NULL);
+
+    free(cleaned.data);
+    free(image.data);
+    return 0;
+}
+
+char *test_bilateral_filter() {
+    // Noisy step edge: 60 on the left, 190 on the right, +-10 of noise
+    size_t width = 120, height = 90, pixels = width * height;
+    grayscale_image_t image = { .width = width, .height = height, .data = (unsigned char*)malloc(pixels) };
+    mu_assert("Test image allocation failed", image.data != NULL);
+    for (size_t i = 0; i < pixels; i++) {
+        int base = i % width < width / 2 ? 60 : 190;
+        image.data[i] = (unsigned char)(base + (int)((i * 7919) % 21) - 10);
+    }
+
+    set_thread_count(1);
+    grayscale_image_t single = apply_bilateral_filter(&image, 4.0f, 25.0f);
+    set_thread_count(3);
+    grayscale_image_t banded = apply_bilateral_filter(&image, 4.0f, 25.0f);
+    set_thread_count(0);
+    mu_assert("Bilateral result should not be NULL", single.data != NULL && banded.data != NULL);
+    mu_assert("Bilateral filter should not depend on the thread count",
+              memcmp(single.data, banded.data, pixels) == 0);
+
+    long noise_before = 0, noise_after = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        int base = i % width < width / 2 ? 60 : 190;
+        noise_before += abs(image.data[i] - base);
+        noise_after += abs(single.data[i] - base);
+        // Pixels next to the edge must not be pulled towards the other side
+        mu_assert("Bilateral filter should preserve the step edge", abs(single.data[i] - base) <= 12);
+    }
+    mu_assert("Bilateral filter should reduce the noise", noise_after * 3 < noise_before);
+
+    // A colour image whose channels are equal keeps them equal
+    rgb_image_t rgb = { .width = width, .height = height, .r_data = image.data, .g_data = image.data, .b_data = image.data };
+    rgb_image_t filtered = apply_bilateral_filter_rgb(&rgb, 4.0f, 25.0f);
+    mu_assert("Bilateral RGB result should not be NULL", filtered.r_data != NULL);
+    mu_assert("Bilateral RGB channels should stay equal",
+              memcmp(filtered.r_data, filtered.g_data, pixels) == 0 &&
+              memcmp(filtered.r_data, filtered.b_data, pixels) == 0);
+
+    // Sigmas of one pixel and one grey level on a larger image would need a
+    // grid of hundreds of millions of cells; they are coarsened instead
+    size_t big_width = 800, big_height = 600, big_pixels = big_width * big_height;
+    grayscale_image_t big = { .width = big_width, .height = big_height, .data = (unsigned char*)malloc(big_pixels) };
+    mu_assert("Test image allocation failed", big.data != NULL);
+    for (size_t i = 0; i < big_pixels; i++) {
+        big.data[i] = i % big_width < big_width / 2 ? 60 : 190;
+    }
+    grayscale_image_t fine = apply_bilateral_filter(&big, 1.0f, 1.0f);
+    mu_assert("Bilateral filter with small sigmas should not be NULL", fine.data != NULL);
+    for (size_t i = 0; i < big_pixels; i++) {
+        mu_assert("Bilateral filter with small sigmas should keep a flat step", fine.data[i] == big.data[i]);
+    }
+
+    free(fine.data);
+    free(big.data);
+    free_rgb_image(&filtered);
+    free(single.data);
+    free(banded.data);
+    free(image.data);
+    return 0;
+}
+
+// Edge-clamped box mean for the guided filter reference
+static double* reference_box_mean(const double* plane, int width, int height, int radius) {
+    double* mean = (double*)malloc(sizeof(double) * width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double sum = 0.0;
+            for (int dy = -radius; dy <= radius; dy++) {
+                for (int dx = -radius; dx <= radius; dx++) {
+                    int sy = y + dy < 0 ? 0 : (y + dy >= height ? height - 1 : y + dy);
+                    int sx = x + dx < 0 ? 0 : (x + dx >= width ? width - 1 : x + dx);
+                    sum += plane[sy * width + sx];
+                }
+            }
+            mean[y * width + x] = sum / ((2 * radius + 1) * (2 * radius + 1));
+        }
+    }
+    return mean;
+}
+
+char *test_guided_filter() {
+    // Noisy step edge, filtered with itself as the guide
+    int width = 97, height = 61, radius = 5, pixels = width * height;
+    double eps = 0.01;
+    grayscale_image_t image = { .width = (size_t)width, .height = (size_t)height, .data = (unsigned char*)malloc((size_t)pixels) };
+    mu_assert("Test image allocation failed", image.data != NULL);
+    for (int i = 0; i < pixels; i++) {
+        image.data[i] = (unsigned char)((i % width < width / 2 ? 60 : 190) + (i * 7919) % 31 - 15);
+    }
+
+    double* guide = (double*)malloc(sizeof(double) * pixels);
+    double* square = (double*)malloc(sizeof(double) * pixels);
+    for (int i = 0; i < pixels; i++) {
+        guide[i] = image.data[i] / 255.0;
+        square[i] = guide[i] * guide[i];
+    }
+    double* mean = reference_box_mean(guide, width, height, radius);
+    double* mean_square = reference_box_mean(square, width, height, radius);
+    for (int i = 0; i < pixels; i++) {
+        double variance = mean_square[i] - mean[i] * mean[i];
+        square[i] = variance / (variance + eps);            // a
+        mean_square[i] = mean[i] - square[i] * mean[i];     // b
+    }
+    double* mean_a = reference_box_mean(square, width, height, radius);
+    double* mean_b = reference_box_mean(mean_square, width, height, radius);
+
+    set_thread_count(1);
+    grayscale_image_t single = apply_guided_filter(&image, NULL, radius, (float)eps, 1);
+    set_thread_count(3);
+    grayscale_image_t banded = apply_guided_filter(&image, &image, radius, (float)eps, 1);
+    set_thread_count(0);
+    mu_assert("Guided result should not be NULL", single.data != NULL && banded.data != NULL);
+    mu_assert("Guided filter should not depend on the thread count",
+              memcmp(single.data, banded.data, (size_t)pixels) == 0);
+    for (int i = 0; i < pixels; i++) {
+        double expected = (mean_a[i] * guide[i] + mean_b[i]) * 255.0;
+        mu_assert("Guided filter should match the box-mean reference", fabs(expected - single.data[i]) <= 1.0);
+    }
+
+    // The fast mode fits the same model on a coarser grid
+    grayscale_image_t fast = apply_guided_filter(&image, NULL, radius, (float)eps, 2);
+    mu_assert("Fast guided result should not be NULL", fast.data != NULL);
+    for (int i = 0; i < pixels; i++) {
+        mu_assert("Fast guided filter should stay close to the exact one", abs(fast.data[i] - single.data[i]) <= 8);
+    }
+
+    // A flat matte guided by a colour image keeps its value
+    rgb_image_t color = { .width = (size_t)width, .height = (size_t)height, .r_data = image.data, .g_data = single.data, .b_data = fast.data };
+    grayscale_image_t matte = { .width = (size_t)width, .height = (size_t)height, .data = (unsigned char*)malloc((size_t)pixels) };
+    memset(matte.data, 128, (size_t)pixels);
+    grayscale_image_t refined = apply_guided_filter_color_guide(&matte, &color, radius, (float)eps, 1);
+    mu_assert("Colour-guided result should not be NULL", refined.data != NULL);
+    for (int i = 0; i < pixels; i++) {
+        mu_assert("Colour-guided filter should keep a flat input flat", refined.data[i] == 128);
+    }
+    mu_assert("Mismatched guide should be rejected",
+              apply_guided_filter(&image, &(grayscale_image_t){ .width = 3, .height = 3, .data = image.data }, radius, (float)eps, 1).data == NULL);
+
+    free(refined.data);
+    free(matte.data);
+    free(fast.data);
+    free(single.data);
+    free(banded.data);
+    free(mean_a);
+    free(mean_b);
+    free(mean);
+    free(mean_square);
+    free(square);
+    free(guide);
+    free(image.data);
+    return 0;
+}
+
+static int clamp_coord(int i, int n) {
+    return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+char *test_nl_means() {
+    int width = 53, height = 37, search = 3, patch = 2, pixels = width * height;
+    float strength = 12.0f;
+    grayscale_image_t image = { .width = (size_t)width, .height = (size_t)height, .data = (unsigned char*)malloc((size_t)pixels) };
+    mu_assert("Test image allocation failed", image.data != NULL);
+    for (int i = 0; i < pixels; i++) {
+        image.data[i] = (unsigned char)((i % width < width / 2 ? 60 : 190) + (i * 7919) % 31 - 15);
+    }
+
+    set_thread_count(1);
+    grayscale_image_t single = apply_nl_means(&image, search, patch, strength);
+    set_thread_count(3);
+    grayscale_image_t banded = apply_nl_means(&image, search, patch, strength);
+    set_thread_count(0);
+    mu_assert("Non-local means result should not be NULL", single.data != NULL && banded.data != NULL);
+    mu_assert("Non-local means should not depend on the thread count",
+              memcmp(single.data, banded.data, (size_t)pixels) == 0);
+
+    // Brute-force patch distances with clamped borders
+    double area = (2 * patch + 1) * (2 * patch + 1);
+    long noise_before = 0, noise_after = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double weights = 0.0, values = 0.0, best = 0.0;
+            for (int dy = -search; dy <= search; dy++) {
+                for (int dx = -search; dx <= search; dx++) {
+                    if (dx == 0 && dy == 0) continue;
+                    double distance = 0.0;
+                    for (int py = -patch; py <= patch; py++) {
+                        for (int px = -patch; px <= patch; px++) {
+                            int a = image.data[clamp_coord(y + py, height) * width + clamp_coord(x + px, width)];
+                            int b = image.data[clamp_coord(y + py + dy, height) * width + clamp_coord(x + px + dx, width)];
+                            distance += (a - b) * (a - b);
+                        }
+                    }
+                    double w = exp(-distance / area / (strength * strength));
+                    weights += w;
+                    values += w * image.data[clamp_coord(y + dy, height) * width + clamp_coord(x + dx, width)];
+                    best = w > best ? w : best;
+                }
+            }
+            weights += best;
+            values += best * image.data[y * width + x];
+            int i = y * width + x;
+            mu_assert("Non-local means should match the brute-force weights", fabs(values / weights - single.data[i]) <= 1.0);
+            int base = x < width / 2 ? 60 : 190;
+            noise_before += abs(image.data[i] - base);
+            noise_after += abs(single.data[i] - base);
+        }
+    }
+    mu_assert("Non-local means should reduce the noise", noise_after * 2 < noise_before);
+
+    // Equal channels give equal patch distances, hence the grayscale result
+    rgb_image_t rgb = { .width = (size_t)width, .height = (size_t)height, .r_data = image.data, .g_data = image.data, .b_data = image.data };
+    rgb_image_t filtered = apply_nl_means_rgb(&rgb, search, patch, strength);
+    mu_assert("Non-local means RGB result should not be NULL", filtered.r_data != NULL);
+    mu_assert("Non-local means RGB should weigh the channels together",
+              memcmp(filtered.r_data, single.data, (size_t)pixels) == 0 &&
+              memcmp(filtered.b_data, single.data, (size_t)pixels) == 0);
+    mu_assert("Oversized search radius should be rejected",
+              apply_nl_means(&image, MAX_NLM_SEARCH_RADIUS + 1, patch, strength).data == NULL);
+
+    free_rgb_image(&filtered);
+    free(single.data);
+    free(banded.data);
+    free(image.data);
+    return 0;
+}
+
+// Brute-force erosion or dilation with the element clipped to the image
+static void reference_erode(const unsigned char* input, unsigned char* output, int width, int height,
+                            int element_width, int element_height, bool dilate) {
+    int ax = dilate ? element_width - 1 - element_width / 2 : element_width / 2;
+    int ay = dilate ? element_height - 1 - element_height / 2 : element_height / 2;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int best = dilate ? 0 : 255;
+            for (int j = 0; j < element_height; j++) {
+                for (int i = 0; i < element_width; i++) {
+                    int sy = y - ay + j, sx = x - ax + i;
+                    if (sy < 0 || sy >= height || sx < 0 || sx >= width) continue;
+                    int value = input[sy * width + sx];
+                    if (dilate ? value > best : value < best) best = value;
+                }
+            }
+            output[y * width + x] = (unsigned char)best;
+        }
+    }
+}
+
+char *test_morphology() {
+    grayscale_image_t image = make_test_image(150, 97);
+    mu_assert("Test image allocation failed", image.data != NULL);
+    grayscale_image_t mask = { .width = image.width, .height = image.height, .data = (unsigned char*)malloc(image.width * image.height) };
+    for (size_t i = 0; i < image.width * image.height; i++) {
+        mask.data[i] = image.data[i] > 120 ? 255 : 0;
+    }
+    size_t pixels = image.width * image.height;
+    unsigned char* eroded = (unsigned char*)malloc(pixels);
+    unsigned char* expected = (unsigned char*)malloc(pixels);
+
+    // Odd, even, one-dimensional and wider-than-the-image elements
+    int sizes[5][2] = { { 3, 3 }, { 4, 2 }, { 9, 1 }, { 1, 7 }, { 160, 31 } };
+    for (int s = 0; s < 5; s++) {
+        int ew = sizes[s][0], eh = sizes[s][1];
+        set_thread_count(s + 1);
+        for (int m = 0; m < 2; m++) {
+            // The 0/255 mask takes the bit-packed path
+            const grayscale_image_t* input = m == 0 ? &image : &mask;
+            for (int op = MORPHOLOGY_ERODE; op <= MORPHOLOGY_TOPHAT; op++) {
+                if (op == MORPHOLOGY_ERODE || op == MORPHOLOGY_DILATE) {
+                    reference_erode(input->data, expected, (int)image.width, (int)image.height, ew, eh,
+                                    op == MORPHOLOGY_DILATE);
+                } else {
+                    bool closing = op == MORPHOLOGY_CLOSE;
+                    reference_erode(input->data, eroded, (int)image.width, (int)image.height, ew, eh, closing);
+                    reference_erode(eroded, expected, (int)image.width, (int)image.height, ew, eh, !closing);
+                    for (size_t i = 0; op == MORPHOLOGY_TOPHAT && i < pixels; i++) {
+                        expected[i] = (unsigned char)(input->data[i] - expected[i]);
+                    }
+                }
+                grayscale_image_t result = apply_morphology(input, (morphology_op_t)op, (size_t)ew, (size_t)eh);
+                mu_assert("Morphology result should not be NULL", result.data != NULL);
+                mu_assert("Morphology should match the brute-force reference",
+                          memcmp(result.data, expected, pixels) == 0);
+                free(result.data);
+            }
+        }
+    }
+    set_thread_count(0);
+
+    // Any non-zero pixel counts as foreground in the explicit binary path
+    for (size_t i = 0; i < pixels; i++) {
+        mask.data[i] = mask.data[i] ? 1 : 0;
+    }
+    grayscale_image_t opened = apply_binary_morphology(&mask, MORPHOLOGY_OPEN, 5, 5);
+    mu_assert("Binary morphology result should not be NULL", opened.data != NULL);
+    for (size_t i = 0; i < pixels; i++) {
+        mask.data[i] *= 255;
+    }
+    reference_erode(mask.data, eroded, (int)image.width, (int)image.height, 5, 5, false);
+    reference_erode(eroded, expected, (int)image.width, (int)image.height, 5, 5, true);
+    mu_assert("Binary opening should treat non-zero as foreground", memcmp(opened.data, expected, pixels) == 0);
+
+    free(opened.data);
+    free(eroded);
+    free(expected);
+    free(mask.data);
+    free(image.data);
+    return 0;
+}
+
+#define VIEW_FILTER_COUNT 17
+
+// Filter `index` of the view test, applied to `image`
+static grayscale_image_t apply_view_filter(const grayscale_image_t* image, int index) {
+    static float fft_taps[21 * 21];
+    for (int i = 0; i < 21 * 21; i++) {
+        fft_taps[i] = (float)((i % 21 + i / 21) % 5) - 1.5f;
+    }
+    kernel_t fft_kernel = { .size = 21, .divisor = 90.0f, .offset = 128.0f, .data = fft_taps };
+    kernel_t kernel = {0};
+    grayscale_image_t result = {0};
+    filter_chain_t chain;
+    filter_chain_params_t params = { .blur_mode = BLUR_MODE_KERNEL, .blur_sigma = 1.5f };
+
+    switch (index) {
+        case 0: kernel = create_gaussian_blur_kernel(9, 2.0f); break;
+        case 1: kernel = create_sharpen_kernel(); break;
+        case 2: return apply_convolution_grayscale(image, &fft_kernel);
+        case 3: return apply_sobel_edge_detection(image);
+        case 4: return apply_canny_edge_detection(image, 1.4f, 0.4f, 0.2f);
+        case 5: return apply_median_filter(image, 1);
+        case 6: return apply_median_filter(image, 4);
+        case 7: return apply_bilateral_filter(image, 4.0f, 20.0f);
+        case 8: return apply_guided_filter(image, NULL, 4, 0.01f, 2);
+        case 9: return apply_nl_means(image, 3, 1, 10.0f);
+        case 10: return apply_gaussian_blur(image, 3.0f, BLUR_MODE_RECURSIVE);
+        case 11: return apply_gaussian_blur(image, 3.0f, BLUR_MODE_BOX);
+        case 12: return apply_morphology(image, MORPHOLOGY_TOPHAT, 5, 3);
+        case 13: return apply_frequency_filter(image, FILTER_GAUSSIAN_LOWPASS, 20.0);
+        case 14:
+            srand(7);
+            return apply_salt_pepper_noise(image, 0.1f);
+        case 15:
+            parse_filter_chain("blur,sharpen,sobel", &chain);
+            return apply_filter_chain(image, &chain, &params);
+        default:
+            return apply_otsu_thresholding(image);
+    }
+    result = apply_convolution_grayscale(image, &kernel);
+    free_kernel(&kernel);
+    return result;
+}
+
+char *test_filters_on_views() {
+    grayscale_image_t image = make_test_image(160, 120);
+    mu_assert("Test image allocation failed", image.data != NULL);
+
+    // A view whose rows are 160 bytes apart must filter like its packed copy
+    grayscale_image_t view = image_view_roi(&image, 9, 6, 131, 97);
+    grayscale_image_t packed = copy_grayscale_image(&view);
+    mu_assert("View and copy should not be NULL", view.data != NULL && packed.data != NULL);
+    size_t pixels = packed.width * packed.height;
+    for (int i = 0; i < VIEW_FILTER_COUNT; i++) {
+        grayscale_image_t from_view = apply_view_filter(&view, i);
+        grayscale_image_t from_packed = apply_view_filter(&packed, i);
+        mu_assert("Filtered view should not be NULL", from_view.data != NULL && from_packed.data != NULL);
+        mu_assert("Filtered view should be packed", from_view.stride == 0 && from_view.width == packed.width);
+        mu_assert("Filtering a view should match filtering its packed copy",
+                  memcmp(from_view.data, from_packed.data, pixels) == 0);
+        free_grayscale_image(&from_view);
+        free_grayscale_image(&from_packed);
+    }
+
+    // Bit-packed morphology reads its mask through the stride too
+    for (size_t i = 0; i < image.width * image.height; i++) {
+        image.data[i] = image.data[i] > 120 ? 255 : 0;
+    }
+    free_grayscale_image(&packed);
+    packed = copy_grayscale_image(&view);
+    grayscale_image_t from_view = apply_morphology(&view, MORPHOLOGY_CLOSE, 4, 6);
+    grayscale_image_t from_packed = apply_morphology(&packed, MORPHOLOGY_CLOSE, 4, 6);
+    mu_assert("Binary morphology of a view should match its packed copy",
+              from_view.data != NULL && from_packed.data != NULL &&
+              memcmp(from_view.data, from_packed.data, pixels) == 0);
+    free_grayscale_image(&from_view);
+    free_grayscale_image(&from_packed);
+
+    // RGB views share one stride across their planes
+    rgb_image_t rgb = allocate_rgb_image(160, 120);
+    mu_assert("RGB allocation failed", rgb.r_data != NULL);
+    grayscale_image_t texture = make_test_image(160, 120);
+    for (size_t i = 0; i < 160 * 120; i++) {
+        rgb.r_data[i] = texture.data[i];
+        rgb.g_data[i] = (unsigned char)(255 - texture.data[i]);
+        rgb.b_data[i] = (unsigned char)(texture.data[i] / 2 + 60);
+    }
+    rgb_image_t rgb_view = image_view_roi_rgb(&rgb, 9, 6, 131, 97);
+    unsigned char* view_planes[3] = { rgb_view.r_data, rgb_view.g_data, rgb_view.b_data };
+    grayscale_image_t packed_planes[3];
+    for (int c = 0; c < 3; c++) {
+        grayscale_image_t plane = image_view_buffer(view_planes[c], 131, 97, rgb_view.stride);
+        packed_planes[c] = copy_grayscale_image(&plane);
+    }
+    rgb_image_t rgb_packed = { .width = 131, .height = 97, .r_data = packed_planes[0].data,
+                               .g_data = packed_planes[1].data, .b_data = packed_planes[2].data };
+    for (int i = 0; i < 3; i++) {
+        rgb_image_t a = i == 0 ? apply_bilateral_filter_rgb(&rgb_view, 4.0f, 20.0f)
+                      : i == 1 ? apply_guided_filter_rgb(&rgb_view, NULL, 3, 0.02f, 1)
+                               : apply_median_filter_rgb(&rgb_view, 2);
+        rgb_image_t b = i == 0 ? apply_bilateral_filter_rgb(&rgb_packed, 4.0f, 20.0f)
+                      : i == 1 ? apply_guided_filter_rgb(&rgb_packed, NULL, 3, 0.02f, 1)
+                               : apply_median_filter_rgb(&rgb_packed, 2);
+        mu_assert("Filtered RGB view should not be NULL", a.r_data != NULL && b.r_data != NULL);
+        mu_assert("Filtering an RGB view should match filtering its packed copy",
+                  memcmp(a.r_data, b.r_data, pixels) == 0 && memcmp(a.g_data, b.g_data, pixels) == 0 &&
+                  memcmp(a.b_data, b.b_data, pixels) == 0);
+        free_rgb_image(&a);
+        free_rgb_image(&b);
+    }
+
+    for (int c = 0; c < 3; c++) {
+        free_grayscale_image(&packed_planes[c]);
+    }
+    free_rgb_image(&rgb);
+    free(texture.data);
+    free_grayscale_image(&packed);
+    free(image.data);
+    return 0;
+}
+
 char *all_tests() {
     mu_run_test(test_canny_edge_detector);
+    mu_run_test(test_separable_convolution);
+    mu_run_test(test_gradient_field);
+    mu_run_test(test_canny_hysteresis_long_edges);
+    mu_run_test(test_constant_cost_blurs);
+    mu_run_test(test_fixed_point_convolution);
+    mu_run_test(test_thread_count_invariance);
+    mu_run_test(test_fft_convolution);
+    mu_run_test(test_filter_chain);
+    mu_run_test(test_median_filter);
+    mu_run_test(test_bilateral_filter);
+    mu_run_test(test_guided_filter);
+    mu_run_test(test_nl_means);
+    mu_run_test(test_morphology);
+    mu_run_test(test_filters_on_views);
     return 0;
 }
 
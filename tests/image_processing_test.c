@@ -1,11 +1,23 @@
 #include "minunit.h"
 #include "image_processing.h"
+#include "image_alloc.h"
+#include "integral_image.h"
+#include "parallel.h"
+#include "resample.h"
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 char *test_otsu_thresholding();
 char *test_adaptive_thresholding();
 char *test_region_growing();
+char *test_integral_image();
+char *test_resize_average();
+char *test_resize_kernels();
+char *test_image_views();
+char *test_image_alloc();
+char *test_buffer_pool();
 
 char *test_equalize_histogram() {
     int width = 2;
@@ -180,6 +192,12 @@ char *all_tests() {
     mu_run_test(test_otsu_thresholding);
     mu_run_test(test_adaptive_thresholding);
     mu_run_test(test_region_growing);
+    mu_run_test(test_integral_image);
+    mu_run_test(test_resize_average);
+    mu_run_test(test_resize_kernels);
+    mu_run_test(test_image_views);
+    mu_run_test(test_image_alloc);
+    mu_run_test(test_buffer_pool);
     return 0;
 }
 
@@ -263,6 +281,370 @@ char *test_otsu_thresholding() {
     return 0;
 }
 
+char *test_integral_image() {
+    size_t width = 37, height = 23;
+    unsigned char *data = malloc(width * height);
+    int32_t *signed_data = malloc(width * height * sizeof(int32_t));
+    srand(7);
+    for (size_t i = 0; i < width * height; i++) {
+        data[i] = (unsigned char)(rand() % 256);
+        signed_data[i] = rand() % 130051 - 65025;
+    }
+
+    integral_image_t table;
+    integral_image64_t table64;
+    mu_assert("Integral image: build failed", build_integral_image(data, width, height, width, &table));
+    mu_assert("Integral image: 64-bit build failed", build_integral_image64(signed_data, width, height, width, &table64));
+
+    for (size_t y0 = 0; y0 <= height; y0 += 3) {
+        for (size_t y1 = y0; y1 <= height; y1 += 4) {
+            for (size_t x0 = 0; x0 <= width; x0 += 5) {
+                for (size_t x1 = x0; x1 <= width; x1 += 2) {
+                    uint32_t sum = 0;
+                    int64_t sum64 = 0;
+                    for (size_t y = y0; y < y1; y++) {
+                        for (size_t x = x0; x < x1; x++) {
+                            sum += data[y * width + x];
+                            sum64 += signed_data[y * width + x];
+                        }
+                    }
+                    mu_assert("Integral image: rectangle sum differs",
+                              integral_rect_sum(&table, x0, y0, x1, y1) == sum);
+                    mu_assert("Integral image: 64-bit rectangle sum differs",
+                              integral_rect_sum64(&table64, x0, y0, x1, y1) == sum64);
+                }
+            }
+        }
+    }
+
+    // Adaptive thresholding against the clipped-window mean
+    grayscale_image_t image = { .width = width, .height = height, .data = data };
+    grayscale_image_t thresholded = apply_adaptive_thresholding(&image, 7, 2.5);
+    mu_assert("Integral image: adaptive thresholding failed", thresholded.data != NULL);
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            double sum = 0;
+            int count = 0;
+            for (int j = -3; j <= 3; j++) {
+                for (int i = -3; i <= 3; i++) {
+                    int cx = (int)x + i, cy = (int)y + j;
+                    if (cx >= 0 && cx < (int)width && cy >= 0 && cy < (int)height) {
+                        sum += data[cy * width + cx];
+                        count++;
+                    }
+                }
+            }
+            unsigned char expected = data[y * width + x] > sum / count - 2.5 ? 255 : 0;
+            mu_assert("Integral image: adaptive threshold differs", thresholded.data[y * width + x] == expected);
+        }
+    }
+
+    free(thresholded.data);
+    free_integral_image(&table);
+    free_integral_image64(&table64);
+    free(data);
+    free(signed_data);
+    return 0;
+}
+
+char *test_resize_average() {
+    size_t width = 50, height = 30;
+    unsigned char *data = malloc(width * height);
+    for (size_t i = 0; i < width * height; i++) {
+        data[i] = (unsigned char)((i * 37) % 251);
+    }
+    grayscale_image_t image = { .width = width, .height = height, .data = data };
+
+    // 50x30 to 20x6: blocks of 2.5 x 5 pixels, so columns are split
+    grayscale_image_t resized = make_resized_grayscale(&image, 20, 20, INTERPOLATION_AVERAGE);
+    mu_assert("Resize average: result is null", resized.data != NULL);
+    mu_assert("Resize average: wrong size", resized.width == 20 && resized.height == 6);
+
+    // Each output pixel is the coverage-weighted mean of its area
+    double sx = (double)width / resized.width, sy = (double)height / resized.height;
+    for (size_t j = 0; j < resized.height; j++) {
+        for (size_t i = 0; i < resized.width; i++) {
+            double sum = 0;
+            for (size_t y = 0; y < height; y++) {
+                double wy = fmin(y + 1.0, (j + 1) * sy) - fmax((double)y, j * sy);
+                for (size_t x = 0; x < width && wy > 0; x++) {
+                    double wx = fmin(x + 1.0, (i + 1) * sx) - fmax((double)x, i * sx);
+                    if (wx > 0) sum += wx * wy * data[y * width + x];
+                }
+            }
+            double expected = sum / (sx * sy);
+            mu_assert("Resize average: area mean differs",
+                      fabs(resized.data[j * resized.width + i] - expected) <= 1.0);
+        }
+    }
+
+    // RGB channels match the grayscale path
+    rgb_image_t rgb = { .width = width, .height = height, .r_data = data, .g_data = data, .b_data = data };
+    rgb_image_t resized_rgb = make_resized_rgb(&rgb, 20, 20, INTERPOLATION_AVERAGE);
+    mu_assert("Resize average: RGB result is null", resized_rgb.r_data != NULL);
+    mu_assert("Resize average: RGB differs from grayscale",
+              memcmp(resized_rgb.g_data, resized.data, resized.width * resized.height) == 0);
+
+    // Nearest picks the pixel under each block's corner
+    grayscale_image_t nearest = make_resized_grayscale(&image, 20, 20, INTERPOLATION_NEAREST);
+    for (size_t j = 0; j < nearest.height; j++) {
+        for (size_t i = 0; i < nearest.width; i++) {
+            size_t x = i * width / nearest.width, y = j * height / nearest.height;
+            mu_assert("Resize nearest: pixel differs", nearest.data[j * nearest.width + i] == data[y * width + x]);
+        }
+    }
+
+    free(nearest.data);
+    free_rgb_image(&resized_rgb);
+    free(resized.data);
+    free(data);
+    return 0;
+}
+
+static double reference_kernel(interpolation_method_t method, double x) {
+    x = fabs(x);
+    if (method == INTERPOLATION_BILINEAR) return x < 1 ? 1 - x : 0;
+    if (method == INTERPOLATION_BICUBIC) {
+        if (x < 1) return 1.5 * x * x * x - 2.5 * x * x + 1;
+        return x < 2 ? -0.5 * x * x * x + 2.5 * x * x - 4 * x + 2 : 0;
+    }
+    if (x == 0) return 1;
+    if (x >= 3) return 0;
+    double px = 3.14159265358979323846 * x;
+    return 3 * sin(px) * sin(px / 3) / (px * px);
+}
+
+// Normalised weights of source pixels [0, src) for destination pixel i
+static void reference_weights(interpolation_method_t method, size_t src, size_t dst, size_t i, double *weights) {
+    double scale = (double)src / dst, stretch = scale > 1 ? scale : 1;
+    double center = (i + 0.5) * scale, support = (method == INTERPOLATION_BILINEAR ? 1 : method == INTERPOLATION_BICUBIC ? 2 : 3) * stretch;
+    double total = 0;
+    for (size_t x = 0; x < src; x++) {
+        bool inside = x + 0.5 >= center - support && x + 0.5 < center + support;
+        weights[x] = inside ? reference_kernel(method, (x + 0.5 - center) / stretch) : 0;
+        total += weights[x];
+    }
+    for (size_t x = 0; x < src; x++) {
+        weights[x] /= total;
+    }
+}
+
+char *test_resize_kernels() {
+    size_t width = 23, height = 17;
+    unsigned char *data = malloc(width * height);
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            data[y * width + x] = (unsigned char)(128 + 100 * sin(x * 0.7) * cos(y * 0.4));
+        }
+    }
+    grayscale_image_t image = { .width = width, .height = height, .data = data };
+
+    interpolation_method_t methods[] = { INTERPOLATION_BILINEAR, INTERPOLATION_BICUBIC, INTERPOLATION_LANCZOS3 };
+    size_t sizes[][2] = { { 9, 7 }, { 40, 31 } };   // Shrink, then enlarge
+    double wx[64], wy[64];
+
+    for (int m = 0; m < 3; m++) {
+        for (int s = 0; s < 2; s++) {
+            size_t out_w = sizes[s][0], out_h = sizes[s][1];
+            grayscale_image_t resized = resample_grayscale(&image, out_w, out_h, methods[m]);
+            mu_assert("Resize kernels: result is null", resized.data != NULL);
+
+            for (size_t j = 0; j < out_h; j++) {
+                reference_weights(methods[m], height, out_h, j, wy);
+                for (size_t i = 0; i < out_w; i++) {
+                    reference_weights(methods[m], width, out_w, i, wx);
+                    double expected = 0;
+                    for (size_t y = 0; y < height; y++) {
+                        for (size_t x = 0; x < width; x++) {
+                            expected += wy[y] * wx[x] * data[y * width + x];
+                        }
+                    }
+                    expected = expected < 0 ? 0 : expected > 255 ? 255 : expected;
+                    mu_assert("Resize kernels: pixel differs from the reference",
+                              fabs(resized.data[j * out_w + i] - expected) <= 1.0);
+                }
+            }
+
+            // The second call takes its weights from the cache
+            grayscale_image_t again = resample_grayscale(&image, out_w, out_h, methods[m]);
+            mu_assert("Resize kernels: cached weights give a different result",
+                      memcmp(again.data, resized.data, out_w * out_h) == 0);
+            free(again.data);
+            free(resized.data);
+        }
+    }
+
+    free(data);
+    return 0;
+}
+
+char *test_image_views() {
+    size_t width = 40, height = 30;
+    unsigned char *data = malloc(width * height);
+    for (size_t i = 0; i < width * height; i++) {
+        data[i] = (unsigned char)((i * 29) % 253);
+    }
+    grayscale_image_t image = { .width = width, .height = height, .data = data };
+
+    grayscale_image_t view = image_view_roi(&image, 5, 7, 21, 13);
+    mu_assert("View: should borrow the parent pixels", view.borrowed && view.data == data + 7 * width + 5);
+    mu_assert("View: should keep the parent stride", view.stride == width && grayscale_stride(&view) == width);
+    mu_assert("View: out-of-bounds rectangle should be rejected", image_view_roi(&image, 30, 0, 11, 1).data == NULL);
+
+    grayscale_image_t packed = copy_grayscale_image(&view);
+    mu_assert("View: copy should be packed and owned", packed.data != NULL && packed.stride == 0 && !packed.borrowed);
+    for (size_t y = 0; y < view.height; y++) {
+        mu_assert("View: copy differs", memcmp(packed.data + y * view.width, grayscale_row(&view, y), view.width) == 0);
+    }
+
+    // Stride-aware routines give the same result on the view and its copy
+    grayscale_image_t from_view = resample_grayscale(&view, 8, 5, INTERPOLATION_BICUBIC);
+    grayscale_image_t from_copy = resample_grayscale(&packed, 8, 5, INTERPOLATION_BICUBIC);
+    mu_assert("View: resampling differs", memcmp(from_view.data, from_copy.data, 8 * 5) == 0);
+    free(from_view.data);
+    free(from_copy.data);
+
+    from_view = apply_adaptive_thresholding(&view, 5, 1.0);
+    from_copy = apply_adaptive_thresholding(&packed, 5, 1.0);
+    mu_assert("View: thresholding differs", memcmp(from_view.data, from_copy.data, view.width * view.height) == 0);
+    free(from_view.data);
+    free(from_copy.data);
+
+    rgb_image_t rgb = { .width = width, .height = height, .r_data = data, .g_data = data, .b_data = data };
+    rgb_image_t rgb_view = image_view_roi_rgb(&rgb, 5, 7, 21, 13);
+    grayscale_image_t luma = rgb_to_grayscale(&rgb_view);
+    for (size_t i = 0; i < view.width * view.height; i++) {
+        mu_assert("View: luma differs", abs((int)luma.data[i] - (int)packed.data[i]) <= 1);
+    }
+    free(luma.data);
+
+    // Freeing a view leaves the parent alone
+    free_grayscale_image(&view);
+    free_rgb_image(&rgb_view);
+    mu_assert("View: free should clear the view", view.data == NULL && rgb_view.r_data == NULL);
+    mu_assert("View: parent should be untouched", data[0] == 0 && data[width * height - 1] == (unsigned char)(((width * height - 1) * 29) % 253));
+
+    free(packed.data);
+    free(data);
+    return 0;
+}
+
+char *test_image_alloc() {
+    // Three planes in one block, each on its own cache line
+    rgb_image_t rgb = allocate_rgb_image(37, 11);
+    mu_assert("Alloc: RGB image is null", rgb.r_data != NULL && rgb.contiguous);
+    mu_assert("Alloc: planes should be aligned",
+              (uintptr_t)rgb.r_data % IMAGE_ALIGNMENT == 0 && (uintptr_t)rgb.g_data % IMAGE_ALIGNMENT == 0 &&
+              (uintptr_t)rgb.b_data % IMAGE_ALIGNMENT == 0);
+    mu_assert("Alloc: planes should not overlap",
+              rgb.g_data >= rgb.r_data + 37 * 11 && rgb.b_data >= rgb.g_data + 37 * 11);
+    memset(rgb.r_data, 1, 37 * 11);
+    memset(rgb.g_data, 2, 37 * 11);
+    memset(rgb.b_data, 3, 37 * 11);
+    mu_assert("Alloc: planes should keep their pixels",
+              rgb.r_data[37 * 11 - 1] == 1 && rgb.g_data[0] == 2 && rgb.b_data[37 * 11 - 1] == 3);
+    mu_assert("Alloc: odd width rows are byte aligned only", rgb.alignment == 1);
+
+    grayscale_image_t luma = rgb_to_grayscale(&rgb);
+    mu_assert("Alloc: conversion result is null", luma.data != NULL && (uintptr_t)luma.data % IMAGE_ALIGNMENT == 0);
+    mu_assert("Alloc: conversion differs", luma.data[0] == 1);
+    free_grayscale_image(&luma);
+    free_rgb_image(&rgb);
+    mu_assert("Alloc: free should clear the image", rgb.r_data == NULL && !rgb.contiguous);
+
+    // Resizing and copying keep to the allocator
+    grayscale_image_t gray = allocate_grayscale_image(128, 3);
+    mu_assert("Alloc: grayscale image is null", gray.data != NULL && gray.alignment == IMAGE_ALIGNMENT);
+    memset(gray.data, 9, 128 * 3);
+    grayscale_image_t copy = copy_grayscale_image(&gray);
+    mu_assert("Alloc: copy should be aligned", (uintptr_t)copy.data % IMAGE_ALIGNMENT == 0 && copy.data[200] == 9);
+    rgb_image_t planes = { .width = 128, .height = 3, .r_data = gray.data, .g_data = gray.data, .b_data = copy.data };
+    rgb_image_t resized = resample_rgb(&planes, 40, 2, INTERPOLATION_BILINEAR);
+    mu_assert("Alloc: resized RGB should be one block", resized.contiguous && resized.b_data[79] == 9);
+    free_rgb_image(&resized);
+    free_grayscale_image(&copy);
+    free_grayscale_image(&gray);
+
+    // Frame-sized blocks take the huge page path and stay usable
+    size_t large = (size_t)IMAGE_HUGE_PAGE_THRESHOLD + 12345;
+    unsigned char* block = image_alloc(large);
+    mu_assert("Alloc: large block is null", block != NULL && (uintptr_t)block % IMAGE_ALIGNMENT == 0);
+    block[0] = 1;
+    block[large - 1] = 2;
+    mu_assert("Alloc: large block should be writable", block[0] + block[large - 1] == 3);
+    image_free(block);
+    mu_assert("Alloc: empty request should fail", image_alloc(0) == NULL);
+    return 0;
+}
+
+// Each band fills a scratch buffer and checks nobody else wrote to it
+static bool scratch_band(void* context, const row_band_t* band) {
+    scratch_mark_t mark = scratch_mark();
+    unsigned char* buffer = scratch_alloc(100000);
+    if (buffer == NULL) {
+        return false;
+    }
+    memset(buffer, (int)band->index + 1, 100000);
+    for (size_t i = 0; i < 100000; i++) {
+        if (buffer[i] != (unsigned char)(band->index + 1)) {
+            return false;
+        }
+    }
+    scratch_release(mark);
+    return true;
+}
+
+char *test_buffer_pool() {
+    // A released buffer serves the next request of its size class
+    unsigned char* first = image_buffer_acquire(100000);
+    mu_assert("Pool: buffer is null", first != NULL && (uintptr_t)first % IMAGE_ALIGNMENT == 0);
+    memset(first, 7, 100000);
+    image_buffer_release(first);
+    unsigned char* second = image_buffer_acquire(90000);
+    mu_assert("Pool: buffer should be reused", second == first);
+    unsigned char* third = image_buffer_acquire(90000);
+    mu_assert("Pool: live buffers must differ", third != NULL && third != second);
+    image_buffer_release(third);
+    image_buffer_release(second);
+
+    // Disabled, the pool hands out plain allocations
+    image_buffer_pool_set_enabled(false);
+    unsigned char* plain = image_buffer_acquire(100000);
+    mu_assert("Pool: disabled buffer is null", plain != NULL && (uintptr_t)plain % IMAGE_ALIGNMENT == 0);
+    plain[99999] = 1;
+    image_buffer_release(plain);
+    image_buffer_pool_set_enabled(true);
+    mu_assert("Pool: empty request should fail", image_buffer_acquire(0) == NULL);
+
+    // Scratch allocations are aligned, nest, and rewind to their mark
+    scratch_mark_t outer = scratch_mark();
+    unsigned char* a = scratch_alloc(10);
+    unsigned char* b = scratch_alloc(10);
+    mu_assert("Scratch: allocation is null", a != NULL && b != NULL);
+    mu_assert("Scratch: allocations should be aligned and apart",
+              (uintptr_t)a % IMAGE_ALIGNMENT == 0 && (uintptr_t)b % IMAGE_ALIGNMENT == 0 && b >= a + 10);
+    scratch_mark_t inner = scratch_mark();
+    unsigned char* c = scratch_alloc(10);
+    scratch_release(inner);
+    mu_assert("Scratch: release should rewind", scratch_alloc(10) == c);
+
+    // Requests beyond the chunk grow the arena; releasing returns to the first chunk
+    b[0] = 42;
+    unsigned char* large = scratch_alloc(3 << 20);
+    mu_assert("Scratch: large allocation is null", large != NULL);
+    memset(large, 5, 3 << 20);
+    mu_assert("Scratch: earlier allocations survive growth", b[0] == 42);
+    scratch_release(outer);
+    mu_assert("Scratch: arena should restart at the mark", scratch_alloc(10) == a);
+    scratch_release(outer);
+
+    // Worker threads get arenas of their own
+    set_thread_count(4);
+    mu_assert("Scratch: parallel bands failed", parallel_for(64, (size_t)1 << 20, 0, scratch_band, NULL));
+    set_thread_count(0);
+    return 0;
+}
+
 int main(int argc, char **argv) {
     char *result = all_tests();
     if (result != 0) {
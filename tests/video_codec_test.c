@@ -0,0 +1,120 @@
+#include "minunit.h"
+#include "../include/video_codec.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Forward declarations
+char *test_video_codec_round_trip();
+char *test_video_container_round_trip();
+
+#define CODEC_TEST_WIDTH 52
+#define CODEC_TEST_HEIGHT 44
+#define CODEC_TEST_FRAMES 6
+
+// Textured frame translated by (t * 1.25, t * 0.5) pixels
+static grayscale_image_t make_moving_frame(int t) {
+    grayscale_image_t frame = { .width = CODEC_TEST_WIDTH, .height = CODEC_TEST_HEIGHT };
+    frame.data = (unsigned char*)malloc(CODEC_TEST_WIDTH * CODEC_TEST_HEIGHT);
+    for (int y = 0; y < CODEC_TEST_HEIGHT; y++) {
+        for (int x = 0; x < CODEC_TEST_WIDTH; x++) {
+            double sx = x - t * 1.25;
+            double sy = y - t * 0.5;
+            double value = 128.0 + 45.0 * sin(0.3 * sx) + 45.0 * sin(0.25 * sy + 0.2 * sx);
+            frame.data[y * CODEC_TEST_WIDTH + x] = (unsigned char)lround(value);
+        }
+    }
+    return frame;
+}
+
+static double psnr(const grayscale_image_t* a, const grayscale_image_t* b) {
+    double mse = 0.0;
+    size_t n = a->width * a->height;
+    for (size_t i = 0; i < n; i++) {
+        double diff = (double)a->data[i] - (double)b->data[i];
+        mse += diff * diff;
+    }
+    mse /= n;
+    return mse == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+char *test_video_codec_round_trip() {
+    VideoEncoder* encoder = video_encoder_create(CODEC_TEST_WIDTH, CODEC_TEST_HEIGHT, 4, 75, 4);
+    mu_assert("Encoder should not be NULL", encoder != NULL);
+    VideoDecoder* decoder = video_decoder_create(&encoder->header);
+    mu_assert("Decoder should not be NULL", decoder != NULL);
+
+    size_t intra_bytes = 0, predicted_bytes = 0;
+    for (int t = 0; t < CODEC_TEST_FRAMES; t++) {
+        grayscale_image_t frame = make_moving_frame(t);
+        size_t packet_len = 0;
+        unsigned char* packet = video_encode_frame(encoder, &frame, &packet_len);
+        mu_assert("Packet should not be NULL", packet != NULL);
+        mu_assert("GOP should start with an intra frame",
+                  packet[0] == ((t % 4 == 0) ? VIDEO_FRAME_INTRA : VIDEO_FRAME_PREDICTED));
+        if (t == 0) intra_bytes = packet_len;
+        if (t == 1) predicted_bytes = packet_len;
+
+        grayscale_image_t decoded;
+        mu_assert("Packet should decode", video_decode_frame(decoder, packet, packet_len, &decoded));
+        mu_assert("Decoded size should match", decoded.width == frame.width && decoded.height == frame.height);
+        mu_assert("Decoder should track the encoder reconstruction",
+                  memcmp(decoded.data, encoder->reference.data, frame.width * frame.height) == 0);
+        mu_assert("Decoded frame quality should exceed 30 dB", psnr(&frame, &decoded) > 30.0);
+
+        free(packet);
+        free_grayscale_image(&decoded);
+        free_grayscale_image(&frame);
+    }
+    mu_assert("Predicted frame should be smaller than the intra frame", predicted_bytes < intra_bytes);
+
+    video_encoder_free(encoder);
+    video_decoder_free(decoder);
+    return 0;
+}
+
+char *test_video_container_round_trip() {
+    VideoStreamHeader header = { .width = 33, .height = 17, .gop_size = 12, .quality = 50 };
+    unsigned char packet[] = { VIDEO_FRAME_INTRA, 1, 2, 3, 4, 5 };
+
+    FILE* stream = tmpfile();
+    mu_assert("tmpfile should open", stream != NULL);
+    mu_assert("Header should be written", write_video_stream_header(stream, &header));
+    mu_assert("Packet should be written", write_video_packet(stream, packet, sizeof(packet)));
+    rewind(stream);
+
+    VideoStreamHeader read_header;
+    mu_assert("Header should be read", read_video_stream_header(stream, &read_header));
+    mu_assert("Header fields should round-trip",
+              read_header.width == 33 && read_header.height == 17 &&
+              read_header.gop_size == 12 && read_header.quality == 50);
+
+    size_t packet_len = 0;
+    unsigned char* read_packet = read_video_packet(stream, &packet_len);
+    mu_assert("Packet should be read", read_packet != NULL && packet_len == sizeof(packet));
+    mu_assert("Packet bytes should round-trip", memcmp(read_packet, packet, sizeof(packet)) == 0);
+    free(read_packet);
+    mu_assert("End of stream should return NULL", read_video_packet(stream, &packet_len) == NULL);
+
+    fclose(stream);
+    return 0;
+}
+
+char *all_tests() {
+    mu_run_test(test_video_codec_round_trip);
+    mu_run_test(test_video_container_round_trip);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    }
+    else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
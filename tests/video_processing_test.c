@@ -9,6 +9,10 @@
 char *test_video_io();
 char *test_motion_estimation();
 char *test_optical_flow();
+char *test_subpel_motion_estimation();
+char *test_frame_change_detector();
+char *test_scene_cut_histograms();
+char *test_background_subtraction();
 
 char *test_video_io() {
     // Assuming a test video file exists in the assets directory
@@ -108,6 +112,71 @@ char *test_motion_estimation() {
     return 0;
 }
 
+char *test_subpel_motion_estimation() {
+    int width = 48;
+    int height = 48;
+    int block_size = 8;
+    int search_window = 4;
+    double shift_x = 2.5; // Half-pixel horizontal motion
+    double shift_y = 1.0;
+
+    // Smooth pattern so the interpolated planes can reproduce the shift
+    grayscale_image_t reference_frame = { .width = width, .height = height };
+    grayscale_image_t current_frame = { .width = width, .height = height };
+    reference_frame.data = (unsigned char*)malloc(width * height);
+    current_frame.data = (unsigned char*)malloc(width * height);
+    mu_assert("Frame allocation failed", reference_frame.data != NULL && current_frame.data != NULL);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            reference_frame.data[y * width + x] = (unsigned char)round(128 + 45 * sin(0.5 * x) + 45 * sin(0.45 * y + 0.3 * x));
+            current_frame.data[y * width + x] = (unsigned char)round(128 + 45 * sin(0.5 * (x - shift_x)) + 45 * sin(0.45 * (y - shift_y) + 0.3 * (x - shift_x)));
+        }
+    }
+
+    SubpelReference* subpel_ref = build_subpel_reference(&reference_frame);
+    mu_assert("SubpelReference should not be NULL", subpel_ref != NULL);
+    mu_assert("Integer plane should match the reference", memcmp(subpel_ref->planes[0], reference_frame.data, width * height) == 0);
+
+    MotionVectorField* integer_field = estimate_motion(&current_frame, &reference_frame, block_size, search_window);
+    MotionVectorField* subpel_field = estimate_motion_subpel(&current_frame, subpel_ref, block_size, search_window, 4);
+    mu_assert("Motion vector fields should not be NULL", integer_field != NULL && subpel_field != NULL);
+
+    // An interior block should land on the half-pel phase: -2.5 = -3 + 2/4
+    MotionVector mv = subpel_field->vectors[(16 / block_size) * (width / block_size) + 16 / block_size];
+    mu_assert("Interior block dx should be -3 + 2/4", mv.dx == -3 && mv.frac_dx == 2);
+    mu_assert("Interior block dy should be -1", mv.dy == -1 && mv.frac_dy == 0);
+
+    grayscale_image_t* integer_compensated = compensate_motion(&reference_frame, integer_field, block_size);
+    grayscale_image_t* subpel_compensated = compensate_motion_subpel(subpel_ref, subpel_field, block_size);
+    mu_assert("Compensated frames should not be NULL", integer_compensated != NULL && subpel_compensated != NULL);
+
+    double integer_mse = 0.0, subpel_mse = 0.0;
+    int interior_pixels = (width - 2 * block_size) * (height - 2 * block_size);
+    for (int y = block_size; y < height - block_size; y++) {
+        for (int x = block_size; x < width - block_size; x++) {
+            int i = y * width + x;
+            integer_mse += pow(current_frame.data[i] - integer_compensated->data[i], 2);
+            subpel_mse += pow(current_frame.data[i] - subpel_compensated->data[i], 2);
+        }
+    }
+    integer_mse /= interior_pixels;
+    subpel_mse /= interior_pixels;
+    printf("Sub-pixel Compensation MSE: %f (integer: %f)\n", subpel_mse, integer_mse);
+    mu_assert("Sub-pixel compensation should beat integer compensation", subpel_mse < integer_mse);
+
+    free(reference_frame.data);
+    free(current_frame.data);
+    free_motion_vector_field(integer_field);
+    free_motion_vector_field(subpel_field);
+    free_grayscale_image(integer_compensated);
+    free(integer_compensated);
+    free_grayscale_image(subpel_compensated);
+    free(subpel_compensated);
+    free_subpel_reference(subpel_ref);
+
+    return 0;
+}
+
 char *test_optical_flow() {
     int width = 32;
     int height = 32;
@@ -163,7 +232,152 @@ char *test_optical_flow() {
     return 0;
 }
 
+char *test_frame_change_detector() {
+    int width = 70; // Not a multiple of the tile size, exercises the edge tiles
+    int height = 40;
+    grayscale_image_t frame = { .width = width, .height = height };
+    frame.data = (unsigned char*)malloc(width * height);
+    mu_assert("Frame allocation failed", frame.data != NULL);
+    for (int i = 0; i < width * height; i++) {
+        frame.data[i] = (unsigned char)((i * 37) % 251);
+    }
+
+    FrameChangeDetector* detector = create_frame_change_detector(width, height, 32);
+    mu_assert("Detector should not be NULL", detector != NULL);
+    mu_assert("Tile grid should cover the frame", detector->tiles_x == 3 && detector->tiles_y == 2);
+
+    mu_assert("First frame should mark every tile dirty", detect_frame_changes(detector, &frame, 2.0) == 6);
+    mu_assert("Identical frame should have no dirty tiles", detect_frame_changes(detector, &frame, 2.0) == 0);
+
+    // Low-amplitude noise stays under the threshold
+    for (int i = 0; i < width * height; i += 3) {
+        if (frame.data[i] < 255) frame.data[i]++;
+    }
+    mu_assert("Noise below threshold should be ignored", detect_frame_changes(detector, &frame, 2.0) == 0);
+
+    // A bright patch inside the bottom-right tile
+    for (int y = 34; y < 40; y++) {
+        for (int x = 66; x < 70; x++) {
+            frame.data[y * width + x] = 255;
+        }
+    }
+    mu_assert("Only the changed tile should be dirty", detect_frame_changes(detector, &frame, 2.0) == 1);
+    mu_assert("Dirty flag should be set on the bottom-right tile", detector->dirty[1 * 3 + 2] == 1);
+    mu_assert("Changed tile should be adopted as the new reference", detect_frame_changes(detector, &frame, 2.0) == 0);
+
+    free_frame_change_detector(detector);
+    free(frame.data);
+    return 0;
+}
+
+char *test_scene_cut_histograms() {
+    int width = 64;
+    int height = 48;
+    grayscale_image_t dark = { .width = width, .height = height };
+    grayscale_image_t dark_shifted = { .width = width, .height = height };
+    grayscale_image_t bright = { .width = width, .height = height };
+    dark.data = (unsigned char*)malloc(width * height);
+    dark_shifted.data = (unsigned char*)malloc(width * height);
+    bright.data = (unsigned char*)malloc(width * height);
+    mu_assert("Frame allocation failed", dark.data && dark_shifted.data && bright.data);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            dark.data[y * width + x] = (unsigned char)(20 + (x + y) % 60);
+            dark_shifted.data[y * width + x] = (unsigned char)(20 + (x + y + 7) % 60); // Same shot, camera pan
+            bright.data[y * width + x] = (unsigned char)(150 + (x * y) % 100);
+        }
+    }
+
+    unsigned int hist_dark[SCENE_HISTOGRAM_BINS], hist_shifted[SCENE_HISTOGRAM_BINS], hist_bright[SCENE_HISTOGRAM_BINS];
+    compute_luma_histogram(&dark, hist_dark);
+    compute_luma_histogram(&dark_shifted, hist_shifted);
+    compute_luma_histogram(&bright, hist_bright);
+
+    unsigned int total = 0;
+    for (int b = 0; b < SCENE_HISTOGRAM_BINS; b++) total += hist_dark[b];
+    mu_assert("Histogram should count every pixel", total == (unsigned int)(width * height));
+
+    mu_assert("Identical histograms should have zero distance", histogram_chi_square_distance(hist_dark, hist_dark) == 0.0);
+    mu_assert("Pan within a shot should stay below the cut threshold", histogram_chi_square_distance(hist_dark, hist_shifted) < 0.1);
+    mu_assert("Disjoint histograms should have chi-square distance 1", fabs(histogram_chi_square_distance(hist_dark, hist_bright) - 1.0) < 1e-9);
+    mu_assert("Disjoint histograms should have intersection distance 1", fabs(histogram_intersection_distance(hist_dark, hist_bright) - 1.0) < 1e-9);
+
+    // Two shots -> contact sheet with a one-pixel grid
+    grayscale_image_t thumbnails[2];
+    thumbnails[0] = make_thumbnail(&dark, 16);
+    thumbnails[1] = make_thumbnail(&bright, 16);
+    mu_assert("Thumbnail should keep the aspect ratio", thumbnails[0].width == 16 && thumbnails[0].height == 12);
+    grayscale_image_t sheet = make_contact_sheet(thumbnails, 2, 4);
+    mu_assert("Contact sheet should be two cells wide", sheet.width == 2 * 17 + 1 && sheet.height == 12 + 2);
+    mu_assert("Grid lines should be black", sheet.data[0] == 0 && sheet.data[17] == 0);
+    mu_assert("Second cell should hold the bright thumbnail", sheet.data[1 * sheet.width + 18] == thumbnails[1].data[0]);
+
+    free_grayscale_image(&sheet);
+    free_grayscale_image(&thumbnails[0]);
+    free_grayscale_image(&thumbnails[1]);
+    free(dark.data);
+    free(dark_shifted.data);
+    free(bright.data);
+    return 0;
+}
+
+char *test_background_subtraction() {
+    int width = 37; // Odd size exercises the scalar tail after the vector loop
+    int height = 23;
+    grayscale_image_t frame = { .width = width, .height = height };
+    frame.data = (unsigned char*)malloc(width * height);
+    mu_assert("Frame allocation failed", frame.data != NULL);
+
+    BackgroundModel* model = create_background_model(width, height, 3, 2.5);
+    mu_assert("Background model should not be NULL", model != NULL);
+
+    // Textured static background with +-2 levels of sensor noise
+    for (int t = 0; t < 24; t++) {
+        for (int i = 0; i < width * height; i++) {
+            int noise = ((i * 7 + t * 13) % 5) - 2;
+            frame.data[i] = (unsigned char)(60 + (i % 11) * 9 + noise);
+        }
+        grayscale_image_t* mask = subtract_background(model, &frame);
+        mu_assert("Mask should not be NULL", mask != NULL);
+        if (t > 0) {
+            int foreground = 0;
+            for (int i = 0; i < width * height; i++) foreground += mask->data[i] != 0;
+            mu_assert("Noise should not be classified as foreground", foreground == 0);
+        }
+    }
+
+    // A bright object enters the scene
+    for (int y = 8; y < 16; y++) {
+        for (int x = 20; x < 28; x++) {
+            frame.data[y * width + x] = 250;
+        }
+    }
+    grayscale_image_t* mask = subtract_background(model, &frame);
+    mu_assert("Mask should not be NULL", mask != NULL);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            bool inside = x >= 20 && x < 28 && y >= 8 && y < 16;
+            mu_assert("Mask should cover exactly the object", (mask->data[y * width + x] == 255) == inside);
+        }
+    }
+
+    grayscale_image_t blobs = connected_components(mask, 8);
+    mu_assert("Connected components should label the mask", blobs.data != NULL);
+    int labelled = 0;
+    for (int i = 0; i < width * height; i++) labelled += blobs.data[i] != 0;
+    mu_assert("The object should form one labelled blob", labelled == 64);
+
+    free(blobs.data);
+    free_background_model(model);
+    free(frame.data);
+    return 0;
+}
+
 char *all_tests() {
+    mu_run_test(test_subpel_motion_estimation);
+    mu_run_test(test_frame_change_detector);
+    mu_run_test(test_scene_cut_histograms);
+    mu_run_test(test_background_subtraction);
     mu_run_test(test_video_io);
     mu_run_test(test_motion_estimation);
     mu_run_test(test_optical_flow);